@@ -39,7 +39,7 @@
 #define HPP_FCL_BVH_FRONT_H
 
 
-#include <list>
+#include <vector>
 
 #include <hpp/fcl/config.hh>
 
@@ -68,7 +68,15 @@ struct HPP_FCL_DLLAPI BVHFrontNode
 };
 
 /// @brief BVH front list is a list of front nodes.
-typedef std::list<BVHFrontNode> BVHFrontList;
+/// The nodes are stored contiguously. Reusing the same front list for
+/// successive queries reuses its memory.
+typedef std::vector<BVHFrontNode> BVHFrontList;
+
+/// @brief Whether a front node is not valid anymore.
+inline bool isInvalidFrontNode(const BVHFrontNode& node)
+{
+  return !node.valid;
+}
 
 /// @brief Add new front node into the front list
 inline void updateFrontList(BVHFrontList* front_list, int b1, int b2)
@@ -45,6 +45,11 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
 
+namespace boost
+{
+class barrier;
+}
+
 namespace hpp
 {
 namespace fcl
@@ -58,6 +63,11 @@ class ConvexBase;
 template <typename BV> class BVFitter;
 template <typename BV> class BVSplitter;
 
+namespace details
+{
+template <typename BV> struct BVHModelIO;
+}
+
 /// @brief A base class describing the bounding hierarchy of a mesh model or a point cloud model (which is viewed as a degraded version of mesh)
 class HPP_FCL_DLLAPI BVHModelBase : public CollisionGeometry
 {
@@ -83,6 +93,17 @@ public:
   /// @brief Convex<Triangle> representation of this object
   boost::shared_ptr< ConvexBase > convex;
 
+  /// @brief Number of threads used by the bottom-up refit of endUpdateModel
+  /// and endReplaceModel. 1 (the default) refits serially and 0 uses as many
+  /// threads as the hardware supports.
+  unsigned int refit_num_threads;
+
+  /// @brief When strictly positive, the bottom-up refit rebuilds the subtrees
+  /// whose bounding volume size (see e.g. AABB::size) exceeds
+  /// rebuild_threshold times their size when the hierarchy was built.
+  /// The default, 0, never rebuilds the hierarchy during a refit.
+  FCL_REAL rebuild_threshold;
+
   /// @brief Model type described by the instance
   BVHModelType getModelType() const
   {
@@ -101,6 +122,8 @@ public:
                    num_tris(0),
                    num_vertices(0),
                    build_state(BVH_BUILD_STATE_EMPTY),
+                   refit_num_threads(1),
+                   rebuild_threshold(0),
                    num_tris_allocated(0),
                    num_vertices_allocated(0),
                    num_vertex_updated(0)
@@ -113,14 +136,24 @@ public:
   /// @brief deconstruction, delete mesh data related.
   virtual ~BVHModelBase ()
   {
-    delete [] vertices;
-    delete [] tri_indices;
+    if(!mapped_storage)
+    {
+      delete [] vertices;
+      delete [] tri_indices;
+    }
     delete [] prev_vertices;
   }
 
   /// @brief Get the object type: it is a BVH
   OBJECT_TYPE getObjectType() const { return OT_BVH; }
 
+  /// @brief Whether the geometry and the hierarchy are read-only views into
+  /// a memory mapped file (see \ref loadBVHModel).
+  /// Calls to beginModel(), beginReplaceModel(), beginUpdateModel() and
+  /// makeParentRelative() first copy the mapped data into memory owned by
+  /// this object.
+  bool isMemoryMapped() const { return mapped_storage.get() != NULL; }
+
   /// @brief Compute the AABB for the BVH, used for broad-phase collision
   void computeLocalAABB();
 
@@ -143,6 +176,8 @@ public:
   int endModel();
 
   /// @brief Replace the geometry information of current frame (i.e. should have the same mesh topology with the previous frame)
+  /// @note The bottom-up refit only updates the bounding volumes containing
+  /// vertices which moved in this frame or in the previous one.
   int beginReplaceModel();
 
   /// @brief Replace one point in the old BVH model
@@ -159,6 +194,8 @@ public:
 
   /// @brief Replace the geometry information of current frame (i.e. should have the same mesh topology with the previous frame).
   /// The current frame will be saved as the previous frame in prev_vertices.
+  /// @note The bottom-up refit only updates the bounding volumes containing
+  /// vertices which moved in this frame or in the previous one.
   int beginUpdateModel();
 
   /// @brief Update one point in the old BVH model
@@ -192,6 +229,8 @@ public:
   ///          (think of a U with 4 vertices and 3 edges).
   bool buildConvexHull(bool keepTriangle, const char* qhullCommand = NULL);
 
+  /// @brief Number of bytes used by the model.
+  /// @param msg if non zero, print the details on std::cerr.
   virtual int memUsage(int msg) const = 0;
 
   /// @brief This is a special acceleration: BVH_model default stores the BV's transform in world coordinate. However, we can also store each BV's transform related to its parent 
@@ -252,15 +291,41 @@ protected:
   virtual void deleteBVs() = 0;
   virtual bool allocateBVs() = 0;
 
+  /// @brief Copy the bounding volume arrays out of the memory mapped file.
+  virtual void unmapBVs() = 0;
+
+  /// @brief Copy the memory mapped arrays into memory owned by this object,
+  /// so that they can be modified. Does nothing if the model is not mapped.
+  void unmapStorage();
+
   /// @brief Build the bounding volume hierarchy
   virtual int buildTree() = 0;
 
   /// @brief Refit the bounding volume hierarchy
   virtual int refitTree(bool bottomup) = 0;
 
+  /// @brief Store p as the next vertex of the frame being replaced or
+  /// updated and record whether it moved.
+  void setNextVertex(const Vec3f& p)
+  {
+    const Vec3f& previous = (build_state == BVH_BUILD_STATE_UPDATE_BEGUN)
+      ? prev_vertices[num_vertex_updated] : vertices[num_vertex_updated];
+    if(p != previous) moved_vertices.push_back(num_vertex_updated);
+    vertices[num_vertex_updated] = p;
+    num_vertex_updated++;
+  }
+
   int num_tris_allocated;
   int num_vertices_allocated;
   int num_vertex_updated; /// for ccd vertex update
+
+  /// @brief Indices of the vertices which moved in the current frame and in
+  /// the previous frame.
+  std::vector<int> moved_vertices, prev_moved_vertices;
+
+  /// @brief Keeps alive the memory mapped file the arrays point into, if any.
+  /// When set, the arrays are not owned by this object.
+  boost::shared_ptr<const void> mapped_storage;
 };
 
 /// @brief A class describing the bounding hierarchy of a mesh model or a point cloud model (which is viewed as a degraded version of mesh)
@@ -285,8 +350,11 @@ public:
   /// @brief deconstruction, delete mesh data related.
   ~BVHModel()
   {
-    delete [] bvs;
-    delete [] primitive_indices;
+    if(!mapped_storage)
+    {
+      delete [] bvs;
+      delete [] primitive_indices;
+    }
   }
 
   /// @brief We provide getBV() and getNumBVs() because BVH may be compressed (in future), so we must provide some flexibility here
@@ -299,6 +367,7 @@ public:
   }
 
   /// @brief Access the bv giving the its index
+  /// @warning the BV must not be modified if the model is memory mapped.
   BVNode<BV>& getBV(int id)
   {
     assert (id < num_bvs);
@@ -314,20 +383,34 @@ public:
   /// @brief Get the BV type: default is unknown
   NODE_TYPE getNodeType() const { return BV_UNKNOWN; }
 
-  /// @brief Check the number of memory used
+  /// @brief Number of bytes used by the model.
+  /// @param msg if non zero, print the details on std::cerr.
   int memUsage(int msg) const;
 
   /// @brief This is a special acceleration: BVH_model default stores the BV's transform in world coordinate. However, we can also store each BV's transform related to its parent 
   /// BV node. When traversing the BVH, this can save one matrix transformation.
   void makeParentRelative()
   {
+    unmapStorage();
     Matrix3f I (Matrix3f::Identity());
     makeParentRelativeRecurse(0, I, Vec3f());
   }
 
+  /// @brief Improve the hierarchy of a built model with tree rotations.
+  /// Each pass visits the nodes bottom-up and exchanges a child of the node
+  /// with a grandchild when it reduces the surface area of the other child
+  /// (see computeBVHQuality). The bounding volumes are then refitted from the
+  /// primitives.
+  /// @param num_passes number of passes over the hierarchy.
+  /// @note this undoes makeParentRelative().
+  int optimizeTree(int num_passes = 1);
+
 private:
+  friend struct details::BVHModelIO<BV>;
+
   void deleteBVs();
   bool allocateBVs();
+  void unmapBVs();
 
   int num_bvs_allocated;
   unsigned int* primitive_indices;
@@ -347,14 +430,55 @@ private:
   /// @brief Refit the bounding volume hierarchy in a top-down way (slow but more compact)
   int refitTree_topdown();
 
-  /// @brief Refit the bounding volume hierarchy in a bottom-up way (fast but less compact)
+  /// @brief Refit the bounding volume hierarchy in a bottom-up way (fast but less compact).
+  /// Only the ancestors of the moved vertices are refitted.
   int refitTree_bottomup();
 
   /// @brief Recursive kernel for hierarchy construction
   int recursiveBuildTree(int bv_id, int first_primitive, int num_primitives);
 
-  /// @brief Recursive kernel for bottomup refitting 
-  int recursiveRefitTree_bottomup(int bv_id);
+  /// @brief Apply the tree rotations of optimizeTree to the subtree of
+  /// bv_id, from the leaves to bv_id.
+  /// @return the number of rotations.
+  int rotateTree(int bv_id);
+
+  /// @brief Copy the subtree of old_id of bvs at new_id of new_bvs, with the
+  /// layout of recursiveBuildTree. The primitive indices are rewritten in the
+  /// order of the leaves.
+  void relayoutTree(int old_id, int new_id, BVNode<BV>* new_bvs,
+                    int& next_node, int& next_primitive);
+
+  /// @brief Recompute the bounding volume of a node from its children or
+  /// from its primitive.
+  void refitNode(int bv_id);
+
+  /// @brief Refit the nodes of refit_levels of rank thread_id modulo
+  /// num_threads, from the deepest level to the root.
+  void refitLevels(unsigned int thread_id, unsigned int num_threads,
+                   boost::barrier* barrier);
+
+  /// @brief Rebuild the subtrees of the refitted nodes whose bounding volume
+  /// grew too much. See rebuild_threshold.
+  void rebuildDegradedSubtrees();
+
+  /// @brief Mark a node and its ancestors for refitting.
+  void markForRefit(int bv_id);
+
+  /// @brief Compute the caches of the incremental refit for the subtree of
+  /// bv_id, knowing the parent and depth of bv_id.
+  void computeRefitCaches(int bv_id);
+
+  /// @brief Parent and depth of each node, leaf of each primitive and size of
+  /// each bounding volume when built. Computed at the first refit.
+  std::vector<int> bv_parents, bv_depths, primitive_leaves;
+  std::vector<FCL_REAL> bv_built_sizes;
+  /// @brief Triangles of each vertex, in compressed row storage.
+  std::vector<int> vertex_triangles_offsets, vertex_triangles;
+
+  /// @brief Work memory of the refit: whether each node was refitted and
+  /// the refitted nodes sorted by depth.
+  std::vector<unsigned char> bv_refitted;
+  std::vector<std::vector<int> > refit_levels;
 
   /// @ recursively compute each bv's transform related to its parent. For default BV, only the translation works. 
   /// For oriented BV (OBB, RSS, OBBRSS), special implementation is provided.
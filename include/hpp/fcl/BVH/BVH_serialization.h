@@ -0,0 +1,91 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HPP_FCL_BVH_SERIALIZATION_H
+#define HPP_FCL_BVH_SERIALIZATION_H
+
+#include <string>
+
+#include <hpp/fcl/fwd.hh>
+#include <hpp/fcl/BVH/BVH_model.h>
+
+namespace hpp
+{
+namespace fcl
+{
+
+/// @addtogroup Construction_Of_BVH
+/// @{
+
+/// @brief Version of the binary file format written by saveBVHModel.
+static const unsigned int BVH_FILE_FORMAT_VERSION = 1;
+
+/// @brief Write a built BVHModel to a binary file.
+///
+/// The file stores the vertices, the triangle indices, the bounding volume
+/// nodes and the primitive indices in the native memory layout of the
+/// machine, so that it can be memory mapped by \ref loadBVHModel without any
+/// parsing. It is therefore only portable between machines with the same
+/// endianness and the same floating point and index sizes.
+///
+/// @param model a BVHModel whose hierarchy has been built (i.e. after
+///        \ref BVHModelBase::endModel).
+/// @param filename path of the file to write.
+/// @throw std::invalid_argument if the hierarchy is not built.
+/// @throw std::runtime_error if the file cannot be written.
+HPP_FCL_DLLAPI void saveBVHModel (const BVHModelBase& model,
+                                  const std::string& filename);
+
+/// @brief Read a BVHModel written by \ref saveBVHModel.
+///
+/// @param filename path of the file to read.
+/// @param memory_map when true, the file is mapped read-only in memory and
+///        the returned model points directly into the mapping. No data is
+///        copied and the pages are shared between all the processes that map
+///        the same file. When false, the data is copied into a model which
+///        owns its memory.
+/// @return a BVHModel<BV>, with BV the bounding volume type stored in the file.
+/// @throw std::runtime_error if the file cannot be read or was written
+///        with an incompatible format.
+/// @sa BVHModelBase::isMemoryMapped
+HPP_FCL_DLLAPI BVHModelPtr_t loadBVHModel (const std::string& filename,
+                                           bool memory_map = true);
+
+/// @}
+
+}
+
+} // namespace hpp
+
+#endif
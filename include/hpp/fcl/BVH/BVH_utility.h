@@ -39,6 +39,8 @@
 #ifndef HPP_FCL_BVH_UTILITY_H
 #define HPP_FCL_BVH_UTILITY_H
 
+#include <vector>
+
 #include <hpp/fcl/BVH/BVH_model.h>
 
 namespace hpp
@@ -76,6 +78,62 @@ template<>
 HPP_FCL_DLLAPI
 BVHModel<KDOP<24> >* BVHExtract(const BVHModel<KDOP<24> >& model, const Transform3f& pose, const AABB& aabb);
 
+/// @brief Statistics on the quality of a bounding volume hierarchy.
+/// \sa computeBVHQuality
+struct HPP_FCL_DLLAPI BVHQuality
+{
+  /// @brief Surface area heuristic cost of the hierarchy: expected cost of
+  /// a query of a random ray or object with the root, each internal node
+  /// costing traversal_cost and each primitive primitive_cost, weighted by the
+  /// probability to visit them. Lower is better.
+  FCL_REAL sah_cost;
+
+  /// @brief Number of leaves at each depth. The root has depth 0.
+  std::vector<int> depth_histogram;
+
+  /// @brief Depth of the deepest leaf.
+  int max_depth;
+
+  /// @brief Mean depth of the leaves.
+  FCL_REAL mean_leaf_depth;
+
+  /// @brief Number of leaves.
+  int num_leaves;
+
+  /// @brief Minimal, maximal and mean number of primitives in a leaf.
+  int min_leaf_primitives;
+  int max_leaf_primitives;
+  FCL_REAL mean_leaf_primitives;
+
+  /// @brief Mean, over the internal nodes of non zero volume, of the sum of
+  /// the volumes of the children divided by the volume of the node.
+  FCL_REAL mean_volume_ratio;
+
+  /// @brief Fraction of the internal nodes whose children overlap.
+  FCL_REAL overlap_ratio;
+};
+
+/// @brief Compute the quality statistics of a built hierarchy.
+/// The surface area of a bounding volume is approximated by the one of a box
+/// of dimensions width(), height() and depth().
+template<typename BV>
+HPP_FCL_DLLAPI
+BVHQuality computeBVHQuality(const BVHModel<BV>& model,
+                             FCL_REAL traversal_cost = 1,
+                             FCL_REAL primitive_cost = 1);
+
+namespace details
+{
+  /// @brief Surface area of the box of dimensions width(), height() and
+  /// depth() of a bounding volume.
+  template<typename BV>
+  inline FCL_REAL surfaceArea(const BV& bv)
+  {
+    FCL_REAL w = bv.width(), h = bv.height(), d = bv.depth();
+    return 2 * (w * h + h * d + d * w);
+  }
+}
+
 /// @brief Compute the covariance matrix for a set or subset of points. if ts = null, then indices refer to points directly; otherwise refer to triangles
 HPP_FCL_DLLAPI void getCovariance(Vec3f* ps, Vec3f* ps2, Triangle* ts, unsigned int* indices, int n, Matrix3f& M);
 
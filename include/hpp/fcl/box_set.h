@@ -0,0 +1,119 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HPP_FCL_BOX_SET_H
+#define HPP_FCL_BOX_SET_H
+
+#include <vector>
+
+#include <hpp/fcl/BV/AABB.h>
+#include <hpp/fcl/collision_object.h>
+
+namespace hpp
+{
+namespace fcl
+{
+
+/// @brief Set of solid axis aligned boxes, with a static AABB hierarchy
+///        whose leaves are the boxes.
+///
+/// The leaves are tested with the box narrow phase, so that a shape inside
+/// a box collides with it. Built from the merged boxes of an octree, a
+/// BoxSet answers the collision and distance queries of the octree with
+/// far fewer narrow phase tests.
+///
+/// A BoxSet can be used in collision and distance queries against the
+/// basic shapes. The indices of the boxes are reported in Contact::b1 (or
+/// b2) and DistanceResult::b1 (or b2).
+/// \sa LinearOcTree::toMergedBoxes
+class HPP_FCL_DLLAPI BoxSet : public CollisionGeometry
+{
+public:
+  /// @brief A node of the hierarchy.
+  struct Node
+  {
+    /// @brief Bounding box of the boxes below the node.
+    AABB bv;
+    /// @brief Index of the first child in the node array, the second child
+    ///        follows it. It is -1 for a leaf.
+    int first_child;
+    /// @brief Index of the box of a leaf, -1 for an inner node.
+    int box;
+
+    bool isLeaf() const { return first_child < 0; }
+  };
+
+  /// @brief build the hierarchy of a set of boxes
+  ///
+  /// The boxes are split recursively at the median of their centers, along
+  /// the longest side of the bounding box of the centers.
+  explicit BoxSet(const std::vector<AABB>& boxes);
+
+  /// @brief compute the AABB of the boxes in their local coordinate system
+  void computeLocalAABB();
+
+  /// @brief the boxes, in the order given to the constructor
+  const std::vector<AABB>& getBoxes() const
+  {
+    return boxes;
+  }
+
+  /// @brief the nodes of the hierarchy. The root is the first node, there is
+  ///        none when the set is empty.
+  const std::vector<Node>& getNodes() const
+  {
+    return nodes;
+  }
+
+  /// @brief return object type, it is a geometric shape
+  OBJECT_TYPE getObjectType() const { return OT_GEOM; }
+
+  /// @brief return node type, it is a set of boxes
+  NODE_TYPE getNodeType() const { return GEOM_BOX_SET; }
+
+private:
+  std::vector<AABB> boxes;
+  std::vector<Node> nodes;
+
+  /// @brief build the subtree of nodes[node] over the boxes
+  ///        indices[begin:end].
+  void build(std::size_t node, std::vector<int>& indices,
+             std::size_t begin, std::size_t end);
+};
+
+}
+
+} // namespace hpp
+
+#endif
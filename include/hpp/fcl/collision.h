@@ -43,6 +43,7 @@
 #include <hpp/fcl/collision_object.h>
 #include <hpp/fcl/collision_data.h>
 #include <hpp/fcl/collision_func_matrix.h>
+#include <hpp/fcl/profile.h>
 
 namespace hpp
 {
@@ -85,6 +86,38 @@ inline std::size_t collide(const CollisionGeometry* o1, const Transform3f& tf1,
   return res;
 }
 
+/// @brief Collision and distance between two objects in a single query.
+///
+/// Fills \c result as collide and \c distance_result as distance would.
+/// For two BVHModel<OBBRSS>, both are computed by a single traversal of the
+/// hierarchies, where the distance between two triangles also tells whether
+/// they collide. Other pairs of objects run collide and distance in turn.
+/// @return the number of contacts.
+HPP_FCL_DLLAPI std::size_t collideAndDistance(
+    const CollisionGeometry* o1, const Transform3f& tf1,
+    const CollisionGeometry* o2, const Transform3f& tf2,
+    const CollisionRequest& request, CollisionResult& result,
+    const DistanceRequest& distance_request, DistanceResult& distance_result);
+
+/// @brief Collision between an octree and several shapes.
+///
+/// The octree is descended once for all the shapes, each node being tested
+/// only against the shapes which overlap its parent. This is much faster
+/// than one call to collide per shape, for instance for a robot modelled by
+/// spheres and capsules.
+/// @param tree an OcTree or a LinearOcTree.
+/// @param shapes the shapes: boxes, spheres, capsules, cones, cylinders or
+///        convex.
+/// @param tfs the poses of the shapes.
+/// @retval results the result of each shape, with the octree as first
+///         object. It is resized to the number of shapes.
+/// @return the number of shapes in collision.
+HPP_FCL_DLLAPI std::size_t collide(
+    const CollisionGeometry* tree, const Transform3f& tf_tree,
+    const std::vector<const CollisionGeometry*>& shapes,
+    const std::vector<Transform3f>& tfs,
+    const CollisionRequest& request, std::vector<CollisionResult>& results);
+
 /// This class reduces the cost of identifying the geometry pair.
 /// This is mostly useful for repeated shape-shape queries.
 ///
@@ -92,6 +125,11 @@ inline std::size_t collide(const CollisionGeometry* o1, const Transform3f& tf1,
 ///   ComputeCollision calc_collision (o1, o2);
 ///   std::size_t ncontacts = calc_collision(tf1, tf2, request, result);
 /// \endcode
+///
+/// For two BVH models of the same type, the front of the traversal of the
+/// hierarchies can be kept between queries (see enableFrontList). The next
+/// query then starts from this front instead of the roots, which is faster
+/// when the relative pose of the objects changes little between queries.
 class HPP_FCL_DLLAPI ComputeCollision {
 public:
   ComputeCollision(const CollisionGeometry* o1, const CollisionGeometry* o2);
@@ -99,6 +137,9 @@ public:
   std::size_t operator()(const Transform3f& tf1, const Transform3f& tf2,
       const CollisionRequest& request, CollisionResult& result)
   {
+    time::point start;
+    if (request.enable_statistics) start = time::now();
+    solver.statistics = request.enable_statistics ? &result.statistics : NULL;
     bool cached = request.enable_cached_gjk_guess;
     solver.enable_cached_guess = cached;
     if (cached) {
@@ -107,7 +148,9 @@ public:
     }
 
     std::size_t res;
-    if (swap_geoms) {
+    if (front_list_enabled && front_func) {
+      res = front_func(o1, tf1, o2, tf2, request, result, &front_list);
+    } else if (swap_geoms) {
       res = func(o2, tf2, o1, tf1, &solver, request, result);
       result.swapObjects();
     } else {
@@ -118,6 +161,9 @@ public:
       result.cached_gjk_guess = solver.cached_guess;
       result.cached_support_func_guess = solver.support_func_cached_guess;
     }
+    if (request.enable_statistics)
+      result.statistics.time +=
+        (FCL_REAL) (time::now() - start).total_microseconds();
     return res;
   }
 
@@ -129,12 +175,34 @@ public:
     return res;
   }
 
+  /// @brief Whether to keep the front of the traversal between queries.
+  /// This only applies to two BVH models of the same type. The front is
+  /// cleared.
+  void enableFrontList(bool enable)
+  {
+    front_list_enabled = enable;
+    front_list.clear();
+  }
+
+  bool frontListEnabled() const { return front_list_enabled; }
+
+  /// @brief Forget the front of the previous query. This must be called
+  /// when one of the hierarchies is rebuilt.
+  void clearFrontList() { front_list.clear(); }
+
+  /// @brief The front of the last query.
+  const BVHFrontList& frontList() const { return front_list; }
+
 private:
   CollisionGeometry const *o1, *o2;
   GJKSolver solver;
 
   CollisionFunctionMatrix::CollisionFunc func;
   bool swap_geoms;
+
+  CollisionFunctionMatrix::CollisionFrontFunc front_func;
+  bool front_list_enabled;
+  BVHFrontList front_list;
 };
 
 } // namespace fcl
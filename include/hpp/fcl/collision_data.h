@@ -40,6 +40,7 @@
 #define HPP_FCL_COLLISION_DATA_H
 
 #include <vector>
+#include <algorithm>
 #include <set>
 #include <limits>
 
@@ -136,6 +137,86 @@ struct HPP_FCL_DLLAPI Contact
 
 struct QueryResult;
 
+/// @brief Statistics of a query, see QueryRequest::enable_statistics.
+///
+/// The counters are summed over the threads of the query.
+struct HPP_FCL_DLLAPI QueryStatistics
+{
+  /// @brief number of tests between pairs of bounding volumes
+  size_t num_bv_tests;
+
+  /// @brief number of tests between pairs of primitives
+  size_t num_leaf_tests;
+
+  /// @brief number of runs of GJK
+  size_t num_gjk_calls;
+
+  /// @brief number of iterations of GJK, over all the runs
+  size_t num_gjk_iterations;
+
+  /// @brief number of runs of EPA
+  size_t num_epa_calls;
+
+  /// @brief number of iterations of EPA, over all the runs
+  size_t num_epa_iterations;
+
+  /// @brief number of runs of EPA which did not reach the required
+  /// accuracy. Their penetration depth may be wrong.
+  size_t num_epa_failures;
+
+  /// @brief number of calls to the support functions, by GJK and EPA
+  size_t num_support_calls;
+
+  /// @brief number of pairs of nodes of the front list the traversal
+  /// started from. See BVHFrontList
+  size_t num_front_nodes_reused;
+
+  /// @brief duration of the query, in microseconds
+  FCL_REAL time;
+
+  QueryStatistics() { clear(); }
+
+  void clear()
+  {
+    num_bv_tests = num_leaf_tests = 0;
+    num_gjk_calls = num_gjk_iterations = 0;
+    num_epa_calls = num_epa_iterations = num_epa_failures = 0;
+    num_support_calls = 0;
+    num_front_nodes_reused = 0;
+    time = 0;
+  }
+
+  /// @brief add the counters of other. The time is not summed, since the
+  /// statistics of the threads of a query overlap in time.
+  QueryStatistics& operator += (const QueryStatistics& other)
+  {
+    num_bv_tests += other.num_bv_tests;
+    num_leaf_tests += other.num_leaf_tests;
+    num_gjk_calls += other.num_gjk_calls;
+    num_gjk_iterations += other.num_gjk_iterations;
+    num_epa_calls += other.num_epa_calls;
+    num_epa_iterations += other.num_epa_iterations;
+    num_epa_failures += other.num_epa_failures;
+    num_support_calls += other.num_support_calls;
+    num_front_nodes_reused += other.num_front_nodes_reused;
+    return *this;
+  }
+
+  bool operator == (const QueryStatistics& other) const
+  {
+    return num_bv_tests == other.num_bv_tests
+      && num_leaf_tests == other.num_leaf_tests
+      && num_gjk_calls == other.num_gjk_calls
+      && num_gjk_iterations == other.num_gjk_iterations
+      && num_epa_calls == other.num_epa_calls
+      && num_epa_iterations == other.num_epa_iterations
+      && num_epa_failures == other.num_epa_failures
+      && num_support_calls == other.num_support_calls
+      && num_front_nodes_reused == other.num_front_nodes_reused
+      && time == other.time;
+  }
+};
+
 /// @brief base class for all query requests
 struct HPP_FCL_DLLAPI QueryRequest
 {
@@ -148,12 +229,67 @@ struct HPP_FCL_DLLAPI QueryRequest
   /// @brief the support function intial guess set by user
   support_func_guess_t cached_support_func_guess;
 
+  /// @brief number of threads used to traverse the hierarchies of two
+  /// BVHModel. 0 means one thread per hardware thread.
+  /// @note the traversal is sequential when a front list is used.
+  unsigned int num_threads;
+
+  /// @brief maximal duration of the traversal of the hierarchies, in
+  /// microseconds. 0 means no limit.
+  /// When it is exceeded, the traversal stops and QueryResult::completed is
+  /// false. The time is checked between the tests of pairs of bounding
+  /// volumes, so a single narrow phase test is never interrupted.
+  /// @note the traversal is sequential when a budget is set.
+  FCL_REAL time_budget;
+
+  /// @brief maximal number of pairs of bounding volumes tested by the
+  /// traversal of the hierarchies. 0 means no limit.
+  /// \sa time_budget
+  size_t max_traversal_iterations;
+
+  /// @brief whether QueryResult::statistics is filled.
+  /// The statistics are not collected otherwise, which costs nothing.
+  bool enable_statistics;
+
+  /// @brief depth of the octree cells which are not subdivided, the root
+  /// being at depth 0. Such a cell is occupied when one of its descendants
+  /// is, so that the query is conservative: a collision at full depth is
+  /// also a collision at a lower depth, and the distance at a lower depth
+  /// is a lower bound of the distance at full depth.
+  /// The default value does not limit the depth.
+  unsigned int octree_max_depth;
+
+  /// @brief whether a depth-limited octree query is refined near contact.
+  /// The query is first run at octree_max_depth. It is run again at full
+  /// depth only when it finds a collision or, for the distance queries,
+  /// a distance below DistanceRequest::octree_refine_distance.
+  bool octree_refine;
+
   QueryRequest () :
     enable_cached_gjk_guess (false),
     cached_gjk_guess (1,0,0),
-    cached_support_func_guess(support_func_guess_t::Zero())
+    cached_support_func_guess(support_func_guess_t::Zero()),
+    num_threads (1),
+    time_budget (0),
+    max_traversal_iterations (0),
+    enable_statistics (false),
+    octree_max_depth ((std::numeric_limits<unsigned int>::max)()),
+    octree_refine (false)
   {}
 
+  /// @brief whether octree_max_depth limits the depth of the octree
+  /// queries.
+  bool hasOcTreeMaxDepth() const
+  {
+    return octree_max_depth != (std::numeric_limits<unsigned int>::max)();
+  }
+
+  /// @brief whether time_budget or max_traversal_iterations is set.
+  bool hasBudget() const
+  {
+    return time_budget > 0 || max_traversal_iterations > 0;
+  }
+
   void updateGuess(const QueryResult& result);
 
   /// @brief whether two QueryRequest are the same or not
@@ -161,7 +297,13 @@ struct HPP_FCL_DLLAPI QueryRequest
   {
     return enable_cached_gjk_guess == other.enable_cached_gjk_guess
       && cached_gjk_guess == other.cached_gjk_guess
-      && cached_support_func_guess == other.cached_support_func_guess;
+      && cached_support_func_guess == other.cached_support_func_guess
+      && num_threads == other.num_threads
+      && time_budget == other.time_budget
+      && max_traversal_iterations == other.max_traversal_iterations
+      && enable_statistics == other.enable_statistics
+      && octree_max_depth == other.octree_max_depth
+      && octree_refine == other.octree_refine;
   }
 };
 
@@ -173,6 +315,19 @@ struct HPP_FCL_DLLAPI QueryResult
 
   /// @brief stores the last support function vertex index, when relevant.
   support_func_guess_t cached_support_func_guess;
+
+  /// @brief false if the traversal stopped because the budget of the
+  /// request was exceeded. The result then holds what was found so far.
+  /// \sa QueryRequest::time_budget, QueryRequest::max_traversal_iterations
+  bool completed;
+
+  /// @brief statistics of the query, when
+  /// QueryRequest::enable_statistics is true.
+  /// @note the tests of bounding volumes and primitives are counted for
+  /// the hierarchies of BVHModel only.
+  QueryStatistics statistics;
+
+  QueryResult() : completed (true) {}
 };
 
 inline void QueryRequest::updateGuess(const QueryResult& result)
@@ -320,6 +475,8 @@ public:
   void clear()
   {
     contacts.clear();
+    completed = true;
+    statistics.clear();
   }
 
   /// @brief reposition Contact objects when fcl inverts them
@@ -329,6 +486,48 @@ public:
 
 struct DistanceResult;
 
+/// @brief Distance between a pair of primitives.
+/// See DistanceRequest::num_closest_pairs
+struct HPP_FCL_DLLAPI DistancePair
+{
+  /// @brief distance between the primitives
+  FCL_REAL distance;
+
+  /// @brief primitive in object 1 (triangle id for a mesh)
+  int b1;
+
+  /// @brief primitive in object 2 (triangle id for a mesh)
+  int b2;
+
+  /// @brief nearest points of the primitives, in world space
+  Vec3f nearest_points[2];
+
+  DistancePair() :
+    distance((std::numeric_limits<FCL_REAL>::max)()), b1(-1), b2(-1)
+  {}
+
+  DistancePair(FCL_REAL distance_, int b1_, int b2_, const Vec3f& p1,
+               const Vec3f& p2) :
+    distance(distance_), b1(b1_), b2(b2_)
+  {
+    nearest_points[0] = p1;
+    nearest_points[1] = p2;
+  }
+
+  /// @brief order of the pairs by increasing distance
+  bool operator<(const DistancePair& other) const
+  {
+    return distance < other.distance;
+  }
+
+  bool operator==(const DistancePair& other) const
+  {
+    return distance == other.distance && b1 == other.b1 && b2 == other.b2
+      && nearest_points[0] == other.nearest_points[0]
+      && nearest_points[1] == other.nearest_points[1];
+  }
+};
+
 /// @brief request to the distance computation
 struct HPP_FCL_DLLAPI DistanceRequest : QueryRequest
 {
@@ -339,6 +538,21 @@ struct HPP_FCL_DLLAPI DistanceRequest : QueryRequest
   FCL_REAL rel_err; // relative error, between 0 and 1
   FCL_REAL abs_err; // absoluate error
 
+  /// @brief Number of closest pairs of primitives returned in
+  /// DistanceResult::closest_pairs. The default value 0 only computes the
+  /// minimal distance.
+  /// \note only supported between two BVH models.
+  size_t num_closest_pairs;
+
+  /// @brief Pairs of primitives further than this distance are not returned
+  /// in DistanceResult::closest_pairs. Together with a large
+  /// num_closest_pairs, returns all the pairs closer than this distance.
+  FCL_REAL closest_pairs_max_distance;
+
+  /// @brief distance below which a depth-limited octree query is run again
+  /// at full depth. \sa QueryRequest::octree_refine
+  FCL_REAL octree_refine_distance;
+
   /// \param enable_nearest_points_ enables the nearest points computation.
   /// \param rel_err_
   /// \param abs_err_
@@ -347,7 +561,10 @@ struct HPP_FCL_DLLAPI DistanceRequest : QueryRequest
                   FCL_REAL abs_err_ = 0.0) :
     enable_nearest_points(enable_nearest_points_),
     rel_err(rel_err_),
-    abs_err(abs_err_)
+    abs_err(abs_err_),
+    num_closest_pairs(0),
+    closest_pairs_max_distance((std::numeric_limits<FCL_REAL>::max)()),
+    octree_refine_distance(0)
   {
   }
 
@@ -359,7 +576,10 @@ struct HPP_FCL_DLLAPI DistanceRequest : QueryRequest
     return QueryRequest::operator==(other)
       && enable_nearest_points == other.enable_nearest_points
       && rel_err == other.rel_err
-      && abs_err == other.abs_err;
+      && abs_err == other.abs_err
+      && num_closest_pairs == other.num_closest_pairs
+      && closest_pairs_max_distance == other.closest_pairs_max_distance
+      && octree_refine_distance == other.octree_refine_distance;
   }
 };
 
@@ -372,6 +592,12 @@ public:
   /// @brief minimum distance between two objects. if two objects are in collision, min_distance <= 0.
   FCL_REAL min_distance;
 
+  /// @brief lower bound of the distance between two objects, min_distance
+  /// being an upper bound. Both are equal when the query completed, up to
+  /// DistanceRequest::rel_err and DistanceRequest::abs_err.
+  /// \sa QueryResult::completed
+  FCL_REAL distance_lower_bound;
+
   /// @brief nearest points
   Vec3f nearest_points[2];
 
@@ -396,12 +622,18 @@ public:
   /// if object 2 is octree, it is the id of the cell
   int b2;
 
+  /// @brief closest pairs of primitives, by increasing distance.
+  /// Only computed if DistanceRequest::num_closest_pairs is positive.
+  std::vector<DistancePair> closest_pairs;
+
   /// @brief invalid contact primitive information
   static const int NONE = -1;
   
   DistanceResult(FCL_REAL min_distance_ =
                  (std::numeric_limits<FCL_REAL>::max)()):
-  min_distance(min_distance_), o1(NULL), o2(NULL), b1(NONE), b2(NONE)
+  min_distance(min_distance_),
+  distance_lower_bound((std::numeric_limits<FCL_REAL>::max)()),
+  o1(NULL), o2(NULL), b1(NONE), b2(NONE)
   {
     Vec3f nan (Vec3f::Constant(std::numeric_limits<FCL_REAL>::quiet_NaN()));
     nearest_points [0] = nearest_points [1] = normal = nan;
@@ -455,14 +687,35 @@ public:
     }
   }
 
+  /// @brief add a pair of primitives to closest_pairs, which is kept as a
+  /// max heap of at most num_pairs elements during the query.
+  void updateClosestPairs(const DistancePair& pair, size_t num_pairs)
+  {
+    if(closest_pairs.size() < num_pairs)
+    {
+      closest_pairs.push_back(pair);
+      std::push_heap(closest_pairs.begin(), closest_pairs.end());
+    }
+    else if(pair < closest_pairs.front())
+    {
+      std::pop_heap(closest_pairs.begin(), closest_pairs.end());
+      closest_pairs.back() = pair;
+      std::push_heap(closest_pairs.begin(), closest_pairs.end());
+    }
+  }
+
   /// @brief clear the result
   void clear()
   {
     min_distance = (std::numeric_limits<FCL_REAL>::max)();
+    distance_lower_bound = (std::numeric_limits<FCL_REAL>::max)();
     o1 = NULL;
     o2 = NULL;
     b1 = NONE;
     b2 = NONE;
+    closest_pairs.clear();
+    completed = true;
+    statistics.clear();
   }
 
   /// @brief whether two DistanceResult are the same or not
@@ -474,7 +727,8 @@ public:
                   && o1 == other.o1
                   && o2 == other.o2
                   && b1 == other.b1
-                  && b2 == other.b2;
+                  && b2 == other.b2
+                  && closest_pairs == other.closest_pairs;
 
 // TODO: check also that two GeometryObject are indeed equal.
     if ((o1 != NULL) ^ (other.o1 != NULL)) return false;
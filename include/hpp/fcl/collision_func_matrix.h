@@ -43,6 +43,7 @@
 #include <hpp/fcl/collision_object.h>
 #include <hpp/fcl/collision_data.h>
 #include <hpp/fcl/narrowphase/narrowphase.h>
+#include <hpp/fcl/BVH/BVH_front.h>
 
 namespace hpp
 {
@@ -63,6 +64,15 @@ struct HPP_FCL_DLLAPI CollisionFunctionMatrix
   /// @brief each item in the collision matrix is a function to handle collision between objects of type1 and type2
   CollisionFunc collision_matrix[NODE_COUNT][NODE_COUNT];
 
+  /// @brief the call interface for collision between two BVH models, which
+  /// starts from the front of the previous query and replaces it by the
+  /// front of this query. See BVHFrontList.
+  typedef std::size_t (*CollisionFrontFunc)(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const CollisionRequest& request, CollisionResult& result, BVHFrontList* front_list);
+
+  /// @brief each item is a function to handle collision between BVH models of
+  /// type1 and type2 with a front list, or NULL if not supported.
+  CollisionFrontFunc collision_front_matrix[NODE_COUNT][NODE_COUNT];
+
   CollisionFunctionMatrix();
 };
 
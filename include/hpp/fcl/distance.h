@@ -41,6 +41,7 @@
 #include <hpp/fcl/collision_object.h>
 #include <hpp/fcl/collision_data.h>
 #include <hpp/fcl/distance_func_matrix.h>
+#include <hpp/fcl/profile.h>
 
 namespace hpp
 {
@@ -88,13 +89,30 @@ inline FCL_REAL distance(const CollisionGeometry* o1, const Transform3f& tf1,
 ///   ComputeDistance calc_distance (o1, o2);
 ///   FCL_REAL distance = calc_distance(tf1, tf2, request, result);
 /// \endcode
+///
+/// For two BVH models of the same type, the front of the traversal of the
+/// hierarchies can be kept between queries (see enableFrontList). The next
+/// query then starts from this front instead of the roots, which is faster
+/// when the relative pose of the objects changes little between queries.
+/// The traversals of the hierarchies also reuse the memory of the previous
+/// queries, so that an instance must not be used by two threads at the same
+/// time.
 class HPP_FCL_DLLAPI ComputeDistance {
 public:
   ComputeDistance(const CollisionGeometry* o1, const CollisionGeometry* o2);
 
+  ComputeDistance(const ComputeDistance& other);
+
+  ComputeDistance& operator=(const ComputeDistance& other);
+
+  ~ComputeDistance();
+
   FCL_REAL operator()(const Transform3f& tf1, const Transform3f& tf2,
       const DistanceRequest& request, DistanceResult& result)
   {
+    time::point start;
+    if (request.enable_statistics) start = time::now();
+    solver.statistics = request.enable_statistics ? &result.statistics : NULL;
     bool cached = request.enable_cached_gjk_guess;
     solver.enable_cached_guess = cached;
     if (cached) {
@@ -103,7 +121,10 @@ public:
     }
 
     FCL_REAL res;
-    if (swap_geoms) {
+    if (front_func) {
+      res = front_func(o1, tf1, o2, tf2, request, result,
+          front_list_enabled ? &front_list : NULL, workspace);
+    } else if (swap_geoms) {
       res = func(o2, tf2, o1, tf1, &solver, request, result);
       if (request.enable_nearest_points) {
         std::swap(result.o1, result.o2);
@@ -117,6 +138,11 @@ public:
       result.cached_gjk_guess = solver.cached_guess;
       result.cached_support_func_guess = solver.support_func_cached_guess;
     }
+    result.distance_lower_bound = (std::min)(result.distance_lower_bound,
+                                             result.min_distance);
+    if (request.enable_statistics)
+      result.statistics.time +=
+        (FCL_REAL) (time::now() - start).total_microseconds();
     return res;
   }
 
@@ -128,12 +154,37 @@ public:
     return res;
   }
 
+  /// @brief Whether to keep the front of the traversal between queries.
+  /// This only applies to two BVH models of the same type. The front is
+  /// cleared.
+  void enableFrontList(bool enable)
+  {
+    front_list_enabled = enable;
+    front_list.clear();
+  }
+
+  bool frontListEnabled() const { return front_list_enabled; }
+
+  /// @brief Forget the front of the previous query. This must be called
+  /// when one of the hierarchies is rebuilt.
+  void clearFrontList() { front_list.clear(); }
+
+  /// @brief The front of the last query.
+  const BVHFrontList& frontList() const { return front_list; }
+
 private:
   CollisionGeometry const *o1, *o2;
   GJKSolver solver;
 
   DistanceFunctionMatrix::DistanceFunc func;
   bool swap_geoms;
+
+  DistanceFunctionMatrix::DistanceFrontFunc front_func;
+  bool front_list_enabled;
+  BVHFrontList front_list;
+  /// @brief the memory of the traversals of the hierarchies, owned by this
+  ///        instance. A copy has its own workspace.
+  DistanceTraversalWorkspace* workspace;
 };
 
 } // namespace fcl
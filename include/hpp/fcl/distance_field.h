@@ -0,0 +1,324 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HPP_FCL_DISTANCE_FIELD_H
+#define HPP_FCL_DISTANCE_FIELD_H
+
+#include <cmath>
+#include <vector>
+
+#include <hpp/fcl/BV/AABB.h>
+#include <hpp/fcl/collision_object.h>
+#include <hpp/fcl/linear_octree.h>
+#include <hpp/fcl/shape/geometric_shapes.h>
+
+namespace hpp
+{
+namespace fcl
+{
+
+/// @brief Signed Euclidean distance field of the occupied cells of an
+///        octree, sampled on a regular grid.
+///
+/// The grid covers a box of the frame of the octree. Its voxels are marked
+/// occupied when they overlap an occupied leaf of the octree, and the
+/// distance to the nearest occupied voxel (or, inside the obstacles, to the
+/// nearest free voxel) is computed with an exact Euclidean distance
+/// transform. The distances are truncated at a maximal distance, which
+/// bounds the part of the grid to recompute when the octree changes.
+///
+/// The distance at any point is the trilinear interpolation of the grid,
+/// which makes the queries cost a constant time, independent of the octree.
+/// The distance is an approximation, within about one voxel, of the
+/// distance to the occupied cells. Unknown space is free.
+///
+/// A DistanceField can be used in collision and distance queries against
+/// spheres and capsules. Since the distances are truncated, the field only
+/// tells that a shape whose center (or axis) is farther than the maximal
+/// distance is at least at getMaxDistance() - radius of the obstacles:
+/// - the collision queries throw if the radius of the shape plus the security
+///   margin is not below the maximal distance,
+/// - the distance queries then only set DistanceResult::distance_lower_bound
+///   and leave DistanceResult::min_distance unchanged.
+class HPP_FCL_DLLAPI DistanceField : public CollisionGeometry
+{
+public:
+  /// @brief build the distance field of an octree
+  /// @param tree an OcTree or a LinearOcTree.
+  /// @param resolution the size of the voxels of the grid.
+  /// @param bounds the box covered by the grid, in the frame of the octree.
+  /// @param max_distance the distances are truncated at max_distance, which
+  ///        must be positive.
+  template<typename OcTreeT>
+  DistanceField(const OcTreeT& tree, FCL_REAL resolution,
+                const AABB& bounds, FCL_REAL max_distance)
+  {
+    init(resolution, bounds, max_distance);
+    std::size_t imin[3] = { 0, 0, 0 };
+    std::size_t imax[3] = { size[0] - 1, size[1] - 1, size[2] - 1 };
+    rasterize(tree, imin, imax);
+    computeDistances(imin, imax);
+  }
+
+  /// @brief update the distance field after changes of the octree
+  /// @param region the box containing the cells which changed, in the
+  ///        frame of the octree.
+  ///
+  /// The distances are recomputed at less than the maximal distance of
+  /// region only.
+  template<typename OcTreeT>
+  void update(const OcTreeT& tree, const AABB& region)
+  {
+    std::size_t imin[3], imax[3];
+    if(!voxelRange(region, imin, imax)) return;
+    rasterize(tree, imin, imax);
+    computeDistances(imin, imax);
+  }
+
+  /// @brief signed distance at a point, negative inside the obstacles
+  /// @param p a point in the frame of the field. Outside of the grid, the
+  ///        distance is the one of the nearest point of the grid.
+  /// @retval gradient the gradient of the distance at p, if not NULL.
+  FCL_REAL distance(const Vec3f& p, Vec3f* gradient = NULL) const;
+
+  /// @brief whether a distance returned by distance() is truncated. The
+  ///        distance is then only known to be at least getMaxDistance().
+  bool isTruncated(FCL_REAL d) const
+  {
+    return d >= (FCL_REAL) (float) max_distance;
+  }
+
+  /// @brief signed distance between a sphere and the obstacles
+  /// @param center the center of the sphere, in the frame of the field.
+  /// @param radius the radius of the sphere.
+  /// @retval gradient the gradient of the distance with respect to the
+  ///         center, if not NULL.
+  FCL_REAL sphereDistance(const Vec3f& center, FCL_REAL radius,
+                          Vec3f* gradient = NULL) const
+  {
+    return distance(center, gradient) - radius;
+  }
+
+  /// @brief signed distance between a capsule and the obstacles
+  ///
+  /// The distance is the minimum of the distance along the axis of the
+  /// capsule, sampled every half voxel.
+  /// @param a, b the extremities of the axis of the capsule, in the frame
+  ///        of the field.
+  /// @param radius the radius of the capsule.
+  /// @retval gradient the gradient of the distance with respect to a
+  ///         translation of the capsule, if not NULL.
+  /// @retval nearest the point of the axis where the distance is minimal,
+  ///         if not NULL.
+  FCL_REAL capsuleDistance(const Vec3f& a, const Vec3f& b, FCL_REAL radius,
+                           Vec3f* gradient = NULL, Vec3f* nearest = NULL) const;
+
+  /// @brief signed distances between a set of spheres and the obstacles
+  /// @param centers the centers of the spheres, in the frame of the field.
+  /// @param radii the radii of the spheres.
+  /// @retval distances the distances of the spheres.
+  /// @retval gradients the gradients of the distances, if not NULL.
+  void sphereDistances(const std::vector<Vec3f>& centers,
+                       const std::vector<FCL_REAL>& radii,
+                       std::vector<FCL_REAL>& distances,
+                       std::vector<Vec3f>* gradients = NULL) const;
+
+  /// @brief signed distances between a set of capsules and the obstacles
+  /// @param a, b the extremities of the axes of the capsules, in the frame
+  ///        of the field.
+  /// @param radii the radii of the capsules.
+  /// @retval distances the distances of the capsules.
+  /// @retval gradients the gradients of the distances, if not NULL.
+  /// \sa capsuleDistance
+  void capsuleDistances(const std::vector<Vec3f>& a,
+                        const std::vector<Vec3f>& b,
+                        const std::vector<FCL_REAL>& radii,
+                        std::vector<FCL_REAL>& distances,
+                        std::vector<Vec3f>* gradients = NULL) const;
+
+  /// @brief signed distance between a sphere and the obstacles
+  /// @param s the sphere.
+  /// @param tf the pose of the sphere in the frame of the field.
+  /// @retval p1 the nearest point of the obstacles, estimated by following
+  ///         the gradient.
+  /// @retval p2 the nearest point of the sphere.
+  /// @retval normal the unit normal pointing from the obstacles to the
+  ///         sphere.
+  /// @retval truncated whether the distance is truncated, if not NULL. The
+  ///         distance is then only known to be at least
+  ///         getMaxDistance() - s.radius.
+  FCL_REAL shapeDistance(const Sphere& s, const Transform3f& tf,
+                         Vec3f& p1, Vec3f& p2, Vec3f& normal,
+                         bool* truncated = NULL) const;
+
+  /// @brief signed distance between a capsule and the obstacles
+  /// \sa shapeDistance(const Sphere&, const Transform3f&, Vec3f&, Vec3f&, Vec3f&, bool*) const
+  FCL_REAL shapeDistance(const Capsule& s, const Transform3f& tf,
+                         Vec3f& p1, Vec3f& p2, Vec3f& normal,
+                         bool* truncated = NULL) const;
+
+  /// @brief compute the AABB of the grid in its local coordinate system
+  void computeLocalAABB()
+  {
+    aabb_local = getBounds();
+    aabb_center = aabb_local.center();
+    aabb_radius = (aabb_local.min_ - aabb_center).norm();
+  }
+
+  /// @brief the box covered by the grid
+  AABB getBounds() const
+  {
+    Vec3f extent (resolution * (FCL_REAL) size[0],
+                  resolution * (FCL_REAL) size[1],
+                  resolution * (FCL_REAL) size[2]);
+    return AABB(origin, origin + extent);
+  }
+
+  /// @brief the size of the voxels
+  FCL_REAL getResolution() const { return resolution; }
+
+  /// @brief the distance at which the distances are truncated
+  FCL_REAL getMaxDistance() const { return max_distance; }
+
+  /// @brief the number of voxels along axis i
+  std::size_t getSize(int i) const { return size[i]; }
+
+  /// @brief the distance at the center of a voxel
+  FCL_REAL getVoxelDistance(std::size_t i, std::size_t j, std::size_t k) const
+  {
+    return values[index(i, j, k)];
+  }
+
+  /// @brief whether a voxel is occupied
+  bool isVoxelOccupied(std::size_t i, std::size_t j, std::size_t k) const
+  {
+    return occupied[index(i, j, k)] != 0;
+  }
+
+  /// @brief return object type, it is a geometry
+  OBJECT_TYPE getObjectType() const { return OT_GEOM; }
+
+  /// @brief return node type, it is a distance field
+  NODE_TYPE getNodeType() const { return GEOM_DISTANCE_FIELD; }
+
+private:
+  FCL_REAL resolution;
+  FCL_REAL max_distance;
+  /// @brief the corner of the first voxel
+  Vec3f origin;
+  std::size_t size[3];
+
+  /// @brief the truncated signed distance at the center of the voxels
+  std::vector<float> values;
+  std::vector<unsigned char> occupied;
+
+  std::size_t index(std::size_t i, std::size_t j, std::size_t k) const
+  {
+    return i + size[0] * (j + size[1] * k);
+  }
+
+  void init(FCL_REAL resolution, const AABB& bounds, FCL_REAL max_distance);
+
+  /// @brief the range of the voxels which overlap a box.
+  /// @return false if the box does not overlap the grid.
+  bool voxelRange(const AABB& box, std::size_t imin[3], std::size_t imax[3]) const;
+
+  /// @brief recompute the distances of the voxels which are nearer than
+  ///        the maximal distance from the voxels [imin, imax].
+  void computeDistances(const std::size_t imin[3], const std::size_t imax[3]);
+
+  /// @brief mark the voxels [imin, imax] which overlap an occupied leaf.
+  template<typename OcTreeT>
+  void rasterize(const OcTreeT& tree, const std::size_t imin[3],
+                 const std::size_t imax[3])
+  {
+    for(std::size_t k = imin[2]; k <= imax[2]; ++k)
+      for(std::size_t j = imin[1]; j <= imax[1]; ++j)
+        for(std::size_t i = imin[0]; i <= imax[0]; ++i)
+          occupied[index(i, j, k)] = 0;
+    if(!tree.getRoot()) return;
+
+    Vec3f lower (origin), upper (origin);
+    for(int a = 0; a < 3; ++a)
+    {
+      lower[a] += resolution * (FCL_REAL) imin[a];
+      upper[a] += resolution * (FCL_REAL) (imax[a] + 1);
+    }
+    const AABB region (lower, upper);
+
+    typedef typename OcTreeT::OcTreeNode Node;
+    std::vector<std::pair<const Node*, AABB> > stack;
+    stack.push_back(std::make_pair(tree.getRoot(), tree.getRootBV()));
+    while(!stack.empty())
+    {
+      const Node* node = stack.back().first;
+      AABB bv = stack.back().second;
+      stack.pop_back();
+      if(!bv.overlap(region) || tree.isNodeFree(node)) continue;
+
+      if(!tree.nodeHasChildren(node))
+      {
+        std::size_t cmin[3], cmax[3];
+        if(tree.isNodeOccupied(node) && voxelRange(bv, cmin, cmax))
+        {
+          for(int a = 0; a < 3; ++a)
+          {
+            cmin[a] = std::max(cmin[a], imin[a]);
+            cmax[a] = std::min(cmax[a], imax[a]);
+          }
+          for(std::size_t k = cmin[2]; k <= cmax[2]; ++k)
+            for(std::size_t j = cmin[1]; j <= cmax[1]; ++j)
+              for(std::size_t i = cmin[0]; i <= cmax[0]; ++i)
+                occupied[index(i, j, k)] = 1;
+        }
+        continue;
+      }
+      for(unsigned int i = 0; i < 8; ++i)
+      {
+        if(tree.nodeChildExists(node, i))
+        {
+          AABB child_bv;
+          computeChildBV(bv, i, child_bv);
+          stack.push_back(std::make_pair(tree.getNodeChild(node, i), child_bv));
+        }
+      }
+    }
+  }
+};
+
+}
+
+} // namespace hpp
+
+#endif
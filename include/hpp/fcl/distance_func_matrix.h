@@ -41,12 +41,15 @@
 #include <hpp/fcl/collision_object.h>
 #include <hpp/fcl/collision_data.h>
 #include <hpp/fcl/narrowphase/narrowphase.h>
+#include <hpp/fcl/BVH/BVH_front.h>
 
 namespace hpp
 {
 namespace fcl
 {
 
+struct DistanceTraversalWorkspace;
+
 /// @brief distance matrix stores the functions for distance between different types of objects and provides a uniform call interface
 struct HPP_FCL_DLLAPI DistanceFunctionMatrix
 {
@@ -62,6 +65,21 @@ struct HPP_FCL_DLLAPI DistanceFunctionMatrix
   /// @brief each item in the distance matrix is a function to handle distance between objects of type1 and type2
   DistanceFunc distance_matrix[NODE_COUNT][NODE_COUNT];
 
+  /// @brief the call interface for distance between two BVH models, which
+  /// starts from the front of the previous query and replaces it by the
+  /// front of this query, if front_list is not NULL. See BVHFrontList.
+  /// The traversal reuses the memory of workspace, if not NULL.
+  typedef FCL_REAL (*DistanceFrontFunc)(const CollisionGeometry* o1, const Transform3f& tf1,
+                                        const CollisionGeometry* o2, const Transform3f& tf2,
+                                        const DistanceRequest& request, DistanceResult& result,
+                                        BVHFrontList* front_list,
+                                        DistanceTraversalWorkspace* workspace);
+
+  /// @brief each item is a function to handle distance between BVH models of
+  /// type1 and type2 with a front list and a workspace, or NULL if not
+  /// supported.
+  DistanceFrontFunc distance_front_matrix[NODE_COUNT][NODE_COUNT];
+
   DistanceFunctionMatrix();
 };
 
@@ -53,6 +53,49 @@ class HPP_FCL_DLLAPI Intersect
 public:
   static bool buildTrianglePlane
     (const Vec3f& v1, const Vec3f& v2, const Vec3f& v3, Vec3f* n, FCL_REAL* t);
+
+  /// @brief Check whether triangles (P1, P2, P3) and (Q1, Q2, Q3) intersect,
+  /// using the separating axis theorem.
+  ///
+  /// The axes are the normals of the triangles, the cross products of their
+  /// edges and, for coplanar triangles, the normals of the edges in the
+  /// plane. The axes are not normalized.
+  /// @retval sqrDistLowerBound if not NULL and the triangles do not
+  ///         intersect, squared lower bound of the distance between them,
+  ///         given by the first separating axis found. Left untouched
+  ///         otherwise.
+  /// @return true if the triangles intersect or touch.
+  static bool intersectTriangles
+    (const Vec3f& P1, const Vec3f& P2, const Vec3f& P3,
+     const Vec3f& Q1, const Vec3f& Q2, const Vec3f& Q3,
+     FCL_REAL* sqrDistLowerBound = NULL);
+
+  /// @brief Check whether triangle (P1, P2, P3) is closer than margin to the
+  /// box centered at the origin, aligned with the axes, whose half side
+  /// lengths are halfSide.
+  ///
+  /// The separating axes are the axes of the box, the normal of the triangle
+  /// and the cross products of the axes of the box with the edges of the
+  /// triangle.
+  /// @retval sqrDistLowerBound if not NULL and the function returns false,
+  ///         squared lower bound of the distance between the triangle and
+  ///         the box. Left untouched otherwise.
+  /// @return false if a separating axis proves that the distance between
+  ///         the triangle and the box is more than margin.
+  static bool intersectTriangleBox
+    (const Vec3f& P1, const Vec3f& P2, const Vec3f& P3,
+     const Vec3f& halfSide, FCL_REAL margin,
+     FCL_REAL* sqrDistLowerBound = NULL);
+
+  /// @brief Squared distance between segment [P1, P2] and the box centered
+  /// at the origin, aligned with the axes, whose half side lengths are
+  /// halfSide.
+  ///
+  /// The squared distance to the box is a convex piecewise quadratic
+  /// function along the segment. It is minimized exactly on each piece,
+  /// the pieces being delimited by the crossings of the faces planes.
+  static FCL_REAL sqrDistanceSegmentBox
+    (const Vec3f& P1, const Vec3f& P2, const Vec3f& halfSide);
 }; // class Intersect
 
 /// @brief Project functions
@@ -43,12 +43,74 @@
 #include <hpp/fcl/data_types.h>
 #include <hpp/fcl/math/transform.h>
 #include <hpp/fcl/collision_data.h>
+#include <hpp/fcl/profile.h>
 
 namespace hpp
 {
 namespace fcl
 {
 
+namespace details
+{
+
+/// @brief Budget of a traversal, given by QueryRequest::time_budget and
+/// QueryRequest::max_traversal_iterations.
+class TraversalBudget
+{
+public:
+  TraversalBudget() : active(false), exhausted(false) {}
+
+  /// @brief Start the budget of a new query.
+  void start(const QueryRequest& request)
+  {
+    iterations = 0;
+    max_iterations = request.max_traversal_iterations;
+    has_deadline = (request.time_budget > 0);
+    if(has_deadline)
+      deadline = time::now() + boost::posix_time::microseconds(
+          static_cast<long>(request.time_budget));
+    active = request.hasBudget();
+    exhausted = false;
+    remaining_lower_bound = (std::numeric_limits<FCL_REAL>::max)();
+  }
+
+  /// @brief Count one tested pair of bounding volumes.
+  /// @return whether the traversal must stop.
+  bool consume()
+  {
+    if(!active) return false;
+    if(exhausted) return true;
+    ++iterations;
+    if(max_iterations > 0 && iterations > max_iterations)
+      exhausted = true;
+    // Reading the clock costs more than a bounding volume test.
+    else if(has_deadline && iterations % 32 == 0 && time::now() >= deadline)
+      exhausted = true;
+    return exhausted;
+  }
+
+  /// @brief Whether the traversal stopped because of the budget.
+  bool isExhausted() const { return exhausted; }
+
+  /// @brief Account for the distance lower bound of a pair of bounding
+  /// volumes left unvisited.
+  void updateRemainingLowerBound(FCL_REAL d)
+  {
+    if(d < remaining_lower_bound) remaining_lower_bound = d;
+  }
+
+  /// @brief Lower bound of the distance of the pairs left unvisited.
+  FCL_REAL remainingLowerBound() const { return remaining_lower_bound; }
+
+private:
+  bool active, exhausted, has_deadline;
+  size_t iterations, max_iterations;
+  time::point deadline;
+  FCL_REAL remaining_lower_bound;
+};
+
+} // namespace details
+
 /// @brief Node structure encoding the information required for traversal.
 
 class TraversalNodeBase
@@ -94,6 +156,9 @@ public:
 
   /// @brief Whether stores statistics
   bool enable_statistics;
+
+  /// @brief Budget of the traversal
+  mutable details::TraversalBudget budget;
 };
 
 /// @defgroup Traversal_For_Collision
@@ -105,7 +170,7 @@ class CollisionTraversalNodeBase : public TraversalNodeBase
 {
 public:
   CollisionTraversalNodeBase (const CollisionRequest& request_) :
-  request (request_), result(NULL) {}
+  request (request_), result(NULL), enable_statistics(false) {}
 
   virtual ~CollisionTraversalNodeBase() {}
 
@@ -166,6 +231,23 @@ public:
   virtual bool canStop(FCL_REAL /*c*/) const
   { return false; }
 
+  /// @brief Set the distance lower bound and the completion of the result,
+  /// once the traversal is over.
+  void finishTraversal() const
+  {
+    FCL_REAL d = result->min_distance;
+    // The pruned pairs were at least this far, see canStop.
+    FCL_REAL lb = (std::min)(d, (std::max)(d - request.abs_err,
+                                           d / (1 + request.rel_err)));
+    if(budget.isExhausted())
+    {
+      result->completed = false;
+      lb = (std::min)(lb, budget.remainingLowerBound());
+    }
+    if(lb < result->distance_lower_bound)
+      result->distance_lower_bound = lb;
+  }
+
   /// @brief request setting for distance
   DistanceRequest request;
 
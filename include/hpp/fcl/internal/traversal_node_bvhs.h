@@ -139,6 +139,107 @@ public:
   mutable FCL_REAL query_time_seconds;
 };
 
+namespace details
+{
+  /// @brief Overlap test between a triangle and a bounding volume, expressed
+  /// in the same frame.
+  ///
+  /// Only available for the bounding volumes made of a box or a rectangle.
+  /// @param margin the triangle and the bounding volume are considered
+  ///        disjoint if their distance is more than margin.
+  /// @retval sqrDistLowerBound squared lower bound of the distance between
+  ///         the triangle and the bounding volume if they are disjoint.
+  template<typename BV> struct TriangleBVOverlap
+  {
+    enum { Available = false };
+    static bool run(const BV&, const Vec3f&, const Vec3f&, const Vec3f&,
+                    FCL_REAL, FCL_REAL&)
+    {
+      return true;
+    }
+  };
+
+  inline bool triangleOBBOverlap(const OBB& obb, const Vec3f& P1,
+      const Vec3f& P2, const Vec3f& P3, FCL_REAL margin,
+      FCL_REAL& sqrDistLowerBound)
+  {
+    return Intersect::intersectTriangleBox(
+        obb.axes.transpose() * (P1 - obb.To),
+        obb.axes.transpose() * (P2 - obb.To),
+        obb.axes.transpose() * (P3 - obb.To),
+        obb.extent, margin, &sqrDistLowerBound);
+  }
+
+  template<> struct TriangleBVOverlap<AABB>
+  {
+    enum { Available = true };
+    static bool run(const AABB& bv, const Vec3f& P1, const Vec3f& P2,
+                    const Vec3f& P3, FCL_REAL margin,
+                    FCL_REAL& sqrDistLowerBound)
+    {
+      const Vec3f c (bv.center());
+      return Intersect::intersectTriangleBox(P1 - c, P2 - c, P3 - c,
+          (bv.max_ - bv.min_) / 2, margin, &sqrDistLowerBound);
+    }
+  };
+
+  template<> struct TriangleBVOverlap<OBB>
+  {
+    enum { Available = true };
+    static bool run(const OBB& bv, const Vec3f& P1, const Vec3f& P2,
+                    const Vec3f& P3, FCL_REAL margin,
+                    FCL_REAL& sqrDistLowerBound)
+    {
+      return triangleOBBOverlap(bv, P1, P2, P3, margin, sqrDistLowerBound);
+    }
+  };
+
+  template<> struct TriangleBVOverlap<OBBRSS>
+  {
+    enum { Available = true };
+    static bool run(const OBBRSS& bv, const Vec3f& P1, const Vec3f& P2,
+                    const Vec3f& P3, FCL_REAL margin,
+                    FCL_REAL& sqrDistLowerBound)
+    {
+      return triangleOBBOverlap(bv.obb, P1, P2, P3, margin, sqrDistLowerBound);
+    }
+  };
+
+  template<> struct TriangleBVOverlap<kIOS>
+  {
+    enum { Available = true };
+    static bool run(const kIOS& bv, const Vec3f& P1, const Vec3f& P2,
+                    const Vec3f& P3, FCL_REAL margin,
+                    FCL_REAL& sqrDistLowerBound)
+    {
+      return triangleOBBOverlap(bv.obb, P1, P2, P3, margin, sqrDistLowerBound);
+    }
+  };
+
+  template<> struct TriangleBVOverlap<RSS>
+  {
+    enum { Available = true };
+    static bool run(const RSS& bv, const Vec3f& P1, const Vec3f& P2,
+                    const Vec3f& P3, FCL_REAL margin,
+                    FCL_REAL& sqrDistLowerBound)
+    {
+      // The rectangle is a flat box, the radius is added to the margin.
+      const Vec3f halfSide (bv.length[0] / 2, bv.length[1] / 2, 0);
+      const Vec3f c (bv.Tr + bv.axes * halfSide);
+      FCL_REAL sqrRectDistance;
+      if (Intersect::intersectTriangleBox(
+            bv.axes.transpose() * (P1 - c),
+            bv.axes.transpose() * (P2 - c),
+            bv.axes.transpose() * (P3 - c),
+            halfSide, margin + bv.radius, &sqrRectDistance))
+        return true;
+      FCL_REAL distance = sqrt(sqrRectDistance) - bv.radius;
+      sqrDistLowerBound = distance * distance;
+      return false;
+    }
+  };
+} // namespace details
+
 /// @brief Traversal node for collision between two meshes
 template<typename BV, int _Options = RelativeTransformationIsIdentity>
 class MeshCollisionTraversalNode : public BVHCollisionTraversalNode<BV>
@@ -156,6 +257,7 @@ public:
     vertices2 = NULL;
     tri_indices1 = NULL;
     tri_indices2 = NULL;
+    enable_triangle_bv_tests = true;
   }
 
   /// @brief BV culling test in one BVTT node
@@ -173,9 +275,19 @@ public:
   /// @param b1, b2 Bounding volumes to test,
   /// @retval sqrDistLowerBound square of a lower bound of the minimal
   ///         distance between bounding volumes.
+  ///
+  /// When only one of the nodes is a leaf, its triangle is tested against
+  /// the bounding volume of the other node, if enable_triangle_bv_tests is
+  /// true and details::TriangleBVOverlap is available for BV.
   bool BVDisjoints(int b1, int b2, FCL_REAL& sqrDistLowerBound) const
   {
     if(this->enable_statistics) this->num_bv_tests++;
+    if (details::TriangleBVOverlap<BV>::Available && enable_triangle_bv_tests) {
+      const BVNode<BV>& node1 = this->model1->getBV(b1);
+      const BVNode<BV>& node2 = this->model2->getBV(b2);
+      if (node1.isLeaf() != node2.isLeaf())
+        return triangleBVDisjoints(node1, node2, sqrDistLowerBound);
+    }
     if (RTIsIdentity)
       return !this->model1->getBV(b1).overlap(this->model2->getBV(b2),
           this->request, sqrDistLowerBound);
@@ -202,6 +314,13 @@ public:
   /// @note If the distance between objects is less than the security margin,
   ///       and the object are not colliding, the penetration depth is
   ///       negative.
+  ///
+  /// When the contact information is not requested and the security margin
+  /// is not negative, the GJK solver is not needed: the triangles are tested
+  /// with Intersect::intersectTriangles or, if a security margin or the
+  /// distance lower bound is requested, with TriangleDistance::sqrTriDistance.
+  /// The contacts then only hold the primitive ids. A negative security
+  /// margin needs the penetration depth, which only GJK/EPA computes.
   void leafCollides(int b1, int b2, FCL_REAL& sqrDistLowerBound) const
   {
     if(this->enable_statistics) this->num_leaf_tests++;
@@ -222,9 +341,40 @@ public:
     const Vec3f& Q2 = vertices2[tri_id2[1]];
     const Vec3f& Q3 = vertices2[tri_id2[2]];
 
+    if (!this->request.enable_contact && this->request.security_margin >= 0) {
+      bool collision;
+      if (this->request.security_margin == 0
+          && !this->request.enable_distance_lower_bound) {
+        sqrDistLowerBound = 0;
+        if (RTIsIdentity)
+          collision = Intersect::intersectTriangles (P1, P2, P3, Q1, Q2, Q3,
+              &sqrDistLowerBound);
+        else
+          collision = Intersect::intersectTriangles (P1, P2, P3,
+              RT._R() * Q1 + RT._T(), RT._R() * Q2 + RT._T(),
+              RT._R() * Q3 + RT._T(), &sqrDistLowerBound);
+      } else {
+        Vec3f p1, p2;
+        if (RTIsIdentity)
+          sqrDistLowerBound = TriangleDistance::sqrTriDistance
+            (P1, P2, P3, Q1, Q2, Q3, p1, p2);
+        else
+          sqrDistLowerBound = TriangleDistance::sqrTriDistance
+            (P1, P2, P3, Q1, Q2, Q3, RT._R(), RT._T(), p1, p2);
+        collision = (sqrt (sqrDistLowerBound) - this->request.security_margin
+                     <= 0);
+      }
+      if (collision && this->result->numContacts() < this->request.num_max_contacts)
+        this->result->addContact(Contact(this->model1, this->model2,
+                                         primitive_id1, primitive_id2));
+      return;
+    }
+
     TriangleP tri1 (P1, P2, P3);
     TriangleP tri2 (Q1, Q2, Q3);
     GJKSolver solver;
+    if (this->request.enable_statistics)
+      solver.statistics = &this->result->statistics;
     Vec3f p1, p2; // closest points if no collision contact points if collision.
     Vec3f normal;
     FCL_REAL distance;
@@ -256,7 +406,48 @@ public:
   Triangle* tri_indices1;
   Triangle* tri_indices2;
 
+  /// @brief Whether the triangle of a leaf is tested against the bounding
+  /// volumes of the other model, instead of its bounding volume.
+  bool enable_triangle_bv_tests;
+
   details::RelativeTransformation<!bool(RTIsIdentity)> RT;
+
+private:
+  /// Test the triangle of the leaf among node1 and node2 against the
+  /// bounding volume of the other one.
+  bool triangleBVDisjoints(const BVNode<BV>& node1, const BVNode<BV>& node2,
+                           FCL_REAL& sqrDistLowerBound) const
+  {
+    const FCL_REAL margin = this->request.break_distance
+      + this->request.security_margin;
+    if (node1.isLeaf()) {
+      const Triangle& tri = tri_indices1[node1.primitiveId()];
+      const Vec3f& P1 = vertices1[tri[0]];
+      const Vec3f& P2 = vertices1[tri[1]];
+      const Vec3f& P3 = vertices1[tri[2]];
+      if (RTIsIdentity)
+        return !details::TriangleBVOverlap<BV>::run(node2.bv, P1, P2, P3,
+            margin, sqrDistLowerBound);
+      // Express the triangle in the frame of the second model.
+      return !details::TriangleBVOverlap<BV>::run(node2.bv,
+          RT._R().transpose() * (P1 - RT._T()),
+          RT._R().transpose() * (P2 - RT._T()),
+          RT._R().transpose() * (P3 - RT._T()),
+          margin, sqrDistLowerBound);
+    } else {
+      const Triangle& tri = tri_indices2[node2.primitiveId()];
+      const Vec3f& Q1 = vertices2[tri[0]];
+      const Vec3f& Q2 = vertices2[tri[1]];
+      const Vec3f& Q3 = vertices2[tri[2]];
+      if (RTIsIdentity)
+        return !details::TriangleBVOverlap<BV>::run(node1.bv, Q1, Q2, Q3,
+            margin, sqrDistLowerBound);
+      // Express the triangle in the frame of the first model.
+      return !details::TriangleBVOverlap<BV>::run(node1.bv,
+          RT._R() * Q1 + RT._T(), RT._R() * Q2 + RT._T(),
+          RT._R() * Q3 + RT._T(), margin, sqrDistLowerBound);
+    }
+  }
 };
 
 /// @brief Traversal node for collision between two meshes if their underlying BVH node is oriented node (OBB, RSS, OBBRSS, kIOS)
@@ -439,6 +630,7 @@ public:
     vertices2 = NULL;
     tri_indices1 = NULL;
     tri_indices2 = NULL;
+    enable_triangle_bv_tests = true;
 
     rel_err = this->request.rel_err;
     abs_err = this->request.abs_err;
@@ -452,18 +644,34 @@ public:
   void postprocess()
   {
     if(!RTIsIdentity) postprocessOrientedNode();
+    if(request.num_closest_pairs > 0)
+      std::sort_heap(result->closest_pairs.begin(),
+                     result->closest_pairs.end());
   }
 
   /// @brief BV culling test in one BVTT node
+  ///
+  /// When only one of the nodes is a leaf and the bounding volumes do not
+  /// prune the pair, the bound is improved with the bound of its triangle
+  /// against the bounding volume of the other node, if
+  /// enable_triangle_bv_tests is true and details::TriangleBVOverlap is
+  /// available for BV.
   FCL_REAL BVDistanceLowerBound(int b1, int b2) const
   {
     if(enable_statistics) num_bv_tests++;
+    const BVNode<BV>& node1 = model1->getBV(b1);
+    const BVNode<BV>& node2 = model2->getBV(b2);
+    FCL_REAL d;
     if (RTIsIdentity)
-      return details::DistanceTraversalBVDistanceLowerBound_impl<BV>
-        ::run (model1->getBV(b1), model2->getBV(b2));
+      d = details::DistanceTraversalBVDistanceLowerBound_impl<BV>
+        ::run (node1, node2);
     else
-      return details::DistanceTraversalBVDistanceLowerBound_impl<BV>
-        ::run (RT._R(), RT._T(), model1->getBV(b1), model2->getBV(b2));
+      d = details::DistanceTraversalBVDistanceLowerBound_impl<BV>
+        ::run (RT._R(), RT._T(), node1, node2);
+    if (details::TriangleBVOverlap<BV>::Available && enable_triangle_bv_tests
+        && node1.isLeaf() != node2.isLeaf() && d < this->result->min_distance)
+      d = (std::max) (d, triangleBVDistanceLowerBound(node1, node2));
+    return d;
   }
 
   /// @brief Distance testing between leaves (two triangles)
@@ -503,12 +711,24 @@ public:
 
     this->result->update(d, this->model1, this->model2, primitive_id1,
                          primitive_id2, P1, P2, normal);
+    updateClosestPairs(d, primitive_id1, primitive_id2, P1, P2);
   }
 
   /// @brief Whether the traversal process can stop early
+  ///
+  /// When closest pairs are requested, the bound is the distance of the
+  /// furthest pair kept, once DistanceRequest::num_closest_pairs pairs are
+  /// found.
   bool canStop(FCL_REAL c) const
   {
-    if((c >= this->result->min_distance - abs_err) && (c * (1 + rel_err) >= this->result->min_distance))
+    FCL_REAL bound = this->result->min_distance;
+    if(request.num_closest_pairs > 0) {
+      if(result->closest_pairs.size() < request.num_closest_pairs)
+        bound = request.closest_pairs_max_distance;
+      else
+        bound = result->closest_pairs.front().distance;
+    }
+    if((c >= bound - abs_err) && (c * (1 + rel_err) >= bound))
       return true;
     return false;
   }
@@ -523,9 +743,66 @@ public:
   FCL_REAL rel_err;
   FCL_REAL abs_err;
 
+  /// @brief Whether the triangle of a leaf is tested against the bounding
+  /// volumes of the other model, instead of its bounding volume.
+  bool enable_triangle_bv_tests;
+
   details::RelativeTransformation<!bool(RTIsIdentity)> RT;
 
+protected:
+  /// @brief Add a pair of triangles to the closest pairs, if requested.
+  void updateClosestPairs(FCL_REAL d, int primitive_id1, int primitive_id2,
+                          const Vec3f& P1, const Vec3f& P2) const
+  {
+    if(request.num_closest_pairs > 0
+       && d <= request.closest_pairs_max_distance)
+      result->updateClosestPairs(DistancePair(d, primitive_id1, primitive_id2,
+            P1, P2), request.num_closest_pairs);
+  }
+
 private:
+  /// Lower bound of the distance between the triangle of the leaf among
+  /// node1 and node2 and the bounding volume of the other one, -1 if they
+  /// overlap.
+  FCL_REAL triangleBVDistanceLowerBound(const BVNode<BV>& node1,
+                                        const BVNode<BV>& node2) const
+  {
+    FCL_REAL sqrDistLowerBound;
+    bool overlap;
+    if (node1.isLeaf()) {
+      const Triangle& tri = tri_indices1[node1.primitiveId()];
+      const Vec3f& P1 = vertices1[tri[0]];
+      const Vec3f& P2 = vertices1[tri[1]];
+      const Vec3f& P3 = vertices1[tri[2]];
+      if (RTIsIdentity)
+        overlap = details::TriangleBVOverlap<BV>::run(node2.bv, P1, P2, P3,
+            0, sqrDistLowerBound);
+      else
+        // Express the triangle in the frame of the second model.
+        overlap = details::TriangleBVOverlap<BV>::run(node2.bv,
+            RT._R().transpose() * (P1 - RT._T()),
+            RT._R().transpose() * (P2 - RT._T()),
+            RT._R().transpose() * (P3 - RT._T()),
+            0, sqrDistLowerBound);
+    } else {
+      const Triangle& tri = tri_indices2[node2.primitiveId()];
+      const Vec3f& Q1 = vertices2[tri[0]];
+      const Vec3f& Q2 = vertices2[tri[1]];
+      const Vec3f& Q3 = vertices2[tri[2]];
+      if (RTIsIdentity)
+        overlap = details::TriangleBVOverlap<BV>::run(node1.bv, Q1, Q2, Q3,
+            0, sqrDistLowerBound);
+      else
+        // Express the triangle in the frame of the first model.
+        overlap = details::TriangleBVOverlap<BV>::run(node1.bv,
+            RT._R() * Q1 + RT._T(), RT._R() * Q2 + RT._T(),
+            RT._R() * Q3 + RT._T(), 0, sqrDistLowerBound);
+    }
+    // TODO A penetration upper bound should be computed.
+    if (overlap) return -1;
+    return sqrt (sqrDistLowerBound);
+  }
+
   void preprocessOrientedNode()
   {
     const int init_tri_id1 = 0, init_tri_id2 = 0;
@@ -561,6 +838,12 @@ private:
       result->nearest_points[0] = tf1.transform(result->nearest_points[0]);
       result->nearest_points[1] = tf1.transform(result->nearest_points[1]);
     }
+    for(std::size_t i = 0; i < result->closest_pairs.size(); ++i)
+    {
+      DistancePair& pair = result->closest_pairs[i];
+      pair.nearest_points[0] = tf1.transform(pair.nearest_points[0]);
+      pair.nearest_points[1] = tf1.transform(pair.nearest_points[1]);
+    }
   }
 };
 
@@ -569,6 +852,134 @@ typedef MeshDistanceTraversalNode<RSS   , 0> MeshDistanceTraversalNodeRSS;
 typedef MeshDistanceTraversalNode<kIOS  , 0> MeshDistanceTraversalNodekIOS;
 typedef MeshDistanceTraversalNode<OBBRSS, 0> MeshDistanceTraversalNodeOBBRSS;
 
+/// @brief Traversal node for collision and distance computation between two
+/// meshes in a single traversal.
+///
+/// The traversal is the one of the distance. The pairs of nodes closer than
+/// the security margin are not pruned as long as contacts are missing. The
+/// distance computed for a pair of triangles gives both the distance and
+/// whether they are in collision. GJK is only run for pairs of intersecting
+/// triangles, when the contact or a negative security margin needs the
+/// penetration depth.
+template<typename BV, int _Options = RelativeTransformationIsIdentity>
+class MeshCollisionDistanceTraversalNode
+  : public MeshDistanceTraversalNode<BV, _Options>
+{
+public:
+  typedef MeshDistanceTraversalNode<BV, _Options> Base;
+  enum {
+    Options = _Options,
+    RTIsIdentity = _Options & RelativeTransformationIsIdentity
+  };
+
+  MeshCollisionDistanceTraversalNode(const CollisionRequest& request)
+    : Base(), collision_request(request), collision_result(NULL)
+  {}
+
+  /// @brief Distance and collision between leaves (two triangles)
+  void leafComputeDistance(int b1, int b2) const
+  {
+    if(this->enable_statistics) this->num_leaf_tests++;
+
+    int primitive_id1 = this->model1->getBV(b1).primitiveId();
+    int primitive_id2 = this->model2->getBV(b2).primitiveId();
+
+    const Triangle& tri_id1 = this->tri_indices1[primitive_id1];
+    const Triangle& tri_id2 = this->tri_indices2[primitive_id2];
+
+    const Vec3f& t11 = this->vertices1[tri_id1[0]];
+    const Vec3f& t12 = this->vertices1[tri_id1[1]];
+    const Vec3f& t13 = this->vertices1[tri_id1[2]];
+
+    const Vec3f& t21 = this->vertices2[tri_id2[0]];
+    const Vec3f& t22 = this->vertices2[tri_id2[1]];
+    const Vec3f& t23 = this->vertices2[tri_id2[2]];
+
+    // nearest point pair, in the frame of the first model if oriented.
+    Vec3f P1, P2, normal;
+
+    FCL_REAL d2;
+    if (RTIsIdentity)
+      d2 = TriangleDistance::sqrTriDistance (t11, t12, t13, t21, t22, t23,
+          P1, P2);
+    else
+      d2 = TriangleDistance::sqrTriDistance (t11, t12, t13, t21, t22, t23,
+          this->RT._R(), this->RT._T(), P1, P2);
+    FCL_REAL d = sqrt(d2);
+
+    this->result->update(d, this->model1, this->model2, primitive_id1,
+                         primitive_id2, P1, P2, normal);
+    this->updateClosestPairs(d, primitive_id1, primitive_id2, P1, P2);
+
+    if (collision_result->numContacts() >= collision_request.num_max_contacts)
+      return;
+
+    // For intersecting triangles, GJK/EPA gives the penetration depth needed
+    // by the contact or to compare with a negative security margin.
+    const bool penetration = (d <= 0 && (collision_request.enable_contact
+          || collision_request.security_margin < 0));
+    FCL_REAL distance (d);
+    Vec3f p1, p2;
+    if (penetration) {
+      TriangleP tri1 (t11, t12, t13);
+      TriangleP tri2 (t21, t22, t23);
+      GJKSolver solver;
+      if (collision_request.enable_statistics)
+        solver.statistics = &collision_result->statistics;
+      solver.shapeDistance (tri1, this->tf1, tri2, this->tf2,
+                            distance, p1, p2, normal);
+    }
+    if (distance - collision_request.security_margin > 0)
+      return;
+    if (!collision_request.enable_contact) {
+      collision_result->addContact(Contact(this->model1, this->model2,
+                                           primitive_id1, primitive_id2));
+      return;
+    }
+
+    Vec3f p; // contact point
+    FCL_REAL penetrationDepth = -distance;
+    if (!penetration) {
+      // Within the security margin: the nearest points give the contact.
+      if (RTIsIdentity) {
+        normal = (P2 - P1).normalized();
+        p = .5 * (P1 + P2);
+      } else {
+        normal = this->tf1.getRotation() * (P2 - P1).normalized();
+        p = this->tf1.transform(.5 * (P1 + P2));
+      }
+    } else {
+      p = p1;
+      if (distance > 0) {
+        normal = (p2-p1).normalized ();
+        p = .5* (p1+p2);
+      }
+    }
+    collision_result->addContact(Contact(this->model1, this->model2,
+                                         primitive_id1, primitive_id2,
+                                         p, normal, penetrationDepth));
+  }
+
+  /// @brief Whether the traversal process can stop early.
+  /// Pairs closer than the security margin, or intersecting pairs if it is
+  /// negative, are needed while contacts are missing.
+  bool canStop(FCL_REAL c) const
+  {
+    if (c - (std::max) (collision_request.security_margin, FCL_REAL(0)) <= 0
+        && collision_result->numContacts() < collision_request.num_max_contacts)
+      return false;
+    return Base::canStop(c);
+  }
+
+  const CollisionRequest& collision_request;
+  CollisionResult* collision_result;
+};
+
+/// @brief Traversal node for collision and distance computation between two
+/// meshes if their underlying BVH node is oriented node.
+typedef MeshCollisionDistanceTraversalNode<OBBRSS, 0>
+  MeshCollisionDistanceTraversalNodeOBBRSS;
+
 /// @}
 
 /// @brief for OBB and RSS, there is local coordinate of BV, so normal need to be transformed
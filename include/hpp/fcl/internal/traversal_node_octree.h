@@ -40,10 +40,19 @@
 
 /// @cond INTERNAL
 
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
 #include <hpp/fcl/collision_data.h>
 #include <hpp/fcl/internal/traversal_node_base.h>
+#include <hpp/fcl/internal/intersect.h>
+#include <hpp/fcl/internal/traversal_parallel.h>
 #include <hpp/fcl/narrowphase/narrowphase.h>
+#include <hpp/fcl/linear_octree.h>
+#ifdef HPP_FCL_HAVE_OCTOMAP
 #include <hpp/fcl/octree.h>
+#endif
 #include <hpp/fcl/BVH/BVH_model.h>
 #include <hpp/fcl/shape/geometric_shapes_utility.h>
 
@@ -52,6 +61,75 @@ namespace hpp
 namespace fcl
 {
 
+namespace details
+{
+  /// @brief Overlap test between a shape and an octree cell, expressed in
+  /// the frame of the octree.
+  ///
+  /// Only available for the shapes with a closed form test. The cell
+  /// is tested against the other shapes with GJK.
+  /// @param cell the cell, an axis aligned box.
+  /// @param tf the pose of the shape in the frame of the octree.
+  /// @return true if the shape and the cell intersect or touch.
+  template<typename S> struct ShapeCellOverlap
+  {
+    enum { Available = false };
+    static bool run(const AABB&, const S&, const Transform3f&)
+    {
+      return true;
+    }
+  };
+
+  template<> struct ShapeCellOverlap<Sphere>
+  {
+    enum { Available = true };
+    static bool run(const AABB& cell, const Sphere& s, const Transform3f& tf)
+    {
+      const Vec3f d (((tf.getTranslation() - cell.center()).cwiseAbs()
+                      - (cell.max_ - cell.min_) / 2).cwiseMax(0));
+      return d.squaredNorm() <= s.radius * s.radius;
+    }
+  };
+
+  template<> struct ShapeCellOverlap<Capsule>
+  {
+    enum { Available = true };
+    static bool run(const AABB& cell, const Capsule& s, const Transform3f& tf)
+    {
+      const Vec3f p (tf.getTranslation() - cell.center());
+      const Vec3f half ((cell.max_ - cell.min_) / 2);
+      // Cheap rejection with the sphere bounding the capsule.
+      const FCL_REAL r = s.radius + s.halfLength;
+      if((p.cwiseAbs() - half).cwiseMax(0).squaredNorm() > r * r) return false;
+      const Vec3f u (s.halfLength * tf.getRotation().col(2));
+      return Intersect::sqrDistanceSegmentBox(p - u, p + u, half)
+        <= s.radius * s.radius;
+    }
+  };
+
+  template<> struct ShapeCellOverlap<Box>
+  {
+    enum { Available = true };
+    static bool run(const AABB& cell, const Box& s, const Transform3f& tf)
+    {
+      return !obbDisjoint(tf.getRotation(), tf.getTranslation() - cell.center(),
+                          (cell.max_ - cell.min_) / 2, s.halfSide);
+    }
+  };
+
+  template<> struct ShapeCellOverlap<TriangleP>
+  {
+    enum { Available = true };
+    static bool run(const AABB& cell, const TriangleP& s, const Transform3f& tf)
+    {
+      const Vec3f c (cell.center());
+      return Intersect::intersectTriangleBox(tf.transform(s.a) - c,
+          tf.transform(s.b) - c, tf.transform(s.c) - c,
+          (cell.max_ - cell.min_) / 2, 0);
+    }
+  };
+} // namespace details
+
 /// @brief Algorithms for collision related with octree
 class HPP_FCL_DLLAPI OcTreeSolver
 {
@@ -64,97 +142,159 @@ private:
   mutable CollisionResult* cresult;
   mutable DistanceResult* dresult;
 
+  /// @brief Contacts of the tasks of a parallel collision traversal, and
+  /// the task of the worker using this solver.
+  mutable const details::TaskContactCounter* counter;
+  mutable std::size_t task;
+
+  /// @brief Best distance of the workers of a parallel distance traversal.
+  mutable details::SharedBestDistance* shared_distance;
+
+  /// @brief QueryRequest::octree_max_depth of the current query.
+  mutable unsigned int max_depth;
+
 public:
   OcTreeSolver(const GJKSolver* solver_) : solver(solver_),
                                                    crequest(NULL),
                                                    drequest(NULL),
                                                    cresult(NULL),
-                                                   dresult(NULL)
+                                                   dresult(NULL),
+                                                   counter(NULL),
+                                                   task(0),
+                                                   shared_distance(NULL),
+                                                   max_depth((std::numeric_limits<unsigned int>::max)()),
+                                                   enable_cell_kernels(true)
   {
   }
 
+  /// @brief Whether the cells are tested against the spheres, capsules,
+  /// boxes and triangles with a closed form test instead of GJK, when no
+  /// contact information is requested.
+  bool enable_cell_kernels;
+
   /// @brief collision between two octrees
-  void OcTreeIntersect(const OcTree* tree1, const OcTree* tree2,
+  template<typename OcTreeT1, typename OcTreeT2>
+  void OcTreeIntersect(const OcTreeT1* tree1, const OcTreeT2* tree2,
                        const Transform3f& tf1, const Transform3f& tf2,
                        const CollisionRequest& request_,
                        CollisionResult& result_) const
   {
     crequest = &request_;
+    max_depth = request_.octree_max_depth;
     cresult = &result_;
-    
+
+    if(request_.num_threads != 1 && tree1->getRoot() && tree2->getRoot())
+    {
+      unsigned int num_threads = details::numTraversalThreads(request_.num_threads);
+      OcTreeTask<OcTreeT1, OcTreeT2> root =
+        { tree1, tree1->getRoot(), tree1->getRootBV(),
+          tree2, tree2->getRoot(), tree2->getRootBV(), &tf1, &tf2, 0 };
+      std::vector<OcTreeTask<OcTreeT1, OcTreeT2> > tasks;
+      splitOcTreeIntersect(root, 32 * num_threads, tasks);
+      intersectParallel(tasks, num_threads);
+      return;
+    }
+
     OcTreeIntersectRecurse(tree1, tree1->getRoot(), tree1->getRootBV(), 
                            tree2, tree2->getRoot(), tree2->getRootBV(), 
                            tf1, tf2);
   }
 
   /// @brief distance between two octrees
-  void OcTreeDistance(const OcTree* tree1, const OcTree* tree2,
+  template<typename OcTreeT1, typename OcTreeT2>
+  void OcTreeDistance(const OcTreeT1* tree1, const OcTreeT2* tree2,
                       const Transform3f& tf1, const Transform3f& tf2,
                       const DistanceRequest& request_,
                       DistanceResult& result_) const
   {
     drequest = &request_;
+    max_depth = request_.octree_max_depth;
     dresult = &result_;
 
+    if(request_.num_threads != 1 && tree1->getRoot() && tree2->getRoot())
+    {
+      unsigned int num_threads = details::numTraversalThreads(request_.num_threads);
+      OcTreeTask<OcTreeT1, OcTreeT2> root =
+        { tree1, tree1->getRoot(), tree1->getRootBV(),
+          tree2, tree2->getRoot(), tree2->getRootBV(), &tf1, &tf2, 0 };
+      root.d = root.distanceLowerBound();
+      std::vector<OcTreeTask<OcTreeT1, OcTreeT2> > tasks;
+      splitOcTreeDistance(root, 32 * num_threads, tasks);
+      distanceParallel(tasks, num_threads);
+      return;
+    }
+
     OcTreeDistanceRecurse(tree1, tree1->getRoot(), tree1->getRootBV(), 
                           tree2, tree2->getRoot(), tree2->getRootBV(),
                           tf1, tf2);
   }
 
   /// @brief collision between octree and mesh
-  template<typename BV>
-  void OcTreeMeshIntersect(const OcTree* tree1, const BVHModel<BV>* tree2,
+  template<typename OcTreeT, typename BV>
+  void OcTreeMeshIntersect(const OcTreeT* tree1, const BVHModel<BV>* tree2,
                            const Transform3f& tf1, const Transform3f& tf2,
                            const CollisionRequest& request_,
                            CollisionResult& result_) const
   {
     crequest = &request_;
+    max_depth = request_.octree_max_depth;
     cresult = &result_;
 
-    OcTreeMeshIntersectRecurse(tree1, tree1->getRoot(), tree1->getRootBV(),
-                               tree2, 0,
-                               tf1, tf2);
+    OcTreeMeshIntersectImpl(tree1, tree2, tf1, tf2);
   }
 
   /// @brief distance between octree and mesh
-  template<typename BV>
-  void OcTreeMeshDistance(const OcTree* tree1, const BVHModel<BV>* tree2,
+  template<typename OcTreeT, typename BV>
+  void OcTreeMeshDistance(const OcTreeT* tree1, const BVHModel<BV>* tree2,
                           const Transform3f& tf1, const Transform3f& tf2,
                           const DistanceRequest& request_,
                           DistanceResult& result_) const
   {
     drequest = &request_;
+    max_depth = request_.octree_max_depth;
     dresult = &result_;
 
+    if(request_.num_threads != 1 && tree1->getRoot())
+    {
+      unsigned int num_threads = details::numTraversalThreads(request_.num_threads);
+      OcTreeMeshTask<OcTreeT, BV> root =
+        { tree1, tree1->getRoot(), tree1->getRootBV(), tree2, 0, &tf1, &tf2, 0 };
+      root.d = root.distanceLowerBound();
+      std::vector<OcTreeMeshTask<OcTreeT, BV> > tasks;
+      splitOcTreeMeshDistance(root, 32 * num_threads, tasks);
+      distanceParallel(tasks, num_threads);
+      return;
+    }
+
     OcTreeMeshDistanceRecurse(tree1, tree1->getRoot(), tree1->getRootBV(),
                               tree2, 0,
                               tf1, tf2);
   }
 
   /// @brief collision between mesh and octree
-  template<typename BV>
-  void MeshOcTreeIntersect(const BVHModel<BV>* tree1, const OcTree* tree2,
+  template<typename BV, typename OcTreeT>
+  void MeshOcTreeIntersect(const BVHModel<BV>* tree1, const OcTreeT* tree2,
                            const Transform3f& tf1, const Transform3f& tf2,
                            const CollisionRequest& request_,
                            CollisionResult& result_) const
   
   {
     crequest = &request_;
+    max_depth = request_.octree_max_depth;
     cresult = &result_;
 
-    OcTreeMeshIntersectRecurse(tree2, tree2->getRoot(), tree2->getRootBV(),
-                               tree1, 0,
-                               tf2, tf1);
+    OcTreeMeshIntersectImpl(tree2, tree1, tf2, tf1);
   }
 
   /// @brief distance between mesh and octree
-  template<typename BV>
-  void MeshOcTreeDistance(const BVHModel<BV>* tree1, const OcTree* tree2,
+  template<typename BV, typename OcTreeT>
+  void MeshOcTreeDistance(const BVHModel<BV>* tree1, const OcTreeT* tree2,
                           const Transform3f& tf1, const Transform3f& tf2,
                           const DistanceRequest& request_,
                           DistanceResult& result_) const
   {
     drequest = &request_;
+    max_depth = request_.octree_max_depth;
     dresult = &result_;
 
     OcTreeMeshDistanceRecurse(tree1, 0,
@@ -163,13 +303,14 @@ public:
   }
 
   /// @brief collision between octree and shape
-  template<typename S>
-  void OcTreeShapeIntersect(const OcTree* tree, const S& s,
+  template<typename OcTreeT, typename S>
+  void OcTreeShapeIntersect(const OcTreeT* tree, const S& s,
                             const Transform3f& tf1, const Transform3f& tf2,
                             const CollisionRequest& request_,
                             CollisionResult& result_) const
   {
     crequest = &request_;
+    max_depth = request_.octree_max_depth;
     cresult = &result_;
 
     AABB bv2;
@@ -177,19 +318,20 @@ public:
     OBB obb2;
     convertBV(bv2, tf2, obb2);
     OcTreeShapeIntersectRecurse(tree, tree->getRoot(), tree->getRootBV(),
-                                s, obb2,
+                                s, obb2, tf1.inverseTimes(tf2),
                                 tf1, tf2);
     
   }
 
   /// @brief collision between shape and octree
-  template<typename S>
-  void ShapeOcTreeIntersect(const S& s, const OcTree* tree,
+  template<typename S, typename OcTreeT>
+  void ShapeOcTreeIntersect(const S& s, const OcTreeT* tree,
                             const Transform3f& tf1, const Transform3f& tf2,
                             const CollisionRequest& request_,
                             CollisionResult& result_) const
   {
     crequest = &request_;
+    max_depth = request_.octree_max_depth;
     cresult = &result_;
 
     AABB bv1;
@@ -197,18 +339,19 @@ public:
     OBB obb1;
     convertBV(bv1, tf1, obb1);
     OcTreeShapeIntersectRecurse(tree, tree->getRoot(), tree->getRootBV(),
-                                s, obb1,
+                                s, obb1, tf2.inverseTimes(tf1),
                                 tf2, tf1);
   }
 
   /// @brief distance between octree and shape
-  template<typename S>
-  void OcTreeShapeDistance(const OcTree* tree, const S& s,
+  template<typename OcTreeT, typename S>
+  void OcTreeShapeDistance(const OcTreeT* tree, const S& s,
                            const Transform3f& tf1, const Transform3f& tf2,
                            const DistanceRequest& request_,
                            DistanceResult& result_) const
   {
     drequest = &request_;
+    max_depth = request_.octree_max_depth;
     dresult = &result_;
 
     AABB aabb2;
@@ -219,13 +362,14 @@ public:
   }
 
   /// @brief distance between shape and octree
-  template<typename S>
-  void ShapeOcTreeDistance(const S& s, const OcTree* tree,
+  template<typename S, typename OcTreeT>
+  void ShapeOcTreeDistance(const S& s, const OcTreeT* tree,
                            const Transform3f& tf1, const Transform3f& tf2,
                            const DistanceRequest& request_,
                            DistanceResult& result_) const
   {
     drequest = &request_;
+    max_depth = request_.octree_max_depth;
     dresult = &result_;
 
     AABB aabb1;
@@ -234,15 +378,565 @@ public:
                                s, aabb1,
                                tf2, tf1);
   }
+
+  /// @brief collision between an octree and several shapes
+  ///
+  /// The octree is descended once. The children of a node are only tested
+  /// against the shapes which overlap the node, and a shape is not tested
+  /// anymore once its result satisfies the request.
+  /// @param shapes the shapes: boxes, spheres, capsules, cones, cylinders
+  ///        or convex.
+  /// @param tfs the poses of the shapes.
+  /// @retval results the result of each shape, of the same size as shapes.
+  template<typename OcTreeT>
+  void OcTreeShapesIntersect(const OcTreeT* tree,
+                             const std::vector<const CollisionGeometry*>& shapes,
+                             const Transform3f& tf1,
+                             const std::vector<Transform3f>& tfs,
+                             const CollisionRequest& request_,
+                             std::vector<CollisionResult>& results) const
+  {
+    crequest = &request_;
+    max_depth = request_.octree_max_depth;
+    cresult = NULL;
+
+    std::vector<BatchShape<OcTreeT> > batch (shapes.size());
+    std::vector<std::size_t> active;
+    active.reserve(4 * shapes.size());
+    for(std::size_t i = 0; i < shapes.size(); ++i)
+    {
+      BatchShape<OcTreeT>& b = batch[i];
+      b.shape = shapes[i];
+      b.tf = &tfs[i];
+      b.tf_s = tf1.inverseTimes(tfs[i]);
+      b.result = &results[i];
+      initBatchShape(b);
+      b.done = b.shape->isUncertain() || crequest->isSatisfied(*b.result);
+      if(!b.done) active.push_back(i);
+    }
+    if(!tree->getRoot() || active.empty()) return;
+
+    OcTreeShapesIntersectRecurse(tree, tree->getRoot(), tree->getRootBV(),
+                                 0, active.size(), active, batch, tf1);
+  }
   
 
 private:
-  template<typename S>
-  bool OcTreeShapeDistanceRecurse(const OcTree* tree1, const OcTree::OcTreeNode* root1, const AABB& bv1,
+  /// @brief A pair of nodes of two octrees, one task of a parallel
+  ///        traversal.
+  template<typename OcTreeT1, typename OcTreeT2>
+  struct OcTreeTask
+  {
+    const OcTreeT1* tree1;
+    const typename OcTreeT1::OcTreeNode* root1;
+    AABB bv1;
+    const OcTreeT2* tree2;
+    const typename OcTreeT2::OcTreeNode* root2;
+    AABB bv2;
+    const Transform3f* tf1;
+    const Transform3f* tf2;
+    /// @brief lower bound of the distance between the nodes, for the
+    ///        distance queries.
+    FCL_REAL d;
+
+    FCL_REAL distanceLowerBound() const
+    {
+      AABB aabb1, aabb2;
+      convertBV(bv1, *tf1, aabb1);
+      convertBV(bv2, *tf2, aabb2);
+      return aabb1.distance(aabb2);
+    }
+
+    bool intersect(const OcTreeSolver& solver) const
+    {
+      return solver.OcTreeIntersectRecurse(tree1, root1, bv1, tree2, root2, bv2,
+                                           *tf1, *tf2);
+    }
+
+    bool distance(const OcTreeSolver& solver) const
+    {
+      return solver.OcTreeDistanceRecurse(tree1, root1, bv1, tree2, root2, bv2,
+                                          *tf1, *tf2);
+    }
+
+    bool operator< (const OcTreeTask& other) const { return d < other.d; }
+  };
+
+  /// @brief A pair of an octree node and a BVH node, one task of a parallel
+  ///        traversal.
+  template<typename OcTreeT, typename BV>
+  struct OcTreeMeshTask
+  {
+    const OcTreeT* tree1;
+    const typename OcTreeT::OcTreeNode* root1;
+    AABB bv1;
+    const BVHModel<BV>* tree2;
+    int root2;
+    const Transform3f* tf1;
+    const Transform3f* tf2;
+    /// @brief lower bound of the distance between the nodes, for the
+    ///        distance queries.
+    FCL_REAL d;
+
+    FCL_REAL distanceLowerBound() const
+    {
+      AABB aabb1, aabb2;
+      convertBV(bv1, *tf1, aabb1);
+      convertBV(tree2->getBV(root2).bv, *tf2, aabb2);
+      return aabb1.distance(aabb2);
+    }
+
+    bool intersect(const OcTreeSolver& solver) const
+    {
+      return solver.OcTreeMeshIntersectRecurse(tree1, root1, bv1, tree2, root2,
+                                               *tf1, *tf2);
+    }
+
+    bool distance(const OcTreeSolver& solver) const
+    {
+      return solver.OcTreeMeshDistanceRecurse(tree1, root1, bv1, tree2, root2,
+                                              *tf1, *tf2);
+    }
+
+    bool operator< (const OcTreeMeshTask& other) const { return d < other.d; }
+  };
+
+  /// @brief Worker of intersectParallel
+  template<typename Task>
+  struct IntersectWorker
+  {
+    const OcTreeSolver* solver;
+    const std::vector<Task>* tasks;
+    std::vector<CollisionResult>* results;
+    details::WorkStealingQueues* queues;
+    details::TaskContactCounter* counter;
+
+    void run(unsigned int worker)
+    {
+      // Each worker writes the contacts and the statistics in the result of
+      // the current task, with its own copy of the narrow phase solver.
+      GJKSolver gjk (*solver->solver);
+      OcTreeSolver local (*solver);
+      local.solver = &gjk;
+      local.counter = counter;
+      std::size_t t;
+      while(queues->pop(worker, t))
+      {
+        if(!counter->needed(t)) continue;
+        local.cresult = &(*results)[t];
+        local.task = t;
+        if(solver->solver->statistics)
+          gjk.statistics = &local.cresult->statistics;
+        (*tasks)[t].intersect(local);
+        counter->finish(t, local.cresult->numContacts());
+      }
+    }
+  };
+
+  /// @brief Worker of distanceParallel
+  template<typename Task>
+  struct DistanceWorker
+  {
+    const OcTreeSolver* solver;
+    const std::vector<Task>* tasks;
+    details::WorkStealingQueues* queues;
+    details::SharedBestDistance* shared;
+    std::vector<QueryStatistics>* statistics;
+
+    void run(unsigned int worker)
+    {
+      GJKSolver gjk (*solver->solver);
+      if(solver->solver->statistics)
+        gjk.statistics = &(*statistics)[worker];
+      OcTreeSolver local (*solver);
+      local.solver = &gjk;
+      DistanceResult result;
+      result.min_distance = shared->load();
+      local.dresult = &result;
+      local.shared_distance = shared;
+      std::size_t t;
+      while(queues->pop(worker, t))
+      {
+        if((*tasks)[t].d < local.minDistance())
+          (*tasks)[t].distance(local);
+      }
+    }
+  };
+
+  /// @brief Run the tasks of a collision traversal with several threads.
+  ///
+  /// The contacts are merged in the order of the tasks, which is the order
+  /// of the recursive traversal, so the result does not depend on the
+  /// scheduling. The tasks which cannot contribute once enough contacts are
+  /// found are cancelled.
+  template<typename Task>
+  void intersectParallel(const std::vector<Task>& tasks,
+                         unsigned int num_threads) const
+  {
+    if(tasks.empty()) return;
+    if(num_threads > tasks.size()) num_threads = (unsigned int) tasks.size();
+
+    std::vector<CollisionResult> results (tasks.size());
+    details::WorkStealingQueues queues (num_threads);
+    queues.distribute(tasks.size());
+    details::TaskContactCounter counter_ (tasks.size(),
+        crequest->num_max_contacts - cresult->numContacts());
+
+    IntersectWorker<Task> worker = { this, &tasks, &results, &queues, &counter_ };
+    // The calling thread is one of the workers.
+    boost::thread_group threads;
+    for(unsigned int i = 1; i < num_threads; ++i)
+      threads.create_thread(boost::bind(&IntersectWorker<Task>::run,
+                                        &worker, i));
+    worker.run(0);
+    threads.join_all();
+
+    if(solver->statistics)
+      for(std::size_t t = 0; t < tasks.size(); ++t)
+        *solver->statistics += results[t].statistics;
+    for(std::size_t t = 0; t < tasks.size(); ++t)
+    {
+      for(std::size_t i = 0; i < results[t].numContacts()
+            && cresult->numContacts() < crequest->num_max_contacts; ++i)
+        cresult->addContact(results[t].getContact(i));
+      if(crequest->isSatisfied(*cresult)) break;
+    }
+  }
+
+  /// @brief Run the tasks of a distance traversal with several threads, the
+  /// nearest tasks first. The best distance is shared between the threads,
+  /// so that each one prunes with the distance found by the others.
+  /// \note when several pairs are at the minimal distance, the returned
+  ///       pair depends on the scheduling.
+  template<typename Task>
+  void distanceParallel(std::vector<Task>& tasks,
+                        unsigned int num_threads) const
+  {
+    if(tasks.empty()) return;
+    if(num_threads > tasks.size()) num_threads = (unsigned int) tasks.size();
+    std::stable_sort(tasks.begin(), tasks.end());
+
+    details::WorkStealingQueues queues (num_threads);
+    queues.distribute(tasks.size());
+    details::SharedBestDistance shared (*dresult);
+    std::vector<QueryStatistics> statistics_ (num_threads);
+
+    DistanceWorker<Task> worker = { this, &tasks, &queues, &shared,
+                                    &statistics_ };
+    boost::thread_group threads;
+    for(unsigned int i = 1; i < num_threads; ++i)
+      threads.create_thread(boost::bind(&DistanceWorker<Task>::run,
+                                        &worker, i));
+    worker.run(0);
+    threads.join_all();
+
+    QueryStatistics statistics (dresult->statistics);
+    *dresult = shared.result();
+    dresult->statistics = statistics;
+    if(solver->statistics)
+      for(std::size_t i = 0; i < statistics_.size(); ++i)
+        *solver->statistics += statistics_[i];
+  }
+
+  /// @brief Split the collision traversal between two octrees into at least
+  /// num_tasks pairs of nodes, unless the trees are too small.
+  ///
+  /// The nodes are split and pruned as in OcTreeIntersectRecurse, and the
+  /// pairs are stored in the order in which it visits them.
+  template<typename OcTreeT1, typename OcTreeT2>
+  void splitOcTreeIntersect(const OcTreeTask<OcTreeT1, OcTreeT2>& root,
+                            std::size_t num_tasks,
+                            std::vector<OcTreeTask<OcTreeT1, OcTreeT2> >& tasks) const
+  {
+    typedef OcTreeTask<OcTreeT1, OcTreeT2> Task;
+    std::vector<Task> next;
+    tasks.assign(1, root);
+    bool split = true;
+    while(split && tasks.size() < num_tasks)
+    {
+      split = false;
+      next.clear();
+      for(std::size_t k = 0; k < tasks.size(); ++k)
+      {
+        const Task& t = tasks[k];
+        const OcTreeT1* tree1 = t.tree1;
+        const OcTreeT2* tree2 = t.tree2;
+        if(!cellHasChildren(tree1, t.root1, t.bv1) && !cellHasChildren(tree2, t.root2, t.bv2))
+        {
+          next.push_back(t);
+          continue;
+        }
+        if(tree1->isNodeFree(t.root1) || tree2->isNodeFree(t.root2)
+           || tree1->isNodeUncertain(t.root1) || tree2->isNodeUncertain(t.root2))
+          continue;
+        OBB obb1, obb2;
+        convertBV(t.bv1, *t.tf1, obb1);
+        convertBV(t.bv2, *t.tf2, obb2);
+        if(!obb1.overlap(obb2)) continue;
+
+        split = true;
+        if(!cellHasChildren(tree2, t.root2, t.bv2)
+           || (cellHasChildren(tree1, t.root1, t.bv1) && (t.bv1.size() > t.bv2.size())))
+        {
+          for(unsigned int i = 0; i < 8; ++i)
+          {
+            if(!tree1->nodeChildExists(t.root1, i)) continue;
+            Task c (t);
+            c.root1 = tree1->getNodeChild(t.root1, i);
+            computeChildBV(t.bv1, i, c.bv1);
+            next.push_back(c);
+          }
+        }
+        else
+        {
+          for(unsigned int i = 0; i < 8; ++i)
+          {
+            if(!tree2->nodeChildExists(t.root2, i)) continue;
+            Task c (t);
+            c.root2 = tree2->getNodeChild(t.root2, i);
+            computeChildBV(t.bv2, i, c.bv2);
+            next.push_back(c);
+          }
+        }
+      }
+      tasks.swap(next);
+    }
+  }
+
+  /// @brief Split the collision traversal between an octree and a BVH
+  /// into at least num_tasks pairs of nodes, unless the trees are too small.
+  ///
+  /// The nodes are split and pruned as in OcTreeMeshIntersectRecurse, and
+  /// the pairs are stored in the order in which it visits them.
+  template<typename OcTreeT, typename BV>
+  void splitOcTreeMeshIntersect(const OcTreeMeshTask<OcTreeT, BV>& root,
+                                std::size_t num_tasks,
+                                std::vector<OcTreeMeshTask<OcTreeT, BV> >& tasks) const
+  {
+    typedef OcTreeMeshTask<OcTreeT, BV> Task;
+    std::vector<Task> next;
+    tasks.assign(1, root);
+    bool split = true;
+    while(split && tasks.size() < num_tasks)
+    {
+      split = false;
+      next.clear();
+      for(std::size_t k = 0; k < tasks.size(); ++k)
+      {
+        const Task& t = tasks[k];
+        const OcTreeT* tree1 = t.tree1;
+        const BVNode<BV>& node2 = t.tree2->getBV(t.root2);
+        if(!cellHasChildren(tree1, t.root1, t.bv1) && node2.isLeaf())
+        {
+          next.push_back(t);
+          continue;
+        }
+        if(tree1->isNodeFree(t.root1) || tree1->isNodeUncertain(t.root1)
+           || t.tree2->isUncertain())
+          continue;
+        OBB obb1, obb2;
+        convertBV(t.bv1, *t.tf1, obb1);
+        convertBV(node2.bv, *t.tf2, obb2);
+        if(!obb1.overlap(obb2)) continue;
+
+        split = true;
+        if(node2.isLeaf()
+           || (cellHasChildren(tree1, t.root1, t.bv1) && (t.bv1.size() > node2.bv.size())))
+        {
+          for(unsigned int i = 0; i < 8; ++i)
+          {
+            if(!tree1->nodeChildExists(t.root1, i)) continue;
+            Task c (t);
+            c.root1 = tree1->getNodeChild(t.root1, i);
+            computeChildBV(t.bv1, i, c.bv1);
+            next.push_back(c);
+          }
+        }
+        else
+        {
+          Task c (t);
+          c.root2 = node2.leftChild();
+          next.push_back(c);
+          c.root2 = node2.rightChild();
+          next.push_back(c);
+        }
+      }
+      tasks.swap(next);
+    }
+  }
+
+  /// @brief Split the distance traversal between two octrees into at least
+  /// num_tasks pairs of nodes, unless the trees are too small. The pairs of
+  /// nodes which are not both occupied are dropped.
+  template<typename OcTreeT1, typename OcTreeT2>
+  void splitOcTreeDistance(const OcTreeTask<OcTreeT1, OcTreeT2>& root,
+                           std::size_t num_tasks,
+                           std::vector<OcTreeTask<OcTreeT1, OcTreeT2> >& tasks) const
+  {
+    typedef OcTreeTask<OcTreeT1, OcTreeT2> Task;
+    std::vector<Task> next;
+    tasks.assign(1, root);
+    bool split = true;
+    while(split && tasks.size() < num_tasks)
+    {
+      split = false;
+      next.clear();
+      for(std::size_t k = 0; k < tasks.size(); ++k)
+      {
+        const Task& t = tasks[k];
+        const OcTreeT1* tree1 = t.tree1;
+        const OcTreeT2* tree2 = t.tree2;
+        if(!tree1->isNodeOccupied(t.root1) || !tree2->isNodeOccupied(t.root2))
+          continue;
+        if(!cellHasChildren(tree1, t.root1, t.bv1) && !cellHasChildren(tree2, t.root2, t.bv2))
+        {
+          next.push_back(t);
+          continue;
+        }
+
+        split = true;
+        if(!cellHasChildren(tree2, t.root2, t.bv2)
+           || (cellHasChildren(tree1, t.root1, t.bv1) && (t.bv1.size() > t.bv2.size())))
+        {
+          for(unsigned int i = 0; i < 8; ++i)
+          {
+            if(!tree1->nodeChildExists(t.root1, i)) continue;
+            Task c (t);
+            c.root1 = tree1->getNodeChild(t.root1, i);
+            computeChildBV(t.bv1, i, c.bv1);
+            c.d = c.distanceLowerBound();
+            next.push_back(c);
+          }
+        }
+        else
+        {
+          for(unsigned int i = 0; i < 8; ++i)
+          {
+            if(!tree2->nodeChildExists(t.root2, i)) continue;
+            Task c (t);
+            c.root2 = tree2->getNodeChild(t.root2, i);
+            computeChildBV(t.bv2, i, c.bv2);
+            c.d = c.distanceLowerBound();
+            next.push_back(c);
+          }
+        }
+      }
+      tasks.swap(next);
+    }
+  }
+
+  /// @brief Split the distance traversal between an octree and a BVH into
+  /// at least num_tasks pairs of nodes, unless the trees are too small.
+  /// The pairs whose octree node is not occupied are dropped.
+  template<typename OcTreeT, typename BV>
+  void splitOcTreeMeshDistance(const OcTreeMeshTask<OcTreeT, BV>& root,
+                               std::size_t num_tasks,
+                               std::vector<OcTreeMeshTask<OcTreeT, BV> >& tasks) const
+  {
+    typedef OcTreeMeshTask<OcTreeT, BV> Task;
+    std::vector<Task> next;
+    tasks.assign(1, root);
+    bool split = true;
+    while(split && tasks.size() < num_tasks)
+    {
+      split = false;
+      next.clear();
+      for(std::size_t k = 0; k < tasks.size(); ++k)
+      {
+        const Task& t = tasks[k];
+        const OcTreeT* tree1 = t.tree1;
+        const BVNode<BV>& node2 = t.tree2->getBV(t.root2);
+        if(!tree1->isNodeOccupied(t.root1)) continue;
+        if(!cellHasChildren(tree1, t.root1, t.bv1) && node2.isLeaf())
+        {
+          next.push_back(t);
+          continue;
+        }
+
+        split = true;
+        if(node2.isLeaf()
+           || (cellHasChildren(tree1, t.root1, t.bv1) && (t.bv1.size() > node2.bv.size())))
+        {
+          for(unsigned int i = 0; i < 8; ++i)
+          {
+            if(!tree1->nodeChildExists(t.root1, i)) continue;
+            Task c (t);
+            c.root1 = tree1->getNodeChild(t.root1, i);
+            computeChildBV(t.bv1, i, c.bv1);
+            c.d = c.distanceLowerBound();
+            next.push_back(c);
+          }
+        }
+        else
+        {
+          Task c (t);
+          c.root2 = node2.leftChild();
+          c.d = c.distanceLowerBound();
+          next.push_back(c);
+          c.root2 = node2.rightChild();
+          c.d = c.distanceLowerBound();
+          next.push_back(c);
+        }
+      }
+      tasks.swap(next);
+    }
+  }
+
+  /// @brief collision between an octree and a BVH, with request.num_threads
+  ///        threads.
+  template<typename OcTreeT, typename BV>
+  void OcTreeMeshIntersectImpl(const OcTreeT* tree1, const BVHModel<BV>* tree2,
+                               const Transform3f& tf1, const Transform3f& tf2) const
+  {
+    if(crequest->num_threads != 1 && tree1->getRoot())
+    {
+      unsigned int num_threads = details::numTraversalThreads(crequest->num_threads);
+      OcTreeMeshTask<OcTreeT, BV> root =
+        { tree1, tree1->getRoot(), tree1->getRootBV(), tree2, 0, &tf1, &tf2, 0 };
+      std::vector<OcTreeMeshTask<OcTreeT, BV> > tasks;
+      splitOcTreeMeshIntersect(root, 32 * num_threads, tasks);
+      intersectParallel(tasks, num_threads);
+      return;
+    }
+
+    OcTreeMeshIntersectRecurse(tree1, tree1->getRoot(), tree1->getRootBV(),
+                               tree2, 0,
+                               tf1, tf2);
+  }
+
+  /// @brief Whether the task of a worker of a parallel collision traversal
+  ///        is not needed anymore.
+  bool cancelled() const
+  {
+    return counter && !counter->needed(task);
+  }
+
+  /// @brief The best distance found, including the distance found by the
+  ///        other workers of a parallel distance traversal.
+  FCL_REAL minDistance() const
+  {
+    if(shared_distance)
+    {
+      FCL_REAL best = shared_distance->load();
+      if(best < dresult->min_distance) dresult->min_distance = best;
+    }
+    return dresult->min_distance;
+  }
+
+  /// @brief Share the result with the other workers of a parallel distance
+  ///        traversal if it improved the distance.
+  void shareDistance(FCL_REAL previous) const
+  {
+    if(shared_distance && dresult->min_distance < previous)
+      shared_distance->submit(*dresult);
+  }
+
+  template<typename OcTreeT, typename S>
+  bool OcTreeShapeDistanceRecurse(const OcTreeT* tree1, const typename OcTreeT::OcTreeNode* root1, const AABB& bv1,
                                   const S& s, const AABB& aabb2,
                                   const Transform3f& tf1, const Transform3f& tf2) const
   {
-    if(!tree1->nodeHasChildren(root1))
+    if(!cellHasChildren(tree1, root1, bv1))
     {
       if(tree1->isNodeOccupied(root1))
       {
@@ -271,14 +965,14 @@ private:
     {
       if(tree1->nodeChildExists(root1, i))
       {
-        const OcTree::OcTreeNode* child = tree1->getNodeChild(root1, i);
+        const typename OcTreeT::OcTreeNode* child = tree1->getNodeChild(root1, i);
         AABB child_bv;
         computeChildBV(bv1, i, child_bv);
         
         AABB aabb1;
         convertBV(child_bv, tf1, aabb1);
         FCL_REAL d = aabb1.distance(aabb2);
-        if(d < dresult->min_distance)
+        if(d < minDistance())
         {
           if(OcTreeShapeDistanceRecurse(tree1, child, child_bv, s, aabb2, tf1, tf2))
             return true;
@@ -289,9 +983,177 @@ private:
     return false;
   }
 
+  /// @brief A shape of a collision query between an octree and several
+  ///        shapes.
+  template<typename OcTreeT>
+  struct BatchShape
+  {
+    const CollisionGeometry* shape;
+    const Transform3f* tf;
+    /// @brief the pose of the shape and its bounding volumes, in the frame
+    ///        of the octree.
+    Transform3f tf_s;
+    AABB aabb;
+    OBB obb;
+    CollisionResult* result;
+    /// @brief whether the result satisfies the request.
+    bool done;
+
+    /// @brief overlap test between a cell and the shape
+    bool (OcTreeSolver::*overlap)(const AABB&, const BatchShape&) const;
+    /// @brief collision between an occupied leaf and the shape
+    void (OcTreeSolver::*leaf)(const OcTreeT*, const typename OcTreeT::OcTreeNode*,
+                               const AABB&, BatchShape&, const Transform3f&) const;
+  };
+
+  template<typename OcTreeT>
+  void initBatchShape(BatchShape<OcTreeT>& b) const
+  {
+    switch(b.shape->getNodeType())
+    {
+    case GEOM_BOX: initBatchShape<OcTreeT, Box>(b); break;
+    case GEOM_SPHERE: initBatchShape<OcTreeT, Sphere>(b); break;
+    case GEOM_CAPSULE: initBatchShape<OcTreeT, Capsule>(b); break;
+    case GEOM_CONE: initBatchShape<OcTreeT, Cone>(b); break;
+    case GEOM_CYLINDER: initBatchShape<OcTreeT, Cylinder>(b); break;
+    case GEOM_CONVEX: initBatchShape<OcTreeT, ConvexBase>(b); break;
+    default:
+      throw std::invalid_argument("Collision between an octree and several "
+                                  "shapes only supports boxes, spheres, "
+                                  "capsules, cones, cylinders and convex.");
+    }
+  }
+
+  template<typename OcTreeT, typename S>
+  void initBatchShape(BatchShape<OcTreeT>& b) const
+  {
+    const S& s = static_cast<const S&>(*b.shape);
+    AABB local;
+    computeBV<AABB>(s, Transform3f(), local);
+    convertBV(local, b.tf_s, b.obb);
+    computeBV<AABB>(s, b.tf_s, b.aabb);
+    b.overlap = &OcTreeSolver::template batchOverlap<OcTreeT, S>;
+    b.leaf = &OcTreeSolver::template batchLeafIntersect<OcTreeT, S>;
+  }
+
+  template<typename OcTreeT, typename S>
+  bool batchOverlap(const AABB& bv, const BatchShape<OcTreeT>& b) const
+  {
+    if(!bv.overlap(b.aabb)) return false;
+    if(useCellKernel<S>())
+      return details::ShapeCellOverlap<S>::run(bv, static_cast<const S&>(*b.shape), b.tf_s);
+    OBB obb;
+    convertBV(bv, Transform3f(), obb);
+    return obb.overlap(b.obb);
+  }
+
+  template<typename OcTreeT, typename S>
+  void batchLeafIntersect(const OcTreeT* tree, const typename OcTreeT::OcTreeNode* node,
+                          const AABB& bv, BatchShape<OcTreeT>& b,
+                          const Transform3f& tf1) const
+  {
+    const S& s = static_cast<const S&>(*b.shape);
+    CollisionResult& result = *b.result;
+    const int id = static_cast<int>(node - tree->getRoot());
+    if(useCellKernel<S>() && !crequest->enable_contact)
+    {
+      if(details::ShapeCellOverlap<S>::run(bv, s, b.tf_s)
+         && result.numContacts() < crequest->num_max_contacts)
+        result.addContact(Contact(tree, &s, id, Contact::NONE));
+    }
+    else
+    {
+      OBB obb;
+      convertBV(bv, Transform3f(), obb);
+      if(!obb.overlap(b.obb)) return;
+
+      Box box;
+      Transform3f box_tf;
+      constructBox(bv, tf1, box, box_tf);
+
+      FCL_REAL distance;
+      Vec3f contact, normal;
+      if(solver->shapeIntersect(box, box_tf, s, *b.tf, distance,
+                                crequest->enable_contact, &contact, &normal)
+         && result.numContacts() < crequest->num_max_contacts)
+      {
+        if(crequest->enable_contact)
+          result.addContact(Contact(tree, &s, id, Contact::NONE, contact, normal, distance));
+        else
+          result.addContact(Contact(tree, &s, id, Contact::NONE));
+      }
+    }
+    b.done = crequest->isSatisfied(result);
+  }
+
+  /// @param begin, end the range of active which contains the shapes
+  ///        overlapping the parent of root1.
+  template<typename OcTreeT>
+  void OcTreeShapesIntersectRecurse(const OcTreeT* tree1, const typename OcTreeT::OcTreeNode* root1, const AABB& bv1,
+                                    std::size_t begin, std::size_t end,
+                                    std::vector<std::size_t>& active,
+                                    std::vector<BatchShape<OcTreeT> >& batch,
+                                    const Transform3f& tf1) const
+  {
+    if(!cellHasChildren(tree1, root1, bv1))
+    {
+      if(!tree1->isNodeOccupied(root1)) return;
+      for(std::size_t k = begin; k < end; ++k)
+      {
+        BatchShape<OcTreeT>& b = batch[active[k]];
+        if(!b.done && bv1.overlap(b.aabb))
+          (this->*b.leaf)(tree1, root1, bv1, b, tf1);
+      }
+      return;
+    }
+    if(tree1->isNodeFree(root1) || tree1->isNodeUncertain(root1)) return;
+
+    // The shapes overlapping this node are appended to active, and removed
+    // once the children are visited.
+    const std::size_t first = active.size();
+    for(std::size_t k = begin; k < end; ++k)
+    {
+      const BatchShape<OcTreeT>& b = batch[active[k]];
+      if(!b.done && (this->*b.overlap)(bv1, b))
+        active.push_back(active[k]);
+    }
+    const std::size_t last = active.size();
+
+    for(unsigned int i = 0; i < 8 && last > first; ++i)
+    {
+      if(tree1->nodeChildExists(root1, i))
+      {
+        AABB child_bv;
+        computeChildBV(bv1, i, child_bv);
+        OcTreeShapesIntersectRecurse(tree1, tree1->getNodeChild(root1, i), child_bv,
+                                     first, last, active, batch, tf1);
+      }
+    }
+    active.resize(first);
+  }
+
+  /// @brief whether the children of a node are visited. The nodes at
+  ///        QueryRequest::octree_max_depth are treated as leaves.
+  template<typename OcTreeT>
+  bool cellHasChildren(const OcTreeT* tree, const typename OcTreeT::OcTreeNode* node,
+                       const AABB& bv) const
+  {
+    if(!tree->nodeHasChildren(node)) return false;
+    if(max_depth >= 32) return true;
+    // The size of a node is twice the size of its children.
+    return bv.width() > 1.5 * std::ldexp(tree->getRootBV().width(), -(int) max_depth);
+  }
+
   template<typename S>
-  bool OcTreeShapeIntersectRecurse(const OcTree* tree1, const OcTree::OcTreeNode* root1, const AABB& bv1,
-                                   const S& s, const OBB& obb2,
+  bool useCellKernel() const
+  {
+    return details::ShapeCellOverlap<S>::Available && enable_cell_kernels;
+  }
+
+  /// @param tf_s pose of the shape in the frame of the octree.
+  template<typename OcTreeT, typename S>
+  bool OcTreeShapeIntersectRecurse(const OcTreeT* tree1, const typename OcTreeT::OcTreeNode* root1, const AABB& bv1,
+                                   const S& s, const OBB& obb2, const Transform3f& tf_s,
                                    const Transform3f& tf1, const Transform3f& tf2) const
   {
     if(!root1)
@@ -317,10 +1179,18 @@ private:
 
       return false;
     }
-    else if(!tree1->nodeHasChildren(root1))
+    else if(!cellHasChildren(tree1, root1, bv1))
     {
       if(tree1->isNodeOccupied(root1)) // occupied area
       {
+        if(useCellKernel<S>() && !crequest->enable_contact)
+        {
+          if(!details::ShapeCellOverlap<S>::run(bv1, s, tf_s)) return false;
+          if(cresult->numContacts() < crequest->num_max_contacts)
+            cresult->addContact(Contact(tree1, &s, static_cast<int>(root1 - tree1->getRoot()), Contact::NONE));
+          return crequest->isSatisfied(*cresult);
+        }
+
         OBB obb1;
         convertBV(bv1, tf1, obb1);
         if(obb1.overlap(obb2))
@@ -363,6 +1233,12 @@ private:
     ///           2) (two uncertain nodes or one node occupied and one node uncertain) AND cost not required
     if(tree1->isNodeFree(root1)) return false;
     else if((tree1->isNodeUncertain(root1) || s.isUncertain())) return false;
+    else if(useCellKernel<S>())
+    {
+      // The closed form test is at least as tight as the test between the
+      // OBB of the cell and the OBB of the shape.
+      if(!details::ShapeCellOverlap<S>::run(bv1, s, tf_s)) return false;
+    }
     else
     {
       OBB obb1;
@@ -374,11 +1250,11 @@ private:
     {
       if(tree1->nodeChildExists(root1, i))
       {
-        const OcTree::OcTreeNode* child = tree1->getNodeChild(root1, i);
+        const typename OcTreeT::OcTreeNode* child = tree1->getNodeChild(root1, i);
         AABB child_bv;
         computeChildBV(bv1, i, child_bv);
         
-        if(OcTreeShapeIntersectRecurse(tree1, child, child_bv, s, obb2, tf1, tf2))
+        if(OcTreeShapeIntersectRecurse(tree1, child, child_bv, s, obb2, tf_s, tf1, tf2))
           return true;
       }
     }
@@ -386,12 +1262,12 @@ private:
     return false;    
   }
 
-  template<typename BV>
-  bool OcTreeMeshDistanceRecurse(const OcTree* tree1, const OcTree::OcTreeNode* root1, const AABB& bv1,
+  template<typename OcTreeT, typename BV>
+  bool OcTreeMeshDistanceRecurse(const OcTreeT* tree1, const typename OcTreeT::OcTreeNode* root1, const AABB& bv1,
                                  const BVHModel<BV>* tree2, int root2,
                                  const Transform3f& tf1, const Transform3f& tf2) const
   {
-    if(!tree1->nodeHasChildren(root1) && tree2->getBV(root2).isLeaf())
+    if(!cellHasChildren(tree1, root1, bv1) && tree2->getBV(root2).isLeaf())
     {
       if(tree1->isNodeOccupied(root1))
       {
@@ -410,8 +1286,10 @@ private:
         solver->shapeTriangleInteraction(box, box_tf, p1, p2, p3, tf2, dist,
                                          closest_p1, closest_p2, normal);
 
+        FCL_REAL previous = dresult->min_distance;
         dresult->update(dist, tree1, tree2, (int) (root1 - tree1->getRoot()),
                         primitive_id, closest_p1, closest_p2, normal);
+        shareDistance(previous);
 
         return drequest->isSatisfied(*dresult);
       }
@@ -421,13 +1299,13 @@ private:
 
     if(!tree1->isNodeOccupied(root1)) return false;
 
-    if(tree2->getBV(root2).isLeaf() || (tree1->nodeHasChildren(root1) && (bv1.size() > tree2->getBV(root2).bv.size())))
+    if(tree2->getBV(root2).isLeaf() || (cellHasChildren(tree1, root1, bv1) && (bv1.size() > tree2->getBV(root2).bv.size())))
     {
       for(unsigned int i = 0; i < 8; ++i)
       {
         if(tree1->nodeChildExists(root1, i))
         {
-          const OcTree::OcTreeNode* child = tree1->getNodeChild(root1, i);
+          const typename OcTreeT::OcTreeNode* child = tree1->getNodeChild(root1, i);
           AABB child_bv;
           computeChildBV(bv1, i, child_bv);
 
@@ -437,7 +1315,7 @@ private:
           convertBV(tree2->getBV(root2).bv, tf2, aabb2);
           d = aabb1.distance(aabb2);
           
-          if(d < dresult->min_distance)
+          if(d < minDistance())
           {
             if(OcTreeMeshDistanceRecurse(tree1, child, child_bv, tree2, root2, tf1, tf2))
               return true;
@@ -454,7 +1332,7 @@ private:
       convertBV(tree2->getBV(child).bv, tf2, aabb2);
       d = aabb1.distance(aabb2);
 
-      if(d < dresult->min_distance)
+      if(d < minDistance())
       {
         if(OcTreeMeshDistanceRecurse(tree1, root1, bv1, tree2, child, tf1, tf2))
           return true;
@@ -464,7 +1342,7 @@ private:
       convertBV(tree2->getBV(child).bv, tf2, aabb2);
       d = aabb1.distance(aabb2);
       
-      if(d < dresult->min_distance)
+      if(d < minDistance())
       {
         if(OcTreeMeshDistanceRecurse(tree1, root1, bv1, tree2, child, tf1, tf2))
           return true;      
@@ -475,11 +1353,13 @@ private:
   }
 
 
-  template<typename BV>
-  bool OcTreeMeshIntersectRecurse(const OcTree* tree1, const OcTree::OcTreeNode* root1, const AABB& bv1,
+  template<typename OcTreeT, typename BV>
+  bool OcTreeMeshIntersectRecurse(const OcTreeT* tree1, const typename OcTreeT::OcTreeNode* root1, const AABB& bv1,
                                   const BVHModel<BV>* tree2, int root2,
                                   const Transform3f& tf1, const Transform3f& tf2) const
   {
+    if(cancelled()) return true;
+
     if(!root1)
     {
       if(tree2->getBV(root2).isLeaf())
@@ -524,7 +1404,7 @@ private:
         return false;
       }
     }
-    else if(!tree1->nodeHasChildren(root1) && tree2->getBV(root2).isLeaf())
+    else if(!cellHasChildren(tree1, root1, bv1) && tree2->getBV(root2).isLeaf())
     {
       if(tree1->isNodeOccupied(root1))
       {
@@ -533,10 +1413,6 @@ private:
         convertBV(tree2->getBV(root2).bv, tf2, obb2);
         if(obb1.overlap(obb2))
         {
-          Box box;
-          Transform3f box_tf;
-          constructBox(bv1, tf1, box, box_tf);
-
           int primitive_id = tree2->getBV(root2).primitiveId();
           const Triangle& tri_id = tree2->tri_indices[primitive_id];
           const Vec3f& p1 = tree2->vertices[tri_id[0]];
@@ -545,10 +1421,29 @@ private:
         
           if(!crequest->enable_contact)
           {
-            Vec3f c1, c2, normal;
-            FCL_REAL distance;
-            if(solver->shapeTriangleInteraction
-               (box, box_tf, p1, p2, p3, tf2, distance, c1, c2, normal))
+            bool collide;
+            if(enable_cell_kernels)
+            {
+              // Separating axis test between the triangle and the cell, in
+              // the frame of the octree.
+              const Transform3f tf (tf1.inverseTimes(tf2));
+              const Vec3f c (bv1.center());
+              collide = Intersect::intersectTriangleBox
+                (tf.transform(p1) - c, tf.transform(p2) - c, tf.transform(p3) - c,
+                 (bv1.max_ - bv1.min_) / 2, 0);
+            }
+            else
+            {
+              Box box;
+              Transform3f box_tf;
+              constructBox(bv1, tf1, box, box_tf);
+
+              Vec3f c1, c2, normal;
+              FCL_REAL distance;
+              collide = solver->shapeTriangleInteraction
+                (box, box_tf, p1, p2, p3, tf2, distance, c1, c2, normal);
+            }
+            if(collide)
             {
               if(cresult->numContacts() < crequest->num_max_contacts)
                 cresult->addContact(Contact(tree1, tree2,
@@ -558,6 +1453,10 @@ private:
           }
           else
           {
+            Box box;
+            Transform3f box_tf;
+            constructBox(bv1, tf1, box, box_tf);
+
             Vec3f c1, c2;
             FCL_REAL distance;
             Vec3f normal;
@@ -596,13 +1495,13 @@ private:
       if(!obb1.overlap(obb2)) return false;      
     }
    
-    if(tree2->getBV(root2).isLeaf() || (tree1->nodeHasChildren(root1) && (bv1.size() > tree2->getBV(root2).bv.size())))
+    if(tree2->getBV(root2).isLeaf() || (cellHasChildren(tree1, root1, bv1) && (bv1.size() > tree2->getBV(root2).bv.size())))
     {
       for(unsigned int i = 0; i < 8; ++i)
       {
         if(tree1->nodeChildExists(root1, i))
         {
-          const OcTree::OcTreeNode* child = tree1->getNodeChild(root1, i);
+          const typename OcTreeT::OcTreeNode* child = tree1->getNodeChild(root1, i);
           AABB child_bv;
           computeChildBV(bv1, i, child_bv);
           
@@ -624,11 +1523,12 @@ private:
     return false;
   }
 
-  bool OcTreeDistanceRecurse(const OcTree* tree1, const OcTree::OcTreeNode* root1, const AABB& bv1,
-                             const OcTree* tree2, const OcTree::OcTreeNode* root2, const AABB& bv2,
+  template<typename OcTreeT1, typename OcTreeT2>
+  bool OcTreeDistanceRecurse(const OcTreeT1* tree1, const typename OcTreeT1::OcTreeNode* root1, const AABB& bv1,
+                             const OcTreeT2* tree2, const typename OcTreeT2::OcTreeNode* root2, const AABB& bv2,
                              const Transform3f& tf1, const Transform3f& tf2) const
   {
-    if(!tree1->nodeHasChildren(root1) && !tree2->nodeHasChildren(root2))
+    if(!cellHasChildren(tree1, root1, bv1) && !cellHasChildren(tree2, root2, bv2))
     {
       if(tree1->isNodeOccupied(root1) && tree2->isNodeOccupied(root2))
       {
@@ -642,9 +1542,11 @@ private:
         solver->shapeDistance(box1, box1_tf, box2, box2_tf, dist, closest_p1,
                               closest_p2, normal);
 
+        FCL_REAL previous = dresult->min_distance;
         dresult->update(dist, tree1, tree2, (int) (root1 - tree1->getRoot()),
                         (int) (root2 - tree2->getRoot()),
                         closest_p1, closest_p2, normal);
+        shareDistance(previous);
         
         return drequest->isSatisfied(*dresult);
       }
@@ -654,13 +1556,13 @@ private:
 
     if(!tree1->isNodeOccupied(root1) || !tree2->isNodeOccupied(root2)) return false;
 
-    if(!tree2->nodeHasChildren(root2) || (tree1->nodeHasChildren(root1) && (bv1.size() > bv2.size())))
+    if(!cellHasChildren(tree2, root2, bv2) || (cellHasChildren(tree1, root1, bv1) && (bv1.size() > bv2.size())))
     {
       for(unsigned int i = 0; i < 8; ++i)
       {
         if(tree1->nodeChildExists(root1, i))
         {
-          const OcTree::OcTreeNode* child = tree1->getNodeChild(root1, i);
+          const typename OcTreeT1::OcTreeNode* child = tree1->getNodeChild(root1, i);
           AABB child_bv;
           computeChildBV(bv1, i, child_bv);
 
@@ -670,7 +1572,7 @@ private:
           convertBV(bv2, tf2, aabb2);
           d = aabb1.distance(aabb2);
 
-          if(d < dresult->min_distance)
+          if(d < minDistance())
           {
           
             if(OcTreeDistanceRecurse(tree1, child, child_bv, tree2, root2, bv2, tf1, tf2))
@@ -685,7 +1587,7 @@ private:
       {
         if(tree2->nodeChildExists(root2, i))
         {
-          const OcTree::OcTreeNode* child = tree2->getNodeChild(root2, i);
+          const typename OcTreeT2::OcTreeNode* child = tree2->getNodeChild(root2, i);
           AABB child_bv;
           computeChildBV(bv2, i, child_bv);
 
@@ -695,7 +1597,7 @@ private:
           convertBV(bv2, tf2, aabb2);
           d = aabb1.distance(aabb2);
 
-          if(d < dresult->min_distance)
+          if(d < minDistance())
           {
             if(OcTreeDistanceRecurse(tree1, root1, bv1, tree2, child, child_bv, tf1, tf2))
               return true;
@@ -708,10 +1610,13 @@ private:
   }
 
 
-  bool OcTreeIntersectRecurse(const OcTree* tree1, const OcTree::OcTreeNode* root1, const AABB& bv1,
-                              const OcTree* tree2, const OcTree::OcTreeNode* root2, const AABB& bv2,
+  template<typename OcTreeT1, typename OcTreeT2>
+  bool OcTreeIntersectRecurse(const OcTreeT1* tree1, const typename OcTreeT1::OcTreeNode* root1, const AABB& bv1,
+                              const OcTreeT2* tree2, const typename OcTreeT2::OcTreeNode* root2, const AABB& bv2,
                               const Transform3f& tf1, const Transform3f& tf2) const
   {
+    if(cancelled()) return true;
+
     if(!root1 && !root2)
     {
       OBB obb1, obb2;
@@ -736,13 +1641,13 @@ private:
     }
     else if(!root1 && root2)
     {
-      if(tree2->nodeHasChildren(root2))
+      if(cellHasChildren(tree2, root2, bv2))
       {
         for(unsigned int i = 0; i < 8; ++i)
         {
           if(tree2->nodeChildExists(root2, i))
           {
-            const OcTree::OcTreeNode* child = tree2->getNodeChild(root2, i);
+            const typename OcTreeT2::OcTreeNode* child = tree2->getNodeChild(root2, i);
             AABB child_bv;
             computeChildBV(bv2, i, child_bv);
             if(OcTreeIntersectRecurse(tree1, NULL, bv1, tree2, child, child_bv, tf1, tf2))
@@ -767,13 +1672,13 @@ private:
     }
     else if(root1 && !root2)
     {
-      if(tree1->nodeHasChildren(root1))
+      if(cellHasChildren(tree1, root1, bv1))
       {
         for(unsigned int i = 0; i < 8; ++i)
         {
           if(tree1->nodeChildExists(root1, i))
           {
-            const OcTree::OcTreeNode* child = tree1->getNodeChild(root1, i);
+            const typename OcTreeT1::OcTreeNode* child = tree1->getNodeChild(root1, i);
             AABB child_bv;
             computeChildBV(bv1, i,  child_bv);
             if(OcTreeIntersectRecurse(tree1, child, child_bv, tree2, NULL, bv2, tf1, tf2))
@@ -796,7 +1701,7 @@ private:
       
       return false;
     }
-    else if(!tree1->nodeHasChildren(root1) && !tree2->nodeHasChildren(root2))
+    else if(!cellHasChildren(tree1, root1, bv1) && !cellHasChildren(tree2, root2, bv2))
     {
       if(tree1->isNodeOccupied(root1) && tree2->isNodeOccupied(root2)) // occupied area
       {
@@ -849,13 +1754,13 @@ private:
       if(!obb1.overlap(obb2)) return false;
     }
 
-    if(!tree2->nodeHasChildren(root2) || (tree1->nodeHasChildren(root1) && (bv1.size() > bv2.size())))
+    if(!cellHasChildren(tree2, root2, bv2) || (cellHasChildren(tree1, root1, bv1) && (bv1.size() > bv2.size())))
     {
       for(unsigned int i = 0; i < 8; ++i)
       {
         if(tree1->nodeChildExists(root1, i))
         {
-          const OcTree::OcTreeNode* child = tree1->getNodeChild(root1, i);
+          const typename OcTreeT1::OcTreeNode* child = tree1->getNodeChild(root1, i);
           AABB child_bv;
           computeChildBV(bv1, i, child_bv);
         
@@ -872,7 +1777,7 @@ private:
       {
         if(tree2->nodeChildExists(root2, i))
         {
-          const OcTree::OcTreeNode* child = tree2->getNodeChild(root2, i);
+          const typename OcTreeT2::OcTreeNode* child = tree2->getNodeChild(root2, i);
           AABB child_bv;
           computeChildBV(bv2, i, child_bv);
           
@@ -892,10 +1797,11 @@ private:
 /// @{
 
 /// @brief Traversal node for octree collision
-class HPP_FCL_DLLAPI OcTreeCollisionTraversalNode : public CollisionTraversalNodeBase
+template<typename OcTreeT1, typename OcTreeT2>
+class HPP_FCL_DLLAPI OcTreeCollisionTraversalNodeTpl : public CollisionTraversalNodeBase
 {
 public:
-  OcTreeCollisionTraversalNode(const CollisionRequest& request) :
+  OcTreeCollisionTraversalNodeTpl(const CollisionRequest& request) :
   CollisionTraversalNodeBase (request)
   {
     model1 = NULL;
@@ -919,16 +1825,18 @@ public:
     otsolver->OcTreeIntersect(model1, model2, tf1, tf2, request, *result);
   }
 
-  const OcTree* model1;
-  const OcTree* model2;
+  const OcTreeT1* model1;
+  const OcTreeT2* model2;
 
   Transform3f tf1, tf2;
 
   const OcTreeSolver* otsolver;
 };
 
+typedef OcTreeCollisionTraversalNodeTpl<OcTree, OcTree> OcTreeCollisionTraversalNode;
+
 /// @brief Traversal node for shape-octree collision
-template<typename S>
+template<typename S, typename OcTreeT = OcTree>
 class HPP_FCL_DLLAPI ShapeOcTreeCollisionTraversalNode : public CollisionTraversalNodeBase
 {
 public:
@@ -957,7 +1865,7 @@ public:
   }
 
   const S* model1;
-  const OcTree* model2;
+  const OcTreeT* model2;
 
   Transform3f tf1, tf2;
 
@@ -966,7 +1874,7 @@ public:
 
 /// @brief Traversal node for octree-shape collision
 
-template<typename S>
+template<typename S, typename OcTreeT = OcTree>
 class HPP_FCL_DLLAPI OcTreeShapeCollisionTraversalNode : public CollisionTraversalNodeBase
 {
 public:
@@ -994,7 +1902,7 @@ public:
     otsolver->OcTreeShapeIntersect(model1, *model2, tf1, tf2, request, *result);
   }
 
-  const OcTree* model1;
+  const OcTreeT* model1;
   const S* model2;
 
   Transform3f tf1, tf2;
@@ -1003,7 +1911,7 @@ public:
 };
 
 /// @brief Traversal node for mesh-octree collision
-template<typename BV>
+template<typename BV, typename OcTreeT = OcTree>
 class HPP_FCL_DLLAPI MeshOcTreeCollisionTraversalNode : public CollisionTraversalNodeBase
 {
 public:
@@ -1032,7 +1940,7 @@ public:
   }
 
   const BVHModel<BV>* model1;
-  const OcTree* model2;
+  const OcTreeT* model2;
 
   Transform3f tf1, tf2;
     
@@ -1040,7 +1948,7 @@ public:
 };
 
 /// @brief Traversal node for octree-mesh collision
-template<typename BV>
+template<typename BV, typename OcTreeT = OcTree>
 class HPP_FCL_DLLAPI OcTreeMeshCollisionTraversalNode : public CollisionTraversalNodeBase
 {
 public:
@@ -1068,7 +1976,7 @@ public:
     otsolver->OcTreeMeshIntersect(model1, model2, tf1, tf2, request, *result);
   }
 
-  const OcTree* model1;
+  const OcTreeT* model1;
   const BVHModel<BV>* model2;
 
   Transform3f tf1, tf2;
@@ -1082,10 +1990,11 @@ public:
 /// @{
 
 /// @brief Traversal node for octree distance
-class HPP_FCL_DLLAPI OcTreeDistanceTraversalNode : public DistanceTraversalNodeBase
+template<typename OcTreeT1, typename OcTreeT2>
+class HPP_FCL_DLLAPI OcTreeDistanceTraversalNodeTpl : public DistanceTraversalNodeBase
 {
 public:
-  OcTreeDistanceTraversalNode()
+  OcTreeDistanceTraversalNodeTpl()
   {
     model1 = NULL;
     model2 = NULL;
@@ -1109,16 +2018,16 @@ public:
     otsolver->OcTreeDistance(model1, model2, tf1, tf2, request, *result);
   }
 
-  const OcTree* model1;
-  const OcTree* model2;
+  const OcTreeT1* model1;
+  const OcTreeT2* model2;
 
   const OcTreeSolver* otsolver;
 };
 
-
+typedef OcTreeDistanceTraversalNodeTpl<OcTree, OcTree> OcTreeDistanceTraversalNode;
 
 /// @brief Traversal node for shape-octree distance
-template<typename S>
+template<typename S, typename OcTreeT = OcTree>
 class HPP_FCL_DLLAPI ShapeOcTreeDistanceTraversalNode : public DistanceTraversalNodeBase
 {
 public:
@@ -1141,13 +2050,13 @@ public:
   }
 
   const S* model1;
-  const OcTree* model2;
+  const OcTreeT* model2;
 
   const OcTreeSolver* otsolver;
 };
 
 /// @brief Traversal node for octree-shape distance
-template<typename S>
+template<typename S, typename OcTreeT = OcTree>
 class HPP_FCL_DLLAPI OcTreeShapeDistanceTraversalNode : public DistanceTraversalNodeBase
 {
 public:
@@ -1169,14 +2078,14 @@ public:
     otsolver->OcTreeShapeDistance(model1, *model2, tf1, tf2, request, *result);
   }
 
-  const OcTree* model1;
+  const OcTreeT* model1;
   const S* model2;
 
   const OcTreeSolver* otsolver;
 };
 
 /// @brief Traversal node for mesh-octree distance
-template<typename BV>
+template<typename BV, typename OcTreeT = OcTree>
 class HPP_FCL_DLLAPI MeshOcTreeDistanceTraversalNode : public DistanceTraversalNodeBase
 {
 public:
@@ -1199,14 +2108,14 @@ public:
   }
 
   const BVHModel<BV>* model1;
-  const OcTree* model2;
+  const OcTreeT* model2;
 
   const OcTreeSolver* otsolver;
 
 };
 
 /// @brief Traversal node for octree-mesh distance
-template<typename BV>
+template<typename BV, typename OcTreeT = OcTree>
 class HPP_FCL_DLLAPI OcTreeMeshDistanceTraversalNode : public DistanceTraversalNodeBase
 {
 public:
@@ -1228,7 +2137,7 @@ public:
     otsolver->OcTreeMeshDistance(model1, model2, tf1, tf2, request, *result);
   }
 
-  const OcTree* model1;
+  const OcTreeT* model1;
   const BVHModel<BV>* model2;
 
   const OcTreeSolver* otsolver;
@@ -44,10 +44,7 @@
 #include <hpp/fcl/internal/traversal_node_bvhs.h>
 #include <hpp/fcl/internal/traversal_node_shapes.h>
 #include <hpp/fcl/internal/traversal_node_bvh_shape.h>
-
-#ifdef HPP_FCL_HAVE_OCTOMAP
 #include <hpp/fcl/internal/traversal_node_octree.h>
-#endif
 
 #include <hpp/fcl/BVH/BVH_utility.h>
 
@@ -56,13 +53,13 @@ namespace hpp
 namespace fcl
 {
 
-#ifdef HPP_FCL_HAVE_OCTOMAP
 /// @brief Initialize traversal node for collision between two octrees, given current object transform
-inline bool initialize(OcTreeCollisionTraversalNode& node,
-                       const OcTree& model1, const Transform3f& tf1,
-                       const OcTree& model2, const Transform3f& tf2,
-                       const OcTreeSolver* otsolver,
-                       CollisionResult& result)
+template<typename OcTreeT1, typename OcTreeT2>
+bool initialize(OcTreeCollisionTraversalNodeTpl<OcTreeT1, OcTreeT2>& node,
+                const OcTreeT1& model1, const Transform3f& tf1,
+                const OcTreeT2& model2, const Transform3f& tf2,
+                const OcTreeSolver* otsolver,
+                CollisionResult& result)
 {
   node.result = &result;
 
@@ -78,12 +75,13 @@ inline bool initialize(OcTreeCollisionTraversalNode& node,
 }
 
 /// @brief Initialize traversal node for distance between two octrees, given current object transform
-inline bool initialize(OcTreeDistanceTraversalNode& node,
-                       const OcTree& model1, const Transform3f& tf1,
-                       const OcTree& model2, const Transform3f& tf2,
-                       const OcTreeSolver* otsolver,
-                       const DistanceRequest& request,
-                       DistanceResult& result)
+template<typename OcTreeT1, typename OcTreeT2>
+bool initialize(OcTreeDistanceTraversalNodeTpl<OcTreeT1, OcTreeT2>& node,
+                const OcTreeT1& model1, const Transform3f& tf1,
+                const OcTreeT2& model2, const Transform3f& tf2,
+                const OcTreeSolver* otsolver,
+                const DistanceRequest& request,
+                DistanceResult& result)
 
 {
   node.request = request;
@@ -101,10 +99,10 @@ inline bool initialize(OcTreeDistanceTraversalNode& node,
 }
 
 /// @brief Initialize traversal node for collision between one shape and one octree, given current object transform
-template<typename S>
-bool initialize(ShapeOcTreeCollisionTraversalNode<S>& node,
+template<typename S, typename OcTreeT>
+bool initialize(ShapeOcTreeCollisionTraversalNode<S, OcTreeT>& node,
                 const S& model1, const Transform3f& tf1,
-                const OcTree& model2, const Transform3f& tf2,
+                const OcTreeT& model2, const Transform3f& tf2,
                 const OcTreeSolver* otsolver,
                 CollisionResult& result)
 {
@@ -122,9 +120,9 @@ bool initialize(ShapeOcTreeCollisionTraversalNode<S>& node,
 }
 
 /// @brief Initialize traversal node for collision between one octree and one shape, given current object transform
-template<typename S>
-bool initialize(OcTreeShapeCollisionTraversalNode<S>& node,
-                const OcTree& model1, const Transform3f& tf1,
+template<typename S, typename OcTreeT>
+bool initialize(OcTreeShapeCollisionTraversalNode<S, OcTreeT>& node,
+                const OcTreeT& model1, const Transform3f& tf1,
                 const S& model2, const Transform3f& tf2,
                 const OcTreeSolver* otsolver,
                 CollisionResult& result)
@@ -143,10 +141,10 @@ bool initialize(OcTreeShapeCollisionTraversalNode<S>& node,
 }
 
 /// @brief Initialize traversal node for distance between one shape and one octree, given current object transform
-template<typename S>
-bool initialize(ShapeOcTreeDistanceTraversalNode<S>& node,
+template<typename S, typename OcTreeT>
+bool initialize(ShapeOcTreeDistanceTraversalNode<S, OcTreeT>& node,
                 const S& model1, const Transform3f& tf1,
-                const OcTree& model2, const Transform3f& tf2,
+                const OcTreeT& model2, const Transform3f& tf2,
                 const OcTreeSolver* otsolver,
                 const DistanceRequest& request,
                 DistanceResult& result)
@@ -166,9 +164,9 @@ bool initialize(ShapeOcTreeDistanceTraversalNode<S>& node,
 }
 
 /// @brief Initialize traversal node for distance between one octree and one shape, given current object transform
-template<typename S>
-bool initialize(OcTreeShapeDistanceTraversalNode<S>& node,
-                const OcTree& model1, const Transform3f& tf1,
+template<typename S, typename OcTreeT>
+bool initialize(OcTreeShapeDistanceTraversalNode<S, OcTreeT>& node,
+                const OcTreeT& model1, const Transform3f& tf1,
                 const S& model2, const Transform3f& tf2,
                 const OcTreeSolver* otsolver,
                 const DistanceRequest& request,
@@ -189,10 +187,10 @@ bool initialize(OcTreeShapeDistanceTraversalNode<S>& node,
 }
 
 /// @brief Initialize traversal node for collision between one mesh and one octree, given current object transform
-template<typename BV>
-bool initialize(MeshOcTreeCollisionTraversalNode<BV>& node,
+template<typename BV, typename OcTreeT>
+bool initialize(MeshOcTreeCollisionTraversalNode<BV, OcTreeT>& node,
                 const BVHModel<BV>& model1, const Transform3f& tf1,
-                const OcTree& model2, const Transform3f& tf2,
+                const OcTreeT& model2, const Transform3f& tf2,
                 const OcTreeSolver* otsolver,
                 CollisionResult& result)
 {
@@ -210,9 +208,9 @@ bool initialize(MeshOcTreeCollisionTraversalNode<BV>& node,
 }
 
 /// @brief Initialize traversal node for collision between one octree and one mesh, given current object transform
-template<typename BV>
-bool initialize(OcTreeMeshCollisionTraversalNode<BV>& node,
-                const OcTree& model1, const Transform3f& tf1,
+template<typename BV, typename OcTreeT>
+bool initialize(OcTreeMeshCollisionTraversalNode<BV, OcTreeT>& node,
+                const OcTreeT& model1, const Transform3f& tf1,
                 const BVHModel<BV>& model2, const Transform3f& tf2,
                 const OcTreeSolver* otsolver,
                 CollisionResult& result)
@@ -231,10 +229,10 @@ bool initialize(OcTreeMeshCollisionTraversalNode<BV>& node,
 }
 
 /// @brief Initialize traversal node for distance between one mesh and one octree, given current object transform
-template<typename BV>
-bool initialize(MeshOcTreeDistanceTraversalNode<BV>& node,
+template<typename BV, typename OcTreeT>
+bool initialize(MeshOcTreeDistanceTraversalNode<BV, OcTreeT>& node,
                 const BVHModel<BV>& model1, const Transform3f& tf1,
-                const OcTree& model2, const Transform3f& tf2,
+                const OcTreeT& model2, const Transform3f& tf2,
                 const OcTreeSolver* otsolver,
                 const DistanceRequest& request,
                 DistanceResult& result)
@@ -254,9 +252,9 @@ bool initialize(MeshOcTreeDistanceTraversalNode<BV>& node,
 }
 
 /// @brief Initialize traversal node for collision between one octree and one mesh, given current object transform
-template<typename BV>
-bool initialize(OcTreeMeshDistanceTraversalNode<BV>& node,
-                const OcTree& model1, const Transform3f& tf1,
+template<typename BV, typename OcTreeT>
+bool initialize(OcTreeMeshDistanceTraversalNode<BV, OcTreeT>& node,
+                const OcTreeT& model1, const Transform3f& tf1,
                 const BVHModel<BV>& model2, const Transform3f& tf2,
                 const OcTreeSolver* otsolver,
                 const DistanceRequest& request,
@@ -276,8 +274,6 @@ bool initialize(OcTreeMeshDistanceTraversalNode<BV>& node,
   return true;
 }
 
-#endif
-
 
 /// @brief Initialize traversal node for collision between two geometric shapes, given current object transform
 template<typename S1, typename S2>
@@ -607,6 +603,23 @@ bool initialize(MeshDistanceTraversalNode<BV, 0>& node,
   return true;
 }
 
+/// @brief Initialize traversal node for collision and distance computation
+/// between two meshes
+template<typename BV>
+bool initialize(MeshCollisionDistanceTraversalNode<BV, 0>& node,
+                const BVHModel<BV>& model1, const Transform3f& tf1,
+                const BVHModel<BV>& model2, const Transform3f& tf2,
+                const DistanceRequest& request,
+                DistanceResult& result,
+                CollisionResult& collision_result)
+{
+  if(!initialize(static_cast<MeshDistanceTraversalNode<BV, 0>&>(node),
+                 model1, tf1, model2, tf2, request, result))
+    return false;
+  node.collision_result = &collision_result;
+  return true;
+}
+
 /// @brief Initialize traversal node for distance computation between one mesh and one shape, given the current transforms
 template<typename BV, typename S>
 bool initialize(MeshShapeDistanceTraversalNode<BV, S>& node,
@@ -0,0 +1,500 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Open Source Robotics Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HPP_FCL_TRAVERSAL_PARALLEL_H
+#define HPP_FCL_TRAVERSAL_PARALLEL_H
+
+/// @cond INTERNAL
+
+#include <deque>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <hpp/fcl/internal/traversal_recurse.h>
+
+namespace hpp
+{
+namespace fcl
+{
+
+namespace details
+{
+
+/// @brief Number of threads to use for a request asking for \c num_threads.
+/// 0 means one thread per hardware thread.
+HPP_FCL_DLLAPI unsigned int numTraversalThreads(unsigned int num_threads);
+
+/// @brief Queues of tasks of the workers of a parallel traversal.
+///
+/// A worker takes its tasks from the front of its own queue. When it is
+/// empty, it steals tasks from the back of the queues of the other workers.
+class HPP_FCL_DLLAPI WorkStealingQueues : private boost::noncopyable
+{
+public:
+  WorkStealingQueues(unsigned int num_workers);
+
+  ~WorkStealingQueues();
+
+  /// @brief Give tasks [0, num_tasks) to the workers in a round robin
+  /// fashion, so that the first tasks are started first.
+  void distribute(std::size_t num_tasks);
+
+  /// @brief Get the next task of a worker.
+  /// @return false when all the queues are empty.
+  bool pop(unsigned int worker, std::size_t& task);
+
+private:
+  struct Queue
+  {
+    boost::mutex mutex;
+    std::deque<std::size_t> tasks;
+  };
+
+  std::vector<Queue*> queues;
+};
+
+/// @brief Contacts found by the tasks of a parallel collision traversal.
+///
+/// The contacts of the tasks are merged in the task order. Once the tasks
+/// of [0, t] which are finished provide the requested number of contacts,
+/// the tasks after t are not needed anymore and are cancelled.
+class HPP_FCL_DLLAPI TaskContactCounter : private boost::noncopyable
+{
+public:
+  TaskContactCounter(std::size_t num_tasks, std::size_t max_contacts);
+
+  /// @brief Record that a task found num_contacts contacts.
+  void finish(std::size_t task, std::size_t num_contacts);
+
+  /// @brief Whether the contacts of a task may be part of the result.
+  bool needed(std::size_t task) const
+  {
+    return task <= last_needed.load(boost::memory_order_relaxed);
+  }
+
+private:
+  boost::mutex mutex;
+  std::vector<std::size_t> counts;
+  std::vector<bool> finished;
+  std::size_t max_contacts;
+  boost::atomic<std::size_t> last_needed;
+};
+
+/// @brief Best distance shared by the workers of a parallel distance
+/// traversal.
+class HPP_FCL_DLLAPI SharedBestDistance : private boost::noncopyable
+{
+public:
+  SharedBestDistance(const DistanceResult& result);
+
+  /// @brief Current best distance.
+  FCL_REAL load() const
+  {
+    return best.load(boost::memory_order_relaxed);
+  }
+
+  /// @brief Submit a result found by a worker.
+  /// It is kept if it improves the best distance.
+  void submit(const DistanceResult& result);
+
+  /// @brief The best result. Must be called once the workers are done.
+  const DistanceResult& result() const { return best_result; }
+
+private:
+  boost::atomic<FCL_REAL> best;
+  boost::mutex mutex;
+  DistanceResult best_result;
+};
+
+/// @brief Split the collision traversal of (0, 0) into at least num_tasks
+/// pairs of nodes, unless the hierarchies are too small.
+///
+/// The pairs are stored in the order in which the recursive traversal
+/// visits them, so that concatenating the results of the pairs gives the
+/// result of the recursive traversal.
+/// @retval sqrDistLowerBound squared lower bound of the distance between
+///         the pairs found disjoint.
+template<typename Node>
+void splitCollisionTraversal(const Node& node, std::size_t num_tasks,
+                             std::vector<std::pair<int, int> >& pairs,
+                             FCL_REAL& sqrDistLowerBound)
+{
+  typedef std::pair<int, int> BVPair_t;
+  std::vector<BVPair_t> next;
+  pairs.assign(1, BVPair_t(0, 0));
+  bool split = true;
+  while(split && pairs.size() < num_tasks)
+  {
+    split = false;
+    next.clear();
+    for(std::size_t i = 0; i < pairs.size(); ++i)
+    {
+      int b1 = pairs[i].first, b2 = pairs[i].second;
+      if(node.isFirstNodeLeaf(b1) && node.isSecondNodeLeaf(b2))
+      {
+        next.push_back(pairs[i]);
+        continue;
+      }
+      FCL_REAL sdlb = 0;
+      if(node.BVDisjoints(b1, b2, sdlb))
+      {
+        sqrDistLowerBound = std::min(sqrDistLowerBound, sdlb);
+        continue;
+      }
+      if(node.firstOverSecond(b1, b2))
+      {
+        next.push_back(BVPair_t(node.getFirstLeftChild(b1), b2));
+        next.push_back(BVPair_t(node.getFirstRightChild(b1), b2));
+      }
+      else
+      {
+        next.push_back(BVPair_t(b1, node.getSecondLeftChild(b2)));
+        next.push_back(BVPair_t(b1, node.getSecondRightChild(b2)));
+      }
+      split = true;
+    }
+    pairs.swap(next);
+  }
+}
+
+/// @brief Split the distance traversal of (0, 0) into at least num_tasks
+/// pairs of nodes, unless the hierarchies are too small. The pairs which
+/// cannot improve the current result are dropped and the remaining ones are
+/// sorted, the nearest first.
+template<typename Node>
+void splitDistanceTraversal(const Node& node, std::size_t num_tasks,
+                            std::vector<BVT>& pairs)
+{
+  std::vector<BVT> next;
+  pairs.assign(1, BVT(node.BVDistanceLowerBound(0, 0), 0, 0));
+  bool split = true;
+  while(split && pairs.size() < num_tasks)
+  {
+    split = false;
+    next.clear();
+    for(std::size_t i = 0; i < pairs.size(); ++i)
+    {
+      const BVT& t = pairs[i];
+      if(node.canStop(t.d)) continue;
+      if(node.isFirstNodeLeaf(t.b1) && node.isSecondNodeLeaf(t.b2))
+      {
+        next.push_back(t);
+        continue;
+      }
+      BVT a, c;
+      if(node.firstOverSecond(t.b1, t.b2))
+      {
+        a.b1 = node.getFirstLeftChild(t.b1);
+        c.b1 = node.getFirstRightChild(t.b1);
+        a.b2 = c.b2 = t.b2;
+      }
+      else
+      {
+        a.b1 = c.b1 = t.b1;
+        a.b2 = node.getSecondLeftChild(t.b2);
+        c.b2 = node.getSecondRightChild(t.b2);
+      }
+      a.d = node.BVDistanceLowerBound(a.b1, a.b2);
+      c.d = node.BVDistanceLowerBound(c.b1, c.b2);
+      next.push_back(a);
+      next.push_back(c);
+      split = true;
+    }
+    pairs.swap(next);
+  }
+  // BVT_Comparer puts the nearest pair last.
+  std::stable_sort(pairs.rbegin(), pairs.rend(), BVT_Comparer());
+}
+
+/// @brief Static dispatch of a collision traversal node, whose traversal
+/// stops when its task is cancelled.
+template<typename TraversalNode>
+struct CancellableDispatch : StaticDispatch<TraversalNode>
+{
+  const TaskContactCounter& counter;
+  std::size_t task;
+
+  CancellableDispatch(TraversalNode& n, const TaskContactCounter& c)
+    : StaticDispatch<TraversalNode>(n), counter(c), task(0) {}
+
+  bool canStop() const
+  {
+    return !counter.needed(task) || StaticDispatch<TraversalNode>::canStop();
+  }
+};
+
+/// @brief Static dispatch of a distance traversal node, which shares its
+/// best distance with the other workers.
+///
+/// The result of the node may hold a distance found by another worker,
+/// without the corresponding primitives. Each improvement found by the
+/// node is thus submitted as soon as it is found.
+template<typename TraversalNode>
+struct SharedDistanceDispatch : StaticDispatch<TraversalNode>
+{
+  SharedBestDistance& shared;
+
+  SharedDistanceDispatch(TraversalNode& n, SharedBestDistance& s)
+    : StaticDispatch<TraversalNode>(n), shared(s) {}
+
+  void leafComputeDistance(int b1, int b2) const
+  {
+    DistanceResult& result = *this->node.result;
+    FCL_REAL d = result.min_distance;
+    StaticDispatch<TraversalNode>::leafComputeDistance(b1, b2);
+    if(result.min_distance < d) shared.submit(result);
+  }
+
+  bool canStop(FCL_REAL c) const
+  {
+    DistanceResult& result = *this->node.result;
+    FCL_REAL best = shared.load();
+    if(best < result.min_distance) result.min_distance = best;
+    return StaticDispatch<TraversalNode>::canStop(c);
+  }
+};
+
+/// @brief Add the tests of the copy of a node used by a worker to the
+/// statistics of the query.
+template<typename TraversalNode>
+void addStatistics(const TraversalNode& local, QueryStatistics* statistics,
+                   boost::mutex* mutex)
+{
+  if(!local.request.enable_statistics) return;
+  boost::mutex::scoped_lock lock (*mutex);
+  statistics->num_bv_tests += (size_t) local.num_bv_tests;
+  statistics->num_leaf_tests += (size_t) local.num_leaf_tests;
+}
+
+/// @brief Worker of collisionParallel
+template<typename TraversalNode>
+struct CollisionWorker
+{
+  const TraversalNode* node;
+  const std::vector<std::pair<int, int> >* pairs;
+  std::vector<CollisionResult>* results;
+  std::vector<FCL_REAL>* sqrDistLowerBounds;
+  WorkStealingQueues* queues;
+  TaskContactCounter* counter;
+  QueryStatistics* statistics;
+  boost::mutex* mutex;
+
+  void run(unsigned int worker)
+  {
+    // Each worker writes the contacts in the result of the current task.
+    TraversalNode local (*node);
+    local.num_bv_tests = local.num_leaf_tests = 0;
+    CancellableDispatch<TraversalNode> dispatch (local, *counter);
+    std::size_t task;
+    while(queues->pop(worker, task))
+    {
+      if(!counter->needed(task)) continue;
+      local.result = &(*results)[task];
+      dispatch.task = task;
+      FCL_REAL sqrDistLowerBound = 0;
+      collisionRecurse(dispatch, (*pairs)[task].first, (*pairs)[task].second,
+                       NULL, sqrDistLowerBound);
+      (*sqrDistLowerBounds)[task] = sqrDistLowerBound;
+      counter->finish(task, local.result->numContacts());
+    }
+    addStatistics(local, statistics, mutex);
+  }
+};
+
+/// @brief Worker of distanceParallel
+template<typename TraversalNode>
+struct DistanceWorker
+{
+  const TraversalNode* node;
+  const std::vector<BVT>* pairs;
+  WorkStealingQueues* queues;
+  SharedBestDistance* shared;
+  QueryStatistics* statistics;
+  boost::mutex* mutex;
+
+  void run(unsigned int worker)
+  {
+    TraversalNode local (*node);
+    local.num_bv_tests = local.num_leaf_tests = 0;
+    DistanceResult result;
+    result.min_distance = shared->load();
+    local.result = &result;
+    SharedDistanceDispatch<TraversalNode> dispatch (local, *shared);
+    DistanceTraversalWorkspace workspace;
+    std::size_t task;
+    while(queues->pop(worker, task))
+    {
+      workspace.stack.assign(1, (*pairs)[task]);
+      distanceTraverseStack(dispatch, NULL, workspace);
+    }
+    addStatistics(local, statistics, mutex);
+    if(local.request.enable_statistics)
+    {
+      boost::mutex::scoped_lock lock (*mutex);
+      *statistics += result.statistics;
+    }
+  }
+};
+
+/// @brief Collision traversal of two hierarchies with several threads.
+///
+/// The node pair recursion is split into tasks near the top of both trees,
+/// which are shared between the threads by work stealing. The contacts are
+/// merged in the order of the recursive traversal, so the result does not
+/// depend on the scheduling of the tasks and is the one of collisionRecurse.
+/// The tasks which cannot contribute once enough contacts are found are
+/// cancelled.
+/// \tparam TraversalNode the dynamic type of node. Its methods must be safe
+///         to call concurrently on copies of node.
+template<typename TraversalNode>
+void collisionParallel(TraversalNode& node, const CollisionRequest& request,
+                       CollisionResult& result, unsigned int num_threads)
+{
+  typedef std::pair<int, int> BVPair_t;
+  num_threads = numTraversalThreads(num_threads);
+
+  std::vector<BVPair_t> pairs;
+  FCL_REAL sqrDistLowerBound = std::numeric_limits<FCL_REAL>::infinity();
+  splitCollisionTraversal(StaticDispatch<TraversalNode>(node),
+                          32 * num_threads, pairs, sqrDistLowerBound);
+  if(num_threads > pairs.size())
+    num_threads = (unsigned int) std::max(pairs.size(), std::size_t(1));
+
+  std::size_t max_contacts = request.num_max_contacts - result.numContacts();
+  std::vector<CollisionResult> results (pairs.size());
+  std::vector<FCL_REAL> sqrDistLowerBounds (pairs.size(),
+      std::numeric_limits<FCL_REAL>::infinity());
+  WorkStealingQueues queues (num_threads);
+  queues.distribute(pairs.size());
+  TaskContactCounter counter (pairs.size(), max_contacts);
+  boost::mutex mutex;
+
+  CollisionWorker<TraversalNode> worker;
+  worker.node = &node;
+  worker.pairs = &pairs;
+  worker.results = &results;
+  worker.sqrDistLowerBounds = &sqrDistLowerBounds;
+  worker.queues = &queues;
+  worker.counter = &counter;
+  worker.statistics = &result.statistics;
+  worker.mutex = &mutex;
+
+  // The calling thread is one of the workers.
+  boost::thread_group threads;
+  for(unsigned int i = 1; i < num_threads; ++i)
+    threads.create_thread(boost::bind(&CollisionWorker<TraversalNode>::run,
+                                      &worker, i));
+  worker.run(0);
+  threads.join_all();
+
+  if(request.enable_statistics)
+    for(std::size_t t = 0; t < pairs.size(); ++t)
+      result.statistics += results[t].statistics;
+  for(std::size_t t = 0; t < pairs.size(); ++t)
+  {
+    for(std::size_t i = 0; i < results[t].numContacts()
+          && result.numContacts() < request.num_max_contacts; ++i)
+      result.addContact(results[t].getContact(i));
+    sqrDistLowerBound = std::min(sqrDistLowerBound, sqrDistLowerBounds[t]);
+    if(request.isSatisfied(result)) break;
+  }
+  if(sqrDistLowerBound < std::numeric_limits<FCL_REAL>::infinity())
+    result.updateDistanceLowerBound(sqrt(sqrDistLowerBound));
+}
+
+/// @brief Distance traversal of two hierarchies with several threads.
+///
+/// The node pair recursion is split into tasks near the top of both trees,
+/// which are shared between the threads by work stealing, the nearest pairs
+/// first. The best distance is shared between the threads, so that each
+/// thread prunes the pairs which cannot improve the distance found by the
+/// others.
+/// \note when several pairs of primitives are at the minimal distance, the
+///       returned pair depends on the scheduling.
+/// \tparam TraversalNode the dynamic type of node. Its methods must be safe
+///         to call concurrently on copies of node.
+template<typename TraversalNode>
+void distanceParallel(TraversalNode& node, unsigned int num_threads)
+{
+  num_threads = numTraversalThreads(num_threads);
+  node.preprocess();
+
+  std::vector<BVT> pairs;
+  splitDistanceTraversal(StaticDispatch<TraversalNode>(node),
+                         32 * num_threads, pairs);
+  if(num_threads > pairs.size())
+    num_threads = (unsigned int) std::max(pairs.size(), std::size_t(1));
+
+  WorkStealingQueues queues (num_threads);
+  queues.distribute(pairs.size());
+  SharedBestDistance shared (*node.result);
+  QueryStatistics statistics (node.result->statistics);
+  boost::mutex mutex;
+
+  DistanceWorker<TraversalNode> worker;
+  worker.node = &node;
+  worker.pairs = &pairs;
+  worker.queues = &queues;
+  worker.shared = &shared;
+  worker.statistics = &statistics;
+  worker.mutex = &mutex;
+
+  boost::thread_group threads;
+  for(unsigned int i = 1; i < num_threads; ++i)
+    threads.create_thread(boost::bind(&DistanceWorker<TraversalNode>::run,
+                                      &worker, i));
+  worker.run(0);
+  threads.join_all();
+
+  *node.result = shared.result();
+  node.result->statistics = statistics;
+  node.postprocess();
+}
+
+} // namespace details
+
+}
+
+} // namespace hpp
+
+/// @endcond
+
+#endif
@@ -41,7 +41,10 @@
 /// @cond INTERNAL
 
 #include <hpp/fcl/BVH/BVH_front.h>
+#include <algorithm>
+#include <limits>
 #include <queue>
+#include <vector>
 #include <hpp/fcl/internal/traversal_node_base.h>
 #include <hpp/fcl/internal/traversal_node_bvhs.h>
 
@@ -50,6 +53,489 @@ namespace hpp
 namespace fcl
 {
 
+/** @brief Bounding volume test structure */
+struct BVT
+{
+  /** @brief distance between bvs */
+  FCL_REAL d;
+
+  /** @brief bv indices for a pair of bvs in two models */
+  int b1, b2;
+
+  BVT() {}
+  BVT(FCL_REAL d_, int b1_, int b2_) : d(d_), b1(b1_), b2(b2_) {}
+};
+
+/** @brief Comparer between two BVT */
+struct BVT_Comparer
+{
+  bool operator() (const BVT& lhs, const BVT& rhs) const
+  {
+    return lhs.d > rhs.d;
+  }
+};
+
+/// @brief Memory used by the non recursive distance traversals.
+/// Reusing the same workspace for several queries avoids allocating memory
+/// at each query. A workspace must not be used by two queries at the same
+/// time.
+struct DistanceTraversalWorkspace
+{
+  /// @brief Pairs of bounding volumes to visit in depth first order.
+  std::vector<BVT> stack;
+  /// @brief Pairs of bounding volumes to visit in best first order, as a
+  /// heap ordered by BVT_Comparer.
+  std::vector<BVT> heap;
+};
+
+namespace details
+{
+/// @brief Call the methods of a traversal node without virtual dispatch.
+///
+/// The traversal loops below are templated on the node type. Instantiated
+/// with CollisionTraversalNodeBase or DistanceTraversalNodeBase, each visited
+/// pair of bounding volumes costs several virtual calls. Instantiated with
+/// StaticDispatch<T>, the calls are resolved at compile time and can be
+/// inlined.
+/// \tparam TraversalNode the dynamic type of the node.
+template<typename TraversalNode>
+struct StaticDispatch
+{
+  TraversalNode& node;
+  TraversalBudget& budget;
+
+  StaticDispatch(TraversalNode& n) : node(n), budget(n.budget) {}
+
+  bool isFirstNodeLeaf(int b) const { return node.TraversalNode::isFirstNodeLeaf(b); }
+  bool isSecondNodeLeaf(int b) const { return node.TraversalNode::isSecondNodeLeaf(b); }
+  bool firstOverSecond(int b1, int b2) const { return node.TraversalNode::firstOverSecond(b1, b2); }
+  int getFirstLeftChild(int b) const { return node.TraversalNode::getFirstLeftChild(b); }
+  int getFirstRightChild(int b) const { return node.TraversalNode::getFirstRightChild(b); }
+  int getSecondLeftChild(int b) const { return node.TraversalNode::getSecondLeftChild(b); }
+  int getSecondRightChild(int b) const { return node.TraversalNode::getSecondRightChild(b); }
+
+  bool BVDisjoints(int b1, int b2, FCL_REAL& sqrDistLowerBound) const
+  { return node.TraversalNode::BVDisjoints(b1, b2, sqrDistLowerBound); }
+  void leafCollides(int b1, int b2, FCL_REAL& sqrDistLowerBound) const
+  { node.TraversalNode::leafCollides(b1, b2, sqrDistLowerBound); }
+  bool canStop() const { return node.TraversalNode::canStop(); }
+
+  FCL_REAL BVDistanceLowerBound(int b1, int b2) const
+  { return node.TraversalNode::BVDistanceLowerBound(b1, b2); }
+  void leafComputeDistance(int b1, int b2) const
+  { node.TraversalNode::leafComputeDistance(b1, b2); }
+  bool canStop(FCL_REAL c) const { return node.TraversalNode::canStop(c); }
+};
+
+template<typename Node>
+void collisionRecurse(const Node& node, int b1, int b2,
+                      BVHFrontList* front_list, FCL_REAL& sqrDistLowerBound)
+{
+  // Nothing is known about the pairs left unvisited.
+  if(node.budget.consume()) { sqrDistLowerBound = 0; return; }
+
+  FCL_REAL sqrDistLowerBound1 = 0, sqrDistLowerBound2 = 0;
+  bool l1 = node.isFirstNodeLeaf(b1);
+  bool l2 = node.isSecondNodeLeaf(b2);
+  if(l1 && l2)
+  {
+    updateFrontList(front_list, b1, b2);
+
+   // if(node.BVDisjoints(b1, b2, sqrDistLowerBound)) return;
+    node.leafCollides(b1, b2, sqrDistLowerBound);
+    return;
+  }
+
+  if(node.BVDisjoints(b1, b2, sqrDistLowerBound)) {
+    updateFrontList(front_list, b1, b2);
+    return;
+  }
+  if(node.firstOverSecond(b1, b2))
+  {
+    int c1 = node.getFirstLeftChild(b1);
+    int c2 = node.getFirstRightChild(b1);
+
+    collisionRecurse(node, c1, b2, front_list, sqrDistLowerBound1);
+
+    // early stop is disabled is front_list is used
+    if(node.canStop() && !front_list) return;
+
+    collisionRecurse(node, c2, b2, front_list, sqrDistLowerBound2);
+    sqrDistLowerBound = std::min (sqrDistLowerBound1, sqrDistLowerBound2);
+  }
+  else
+  {
+    int c1 = node.getSecondLeftChild(b2);
+    int c2 = node.getSecondRightChild(b2);
+
+    collisionRecurse(node, b1, c1, front_list, sqrDistLowerBound1);
+
+    // early stop is disabled is front_list is used
+    if(node.canStop() && !front_list) return;
+
+    collisionRecurse(node, b1, c2, front_list, sqrDistLowerBound2);
+    sqrDistLowerBound = std::min (sqrDistLowerBound1, sqrDistLowerBound2);
+  }
+}
+
+template<typename Node>
+void collisionNonRecurse(const Node& node,
+                         BVHFrontList* front_list, FCL_REAL& sqrDistLowerBound)
+{
+  typedef std::pair<int, int> BVPair_t;
+  //typedef std::stack<BVPair_t, std::vector<BVPair_t> > Stack_t;
+  typedef std::vector<BVPair_t> Stack_t;
+
+  Stack_t pairs;
+  pairs.reserve (1000);
+  sqrDistLowerBound = std::numeric_limits<FCL_REAL>::infinity();
+  FCL_REAL sdlb = std::numeric_limits<FCL_REAL>::infinity();
+
+  pairs.push_back (BVPair_t (0, 0));
+
+  while (!pairs.empty()) {
+    // Nothing is known about the pairs left unvisited.
+    if(node.budget.consume()) { sqrDistLowerBound = 0; return; }
+
+    int a = pairs.back().first,
+        b = pairs.back().second;
+    pairs.pop_back();
+
+    bool la = node.isFirstNodeLeaf(a);
+    bool lb = node.isSecondNodeLeaf(b);
+
+    // Leaf / Leaf case
+    if (la && lb) {
+      updateFrontList(front_list, a, b);
+
+      // TODO should we test the BVs ?
+      //if(node.BVDijsoints(a, b, sdlb)) {
+        //if (sdlb < sqrDistLowerBound) sqrDistLowerBound = sdlb;
+        //continue;
+      //}
+      node.leafCollides(a, b, sdlb);
+      if (sdlb < sqrDistLowerBound) sqrDistLowerBound = sdlb;
+      if (node.canStop() && !front_list) return;
+      continue;
+    }
+
+    // Check the BV. When only one node is a leaf, the node may test its
+    // primitive against the other BV.
+    if(node.BVDisjoints(a, b, sdlb)) {
+      if (sdlb < sqrDistLowerBound) sqrDistLowerBound = sdlb;
+      updateFrontList(front_list, a, b);
+      continue;
+    }
+
+    if(node.firstOverSecond(a, b))
+    {
+      int c1 = node.getFirstLeftChild(a);
+      int c2 = node.getFirstRightChild(a);
+      pairs.push_back (BVPair_t (c2, b));
+      pairs.push_back (BVPair_t (c1, b));
+    }
+    else
+    {
+      int c1 = node.getSecondLeftChild(b);
+      int c2 = node.getSecondRightChild(b);
+      pairs.push_back (BVPair_t (a, c2));
+      pairs.push_back (BVPair_t (a, c1));
+    }
+  }
+}
+
+template<typename Node>
+void distanceRecurse(const Node& node, int b1, int b2, BVHFrontList* front_list)
+{
+  if(node.budget.consume())
+  {
+    // The lower bound of this pair is not known here.
+    node.budget.updateRemainingLowerBound(
+        -std::numeric_limits<FCL_REAL>::infinity());
+    return;
+  }
+
+  bool l1 = node.isFirstNodeLeaf(b1);
+  bool l2 = node.isSecondNodeLeaf(b2);
+
+  if(l1 && l2)
+  {
+    updateFrontList(front_list, b1, b2);
+
+    node.leafComputeDistance(b1, b2);
+    return;
+  }
+
+  int a1, a2, c1, c2;
+
+  if(node.firstOverSecond(b1, b2))
+  {
+    a1 = node.getFirstLeftChild(b1);
+    a2 = b2;
+    c1 = node.getFirstRightChild(b1);
+    c2 = b2;
+  }
+  else
+  {
+    a1 = b1;
+    a2 = node.getSecondLeftChild(b2);
+    c1 = b1;
+    c2 = node.getSecondRightChild(b2);
+  }
+
+  FCL_REAL d1 = node.BVDistanceLowerBound(a1, a2);
+  FCL_REAL d2 = node.BVDistanceLowerBound(c1, c2);
+
+  if(d2 < d1)
+  {
+    if(!node.canStop(d2))
+      distanceRecurse(node, c1, c2, front_list);
+    else
+      updateFrontList(front_list, c1, c2);
+
+    if(!node.canStop(d1))
+      distanceRecurse(node, a1, a2, front_list);
+    else
+      updateFrontList(front_list, a1, a2);
+  }
+  else
+  {
+    if(!node.canStop(d1))
+      distanceRecurse(node, a1, a2, front_list);
+    else
+      updateFrontList(front_list, a1, a2);
+
+    if(!node.canStop(d2))
+      distanceRecurse(node, c1, c2, front_list);
+    else
+      updateFrontList(front_list, c1, c2);
+  }
+}
+
+/// Depth first distance traversal of the pairs of workspace.stack, visiting
+/// the nearest pair of children first. Pairs which cannot improve the result
+/// are pruned when they are visited.
+template<typename Node>
+void distanceTraverseStack(const Node& node, BVHFrontList* front_list,
+                           DistanceTraversalWorkspace& workspace)
+{
+  std::vector<BVT>& stack = workspace.stack;
+  while(!stack.empty())
+  {
+    BVT t = stack.back();
+    stack.pop_back();
+
+    if(node.canStop(t.d))
+    {
+      updateFrontList(front_list, t.b1, t.b2);
+      continue;
+    }
+
+    if(node.budget.consume())
+    {
+      node.budget.updateRemainingLowerBound(t.d);
+      for(std::size_t i = 0; i < stack.size(); ++i)
+        node.budget.updateRemainingLowerBound(stack[i].d);
+      stack.clear();
+      return;
+    }
+
+    bool l1 = node.isFirstNodeLeaf(t.b1);
+    bool l2 = node.isSecondNodeLeaf(t.b2);
+    if(l1 && l2)
+    {
+      updateFrontList(front_list, t.b1, t.b2);
+      node.leafComputeDistance(t.b1, t.b2);
+      continue;
+    }
+
+    BVT a, c;
+    if(node.firstOverSecond(t.b1, t.b2))
+    {
+      a.b1 = node.getFirstLeftChild(t.b1);
+      c.b1 = node.getFirstRightChild(t.b1);
+      a.b2 = c.b2 = t.b2;
+    }
+    else
+    {
+      a.b1 = c.b1 = t.b1;
+      a.b2 = node.getSecondLeftChild(t.b2);
+      c.b2 = node.getSecondRightChild(t.b2);
+    }
+    a.d = node.BVDistanceLowerBound(a.b1, a.b2);
+    c.d = node.BVDistanceLowerBound(c.b1, c.b2);
+
+    // The nearest pair is pushed last, to be visited first.
+    if(c.d < a.d)
+    {
+      stack.push_back(a);
+      stack.push_back(c);
+    }
+    else
+    {
+      stack.push_back(c);
+      stack.push_back(a);
+    }
+  }
+}
+
+/// Depth first distance traversal of the pairs below (b1, b2).
+/// \sa distanceTraverseStack
+template<typename Node>
+void distanceNonRecurse(const Node& node, int b1, int b2,
+                        BVHFrontList* front_list,
+                        DistanceTraversalWorkspace& workspace)
+{
+  std::vector<BVT>& stack = workspace.stack;
+  stack.clear();
+  stack.push_back(BVT(-std::numeric_limits<FCL_REAL>::infinity(), b1, b2));
+  distanceTraverseStack(node, front_list, workspace);
+}
+
+/// Depth first distance traversal starting from the front of a previous
+/// traversal. The pairs of the front are visited nearest first and the
+/// front is replaced by the front of this traversal.
+template<typename Node>
+void propagateBVHFrontListDistance(const Node& node, BVHFrontList* front_list,
+                                   DistanceTraversalWorkspace& workspace)
+{
+  std::vector<BVT>& stack = workspace.stack;
+  stack.clear();
+  for(BVHFrontList::const_iterator it = front_list->begin();
+      it != front_list->end(); ++it)
+    stack.push_back(BVT(node.BVDistanceLowerBound(it->left, it->right),
+                        it->left, it->right));
+  // The nearest pair is the last one, to be visited first.
+  std::sort(stack.begin(), stack.end(), BVT_Comparer());
+  front_list->clear();
+  distanceTraverseStack(node, front_list, workspace);
+}
+
+/// Collision traversal starting from the front of a previous traversal.
+/// The pairs of the front whose bounding volumes still overlap, as well as
+/// the pairs of leaves, are replaced by the front of their subtree.
+template<typename Node>
+void propagateBVHFrontListCollisionRecurse(const Node& node,
+                                           CollisionResult& result,
+                                           BVHFrontList* front_list)
+{
+  FCL_REAL sqrDistLowerBound = std::numeric_limits<FCL_REAL>::infinity(),
+    sqrDistLowerBound1 = 0, sqrDistLowerBound2 = 0, sdlb = 0;
+  // The nodes appended during the loop are already up to date.
+  const std::size_t n = front_list->size();
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    int b1 = (*front_list)[i].left;
+    int b2 = (*front_list)[i].right;
+    bool l1 = node.isFirstNodeLeaf(b1);
+    bool l2 = node.isSecondNodeLeaf(b2);
+
+    if(l1 & l2)
+    {
+      (*front_list)[i].valid = false; // the front node is no longer valid, in collideRecurse will add again.
+      collisionRecurse(node, b1, b2, front_list, sdlb);
+    }
+    else if(!node.BVDisjoints(b1, b2, sdlb))
+    {
+      (*front_list)[i].valid = false;
+      if(node.firstOverSecond(b1, b2)) {
+        int c1 = node.getFirstLeftChild(b1);
+        int c2 = node.getFirstRightChild(b1);
+
+        collisionRecurse(node, c1, b2, front_list, sqrDistLowerBound1);
+        collisionRecurse(node, c2, b2, front_list, sqrDistLowerBound2);
+      } else {
+        int c1 = node.getSecondLeftChild(b2);
+        int c2 = node.getSecondRightChild(b2);
+
+        collisionRecurse(node, b1, c1, front_list, sqrDistLowerBound1);
+        collisionRecurse(node, b1, c2, front_list, sqrDistLowerBound2);
+      }
+      sdlb = std::min (sqrDistLowerBound1, sqrDistLowerBound2);
+    }
+    sqrDistLowerBound = std::min (sqrDistLowerBound, sdlb);
+  }
+  if(n > 0)
+    result.updateDistanceLowerBound (sqrt (sqrDistLowerBound));
+
+  // clean the old front list (remove invalid node)
+  front_list->erase(std::remove_if(front_list->begin(), front_list->end(),
+                                   isInvalidFrontNode),
+                    front_list->end());
+}
+
+/// Best first distance traversal of the pairs below (b1, b2), with at most
+/// qsize pairs waiting in the heap. When the heap is full, the subtree of
+/// the nearest pair is traversed depth first.
+template<typename Node>
+void distanceQueueNonRecurse(const Node& node, int b1, int b2,
+                             BVHFrontList* front_list, int qsize,
+                             DistanceTraversalWorkspace& workspace)
+{
+  std::vector<BVT>& heap = workspace.heap;
+  BVT_Comparer comparer;
+  heap.clear();
+  heap.push_back(BVT(-std::numeric_limits<FCL_REAL>::infinity(), b1, b2));
+
+  while(!heap.empty())
+  {
+    std::pop_heap(heap.begin(), heap.end(), comparer);
+    BVT t = heap.back();
+    heap.pop_back();
+
+    if(node.canStop(t.d))
+    {
+      updateFrontList(front_list, t.b1, t.b2);
+      break;
+    }
+
+    if(node.budget.consume())
+    {
+      node.budget.updateRemainingLowerBound(t.d);
+      for(std::size_t i = 0; i < heap.size(); ++i)
+        node.budget.updateRemainingLowerBound(heap[i].d);
+      heap.clear();
+      return;
+    }
+
+    bool l1 = node.isFirstNodeLeaf(t.b1);
+    bool l2 = node.isSecondNodeLeaf(t.b2);
+    if(l1 && l2)
+    {
+      updateFrontList(front_list, t.b1, t.b2);
+      node.leafComputeDistance(t.b1, t.b2);
+    }
+    else if((int)heap.size() + 1 >= qsize)
+    {
+      // queue should not get two more tests
+      distanceNonRecurse(node, t.b1, t.b2, front_list, workspace);
+    }
+    else
+    {
+      BVT a, c;
+      if(node.firstOverSecond(t.b1, t.b2))
+      {
+        a.b1 = node.getFirstLeftChild(t.b1);
+        c.b1 = node.getFirstRightChild(t.b1);
+        a.b2 = c.b2 = t.b2;
+      }
+      else
+      {
+        a.b1 = c.b1 = t.b1;
+        a.b2 = node.getSecondLeftChild(t.b2);
+        c.b2 = node.getSecondRightChild(t.b2);
+      }
+      a.d = node.BVDistanceLowerBound(a.b1, a.b2);
+      c.d = node.BVDistanceLowerBound(c.b1, c.b2);
+      heap.push_back(a);
+      std::push_heap(heap.begin(), heap.end(), comparer);
+      heap.push_back(c);
+      std::push_heap(heap.begin(), heap.end(), comparer);
+    }
+  }
+}
+}
+
 /// Recurse function for collision
 /// @param node collision node,
 /// @param b1, b2 ids of bounding volume nodes for object 1 and object 2
@@ -66,11 +552,29 @@ void distanceRecurse(DistanceTraversalNodeBase* node, int b1, int b2, BVHFrontLi
 /// @brief Recurse function for distance, using queue acceleration
 void distanceQueueRecurse(DistanceTraversalNodeBase* node, int b1, int b2, BVHFrontList* front_list, int qsize);
 
+/// @brief Non recursive function for distance, visiting the nearest pair of
+/// bounding volumes first.
+/// @param workspace memory reused between queries.
+void distanceNonRecurse(DistanceTraversalNodeBase* node, int b1, int b2,
+                        BVHFrontList* front_list,
+                        DistanceTraversalWorkspace& workspace);
+
+/// @brief Non recursive function for distance, using queue acceleration.
+/// @param workspace memory reused between queries.
+void distanceQueueNonRecurse(DistanceTraversalNodeBase* node, int b1, int b2,
+                             BVHFrontList* front_list, int qsize,
+                             DistanceTraversalWorkspace& workspace);
+
 /// @brief Recurse function for front list propagation
 void propagateBVHFrontListCollisionRecurse
   (CollisionTraversalNodeBase* node, const CollisionRequest& request,
    CollisionResult& result, BVHFrontList* front_list);
 
+/// @brief Non recursive distance function starting from a front list.
+void propagateBVHFrontListDistance(DistanceTraversalNodeBase* node,
+                                   BVHFrontList* front_list,
+                                   DistanceTraversalWorkspace& workspace);
+
 }
 
 } // namespace hpp
@@ -0,0 +1,346 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HPP_FCL_LINEAR_OCTREE_H
+#define HPP_FCL_LINEAR_OCTREE_H
+
+#include <vector>
+
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <hpp/fcl/BV/AABB.h>
+#include <hpp/fcl/collision_object.h>
+
+namespace hpp
+{
+namespace fcl
+{
+
+class OcTree;
+
+namespace details
+{
+struct LinearOcTreeIO;
+}
+
+/// @brief Octree stored in a single contiguous array, without pointers.
+///
+/// The nodes are stored level by level, from the root to the finest cells.
+/// Inside a level, the nodes are sorted by Morton code so that the children
+/// of a node are contiguous and only the index of the first one is stored,
+/// together with a bit mask of the existing children. The occupancy state of
+/// each node is computed once from the thresholds, so that the traversals do
+/// not compare probabilities.
+///
+/// The cells use the same convention as octomap: the root cell is centered at
+/// the origin and a cell of the finest level has the size of the resolution.
+/// A LinearOcTree can be used wherever an OcTree can, and does not depend on
+/// octomap.
+///
+/// The node array can be saved to a file and mapped back into memory, read
+/// only (see \ref saveLinearOcTree and \ref loadLinearOcTree).
+class HPP_FCL_DLLAPI LinearOcTree : public CollisionGeometry
+{
+public:
+  /// @brief A node of the tree.
+  struct Node
+  {
+    /// @brief Index of the first child in the node array.
+    boost::uint32_t first_child;
+    /// @brief Bit i is set when child i exists.
+    unsigned char child_mask;
+    /// @brief Occupancy state, a combination of \ref Occupied and \ref Free.
+    unsigned char flags;
+    /// @brief Occupancy probability. For an inner node, it is the maximum
+    ///        occupancy of its children.
+    float occupancy;
+  };
+
+  typedef Node OcTreeNode;
+
+  /// @brief Values of Node::flags
+  enum NodeFlag { Occupied = 1, Free = 2 };
+
+  /// @brief Maximal depth of the tree, so that the Morton codes fit in 64 bits.
+  static const unsigned int MAX_DEPTH = 21;
+
+  /// @brief construct an empty octree with a given resolution
+  LinearOcTree(FCL_REAL resolution, unsigned int depth = 16);
+
+  /// @brief construct an octree whose occupied cells contain the given points
+  /// @param resolution the size of the finest cells.
+  /// @param occupied_points the points of the occupied space. The points
+  ///        which lie outside the root cell are ignored.
+  /// @param depth the depth of the tree.
+  LinearOcTree(FCL_REAL resolution, const std::vector<Vec3f>& occupied_points,
+               unsigned int depth = 16);
+
+#ifdef HPP_FCL_HAVE_OCTOMAP
+  /// @brief construct an octree with the same cells and thresholds as an
+  ///        octomap based OcTree.
+  explicit LinearOcTree(const OcTree& tree);
+#endif
+
+  /// @brief copy another octree. A memory mapped octree shares its mapping
+  ///        with its copies.
+  LinearOcTree(const LinearOcTree& other);
+
+  LinearOcTree& operator=(const LinearOcTree& other);
+
+  /// @brief Whether the nodes are a read-only view into a memory mapped file
+  /// (see \ref loadLinearOcTree).
+  /// Changing the thresholds first copies the nodes into memory owned by
+  /// this object.
+  bool isMemoryMapped() const
+  {
+    return mapped_storage.get() != NULL;
+  }
+
+  /// @brief compute the AABB for the octree in its local coordinate system
+  void computeLocalAABB()
+  {
+    aabb_local = getRootBV();
+    aabb_center = aabb_local.center();
+    aabb_radius = (aabb_local.min_ - aabb_center).norm();
+  }
+
+  /// @brief get the bounding volume for the root
+  AABB getRootBV() const
+  {
+    FCL_REAL delta = (FCL_REAL)((boost::uint64_t)1 << depth) * resolution / 2;
+    return AABB(Vec3f(-delta, -delta, -delta), Vec3f(delta, delta, delta));
+  }
+
+  /// @brief get the root node of the octree, NULL if the octree is empty.
+  const OcTreeNode* getRoot() const
+  {
+    return num_nodes ? node_data : NULL;
+  }
+
+  /// @brief whether one node is completely occupied
+  bool isNodeOccupied(const OcTreeNode* node) const
+  {
+    return (node->flags & Occupied) != 0;
+  }
+
+  /// @brief whether one node is completely free
+  bool isNodeFree(const OcTreeNode* node) const
+  {
+    return (node->flags & Free) != 0;
+  }
+
+  /// @brief whether one node is uncertain
+  bool isNodeUncertain(const OcTreeNode* node) const
+  {
+    return node->flags == 0;
+  }
+
+  /// @return const ptr to child number childIdx of node
+  const OcTreeNode* getNodeChild(const OcTreeNode* node, unsigned int childIdx) const
+  {
+    unsigned int before = node->child_mask & ((1u << childIdx) - 1);
+    return &node_data[node->first_child + bitCount(before)];
+  }
+
+  /// @brief return true if the child at childIdx exists
+  bool nodeChildExists(const OcTreeNode* node, unsigned int childIdx) const
+  {
+    return (node->child_mask & (1u << childIdx)) != 0;
+  }
+
+  /// @brief return true if node has at least one child
+  bool nodeHasChildren(const OcTreeNode* node) const
+  {
+    return node->child_mask != 0;
+  }
+
+  /// @brief transform the octree into a bunch of boxes; only the occupied
+  ///        leaves are kept. Each box is {x, y, z, size, occupancy, threshold}.
+  std::vector<boost::array<FCL_REAL, 6> > toBoxes() const;
+
+  /// @brief merge the occupied leaves of the octree into larger boxes
+  ///
+  /// Runs of occupied leaves with the same cross section are merged along
+  /// each axis in turn, until no box can be extended. The boxes cover
+  /// exactly the occupied leaves and do not overlap, but there are usually
+  /// far fewer boxes than leaves.
+  /// \sa BoxSet
+  std::vector<AABB> toMergedBoxes() const;
+
+  /// @brief the regions where the state of the cells differs from another
+  ///        octree
+  ///
+  /// The regions are the largest cells of this tree or of previous in which
+  /// the occupancy state of some cell changed. They can be recorded in an
+  /// OcTreeChangeTracker.
+  /// @param previous an octree with the same resolution and depth, usually
+  ///        the previous version of the map.
+  std::vector<AABB> changedRegions(const LinearOcTree& previous) const;
+
+  /// @brief the threshold used to decide whether one node is occupied
+  FCL_REAL getOccupancyThres() const
+  {
+    return occupancy_threshold;
+  }
+
+  /// @brief the threshold used to decide whether one node is free
+  FCL_REAL getFreeThres() const
+  {
+    return free_threshold;
+  }
+
+  FCL_REAL getDefaultOccupancy() const
+  {
+    return default_occupancy;
+  }
+
+  void setCellDefaultOccupancy(FCL_REAL d)
+  {
+    default_occupancy = d;
+  }
+
+  /// @brief set the occupancy threshold and update the state of the nodes
+  void setOccupancyThres(FCL_REAL d);
+
+  /// @brief set the free threshold and update the state of the nodes
+  void setFreeThres(FCL_REAL d);
+
+  /// @brief the size of the finest cells
+  FCL_REAL getResolution() const
+  {
+    return resolution;
+  }
+
+  /// @brief the number of levels below the root
+  unsigned int getTreeDepth() const
+  {
+    return depth;
+  }
+
+  /// @brief number of nodes
+  std::size_t size() const
+  {
+    return num_nodes;
+  }
+
+  /// @brief the \ref size nodes, stored level by level in Morton order
+  const Node* getNodes() const
+  {
+    return node_data;
+  }
+
+  /// @brief return object type, it is an octree
+  OBJECT_TYPE getObjectType() const { return OT_OCTREE; }
+
+  /// @brief return node type, it is a linear octree
+  NODE_TYPE getNodeType() const { return GEOM_LINEAR_OCTREE; }
+
+private:
+  /// @brief the nodes, when they are not mapped from a file
+  std::vector<Node> nodes;
+  /// @brief the mapping of the file which holds the nodes, if any
+  boost::shared_ptr<const void> mapped_storage;
+  /// @brief the first node, in nodes or in the mapping
+  const Node* node_data;
+  std::size_t num_nodes;
+
+  FCL_REAL resolution;
+  unsigned int depth;
+
+  FCL_REAL default_occupancy;
+
+  FCL_REAL occupancy_threshold;
+  FCL_REAL free_threshold;
+
+  static unsigned int bitCount(unsigned int mask)
+  {
+    mask = mask - ((mask >> 1) & 0x55);
+    mask = (mask & 0x33) + ((mask >> 2) & 0x33);
+    return (mask + (mask >> 4)) & 0x0F;
+  }
+
+  void init(FCL_REAL resolution, unsigned int depth);
+
+  /// @brief use the nodes owned by the tree
+  void useOwnedNodes();
+
+  friend struct details::LinearOcTreeIO;
+
+  void updateFlags();
+};
+
+/// @brief compute the bounding volume of an octree node's i-th child
+static inline void computeChildBV(const AABB& root_bv, unsigned int i, AABB& child_bv)
+{
+  if(i&1)
+  {
+    child_bv.min_[0] = (root_bv.min_[0] + root_bv.max_[0]) * 0.5;
+    child_bv.max_[0] = root_bv.max_[0];
+  }
+  else
+  {
+    child_bv.min_[0] = root_bv.min_[0];
+    child_bv.max_[0] = (root_bv.min_[0] + root_bv.max_[0]) * 0.5;
+  }
+
+  if(i&2)
+  {
+    child_bv.min_[1] = (root_bv.min_[1] + root_bv.max_[1]) * 0.5;
+    child_bv.max_[1] = root_bv.max_[1];
+  }
+  else
+  {
+    child_bv.min_[1] = root_bv.min_[1];
+    child_bv.max_[1] = (root_bv.min_[1] + root_bv.max_[1]) * 0.5;
+  }
+
+  if(i&4)
+  {
+    child_bv.min_[2] = (root_bv.min_[2] + root_bv.max_[2]) * 0.5;
+    child_bv.max_[2] = root_bv.max_[2];
+  }
+  else
+  {
+    child_bv.min_[2] = root_bv.min_[2];
+    child_bv.max_[2] = (root_bv.min_[2] + root_bv.max_[2]) * 0.5;
+  }
+}
+
+}
+
+} // namespace hpp
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HPP_FCL_LINEAR_OCTREE_SERIALIZATION_H
+#define HPP_FCL_LINEAR_OCTREE_SERIALIZATION_H
+
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+#include <hpp/fcl/linear_octree.h>
+
+namespace hpp
+{
+namespace fcl
+{
+
+/// @brief Version of the binary file format written by saveLinearOcTree.
+static const unsigned int LINEAR_OCTREE_FILE_FORMAT_VERSION = 1;
+
+/// @brief Write a LinearOcTree to a binary file.
+///
+/// The file stores the node array in the native memory layout of the
+/// machine, so that it can be memory mapped by \ref loadLinearOcTree without
+/// any parsing. It is therefore only portable between machines with the same
+/// endianness.
+///
+/// @param tree the octree.
+/// @param filename path of the file to write.
+/// @throw std::runtime_error if the file cannot be written.
+HPP_FCL_DLLAPI void saveLinearOcTree (const LinearOcTree& tree,
+                                      const std::string& filename);
+
+/// @brief Read a LinearOcTree written by \ref saveLinearOcTree.
+///
+/// @param filename path of the file to read.
+/// @param memory_map when true, the file is mapped read-only in memory and
+///        the returned octree points directly into the mapping. No data is
+///        copied, the pages are only read when the traversals reach them,
+///        and they are shared between all the processes that map the same
+///        file. When false, the nodes are copied into an octree which owns
+///        its memory.
+/// @throw std::runtime_error if the file cannot be read or was written
+///        with an incompatible format.
+/// @sa LinearOcTree::isMemoryMapped
+HPP_FCL_DLLAPI boost::shared_ptr<LinearOcTree> loadLinearOcTree
+  (const std::string& filename, bool memory_map = true);
+
+/// @brief Whether a file starts like a file written by \ref saveLinearOcTree.
+HPP_FCL_DLLAPI bool isLinearOcTreeFile (const std::string& filename);
+
+}
+
+} // namespace hpp
+
+#endif
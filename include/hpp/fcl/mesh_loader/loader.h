@@ -44,7 +44,14 @@
 #include <hpp/fcl/data_types.h>
 #include <hpp/fcl/collision_object.h>
 
+#include <list>
 #include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 namespace hpp
 {
@@ -59,12 +66,37 @@ namespace fcl {
       virtual BVHModelPtr_t load (const std::string& filename,
                                   const Vec3f& scale = Vec3f::Ones());
 
-      /// Create an OcTree from a file in binary octomap format.
+      /// Load several meshes in parallel with MeshLoader::load.
+      /// \param filenames the mesh files,
+      /// \param scales the scale of each mesh. If empty, meshes are not scaled.
+      /// \param numThreads number of loading threads. If 0, the number of
+      ///        hardware threads is used.
+      /// \return the polyhedra, in the order of \c filenames.
+      /// \throw std::invalid_argument if \c scales and \c filenames do not
+      ///        have the same size,
+      /// \throw std::runtime_error if one of the meshes cannot be loaded. The
+      ///        other meshes are loaded anyway.
+      std::vector<BVHModelPtr_t> loadMany
+        (const std::vector<std::string>& filenames,
+         const std::vector<Vec3f>& scales = std::vector<Vec3f>(),
+         unsigned int numThreads = 0);
+
+      /// Create an octree from a file.
+      ///
+      /// Files written by saveLinearOcTree are mapped into memory, read
+      /// only, as a LinearOcTree (see loadLinearOcTree): they are neither
+      /// parsed nor copied, and the processes loading the same file share
+      /// its memory. The other files are read in binary octomap format, as
+      /// an OcTree.
+      /// \note hpp-fcl-convert-octree converts binary octomap files.
       /// \todo add OctreePtr_t
       virtual CollisionGeometryPtr_t loadOctree (const std::string& filename);
 
       MeshLoader (const NODE_TYPE& bvType = BV_OBBRSS) : bvType_ (bvType) {}
 
+      /// Type of bounding volume of the built polyhedra.
+      const NODE_TYPE& getNodeType () const { return bvType_; }
+
     private:
       const NODE_TYPE bvType_;
   };
@@ -73,12 +105,38 @@ namespace fcl {
   /// This class builds a new object for each different file.
   /// If method CachedMeshLoader::load is called twice with the same arguments,
   /// the second call returns the result of the first call.
+  ///
+  /// Files with identical content and loaded with the same scale share the
+  /// same polyhedron, even when they are referred to by different paths.
+  ///
+  /// The memory used by the cache can be bounded with
+  /// CachedMeshLoader::setMemoryBudget. The least recently used polyhedra are
+  /// then removed from the cache. They are not destroyed while the user holds
+  /// a reference to them.
+  ///
+  /// CachedMeshLoader::load is thread safe. When several threads request the
+  /// same mesh, it is loaded only once and all the threads get the same
+  /// object.
+  ///
+  /// Optionally, the built polyhedra are also stored on disk in a cache
+  /// directory (see CachedMeshLoader::setCacheDirectory), so that other
+  /// processes loading the same mesh skip parsing the mesh and building the
+  /// hierarchy. An entry of the disk cache is identified by the content of the
+  /// mesh file, the scale and the bounding volume type. Modifying the mesh
+  /// file thus invalidates the corresponding entries.
   class HPP_FCL_DLLAPI CachedMeshLoader : public MeshLoader
   {
     public:
       virtual ~CachedMeshLoader() {}
 
-      CachedMeshLoader (const NODE_TYPE& bvType = BV_OBBRSS) : MeshLoader (bvType) {}
+      CachedMeshLoader (const NODE_TYPE& bvType = BV_OBBRSS)
+        : MeshLoader (bvType), memoryBudget_ (0) {}
+
+      /// \param cacheDirectory see CachedMeshLoader::setCacheDirectory
+      CachedMeshLoader (const NODE_TYPE& bvType,
+                        const std::string& cacheDirectory)
+        : MeshLoader (bvType), cacheDirectory_ (cacheDirectory),
+          memoryBudget_ (0) {}
 
       virtual BVHModelPtr_t load (const std::string& filename,
           const Vec3f& scale);
@@ -94,9 +152,115 @@ namespace fcl {
       };
       typedef std::map <Key, BVHModelPtr_t> Cache_t;
 
-      const Cache_t cache () const { return cache_; }
+      /// Cache statistics.
+      struct HPP_FCL_DLLAPI Statistics {
+        /// Number of calls to load answered from the cache.
+        std::size_t hits;
+        /// Number of calls to load not answered from the cache.
+        std::size_t misses;
+        /// Number of misses answered with a cached polyhedron of a file with
+        /// the same content.
+        std::size_t deduplicated;
+        /// Number of polyhedra removed from the cache to respect the budget.
+        std::size_t evictions;
+        /// Memory used by the cached polyhedra, in bytes.
+        std::size_t bytes;
+
+        Statistics () : hits (0), misses (0), deduplicated (0),
+          evictions (0), bytes (0) {}
+      };
+
+      const Cache_t cache () const;
+
+      /// Set the maximal memory used by the cached polyhedra, in bytes, as
+      /// given by BVHModelBase::memUsage. 0 (the default) means no limit.
+      /// The most recently used polyhedron is always kept.
+      void setMemoryBudget (std::size_t bytes);
+
+      std::size_t getMemoryBudget () const
+      {
+        boost::mutex::scoped_lock lock (mutex_);
+        return memoryBudget_;
+      }
+
+      Statistics statistics () const
+      {
+        boost::mutex::scoped_lock lock (mutex_);
+        return statistics_;
+      }
+
+      /// Reset the counters of the statistics. The memory usage is kept.
+      void resetStatistics ();
+
+      /// Set the directory where built polyhedra are stored.
+      /// The directory is created if it does not exist. An empty string
+      /// (the default) disables the disk cache.
+      /// \warning this must not be called while other threads are loading.
+      /// \note meshes are only identified by the content of the main file.
+      ///       Changes in files it refers to (e.g. external geometry of a
+      ///       COLLADA file) are not detected.
+      void setCacheDirectory (const std::string& directory)
+      {
+        cacheDirectory_ = directory;
+      }
+
+      const std::string& getCacheDirectory () const { return cacheDirectory_; }
+
     private:
-      Cache_t cache_;
+      /// Load a polyhedron from the disk cache or build it and store it in
+      /// the disk cache.
+      BVHModelPtr_t loadWithDiskCache (const std::string& filename,
+                                       const Vec3f& scale,
+                                       const std::string& contentHash);
+
+      /// Insert a polyhedron in the cache and evict the least recently used
+      /// ones if needed. Must be called with mutex_ locked.
+      /// \return the cached polyhedron, which may differ from \c geom if a
+      ///         file with the same content was loaded in the meantime.
+      BVHModelPtr_t insert (const Key& key, const Key& contentKey,
+                            const BVHModelPtr_t& geom);
+
+      /// Evict entries until the budget is respected.
+      /// Must be called with mutex_ locked.
+      void evict ();
+
+      struct Entry {
+        BVHModelPtr_t geom;
+        /// Content hash and scale of the file.
+        Key contentKey;
+        /// Position in lru_.
+        std::list<Key>::iterator lru;
+
+        Entry (const BVHModelPtr_t& g, const Key& ck,
+               const std::list<Key>::iterator& it)
+          : geom (g), contentKey (ck), lru (it) {}
+      };
+
+      struct Content {
+        BVHModelPtr_t geom;
+        std::size_t bytes;
+        /// Number of entries referring to this content.
+        std::size_t uses;
+      };
+
+      std::map<Key, Entry> entries_;
+      /// Content of the cached files. The filename of the keys is replaced
+      /// by a hash of the file content.
+      std::map<Key, Content> contents_;
+      /// Keys of entries_, the most recently used first.
+      std::list<Key> lru_;
+
+      std::string cacheDirectory_;
+      std::size_t memoryBudget_;
+      Statistics statistics_;
+
+      /// Protects entries_, contents_, lru_, memoryBudget_, statistics_
+      /// and loading_.
+      mutable boost::mutex mutex_;
+      /// Keys being loaded by a thread.
+      std::set<Key> loading_;
+      /// Notified whenever a key is removed from loading_.
+      boost::condition_variable loaded_;
   };
 }
 
@@ -170,6 +170,13 @@ struct HPP_FCL_DLLAPI GJK
   FCL_REAL distance;
   Simplex simplices[2];
 
+  /// @brief number of iterations of the last call to evaluate.
+  size_t iterations;
+
+  /// @brief number of calls to getSupport since the last call to evaluate,
+  /// including the calls by EPA.
+  mutable size_t num_support_calls;
+
 
   /// \param max_iterations_ number of iteration before GJK returns failure.
   /// \param tolerance_ precision of the algorithm.
@@ -194,6 +201,7 @@ struct HPP_FCL_DLLAPI GJK
   inline void getSupport(const Vec3f& d, bool dIsNormalized, SimplexV& sv,
       support_func_guess_t& hint) const
   {
+    ++num_support_calls;
     shape->support(d, dIsNormalized, sv.w0, sv.w1, hint);
     sv.w.noalias() = sv.w0 - sv.w1;
   }
@@ -351,6 +359,11 @@ public:
   GJK::Simplex result;
   Vec3f normal;
   FCL_REAL depth;
+  /// @brief number of iterations of the last call to evaluate.
+  size_t iterations;
+  /// @brief number of calls to the support function by the last call to
+  /// evaluate.
+  size_t num_support_calls;
   SimplexV* sv_store;
   SimplexF* fc_store;
   size_t nextsv;
@@ -46,6 +46,8 @@ namespace hpp
 namespace fcl
 {
 
+  struct QueryStatistics;
+
   /// @brief collision and distance solver based on GJK algorithm implemented in fcl (rewritten the code from the GJK in bullet)
   struct HPP_FCL_DLLAPI GJKSolver
   {
@@ -70,6 +72,7 @@ namespace fcl
   
       details::GJK gjk((unsigned int )gjk_max_iterations, gjk_tolerance);
       details::GJK::Status gjk_status = gjk.evaluate(shape, guess, support_hint);
+      if(statistics) updateStatistics(gjk);
       if(enable_cached_guess) {
         cached_guess = gjk.getGuessFromSimplex();
         support_func_cached_guess = gjk.support_hint;
@@ -89,6 +92,7 @@ namespace fcl
           } else {
             details::EPA epa(epa_max_face_num, epa_max_vertex_num, epa_max_iterations, epa_tolerance);
             details::EPA::Status epa_status = epa.evaluate(gjk, -guess);
+            if(statistics) updateStatistics(epa);
             if(epa_status & details::EPA::Valid
                 || epa_status == details::EPA::OutOfFaces    // Warnings
                 || epa_status == details::EPA::OutOfVertices // Warnings
@@ -144,6 +148,7 @@ namespace fcl
   
       details::GJK gjk((unsigned int )gjk_max_iterations, gjk_tolerance);
       details::GJK::Status gjk_status = gjk.evaluate(shape, guess, support_hint);
+      if(statistics) updateStatistics(gjk);
       if(enable_cached_guess) {
         cached_guess = gjk.getGuessFromSimplex();
         support_func_cached_guess = gjk.support_hint;
@@ -161,6 +166,7 @@ namespace fcl
           } else {
             details::EPA epa(epa_max_face_num, epa_max_vertex_num, epa_max_iterations, epa_tolerance);
             details::EPA::Status epa_status = epa.evaluate(gjk, -guess);
+            if(statistics) updateStatistics(epa);
             if(epa_status & details::EPA::Valid
                 || epa_status == details::EPA::OutOfFaces    // Warnings
                 || epa_status == details::EPA::OutOfVertices // Warnings
@@ -222,6 +228,7 @@ namespace fcl
 
       details::GJK gjk((unsigned int) gjk_max_iterations, gjk_tolerance);
       details::GJK::Status gjk_status = gjk.evaluate(shape, guess, support_hint);
+      if(statistics) updateStatistics(gjk);
       if(enable_cached_guess) {
         cached_guess = gjk.getGuessFromSimplex();
         support_func_cached_guess = gjk.support_hint;
@@ -268,6 +275,7 @@ namespace fcl
             details::EPA epa(epa_max_face_num, epa_max_vertex_num,
                              epa_max_iterations, epa_tolerance);
             details::EPA::Status epa_status = epa.evaluate(gjk, -guess);
+            if(statistics) updateStatistics(epa);
             if(epa_status & details::EPA::Valid
                 || epa_status == details::EPA::OutOfFaces    // Warnings
                 || epa_status == details::EPA::OutOfVertices // Warnings
@@ -303,6 +311,7 @@ namespace fcl
       enable_cached_guess = false;
       cached_guess = Vec3f(1, 0, 0);
       support_func_cached_guess = support_func_guess_t::Zero();
+      statistics = NULL;
     }
 
     void enableCachedGuess(bool if_enable) const
@@ -346,6 +355,15 @@ namespace fcl
 
     /// @brief smart guess for the support function
     mutable support_func_guess_t support_func_cached_guess;
+
+    /// @brief statistics updated by the runs of GJK and EPA, if not NULL.
+    mutable QueryStatistics* statistics;
+
+    /// @brief add the iterations of a run of GJK to statistics.
+    void updateStatistics(const details::GJK& gjk) const;
+
+    /// @brief add the iterations of a run of EPA to statistics.
+    void updateStatistics(const details::EPA& epa) const;
   };
 
   template<>
@@ -46,6 +46,7 @@
 #include <octomap/octomap.h>
 #include <hpp/fcl/BV/AABB.h>
 #include <hpp/fcl/collision_object.h>
+#include <hpp/fcl/linear_octree.h>
 
 namespace hpp
 {
@@ -87,6 +88,12 @@ public:
     free_threshold = 0;
   }
 
+  /// @brief the underlying octomap tree
+  const boost::shared_ptr<const octomap::OcTree>& getTree() const
+  {
+    return tree;
+  }
+
   /// @brief compute the AABB for the octree in its local coordinate system
   void computeLocalAABB() 
   {
@@ -158,6 +165,34 @@ public:
     return boxes;
   }
 
+  /// @brief merge the occupied leaves of the octree into larger boxes
+  /// \sa LinearOcTree::toMergedBoxes
+  std::vector<AABB> toMergedBoxes() const
+  {
+    return LinearOcTree(*this).toMergedBoxes();
+  }
+
+  /// @brief the finest cells changed since the change detection of the
+  ///        octomap tree was last reset
+  ///
+  /// The change detection must be enabled on the octomap tree with
+  /// octomap::OcTree::enableChangeDetection. The regions can be recorded in
+  /// an OcTreeChangeTracker, before resetting the change detection.
+  std::vector<AABB> getChangedRegions() const
+  {
+    std::vector<AABB> regions;
+    regions.reserve(tree->numChangesDetected());
+    const Vec3f half (Vec3f::Constant(tree->getResolution() / 2));
+    for(octomap::KeyBoolMap::const_iterator it = tree->changedKeysBegin();
+        it != tree->changedKeysEnd(); ++it)
+    {
+      octomap::point3d p = tree->keyToCoord(it->first);
+      Vec3f c (p.x(), p.y(), p.z());
+      regions.push_back(AABB(c - half, c + half));
+    }
+    return regions;
+  }
+
   /// @brief the threshold used to decide whether one node is occupied, this is NOT the octree occupied_thresold
   FCL_REAL getOccupancyThres() const
   {
@@ -237,45 +272,6 @@ public:
   NODE_TYPE getNodeType() const { return GEOM_OCTREE; }
 };
 
-/// @brief compute the bounding volume of an octree node's i-th child
-static inline void computeChildBV(const AABB& root_bv, unsigned int i, AABB& child_bv)
-{
-  if(i&1)
-  {
-    child_bv.min_[0] = (root_bv.min_[0] + root_bv.max_[0]) * 0.5;
-    child_bv.max_[0] = root_bv.max_[0];
-  }
-  else
-  {
-    child_bv.min_[0] = root_bv.min_[0];
-    child_bv.max_[0] = (root_bv.min_[0] + root_bv.max_[0]) * 0.5;
-  }
-
-  if(i&2)
-  {
-    child_bv.min_[1] = (root_bv.min_[1] + root_bv.max_[1]) * 0.5;
-    child_bv.max_[1] = root_bv.max_[1];
-  }
-  else
-  {
-    child_bv.min_[1] = root_bv.min_[1];
-    child_bv.max_[1] = (root_bv.min_[1] + root_bv.max_[1]) * 0.5;
-  }
-
-  if(i&4)
-  {
-    child_bv.min_[2] = (root_bv.min_[2] + root_bv.max_[2]) * 0.5;
-    child_bv.max_[2] = root_bv.max_[2];
-  }        
-  else
-  {
-    child_bv.min_[2] = root_bv.min_[2];
-    child_bv.max_[2] = (root_bv.min_[2] + root_bv.max_[2]) * 0.5;
-  }
-}
-
-
-
 }
 
 } // namespace hpp
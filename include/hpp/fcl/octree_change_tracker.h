@@ -0,0 +1,132 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HPP_FCL_OCTREE_CHANGE_TRACKER_H
+#define HPP_FCL_OCTREE_CHANGE_TRACKER_H
+
+#include <deque>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include <hpp/fcl/BV/AABB.h>
+#include <hpp/fcl/collision_object.h>
+
+namespace hpp
+{
+namespace fcl
+{
+
+/// @brief History of the regions of an octree changed by its updates.
+///
+/// Each update of the octree is recorded as a list of dirty regions, in the
+/// frame of the octree, and increments a stamp. A query result computed at
+/// some stamp stays valid as long as no later dirty region overlaps the
+/// volume of the other object of the query, which lets the users keep most
+/// of their cached results across the updates of a map.
+///
+/// The dirty regions of an update are given by
+/// LinearOcTree::changedRegions or OcTree::getChangedRegions.
+///
+/// Only the last updates are kept. A result older than the history is never
+/// valid.
+class HPP_FCL_DLLAPI OcTreeChangeTracker
+{
+public:
+  typedef boost::uint64_t Stamp;
+
+  /// @param max_updates the number of updates kept in the history.
+  explicit OcTreeChangeTracker(std::size_t max_updates = 64);
+
+  /// @brief the stamp of the last update, 0 before the first one. A result
+  ///        should be stored with the stamp at the time of the query.
+  Stamp getStamp() const
+  {
+    return stamp;
+  }
+
+  /// @brief record an update of the octree
+  /// @param regions the dirty regions, in the frame of the octree.
+  /// @return the new stamp.
+  Stamp addUpdate(const std::vector<AABB>& regions);
+
+  /// @brief whether a result computed at stamp result_stamp against a volume
+  ///        is still valid
+  /// @param bv the volume of the other object, in the frame of the octree.
+  /// @param result_stamp the stamp at the time of the query.
+  /// @param margin the changes closer than margin to bv invalidate the
+  ///        result. It should be the security margin of a collision query,
+  ///        or the distance found by a distance query.
+  bool isValid(const AABB& bv, Stamp result_stamp, FCL_REAL margin = 0) const;
+
+  /// @brief whether a result computed at stamp result_stamp against an
+  ///        object is still valid
+  /// @param o the other object of the query. Its local AABB must have been
+  ///        computed.
+  /// @param tf the pose of o.
+  /// @param tf_tree the pose of the octree.
+  /// @param result_stamp the stamp at the time of the query.
+  /// @param margin see \ref isValid(const AABB&, Stamp, FCL_REAL) const.
+  bool isValid(const CollisionGeometry* o, const Transform3f& tf,
+               const Transform3f& tf_tree, Stamp result_stamp,
+               FCL_REAL margin = 0) const;
+
+  /// @brief the bounding box of the regions changed since a stamp
+  /// @return an empty AABB when nothing changed, the whole space when the
+  ///         stamp is older than the history.
+  AABB getDirtyRegion(Stamp since) const;
+
+  /// @brief forget the history. The results computed before are not valid
+  ///        anymore.
+  void clear();
+
+private:
+  struct Update
+  {
+    /// @brief bounding box of the regions
+    AABB bounds;
+    std::vector<AABB> regions;
+  };
+
+  /// @brief the updates after stamp - updates.size(), the last one at the back
+  std::deque<Update> updates;
+  Stamp stamp;
+  std::size_t max_updates;
+};
+
+}
+
+} // namespace hpp
+
+#endif
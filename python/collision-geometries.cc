@@ -282,6 +282,9 @@ void exposeCollisionGeometries ()
       .value ("GEOM_HALFSPACE", GEOM_HALFSPACE)
       .value ("GEOM_TRIANGLE" , GEOM_TRIANGLE)
       .value ("GEOM_OCTREE"   , GEOM_OCTREE)
+      .value ("GEOM_LINEAR_OCTREE", GEOM_LINEAR_OCTREE)
+      .value ("GEOM_DISTANCE_FIELD", GEOM_DISTANCE_FIELD)
+      .value ("GEOM_BOX_SET", GEOM_BOX_SET)
       ;
   }
   
@@ -80,6 +80,24 @@ void exposeCollisionAPI ()
       ;
   }
 
+  if(!eigenpy::register_symbolic_link_to_registered_type<QueryStatistics>())
+  {
+    class_ <QueryStatistics> ("QueryStatistics",
+        doxygen::class_doc<QueryStatistics>(), init<>())
+      .DEF_RW_CLASS_ATTRIB (QueryStatistics, num_bv_tests          )
+      .DEF_RW_CLASS_ATTRIB (QueryStatistics, num_leaf_tests        )
+      .DEF_RW_CLASS_ATTRIB (QueryStatistics, num_gjk_calls         )
+      .DEF_RW_CLASS_ATTRIB (QueryStatistics, num_gjk_iterations    )
+      .DEF_RW_CLASS_ATTRIB (QueryStatistics, num_epa_calls         )
+      .DEF_RW_CLASS_ATTRIB (QueryStatistics, num_epa_iterations    )
+      .DEF_RW_CLASS_ATTRIB (QueryStatistics, num_epa_failures      )
+      .DEF_RW_CLASS_ATTRIB (QueryStatistics, num_support_calls     )
+      .DEF_RW_CLASS_ATTRIB (QueryStatistics, num_front_nodes_reused)
+      .DEF_RW_CLASS_ATTRIB (QueryStatistics, time                  )
+      .DEF_CLASS_FUNC (QueryStatistics, clear)
+      ;
+  }
+
   if(!eigenpy::register_symbolic_link_to_registered_type<QueryRequest>())
   {
     class_ <QueryRequest> ("QueryRequest",
@@ -87,6 +105,12 @@ void exposeCollisionAPI ()
       .DEF_RW_CLASS_ATTRIB (QueryRequest, enable_cached_gjk_guess    )
       .DEF_RW_CLASS_ATTRIB (QueryRequest, cached_gjk_guess           )
       .DEF_RW_CLASS_ATTRIB (QueryRequest, cached_support_func_guess  )
+      .DEF_RW_CLASS_ATTRIB (QueryRequest, num_threads                )
+      .DEF_RW_CLASS_ATTRIB (QueryRequest, time_budget                )
+      .DEF_RW_CLASS_ATTRIB (QueryRequest, max_traversal_iterations   )
+      .DEF_RW_CLASS_ATTRIB (QueryRequest, enable_statistics          )
+      .DEF_RW_CLASS_ATTRIB (QueryRequest, octree_max_depth           )
+      .DEF_RW_CLASS_ATTRIB (QueryRequest, octree_refine              )
       .DEF_CLASS_FUNC (QueryRequest, updateGuess)
       ;
   }
@@ -147,6 +171,8 @@ void exposeCollisionAPI ()
         doxygen::class_doc<QueryResult>(), no_init)
       .DEF_RW_CLASS_ATTRIB (QueryResult, cached_gjk_guess         )
       .DEF_RW_CLASS_ATTRIB (QueryResult, cached_support_func_guess)
+      .DEF_RW_CLASS_ATTRIB (QueryResult, completed                )
+      .DEF_RW_CLASS_ATTRIB (QueryResult, statistics               )
       ;
   }
 
@@ -179,6 +205,7 @@ void exposeCollisionAPI ()
         const CollisionGeometry*, const Transform3f&,
         const CollisionGeometry*, const Transform3f&,
         CollisionRequest&, CollisionResult&) > (&collide));
+  doxygen::def ("collideAndDistance", &collideAndDistance);
 
   class_<ComputeCollision> ("ComputeCollision",
       doxygen::class_doc<ComputeCollision>(), no_init)
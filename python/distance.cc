@@ -73,6 +73,12 @@ struct DistanceRequestWrapper
   static Vec3f getNearestPoint2(const DistanceResult & res) { return res.nearest_points[1]; }
 };
 
+struct DistancePairWrapper
+{
+  static Vec3f getNearestPoint1(const DistancePair & pair) { return pair.nearest_points[0]; }
+  static Vec3f getNearestPoint2(const DistancePair & pair) { return pair.nearest_points[1]; }
+};
+
 void exposeDistanceAPI ()
 {
   if(!eigenpy::register_symbolic_link_to_registered_type<DistanceRequest>())
@@ -86,6 +92,9 @@ void exposeDistanceAPI ()
       .DEF_RW_CLASS_ATTRIB (DistanceRequest, enable_nearest_points)
       .DEF_RW_CLASS_ATTRIB (DistanceRequest, rel_err)
       .DEF_RW_CLASS_ATTRIB (DistanceRequest, abs_err)
+      .DEF_RW_CLASS_ATTRIB (DistanceRequest, num_closest_pairs)
+      .DEF_RW_CLASS_ATTRIB (DistanceRequest, closest_pairs_max_distance)
+      .DEF_RW_CLASS_ATTRIB (DistanceRequest, octree_refine_distance)
       ;
   }
 
@@ -96,6 +105,28 @@ void exposeDistanceAPI ()
       ;
   }
 
+  if(!eigenpy::register_symbolic_link_to_registered_type<DistancePair>())
+  {
+    class_ <DistancePair> ("DistancePair",
+        doxygen::class_doc<DistancePair>(), no_init)
+      .def (dv::init<DistancePair>())
+      .DEF_RW_CLASS_ATTRIB (DistancePair, distance)
+      .DEF_RW_CLASS_ATTRIB (DistancePair, b1)
+      .DEF_RW_CLASS_ATTRIB (DistancePair, b2)
+      .def("getNearestPoint1",&DistancePairWrapper::getNearestPoint1,
+          doxygen::class_attrib_doc<DistancePair>("nearest_points"))
+      .def("getNearestPoint2",&DistancePairWrapper::getNearestPoint2,
+          doxygen::class_attrib_doc<DistancePair>("nearest_points"))
+      ;
+  }
+
+  if(!eigenpy::register_symbolic_link_to_registered_type< std::vector<DistancePair> >())
+  {
+    class_< std::vector<DistancePair> >("StdVec_DistancePair")
+      .def(vector_indexing_suite< std::vector<DistancePair> >())
+      ;
+  }
+
   if(!eigenpy::register_symbolic_link_to_registered_type<DistanceResult>())
   {
     class_ <DistanceResult, bases<QueryResult> > ("DistanceResult",
@@ -104,6 +135,7 @@ void exposeDistanceAPI ()
       .def (dv::init<DistanceResult>())
       .DEF_RW_CLASS_ATTRIB (DistanceResult, min_distance)
       .DEF_RW_CLASS_ATTRIB(DistanceResult, normal)
+      .DEF_RW_CLASS_ATTRIB(DistanceResult, distance_lower_bound)
       //.def_readwrite ("nearest_points", &DistanceResult::nearest_points)
       .def("getNearestPoint1",&DistanceRequestWrapper::getNearestPoint1,
           doxygen::class_attrib_doc<DistanceResult>("nearest_points"))
@@ -113,6 +145,7 @@ void exposeDistanceAPI ()
       .DEF_RO_CLASS_ATTRIB (DistanceResult, o2)
       .DEF_RW_CLASS_ATTRIB (DistanceResult, b1)
       .DEF_RW_CLASS_ATTRIB (DistanceResult, b2)
+      .DEF_RW_CLASS_ATTRIB (DistanceResult, closest_pairs)
 
       .def ("clear", &DistanceResult::clear,
           doxygen::member_func_doc(&DistanceResult::clear))
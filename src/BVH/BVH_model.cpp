@@ -36,6 +36,7 @@
 /** \author Jia Pan */
 
 #include <hpp/fcl/BVH/BVH_model.h>
+#include <hpp/fcl/BVH/BVH_utility.h>
 
 #include <iostream>
 #include <string.h>
@@ -46,6 +47,11 @@
 #include <hpp/fcl/internal/BV_splitter.h>
 #include <hpp/fcl/internal/BV_fitter.h>
 
+#include <algorithm>
+#include <boost/bind/bind.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+
 namespace hpp
 {
 namespace fcl
@@ -56,8 +62,12 @@ BVHModelBase::BVHModelBase(const BVHModelBase& other) :
   num_tris(other.num_tris),
   num_vertices(other.num_vertices),
   build_state(other.build_state),
+  refit_num_threads(other.refit_num_threads),
+  rebuild_threshold(other.rebuild_threshold),
   num_tris_allocated(other.num_tris),
-  num_vertices_allocated(other.num_vertices)
+  num_vertices_allocated(other.num_vertices),
+  moved_vertices(other.moved_vertices),
+  prev_moved_vertices(other.prev_moved_vertices)
 {
   if(other.vertices)
   {
@@ -100,6 +110,28 @@ void BVHModelBase::buildConvexRepresentation(bool share_memory)
   }
 }
 
+void BVHModelBase::unmapStorage()
+{
+  if(!mapped_storage) return;
+
+  Vec3f* new_vertices = new Vec3f[num_vertices];
+  memcpy(new_vertices, vertices, sizeof(Vec3f) * num_vertices);
+  vertices = new_vertices;
+  num_vertices_allocated = num_vertices;
+
+  if(tri_indices)
+  {
+    Triangle* new_tris = new Triangle[num_tris];
+    memcpy(new_tris, tri_indices, sizeof(Triangle) * num_tris);
+    tri_indices = new_tris;
+  }
+  num_tris_allocated = num_tris;
+
+  unmapBVs();
+
+  mapped_storage.reset();
+}
+
 bool BVHModelBase::buildConvexHull(bool keepTriangle, const char* qhullCommand)
 {
   convex.reset(
@@ -149,12 +181,21 @@ int BVHModelBase::beginModel(int num_tris_, int num_vertices_)
 {
   if(build_state != BVH_BUILD_STATE_EMPTY)
   {
+    if(mapped_storage)
+    {
+      // The arrays are views into the mapped file.
+      vertices = NULL;
+      tri_indices = NULL;
+    }
     delete [] vertices; vertices = NULL;
     delete [] tri_indices; tri_indices = NULL;
     delete [] prev_vertices; prev_vertices = NULL;
 
     num_vertices_allocated = num_vertices = num_tris_allocated = num_tris = 0;
     deleteBVs();
+    mapped_storage.reset();
+    moved_vertices.clear();
+    prev_moved_vertices.clear();
   }
 
   if(num_tris_ <= 0) num_tris_ = 8;
@@ -430,10 +471,14 @@ int BVHModelBase::beginReplaceModel()
     return BVH_ERR_BUILD_EMPTY_PREVIOUS_FRAME;
   }
 
+  unmapStorage();
+
   if(prev_vertices) delete [] prev_vertices;
   prev_vertices = NULL;
 
   num_vertex_updated = 0;
+  prev_moved_vertices.swap(moved_vertices);
+  moved_vertices.clear();
 
   build_state = BVH_BUILD_STATE_REPLACE_BEGUN;
 
@@ -448,8 +493,7 @@ int BVHModelBase::replaceVertex(const Vec3f& p)
     return BVH_ERR_BUILD_OUT_OF_SEQUENCE;
   }
 
-  vertices[num_vertex_updated] = p;
-  num_vertex_updated++;
+  setNextVertex(p);
 
   return BVH_OK;
 }
@@ -462,9 +506,9 @@ int BVHModelBase::replaceTriangle(const Vec3f& p1, const Vec3f& p2, const Vec3f&
     return BVH_ERR_BUILD_OUT_OF_SEQUENCE;
   }
 
-  vertices[num_vertex_updated] = p1; num_vertex_updated++;
-  vertices[num_vertex_updated] = p2; num_vertex_updated++;
-  vertices[num_vertex_updated] = p3; num_vertex_updated++;
+  setNextVertex(p1);
+  setNextVertex(p2);
+  setNextVertex(p3);
   return BVH_OK;
 }
 
@@ -477,10 +521,7 @@ int BVHModelBase::replaceSubModel(const std::vector<Vec3f>& ps)
   }
 
   for(unsigned int i = 0; i < ps.size(); ++i)
-  {
-    vertices[num_vertex_updated] = ps[i];
-    num_vertex_updated++;
-  }
+    setNextVertex(ps[i]);
   return BVH_OK;
 }
 
@@ -524,6 +565,8 @@ int BVHModelBase::beginUpdateModel()
     return BVH_ERR_BUILD_EMPTY_PREVIOUS_FRAME;
   }
 
+  unmapStorage();
+
   if(prev_vertices)
   {
     Vec3f* temp = prev_vertices;
@@ -537,6 +580,8 @@ int BVHModelBase::beginUpdateModel()
   }
 
   num_vertex_updated = 0;
+  prev_moved_vertices.swap(moved_vertices);
+  moved_vertices.clear();
 
   build_state = BVH_BUILD_STATE_UPDATE_BEGUN;
 
@@ -551,8 +596,7 @@ int BVHModelBase::updateVertex(const Vec3f& p)
     return BVH_ERR_BUILD_OUT_OF_SEQUENCE;
   }
 
-  vertices[num_vertex_updated] = p;
-  num_vertex_updated++;
+  setNextVertex(p);
 
   return BVH_OK;
 }
@@ -565,9 +609,9 @@ int BVHModelBase::updateTriangle(const Vec3f& p1, const Vec3f& p2, const Vec3f&
     return BVH_ERR_BUILD_OUT_OF_SEQUENCE;
   }
 
-  vertices[num_vertex_updated] = p1; num_vertex_updated++;
-  vertices[num_vertex_updated] = p2; num_vertex_updated++;
-  vertices[num_vertex_updated] = p3; num_vertex_updated++;
+  setNextVertex(p1);
+  setNextVertex(p2);
+  setNextVertex(p3);
   return BVH_OK;
 }
 
@@ -580,10 +624,7 @@ int BVHModelBase::updateSubModel(const std::vector<Vec3f>& ps)
   }
 
   for(unsigned int i = 0; i < ps.size(); ++i)
-  {
-    vertices[num_vertex_updated] = ps[i];
-    num_vertex_updated++;
-  }
+    setNextVertex(ps[i]);
   return BVH_OK;
 }
 
@@ -661,11 +702,42 @@ BVHModel<BV>::BVHModel() :
 template<typename BV>
 void BVHModel<BV>::deleteBVs()
 {
-  delete [] bvs; bvs = NULL;
-  delete [] primitive_indices; primitive_indices = NULL;
+  if(!mapped_storage)
+  {
+    delete [] bvs;
+    delete [] primitive_indices;
+  }
+  bvs = NULL;
+  primitive_indices = NULL;
   num_bvs_allocated = num_bvs = 0;
 }
 
+template<typename BV>
+void BVHModel<BV>::unmapBVs()
+{
+  int num_primitives = 0;
+  switch(getModelType())
+  {
+    case BVH_MODEL_TRIANGLES:
+      num_primitives = num_tris;
+      break;
+    case BVH_MODEL_POINTCLOUD:
+      num_primitives = num_vertices;
+      break;
+    default:
+      ;
+  }
+
+  BVNode<BV>* new_bvs = new BVNode<BV>[num_bvs];
+  memcpy(new_bvs, bvs, sizeof(BVNode<BV>) * num_bvs);
+  bvs = new_bvs;
+  num_bvs_allocated = num_bvs;
+
+  unsigned int* new_primitive_indices = new unsigned int[num_bvs];
+  memcpy(new_primitive_indices, primitive_indices, sizeof(unsigned int) * num_primitives);
+  primitive_indices = new_primitive_indices;
+}
+
 template<typename BV>
 bool BVHModel<BV>::allocateBVs()
 {
@@ -692,12 +764,13 @@ bool BVHModel<BV>::allocateBVs()
 template<typename BV>
 int BVHModel<BV>::memUsage(int msg) const
 {
-  int mem_bv_list = (int)sizeof(BV) * num_bvs;
+  int mem_bv_list = (int)sizeof(BVNode<BV>) * num_bvs;
   int mem_tri_list = (int)sizeof(Triangle) * num_tris;
   int mem_vertex_list = (int)sizeof(Vec3f) * num_vertices;
+  int mem_primitive_list = (int)sizeof(unsigned int) * num_bvs;
 
   int total_mem = mem_bv_list + mem_tri_list + mem_vertex_list +
-    (int)sizeof(BVHModel<BV>);
+    mem_primitive_list + (int)sizeof(BVHModel<BV>);
   if(msg)
   {
     std::cerr << "Total for model " << total_mem << " bytes." << std::endl;
@@ -706,7 +779,7 @@ int BVHModel<BV>::memUsage(int msg) const
     std::cerr << "Vertices: " << num_vertices << " allocated." << std::endl;
   }
 
-  return BVH_OK;
+  return total_mem;
 }
 
 template<typename BV>
@@ -740,6 +813,10 @@ int BVHModel<BV>::buildTree()
   bv_fitter->clear();
   bv_splitter->clear();
 
+  // The caches of the incremental refit are computed at the first refit.
+  bv_parents.clear();
+  vertex_triangles_offsets.clear();
+
   return BVH_OK;
 }
 
@@ -819,6 +896,103 @@ int BVHModel<BV>::recursiveBuildTree(int bv_id, int first_primitive, int num_pri
   return BVH_OK;
 }
 
+template<typename BV>
+int BVHModel<BV>::optimizeTree(int num_passes)
+{
+  if(build_state != BVH_BUILD_STATE_PROCESSED && build_state != BVH_BUILD_STATE_UPDATED)
+  {
+    std::cerr << "BVH Error! Call optimizeTree() on a built model." << std::endl;
+    return BVH_ERR_BUILD_OUT_OF_SEQUENCE;
+  }
+  if(num_bvs <= 1) return BVH_OK;
+
+  unmapStorage();
+
+  for(int pass = 0; pass < num_passes; ++pass)
+    if(rotateTree(0) == 0) break;
+
+  BVNode<BV>* new_bvs = new BVNode<BV>[num_bvs_allocated];
+  if(!new_bvs)
+  {
+    std::cerr << "BVH Error! Out of memory for BV array in optimizeTree()!" << std::endl;
+    return BVH_ERR_MODEL_OUT_OF_MEMORY;
+  }
+  int next_node = 1, next_primitive = 0;
+  relayoutTree(0, 0, new_bvs, next_node, next_primitive);
+  delete [] bvs;
+  bvs = new_bvs;
+
+  // The caches of the incremental refit depend on the layout.
+  bv_parents.clear();
+
+  return refitTree_topdown();
+}
+
+template<typename BV>
+int BVHModel<BV>::rotateTree(int bv_id)
+{
+  BVNode<BV>& node = bvs[bv_id];
+  if(node.isLeaf()) return 0;
+
+  int num_rotations = rotateTree(node.leftChild()) + rotateTree(node.rightChild());
+
+  // Candidate rotations: exchange child c with the grandchild g, child of
+  // the other child o. o then holds c and the sibling s of g.
+  int best_c = -1, best_g = -1;
+  FCL_REAL best_gain = 0;
+  for(int k = 0; k < 2; ++k)
+  {
+    int c = node.first_child + k, o = node.first_child + 1 - k;
+    if(bvs[o].isLeaf()) continue;
+    FCL_REAL area = details::surfaceArea(bvs[o].bv);
+    for(int j = 0; j < 2; ++j)
+    {
+      int g = bvs[o].first_child + j, s = bvs[o].first_child + 1 - j;
+      FCL_REAL gain = area - details::surfaceArea(bvs[c].bv + bvs[s].bv);
+      if(gain > best_gain)
+      {
+        best_gain = gain;
+        best_c = c;
+        best_g = g;
+      }
+    }
+  }
+  if(best_c < 0) return num_rotations;
+
+  // Exchanging the nodes exchanges the subtrees.
+  std::swap(bvs[best_c], bvs[best_g]);
+  BVNode<BV>& other = bvs[2 * node.first_child + 1 - best_c];
+  const BVNode<BV>& left = bvs[other.leftChild()];
+  const BVNode<BV>& right = bvs[other.rightChild()];
+  other.bv = left.bv + right.bv;
+  other.num_primitives = left.num_primitives + right.num_primitives;
+  return num_rotations + 1;
+}
+
+template<typename BV>
+void BVHModel<BV>::relayoutTree(int old_id, int new_id, BVNode<BV>* new_bvs,
+                                int& next_node, int& next_primitive)
+{
+  const BVNode<BV>& old_node = bvs[old_id];
+  BVNode<BV>& new_node = new_bvs[new_id];
+  new_node = old_node;
+  if(old_node.isLeaf())
+  {
+    primitive_indices[next_primitive] = old_node.primitiveId();
+    new_node.first_primitive = next_primitive++;
+    new_node.num_primitives = 1;
+  }
+  else
+  {
+    new_node.first_child = next_node;
+    next_node += 2;
+    new_node.first_primitive = next_primitive;
+    relayoutTree(old_node.leftChild(), new_node.leftChild(), new_bvs, next_node, next_primitive);
+    relayoutTree(old_node.rightChild(), new_node.rightChild(), new_bvs, next_node, next_primitive);
+    new_node.num_primitives = next_primitive - new_node.first_primitive;
+  }
+}
+
 template<typename BV>
 int BVHModel<BV>::refitTree(bool bottomup)
 {
@@ -831,26 +1005,196 @@ int BVHModel<BV>::refitTree(bool bottomup)
 template<typename BV>
 int BVHModel<BV>::refitTree_bottomup()
 {
-  // TODO the recomputation of the BV is done manually, without using
-  // bv_fitter. The manual BV recomputation seems bugged. Using bv_fitter
-  // seems to correct the bug.
-  //bv_fitter->set(vertices, tri_indices, getModelType());
+  BVHModelType type = getModelType();
+  if(type != BVH_MODEL_TRIANGLES && type != BVH_MODEL_POINTCLOUD)
+  {
+    std::cerr << "BVH Error: Model type not supported!" << std::endl;
+    return BVH_ERR_UNSUPPORTED_FUNCTION;
+  }
+
+  if((int)bv_parents.size() != num_bvs)
+  {
+    bv_parents.resize(num_bvs);
+    bv_depths.resize(num_bvs);
+    bv_built_sizes.resize(num_bvs);
+    primitive_leaves.resize(type == BVH_MODEL_TRIANGLES ? num_tris : num_vertices);
+    bv_parents[0] = -1;
+    bv_depths[0] = 0;
+    computeRefitCaches(0);
+  }
+  if(type == BVH_MODEL_TRIANGLES && vertex_triangles_offsets.empty())
+  {
+    vertex_triangles_offsets.assign(num_vertices + 1, 0);
+    for(int i = 0; i < num_tris; ++i)
+      for(int j = 0; j < 3; ++j)
+        vertex_triangles_offsets[tri_indices[i][j] + 1]++;
+    for(int v = 0; v < num_vertices; ++v)
+      vertex_triangles_offsets[v + 1] += vertex_triangles_offsets[v];
+    vertex_triangles.resize(3 * num_tris);
+    std::vector<int> next (vertex_triangles_offsets.begin(), vertex_triangles_offsets.end() - 1);
+    for(int i = 0; i < num_tris; ++i)
+      for(int j = 0; j < 3; ++j)
+        vertex_triangles[next[tri_indices[i][j]]++] = i;
+  }
+
+  // Mark the leaves containing a vertex which moved in this frame or in the
+  // previous one, and their ancestors.
+  bv_refitted.assign(num_bvs, 0);
+  for(std::size_t d = 0; d < refit_levels.size(); ++d)
+    refit_levels[d].clear();
+  for(int k = 0; k < 2; ++k)
+  {
+    const std::vector<int>& moved = (k == 0) ? moved_vertices : prev_moved_vertices;
+    for(std::size_t i = 0; i < moved.size(); ++i)
+    {
+      int v = moved[i];
+      if(type == BVH_MODEL_POINTCLOUD)
+        markForRefit(primitive_leaves[v]);
+      else
+        for(int j = vertex_triangles_offsets[v]; j < vertex_triangles_offsets[v + 1]; ++j)
+          markForRefit(primitive_leaves[vertex_triangles[j]]);
+    }
+  }
+
+  unsigned int num_threads = refit_num_threads;
+  if(num_threads == 0)
+    num_threads = std::max(boost::thread::hardware_concurrency(), 1u);
+  std::size_t num_refitted = 0;
+  for(std::size_t d = 0; d < refit_levels.size(); ++d)
+    num_refitted += refit_levels[d].size();
+  // Below this number of nodes, synchronizing the threads costs more than
+  // refitting.
+  if(num_refitted < 1024 * num_threads) num_threads = 1;
+
+  if(num_threads == 1)
+    refitLevels(0, 1, NULL);
+  else
+  {
+    boost::barrier barrier (num_threads);
+    boost::thread_group threads;
+    for(unsigned int i = 1; i < num_threads; ++i)
+      threads.create_thread(boost::bind(&BVHModel<BV>::refitLevels, this,
+                                        i, num_threads, &barrier));
+    refitLevels(0, num_threads, &barrier);
+    threads.join_all();
+  }
+
+  if(rebuild_threshold > 0)
+    rebuildDegradedSubtrees();
+
+  return BVH_OK;
+}
+
+template<typename BV>
+void BVHModel<BV>::markForRefit(int bv_id)
+{
+  while(bv_id >= 0 && !bv_refitted[bv_id])
+  {
+    bv_refitted[bv_id] = 1;
+    std::size_t depth = (std::size_t)bv_depths[bv_id];
+    if(refit_levels.size() <= depth) refit_levels.resize(depth + 1);
+    refit_levels[depth].push_back(bv_id);
+    bv_id = bv_parents[bv_id];
+  }
+}
 
-  int res = recursiveRefitTree_bottomup(0);
+template<typename BV>
+void BVHModel<BV>::refitLevels(unsigned int thread_id, unsigned int num_threads,
+                               boost::barrier* barrier)
+{
+  // The children of a node are refitted before the node since they are one
+  // level deeper.
+  for(std::size_t d = refit_levels.size(); d-- > 0;)
+  {
+    const std::vector<int>& level = refit_levels[d];
+    for(std::size_t i = thread_id; i < level.size(); i += num_threads)
+      refitNode(level[i]);
+    if(barrier) barrier->wait();
+  }
+}
 
-  //bv_fitter->clear();
-  return res;
+template<typename BV>
+void BVHModel<BV>::computeRefitCaches(int bv_id)
+{
+  // The descendants of a node are stored contiguously from its first child,
+  // each node being stored before its children.
+  int end = bv_id + 1;
+  if(!bvs[bv_id].isLeaf())
+    end = bvs[bv_id].first_child + 2 * bvs[bv_id].num_primitives - 2;
+  for(int i = bv_id; i < end; ++i)
+  {
+    if(i == bv_id + 1) i = bvs[bv_id].first_child;
+    const BVNode<BV>& node = bvs[i];
+    if(node.isLeaf())
+      primitive_leaves[node.primitiveId()] = i;
+    else
+    {
+      bv_parents[node.leftChild()] = bv_parents[node.rightChild()] = i;
+      bv_depths[node.leftChild()] = bv_depths[node.rightChild()] = bv_depths[i] + 1;
+    }
+    bv_built_sizes[i] = node.bv.size();
+  }
 }
 
+template<typename BV>
+void BVHModel<BV>::rebuildDegradedSubtrees()
+{
+  // Look for the degraded subtrees from the root, so that the subtrees of a
+  // rebuilt subtree are not considered.
+  std::vector<int> roots;
+  for(std::size_t d = 0; d < refit_levels.size(); ++d)
+  {
+    for(std::size_t i = 0; i < refit_levels[d].size(); ++i)
+    {
+      int bv_id = refit_levels[d][i];
+      const BVNode<BV>& node = bvs[bv_id];
+      if(node.isLeaf() || node.bv.size() <= rebuild_threshold * bv_built_sizes[bv_id])
+        continue;
+      int a = bv_parents[bv_id];
+      while(a >= 0 && bv_refitted[a] != 2) a = bv_parents[a];
+      if(a >= 0) continue;
+      bv_refitted[bv_id] = 2;
+      roots.push_back(bv_id);
+    }
+  }
+  if(roots.empty()) return;
+
+  bv_fitter->set(vertices, tri_indices, getModelType());
+  bv_splitter->set(vertices, tri_indices, getModelType());
+  for(std::size_t i = 0; i < roots.size(); ++i)
+  {
+    // Reuse the nodes of the subtree, which has the same number of nodes.
+    BVNode<BV>& node = bvs[roots[i]];
+    int saved_num_bvs = num_bvs;
+    num_bvs = node.first_child;
+    recursiveBuildTree(roots[i], node.first_primitive, node.num_primitives);
+    num_bvs = saved_num_bvs;
+
+    // The fitter ignores the previous frame.
+    if(prev_vertices)
+    {
+      for(int j = node.first_child + 2 * node.num_primitives - 3; j >= node.first_child; --j)
+        refitNode(j);
+      refitNode(roots[i]);
+    }
+    computeRefitCaches(roots[i]);
+  }
+  bv_fitter->clear();
+  bv_splitter->clear();
+
+  for(std::size_t i = 0; i < roots.size(); ++i)
+    for(int a = bv_parents[roots[i]]; a >= 0; a = bv_parents[a])
+      refitNode(a);
+}
 
 template<typename BV>
-int BVHModel<BV>::recursiveRefitTree_bottomup(int bv_id)
+void BVHModel<BV>::refitNode(int bv_id)
 {
   BVNode<BV>* bvnode = bvs + bv_id;
   if(bvnode->isLeaf())
   {
     BVHModelType type = getModelType();
-    int primitive_id = -(bvnode->first_child + 1);
+    int primitive_id = bvnode->primitiveId();
     if(type == BVH_MODEL_POINTCLOUD)
     {
       BV bv;
@@ -867,7 +1211,7 @@ int BVHModel<BV>::recursiveRefitTree_bottomup(int bv_id)
 
       bvnode->bv = bv;
     }
-    else if(type == BVH_MODEL_TRIANGLES)
+    else
     {
       BV bv;
       const Triangle& triangle = tri_indices[primitive_id];
@@ -885,7 +1229,9 @@ int BVHModel<BV>::recursiveRefitTree_bottomup(int bv_id)
       }
       else
       {
-        //TODO use bv_fitter to build BV. See comment in refitTree_bottomup
+        // TODO the recomputation of the BV is done manually, without using
+        // bv_fitter. The manual BV recomputation seems bugged. Using bv_fitter
+        // seems to correct the bug.
         //unsigned int* cur_primitive_indices = primitive_indices + bvnode->first_primitive;
         //bv = bv_fitter->fit(cur_primitive_indices, bvnode->num_primitives);
         Vec3f v[3];
@@ -899,23 +1245,14 @@ int BVHModel<BV>::recursiveRefitTree_bottomup(int bv_id)
 
       bvnode->bv = bv;
     }
-    else
-    {
-      std::cerr << "BVH Error: Model type not supported!" << std::endl;
-      return BVH_ERR_UNSUPPORTED_FUNCTION;
-    }
   }
   else
   {
-    recursiveRefitTree_bottomup(bvnode->leftChild());
-    recursiveRefitTree_bottomup(bvnode->rightChild());
     bvnode->bv = bvs[bvnode->leftChild()].bv + bvs[bvnode->rightChild()].bv;
-    //TODO use bv_fitter to build BV. See comment in refitTree_bottomup
+    //TODO use bv_fitter to build BV. See comment in refitNode
     //unsigned int* cur_primitive_indices = primitive_indices + bvnode->first_primitive;
     //bvnode->bv = bv_fitter->fit(cur_primitive_indices, bvnode->num_primitives);
   }
-
-  return BVH_OK;
 }
 
 template<typename BV>
@@ -0,0 +1,479 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <hpp/fcl/BVH/BVH_serialization.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <hpp/fcl/BV/BV.h>
+
+namespace hpp
+{
+namespace fcl
+{
+
+namespace details
+{
+
+/// @brief Fixed size header at the beginning of a BVH file.
+/// The arrays follow, each one starting at an offset aligned on
+/// BVH_FILE_ALIGNMENT bytes.
+struct HPP_FCL_LOCAL BVHFileHeader
+{
+  char magic[8];
+  boost::uint32_t version;
+  boost::uint32_t endianness;
+  boost::int32_t node_type;
+  boost::uint32_t sizeof_real;
+  boost::uint32_t sizeof_vertex;
+  boost::uint32_t sizeof_triangle;
+  boost::uint32_t sizeof_bv_node;
+  boost::int32_t num_vertices;
+  boost::int32_t num_tris;
+  boost::int32_t num_bvs;
+  boost::int32_t num_primitives;
+  boost::uint32_t reserved;
+  boost::uint64_t vertices_offset;
+  boost::uint64_t tri_indices_offset;
+  boost::uint64_t bvs_offset;
+  boost::uint64_t primitive_indices_offset;
+  boost::uint64_t file_size;
+  FCL_REAL aabb_min[3];
+  FCL_REAL aabb_max[3];
+  FCL_REAL aabb_center[3];
+  FCL_REAL aabb_radius;
+};
+
+static const char BVH_FILE_MAGIC[8] = { 'H', 'P', 'P', 'F', 'C', 'L', 'B', 'V' };
+static const boost::uint32_t BVH_FILE_ENDIANNESS = 0x01020304;
+/// Sections are aligned on cache lines.
+static const boost::uint64_t BVH_FILE_ALIGNMENT = 64;
+
+inline boost::uint64_t alignOffset (boost::uint64_t offset)
+{
+  return (offset + BVH_FILE_ALIGNMENT - 1) / BVH_FILE_ALIGNMENT * BVH_FILE_ALIGNMENT;
+}
+
+inline int numPrimitives (const BVHModelBase& model)
+{
+  switch(model.getModelType())
+  {
+    case BVH_MODEL_TRIANGLES:
+      return model.num_tris;
+    case BVH_MODEL_POINTCLOUD:
+      return model.num_vertices;
+    default:
+      return 0;
+  }
+}
+
+/// @brief Whether a section of count elements of the given size, starting at
+///        offset, is aligned and fits in a file of file_size bytes.
+/// The size of the section is compared without computing it, which could
+/// overflow.
+inline bool checkSection (boost::uint64_t offset, boost::uint64_t count,
+                          boost::uint64_t size, boost::uint64_t file_size)
+{
+  return offset >= sizeof(BVHFileHeader)
+    && offset % BVH_FILE_ALIGNMENT == 0
+    && offset <= file_size
+    && count <= (file_size - offset) / size;
+}
+
+/// @brief The number of primitives the leaves refer to: the triangles, or
+///        the vertices of a point cloud.
+inline boost::int32_t numPrimitives (const BVHFileHeader& header)
+{
+  return header.num_tris > 0 ? header.num_tris : header.num_vertices;
+}
+
+/// @brief Check the fields of the header which do not depend on the BV type.
+void checkHeader (const BVHFileHeader& header, boost::uint64_t file_size,
+                  const std::string& filename)
+{
+  std::ostringstream error;
+  error << "Cannot load BVH file " << filename << ": ";
+  if(std::memcmp(header.magic, BVH_FILE_MAGIC, sizeof(BVH_FILE_MAGIC)) != 0)
+  {
+    error << "not a BVH file.";
+    throw std::runtime_error (error.str());
+  }
+  if(header.version != BVH_FILE_FORMAT_VERSION)
+  {
+    error << "unsupported format version " << header.version
+          << " (expected " << BVH_FILE_FORMAT_VERSION << ").";
+    throw std::runtime_error (error.str());
+  }
+  if(header.endianness != BVH_FILE_ENDIANNESS)
+  {
+    error << "the file was written on a machine with a different endianness.";
+    throw std::runtime_error (error.str());
+  }
+  if(header.sizeof_real != sizeof(FCL_REAL)
+     || header.sizeof_vertex != sizeof(Vec3f)
+     || header.sizeof_triangle != sizeof(Triangle))
+  {
+    error << "the file was written with different scalar or index types.";
+    throw std::runtime_error (error.str());
+  }
+  if(header.file_size != file_size)
+  {
+    error << "the file is truncated (" << file_size << " bytes instead of "
+          << header.file_size << ").";
+    throw std::runtime_error (error.str());
+  }
+  if(header.num_vertices <= 0 || header.num_tris < 0 || header.num_bvs <= 0
+     || header.num_primitives <= 0 || header.num_primitives > header.num_bvs
+     || header.sizeof_bv_node == 0
+     || !checkSection(header.vertices_offset,
+                      (boost::uint64_t)header.num_vertices, sizeof(Vec3f), file_size)
+     || !checkSection(header.tri_indices_offset,
+                      (boost::uint64_t)header.num_tris, sizeof(Triangle), file_size)
+     || !checkSection(header.bvs_offset,
+                      (boost::uint64_t)header.num_bvs, header.sizeof_bv_node, file_size)
+     || !checkSection(header.primitive_indices_offset,
+                      (boost::uint64_t)header.num_primitives, sizeof(unsigned int),
+                      file_size))
+  {
+    error << "the file is corrupted.";
+    throw std::runtime_error (error.str());
+  }
+}
+
+template<typename BV>
+struct HPP_FCL_LOCAL BVHModelIO
+{
+  static void save (const BVHModel<BV>& model, const std::string& filename)
+  {
+    if(model.build_state != BVH_BUILD_STATE_PROCESSED
+       && model.build_state != BVH_BUILD_STATE_UPDATED)
+      throw std::invalid_argument ("Cannot save a BVHModel whose hierarchy "
+                                   "is not built.");
+
+    BVHFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, BVH_FILE_MAGIC, sizeof(BVH_FILE_MAGIC));
+    header.version = BVH_FILE_FORMAT_VERSION;
+    header.endianness = BVH_FILE_ENDIANNESS;
+    header.node_type = model.getNodeType();
+    header.sizeof_real = sizeof(FCL_REAL);
+    header.sizeof_vertex = sizeof(Vec3f);
+    header.sizeof_triangle = sizeof(Triangle);
+    header.sizeof_bv_node = sizeof(BVNode<BV>);
+    header.num_vertices = model.num_vertices;
+    header.num_tris = model.tri_indices ? model.num_tris : 0;
+    header.num_bvs = model.num_bvs;
+    header.num_primitives = numPrimitives(model);
+
+    header.vertices_offset = alignOffset(sizeof(BVHFileHeader));
+    header.tri_indices_offset = alignOffset(header.vertices_offset
+        + header.num_vertices * sizeof(Vec3f));
+    header.bvs_offset = alignOffset(header.tri_indices_offset
+        + header.num_tris * sizeof(Triangle));
+    header.primitive_indices_offset = alignOffset(header.bvs_offset
+        + header.num_bvs * sizeof(BVNode<BV>));
+    header.file_size = header.primitive_indices_offset
+      + header.num_primitives * sizeof(unsigned int);
+
+    for(int i = 0; i < 3; ++i)
+    {
+      header.aabb_min[i] = model.aabb_local.min_[i];
+      header.aabb_max[i] = model.aabb_local.max_[i];
+      header.aabb_center[i] = model.aabb_center[i];
+    }
+    header.aabb_radius = model.aabb_radius;
+
+    std::ofstream os (filename.c_str(), std::ios::binary | std::ios::trunc);
+    if(!os)
+      throw std::runtime_error ("Cannot open " + filename + " for writing.");
+
+    write(os, &header, sizeof(header));
+    write(os, header.vertices_offset, model.vertices,
+          header.num_vertices * sizeof(Vec3f));
+    write(os, header.tri_indices_offset, model.tri_indices,
+          header.num_tris * sizeof(Triangle));
+    write(os, header.bvs_offset, model.bvs,
+          header.num_bvs * sizeof(BVNode<BV>));
+    write(os, header.primitive_indices_offset, model.primitive_indices,
+          header.num_primitives * sizeof(unsigned int));
+
+    os.close();
+    if(!os)
+      throw std::runtime_error ("Failed to write " + filename + ".");
+  }
+
+  /// @brief Build a model whose arrays point into the mapped buffer \c data.
+  static BVHModelPtr_t map (const BVHFileHeader& header, const char* data,
+                            const boost::shared_ptr<const void>& storage,
+                            const std::string& filename)
+  {
+    const Triangle* tri_indices = reinterpret_cast<const Triangle*>
+      (data + header.tri_indices_offset);
+    const BVNode<BV>* bvs = reinterpret_cast<const BVNode<BV>*>
+      (data + header.bvs_offset);
+    const unsigned int* primitive_indices = reinterpret_cast<const unsigned int*>
+      (data + header.primitive_indices_offset);
+    checkLayout(header);
+    checkIndices(header, tri_indices, bvs, primitive_indices, filename);
+
+    boost::shared_ptr<BVHModel<BV> > model (new BVHModel<BV>);
+    setCommonFields(header, *model);
+    model->vertices = const_cast<Vec3f*>(reinterpret_cast<const Vec3f*>
+        (data + header.vertices_offset));
+    if(header.num_tris > 0)
+      model->tri_indices = const_cast<Triangle*>(tri_indices);
+    model->bvs = const_cast<BVNode<BV>*>(bvs);
+    model->primitive_indices = const_cast<unsigned int*>(primitive_indices);
+    model->mapped_storage = storage;
+    return model;
+  }
+
+  /// @brief Build a model which owns a copy of the arrays stored in \c is.
+  static BVHModelPtr_t copy (const BVHFileHeader& header, std::istream& is,
+                             const std::string& filename)
+  {
+    boost::shared_ptr<BVHModel<BV> > model (new BVHModel<BV>);
+    setCommonFields(header, *model);
+
+    model->vertices = new Vec3f[header.num_vertices];
+    read(is, header.vertices_offset, model->vertices,
+         header.num_vertices * sizeof(Vec3f));
+    if(header.num_tris > 0)
+    {
+      model->tri_indices = new Triangle[header.num_tris];
+      read(is, header.tri_indices_offset, model->tri_indices,
+           header.num_tris * sizeof(Triangle));
+    }
+    model->bvs = new BVNode<BV>[header.num_bvs];
+    read(is, header.bvs_offset, model->bvs,
+         header.num_bvs * sizeof(BVNode<BV>));
+    model->primitive_indices = new unsigned int[header.num_bvs];
+    read(is, header.primitive_indices_offset, model->primitive_indices,
+         header.num_primitives * sizeof(unsigned int));
+    checkIndices(header, model->tri_indices, model->bvs,
+                 model->primitive_indices, filename);
+    return model;
+  }
+
+private:
+  static void checkLayout (const BVHFileHeader& header)
+  {
+    if(header.sizeof_bv_node != sizeof(BVNode<BV>))
+      throw std::runtime_error ("Cannot load BVH file: the bounding volume "
+                                "layout differs from the one of this library.");
+  }
+
+  /// @brief Check that the indices of the arrays stay inside the arrays and
+  /// that the children of each node are stored after it, so that the
+  /// traversals, which do not check the indices, terminate.
+  static void checkIndices (const BVHFileHeader& header,
+                            const Triangle* tri_indices, const BVNode<BV>* bvs,
+                            const unsigned int* primitive_indices,
+                            const std::string& filename)
+  {
+    const boost::int64_t num_primitives = numPrimitives(header);
+    bool valid = true;
+    for(boost::int32_t i = 0; valid && i < header.num_tris; ++i)
+      for(int k = 0; k < 3; ++k)
+        valid = valid
+          && tri_indices[i][k] < (Triangle::index_type)header.num_vertices;
+    for(boost::int32_t i = 0; valid && i < header.num_bvs; ++i)
+    {
+      const BVNode<BV>& node = bvs[i];
+      if(node.isLeaf())
+        valid = node.primitiveId() < num_primitives;
+      else
+        valid = node.first_child > i
+          && (boost::int64_t)node.first_child + 1 < header.num_bvs;
+      valid = valid && node.first_primitive >= 0 && node.num_primitives >= 0
+        && (boost::int64_t)node.first_primitive + node.num_primitives
+           <= header.num_primitives;
+    }
+    for(boost::int32_t i = 0; valid && i < header.num_primitives; ++i)
+      valid = primitive_indices[i] < (boost::uint64_t)num_primitives;
+    if(!valid)
+      throw std::runtime_error ("Cannot load BVH file " + filename
+                                + ": the file is corrupted.");
+  }
+
+  static void setCommonFields (const BVHFileHeader& header, BVHModel<BV>& model)
+  {
+    checkLayout(header);
+
+    model.num_vertices = model.num_vertices_allocated = header.num_vertices;
+    model.num_tris = model.num_tris_allocated = header.num_tris;
+    model.num_bvs = model.num_bvs_allocated = header.num_bvs;
+    model.build_state = BVH_BUILD_STATE_PROCESSED;
+
+    for(int i = 0; i < 3; ++i)
+    {
+      model.aabb_local.min_[i] = header.aabb_min[i];
+      model.aabb_local.max_[i] = header.aabb_max[i];
+      model.aabb_center[i] = header.aabb_center[i];
+    }
+    model.aabb_radius = header.aabb_radius;
+  }
+
+  static void write (std::ostream& os, const void* data, std::size_t size)
+  {
+    os.write(static_cast<const char*>(data), (std::streamsize)size);
+  }
+
+  static void write (std::ostream& os, boost::uint64_t offset,
+                     const void* data, std::size_t size)
+  {
+    static const char zeros[BVH_FILE_ALIGNMENT] = { 0 };
+    std::streamoff pos = os.tellp();
+    write(os, zeros, (std::size_t)(offset - (boost::uint64_t)pos));
+    write(os, data, size);
+  }
+
+  static void read (std::istream& is, boost::uint64_t offset,
+                    void* data, std::size_t size)
+  {
+    is.seekg((std::streamoff)offset);
+    is.read(static_cast<char*>(data), (std::streamsize)size);
+    if(!is)
+      throw std::runtime_error ("Cannot load BVH file: read error.");
+  }
+};
+
+} // namespace details
+
+void saveBVHModel (const BVHModelBase& model, const std::string& filename)
+{
+  switch(model.getNodeType())
+  {
+    case BV_AABB  : return details::BVHModelIO<AABB  >::save(static_cast<const BVHModel<AABB  >&>(model), filename);
+    case BV_OBB   : return details::BVHModelIO<OBB   >::save(static_cast<const BVHModel<OBB   >&>(model), filename);
+    case BV_RSS   : return details::BVHModelIO<RSS   >::save(static_cast<const BVHModel<RSS   >&>(model), filename);
+    case BV_kIOS  : return details::BVHModelIO<kIOS  >::save(static_cast<const BVHModel<kIOS  >&>(model), filename);
+    case BV_OBBRSS: return details::BVHModelIO<OBBRSS>::save(static_cast<const BVHModel<OBBRSS>&>(model), filename);
+    case BV_KDOP16: return details::BVHModelIO<KDOP<16> >::save(static_cast<const BVHModel<KDOP<16> >&>(model), filename);
+    case BV_KDOP18: return details::BVHModelIO<KDOP<18> >::save(static_cast<const BVHModel<KDOP<18> >&>(model), filename);
+    case BV_KDOP24: return details::BVHModelIO<KDOP<24> >::save(static_cast<const BVHModel<KDOP<24> >&>(model), filename);
+    default:
+      throw std::invalid_argument("Unhandled bounding volume type.");
+  }
+}
+
+namespace details
+{
+  BVHModelPtr_t mapBVHModel (const std::string& filename)
+  {
+    namespace bip = boost::interprocess;
+    boost::shared_ptr<bip::mapped_region> region;
+    try {
+      bip::file_mapping file (filename.c_str(), bip::read_only);
+      region.reset (new bip::mapped_region (file, bip::read_only));
+    } catch (const bip::interprocess_exception& e) {
+      throw std::runtime_error ("Cannot map BVH file " + filename + ": "
+                                + e.what());
+    }
+
+    if(region->get_size() < sizeof(BVHFileHeader))
+      throw std::runtime_error ("Cannot load BVH file " + filename
+                                + ": not a BVH file.");
+    const char* data = static_cast<const char*>(region->get_address());
+    const BVHFileHeader& header = *reinterpret_cast<const BVHFileHeader*>(data);
+    checkHeader(header, region->get_size(), filename);
+
+    boost::shared_ptr<const void> storage (region);
+    switch(header.node_type)
+    {
+      case BV_AABB  : return BVHModelIO<AABB  >::map(header, data, storage, filename);
+      case BV_OBB   : return BVHModelIO<OBB   >::map(header, data, storage, filename);
+      case BV_RSS   : return BVHModelIO<RSS   >::map(header, data, storage, filename);
+      case BV_kIOS  : return BVHModelIO<kIOS  >::map(header, data, storage, filename);
+      case BV_OBBRSS: return BVHModelIO<OBBRSS>::map(header, data, storage, filename);
+      case BV_KDOP16: return BVHModelIO<KDOP<16> >::map(header, data, storage, filename);
+      case BV_KDOP18: return BVHModelIO<KDOP<18> >::map(header, data, storage, filename);
+      case BV_KDOP24: return BVHModelIO<KDOP<24> >::map(header, data, storage, filename);
+      default:
+        throw std::runtime_error("Cannot load BVH file " + filename
+                                 + ": unhandled bounding volume type.");
+    }
+  }
+
+  BVHModelPtr_t readBVHModel (const std::string& filename)
+  {
+    std::ifstream is (filename.c_str(), std::ios::binary);
+    if(!is)
+      throw std::runtime_error ("Cannot open BVH file " + filename + ".");
+    is.seekg(0, std::ios::end);
+    boost::uint64_t file_size = (boost::uint64_t)is.tellg();
+    is.seekg(0, std::ios::beg);
+
+    BVHFileHeader header;
+    if(file_size < sizeof(header)
+       || !is.read(reinterpret_cast<char*>(&header), sizeof(header)))
+      throw std::runtime_error ("Cannot load BVH file " + filename
+                                + ": not a BVH file.");
+    checkHeader(header, file_size, filename);
+
+    switch(header.node_type)
+    {
+      case BV_AABB  : return BVHModelIO<AABB  >::copy(header, is, filename);
+      case BV_OBB   : return BVHModelIO<OBB   >::copy(header, is, filename);
+      case BV_RSS   : return BVHModelIO<RSS   >::copy(header, is, filename);
+      case BV_kIOS  : return BVHModelIO<kIOS  >::copy(header, is, filename);
+      case BV_OBBRSS: return BVHModelIO<OBBRSS>::copy(header, is, filename);
+      case BV_KDOP16: return BVHModelIO<KDOP<16> >::copy(header, is, filename);
+      case BV_KDOP18: return BVHModelIO<KDOP<18> >::copy(header, is, filename);
+      case BV_KDOP24: return BVHModelIO<KDOP<24> >::copy(header, is, filename);
+      default:
+        throw std::runtime_error("Cannot load BVH file " + filename
+                                 + ": unhandled bounding volume type.");
+    }
+  }
+} // namespace details
+
+BVHModelPtr_t loadBVHModel (const std::string& filename, bool memory_map)
+{
+  if(memory_map)
+    return details::mapBVHModel(filename);
+  else
+    return details::readBVHModel(filename);
+}
+
+}
+
+} // namespace hpp
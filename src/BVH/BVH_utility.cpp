@@ -39,6 +39,10 @@
 #include <hpp/fcl/BVH/BVH_utility.h>
 #include <hpp/fcl/narrowphase/narrowphase.h>
 #include <hpp/fcl/shape/geometric_shapes_utility.h>
+#include <hpp/fcl/BV/BV.h>
+
+#include <algorithm>
+#include <limits>
 
 namespace hpp
 {
@@ -717,6 +721,82 @@ static inline FCL_REAL maximumDistance_pointcloud(Vec3f* ps, Vec3f* ps2, unsigne
   return std::sqrt(maxD);
 }
 
+template<typename BV>
+BVHQuality computeBVHQuality(const BVHModel<BV>& model,
+                             FCL_REAL traversal_cost, FCL_REAL primitive_cost)
+{
+  BVHQuality quality;
+  quality.sah_cost = 0;
+  quality.max_depth = 0;
+  quality.mean_leaf_depth = 0;
+  quality.num_leaves = 0;
+  quality.min_leaf_primitives = std::numeric_limits<int>::max();
+  quality.max_leaf_primitives = 0;
+  quality.mean_leaf_primitives = 0;
+  quality.mean_volume_ratio = 0;
+  quality.overlap_ratio = 0;
+  if(model.getNumBVs() == 0) return quality;
+
+  const FCL_REAL root_area = details::surfaceArea(model.getBV(0).bv);
+  int num_internal = 0, num_overlaps = 0, num_volume_ratios = 0;
+  int total_leaf_depth = 0, total_leaf_primitives = 0;
+
+  // Depth first traversal.
+  std::vector<std::pair<int, int> > stack (1, std::make_pair(0, 0));
+  while(!stack.empty())
+  {
+    int bv_id = stack.back().first, depth = stack.back().second;
+    stack.pop_back();
+    const BVNode<BV>& node = model.getBV(bv_id);
+    FCL_REAL area = (root_area > 0) ? details::surfaceArea(node.bv) / root_area : 1;
+
+    if(node.isLeaf())
+    {
+      quality.sah_cost += area * primitive_cost * node.num_primitives;
+      if((int)quality.depth_histogram.size() <= depth)
+        quality.depth_histogram.resize(depth + 1, 0);
+      quality.depth_histogram[depth]++;
+      quality.max_depth = std::max(quality.max_depth, depth);
+      quality.num_leaves++;
+      quality.min_leaf_primitives = std::min(quality.min_leaf_primitives, node.num_primitives);
+      quality.max_leaf_primitives = std::max(quality.max_leaf_primitives, node.num_primitives);
+      total_leaf_depth += depth;
+      total_leaf_primitives += node.num_primitives;
+    }
+    else
+    {
+      quality.sah_cost += area * traversal_cost;
+      const BVNode<BV>& left = model.getBV(node.leftChild());
+      const BVNode<BV>& right = model.getBV(node.rightChild());
+      num_internal++;
+      if(left.bv.overlap(right.bv)) num_overlaps++;
+      FCL_REAL volume = node.bv.volume();
+      if(volume > 0)
+      {
+        quality.mean_volume_ratio += (left.bv.volume() + right.bv.volume()) / volume;
+        num_volume_ratios++;
+      }
+      stack.push_back(std::make_pair(node.leftChild(), depth + 1));
+      stack.push_back(std::make_pair(node.rightChild(), depth + 1));
+    }
+  }
+
+  quality.mean_leaf_depth = (FCL_REAL)total_leaf_depth / quality.num_leaves;
+  quality.mean_leaf_primitives = (FCL_REAL)total_leaf_primitives / quality.num_leaves;
+  if(num_volume_ratios > 0) quality.mean_volume_ratio /= num_volume_ratios;
+  if(num_internal > 0) quality.overlap_ratio = (FCL_REAL)num_overlaps / num_internal;
+  return quality;
+}
+
+template HPP_FCL_DLLAPI BVHQuality computeBVHQuality(const BVHModel<AABB     >& model, FCL_REAL, FCL_REAL);
+template HPP_FCL_DLLAPI BVHQuality computeBVHQuality(const BVHModel<OBB      >& model, FCL_REAL, FCL_REAL);
+template HPP_FCL_DLLAPI BVHQuality computeBVHQuality(const BVHModel<RSS      >& model, FCL_REAL, FCL_REAL);
+template HPP_FCL_DLLAPI BVHQuality computeBVHQuality(const BVHModel<kIOS     >& model, FCL_REAL, FCL_REAL);
+template HPP_FCL_DLLAPI BVHQuality computeBVHQuality(const BVHModel<OBBRSS   >& model, FCL_REAL, FCL_REAL);
+template HPP_FCL_DLLAPI BVHQuality computeBVHQuality(const BVHModel<KDOP<16> >& model, FCL_REAL, FCL_REAL);
+template HPP_FCL_DLLAPI BVHQuality computeBVHQuality(const BVHModel<KDOP<18> >& model, FCL_REAL, FCL_REAL);
+template HPP_FCL_DLLAPI BVHQuality computeBVHQuality(const BVHModel<KDOP<24> >& model, FCL_REAL, FCL_REAL);
+
 FCL_REAL maximumDistance(Vec3f* ps, Vec3f* ps2, Triangle* ts, unsigned int* indices, int n, const Vec3f& query)
 {
   if(ts)
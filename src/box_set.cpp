@@ -0,0 +1,124 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <hpp/fcl/box_set.h>
+
+#include <algorithm>
+
+namespace hpp
+{
+namespace fcl
+{
+
+namespace details
+{
+
+/// @brief Order of the boxes by the coordinate of their centers along an
+///        axis.
+struct BoxCenterLess
+{
+  const std::vector<AABB>& boxes;
+  int axis;
+
+  BoxCenterLess(const std::vector<AABB>& boxes_, int axis_)
+    : boxes(boxes_), axis(axis_) {}
+
+  bool operator() (int i, int j) const
+  {
+    return boxes[i].min_[axis] + boxes[i].max_[axis]
+      < boxes[j].min_[axis] + boxes[j].max_[axis];
+  }
+};
+
+} // namespace details
+
+BoxSet::BoxSet(const std::vector<AABB>& boxes_) : boxes(boxes_)
+{
+  if(!boxes.empty())
+  {
+    std::vector<int> indices (boxes.size());
+    for(std::size_t i = 0; i < indices.size(); ++i)
+      indices[i] = (int) i;
+    nodes.reserve(2 * boxes.size() - 1);
+    nodes.resize(1);
+    build(0, indices, 0, indices.size());
+  }
+  computeLocalAABB();
+}
+
+void BoxSet::computeLocalAABB()
+{
+  aabb_local = nodes.empty() ? AABB(Vec3f(0, 0, 0)) : nodes[0].bv;
+  aabb_center = aabb_local.center();
+  aabb_radius = (aabb_local.min_ - aabb_center).norm();
+}
+
+void BoxSet::build(std::size_t node, std::vector<int>& indices,
+                   std::size_t begin, std::size_t end)
+{
+  AABB bv (boxes[indices[begin]]);
+  AABB centers (boxes[indices[begin]].center());
+  for(std::size_t i = begin + 1; i < end; ++i)
+  {
+    bv += boxes[indices[i]];
+    centers += boxes[indices[i]].center();
+  }
+  nodes[node].bv = bv;
+
+  if(end - begin == 1)
+  {
+    nodes[node].first_child = -1;
+    nodes[node].box = indices[begin];
+    return;
+  }
+
+  int axis;
+  (centers.max_ - centers.min_).maxCoeff(&axis);
+  std::size_t middle = (begin + end) / 2;
+  std::nth_element(indices.begin() + (std::ptrdiff_t) begin,
+                   indices.begin() + (std::ptrdiff_t) middle,
+                   indices.begin() + (std::ptrdiff_t) end,
+                   details::BoxCenterLess(boxes, axis));
+
+  std::size_t first_child = nodes.size();
+  nodes[node].first_child = (int) first_child;
+  nodes[node].box = -1;
+  nodes.resize(first_child + 2);
+  build(first_child, indices, begin, middle);
+  build(first_child + 1, indices, middle, end);
+}
+
+}
+
+} // namespace hpp
@@ -38,7 +38,11 @@
 
 #include <hpp/fcl/collision.h>
 #include <hpp/fcl/collision_func_matrix.h>
+#include <hpp/fcl/distance.h>
+#include <hpp/fcl/internal/traversal_node_setup.h>
+#include "collision_node.h"
 #include <hpp/fcl/narrowphase/narrowphase.h>
+#include <hpp/fcl/profile.h>
 
 #include <iostream>
 
@@ -77,7 +81,12 @@ std::size_t collide(const CollisionGeometry* o1, const Transform3f& tf1,
                     const CollisionGeometry* o2, const Transform3f& tf2,
                     const CollisionRequest& request, CollisionResult& result)
 {
+  time::point start;
   GJKSolver solver;
+  if (request.enable_statistics) {
+    start = time::now();
+    solver.statistics = &result.statistics;
+  }
   solver.enable_cached_guess = request.enable_cached_gjk_guess;
   if (solver.enable_cached_guess) {
     solver.cached_guess = request.cached_gjk_guess;
@@ -126,13 +135,125 @@ std::size_t collide(const CollisionGeometry* o1, const Transform3f& tf1,
     result.cached_gjk_guess = solver.cached_guess;
     result.cached_support_func_guess = solver.support_func_cached_guess;
   }
+  if (request.enable_statistics)
+    result.statistics.time +=
+      (FCL_REAL) (time::now() - start).total_microseconds();
+
+  return res;
+}
+
+std::size_t collideAndDistance(
+    const CollisionGeometry* o1, const Transform3f& tf1,
+    const CollisionGeometry* o2, const Transform3f& tf2,
+    const CollisionRequest& request, CollisionResult& result,
+    const DistanceRequest& distance_request, DistanceResult& distance_result)
+{
+  if(o1->getNodeType() == BV_OBBRSS && o2->getNodeType() == BV_OBBRSS
+     && request.num_max_contacts > 0)
+  {
+    const BVHModel<OBBRSS>* obj1 = static_cast<const BVHModel<OBBRSS>* >(o1);
+    const BVHModel<OBBRSS>* obj2 = static_cast<const BVHModel<OBBRSS>* >(o2);
+    MeshCollisionDistanceTraversalNodeOBBRSS node (request);
+    if(initialize(node, *obj1, tf1, *obj2, tf2, distance_request,
+                  distance_result, result))
+    {
+      staticDistance(node);
+      if(!result.isCollision())
+        result.updateDistanceLowerBound(distance_result.distance_lower_bound);
+      return result.numContacts();
+    }
+  }
+
+  std::size_t res = collide(o1, tf1, o2, tf2, request, result);
+  distance(o1, tf1, o2, tf2, distance_request, distance_result);
+  return res;
+}
+
+namespace details
+{
+  void collideShapes(const CollisionGeometry* tree, const Transform3f& tf_tree,
+                     const std::vector<const CollisionGeometry*>& shapes,
+                     const std::vector<Transform3f>& tfs,
+                     const CollisionRequest& request,
+                     std::vector<CollisionResult>& results)
+  {
+    GJKSolver solver;
+    OcTreeSolver otsolver(&solver);
+    switch(tree->getNodeType())
+    {
+#ifdef HPP_FCL_HAVE_OCTOMAP
+    case GEOM_OCTREE:
+      otsolver.OcTreeShapesIntersect(static_cast<const OcTree*>(tree), shapes,
+                                     tf_tree, tfs, request, results);
+      break;
+#endif
+    case GEOM_LINEAR_OCTREE:
+      otsolver.OcTreeShapesIntersect(static_cast<const LinearOcTree*>(tree),
+                                     shapes, tf_tree, tfs, request, results);
+      break;
+    default:
+      throw std::invalid_argument("Collision with several shapes requires an "
+                                  "octree.");
+    }
+  }
+} // namespace details
+
+std::size_t collide(const CollisionGeometry* tree, const Transform3f& tf_tree,
+                    const std::vector<const CollisionGeometry*>& shapes,
+                    const std::vector<Transform3f>& tfs,
+                    const CollisionRequest& request,
+                    std::vector<CollisionResult>& results)
+{
+  if(shapes.size() != tfs.size())
+    throw std::invalid_argument("There must be one pose per shape.");
+  results.resize(shapes.size());
+
+  if(request.octree_refine && request.hasOcTreeMaxDepth())
+  {
+    // Only the shapes in collision with the coarse octree are tested again
+    // at full depth.
+    CollisionRequest coarse_request (request);
+    coarse_request.octree_refine = false;
+    coarse_request.num_max_contacts = 1;
+    std::vector<CollisionResult> coarse_results (shapes.size());
+    details::collideShapes(tree, tf_tree, shapes, tfs, coarse_request,
+                           coarse_results);
+
+    std::vector<const CollisionGeometry*> fine_shapes;
+    std::vector<Transform3f> fine_tfs;
+    std::vector<std::size_t> indices;
+    for(std::size_t i = 0; i < shapes.size(); ++i)
+    {
+      if(!coarse_results[i].isCollision()) continue;
+      fine_shapes.push_back(shapes[i]);
+      fine_tfs.push_back(tfs[i]);
+      indices.push_back(i);
+    }
+
+    CollisionRequest fine_request (request);
+    fine_request.octree_refine = false;
+    fine_request.octree_max_depth = CollisionRequest().octree_max_depth;
+    std::vector<CollisionResult> fine_results (indices.size());
+    for(std::size_t i = 0; i < indices.size(); ++i)
+      fine_results[i] = results[indices[i]];
+    if(!indices.empty())
+      details::collideShapes(tree, tf_tree, fine_shapes, fine_tfs, fine_request,
+                             fine_results);
+    for(std::size_t i = 0; i < indices.size(); ++i)
+      results[indices[i]] = fine_results[i];
+  }
+  else
+    details::collideShapes(tree, tf_tree, shapes, tfs, request, results);
 
+  std::size_t res = 0;
+  for(std::size_t i = 0; i < results.size(); ++i)
+    if(results[i].isCollision()) ++res;
   return res;
 }
 
 ComputeCollision::ComputeCollision(const CollisionGeometry* o1,
     const CollisionGeometry* o2)
-  : o1(o1), o2(o2)
+  : o1(o1), o2(o2), front_list_enabled(false)
 {
   const CollisionFunctionMatrix& looktable = getCollisionFunctionLookTable();
 
@@ -155,6 +276,11 @@ ComputeCollision::ComputeCollision(const CollisionGeometry* o1,
     func = looktable.collision_matrix[node_type2][node_type1];
   else
     func = looktable.collision_matrix[node_type1][node_type2];
+
+  if (swap_geoms)
+    front_func = NULL;
+  else
+    front_func = looktable.collision_front_matrix[node_type1][node_type2];
 }
 
 } // namespace fcl
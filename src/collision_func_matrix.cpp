@@ -39,6 +39,8 @@
 #include <hpp/fcl/collision_func_matrix.h>
 
 #include <hpp/fcl/internal/traversal_node_setup.h>
+#include <hpp/fcl/distance_field.h>
+#include <hpp/fcl/box_set.h>
 #include <../src/collision_node.h>
 #include <hpp/fcl/narrowphase/narrowphase.h>
 #include <../src/distance_func_matrix.h>
@@ -49,8 +51,6 @@ namespace hpp
 namespace fcl
 {
 
-#ifdef HPP_FCL_HAVE_OCTOMAP
-
 template<typename TypeA, typename TypeB>
 std::size_t Collide(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2,
                                const GJKSolver* nsolver,
@@ -58,6 +58,23 @@ std::size_t Collide(const CollisionGeometry* o1, const Transform3f& tf1, const C
 {
   if(request.isSatisfied(result)) return result.numContacts();
 
+  if(request.octree_refine && request.hasOcTreeMaxDepth())
+  {
+    // The query at full depth is only needed when the coarse query, which
+    // is conservative, finds a collision.
+    CollisionRequest coarse_request (request);
+    coarse_request.octree_refine = false;
+    coarse_request.num_max_contacts = 1;
+    CollisionResult coarse_result;
+    Collide<TypeA, TypeB>(o1, tf1, o2, tf2, nsolver, coarse_request, coarse_result);
+    if(!coarse_result.isCollision()) return result.numContacts();
+
+    CollisionRequest fine_request (request);
+    fine_request.octree_refine = false;
+    fine_request.octree_max_depth = CollisionRequest().octree_max_depth;
+    return Collide<TypeA, TypeB>(o1, tf1, o2, tf2, nsolver, fine_request, result);
+  }
+
   typename TraversalTraitsCollision<TypeA, TypeB>::CollisionTraversal_t node (request);
   const TypeA* obj1 = dynamic_cast<const TypeA*>(o1);
   const TypeB* obj2 = dynamic_cast<const TypeB*>(o2);
@@ -68,7 +85,6 @@ std::size_t Collide(const CollisionGeometry* o1, const Transform3f& tf1, const C
 
   return result.numContacts();
 }
-#endif
 
 template<typename T_SH1, typename T_SH2>
 std::size_t ShapeShapeCollide(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, 
@@ -113,6 +129,117 @@ std::size_t ShapeShapeCollide(const CollisionGeometry* o1, const Transform3f& tf
   return 0;
 }
 
+/// @brief Collision between a distance field and a sphere or a capsule.
+///
+/// A truncated distance of the field only tells that the shape is at least
+/// at the maximal distance minus its radius of the obstacles, which decides
+/// the collision if the radius plus the security margin is below the maximal
+/// distance.
+/// \tparam ShapeFirst whether the shape is the first object.
+template<typename T_SH, bool ShapeFirst>
+std::size_t DistanceFieldShapeCollide(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2,
+                                      const GJKSolver*,
+                                      const CollisionRequest& request, CollisionResult& result)
+{
+  if(request.isSatisfied(result)) return result.numContacts();
+
+  const DistanceField* field = static_cast<const DistanceField*>(ShapeFirst ? o2 : o1);
+  const T_SH* shape = static_cast<const T_SH*>(ShapeFirst ? o1 : o2);
+  const Transform3f& tf_field = ShapeFirst ? tf2 : tf1;
+  const Transform3f& tf_shape = ShapeFirst ? tf1 : tf2;
+  if (shape->radius + request.security_margin >= field->getMaxDistance())
+    throw std::invalid_argument("The radius of the shape plus the security "
+        "margin must be below the maximal distance of the DistanceField.");
+
+  Vec3f p1, p2, normal;
+  bool truncated;
+  FCL_REAL distance = field->shapeDistance
+    (*shape, tf_field.inverseTimes(tf_shape), p1, p2, normal, &truncated);
+  if (truncated)
+    distance = field->getMaxDistance() - shape->radius;
+
+  if (distance <= request.security_margin) {
+    if (result.numContacts () < request.num_max_contacts) {
+      normal = tf_field.getRotation() * normal;
+      Contact contact (o1, o2, Contact::NONE, Contact::NONE,
+          tf_field.transform (.5 * (p1 + p2)),
+          ShapeFirst ? Vec3f(-normal) : normal,
+          -distance+request.security_margin);
+      result.addContact (contact);
+    }
+    return 1;
+  }
+  result.updateDistanceLowerBound (distance);
+  return 0;
+}
+
+/// @brief Collision between a set of boxes and a shape.
+///
+/// The nodes of the hierarchy farther than the security margin from the
+/// bounding box of the shape are pruned, and the boxes of the leaves are
+/// tested with ShapeShapeCollide.
+/// \tparam ShapeFirst whether the shape is the first object.
+template<typename T_SH, bool ShapeFirst>
+std::size_t BoxSetShapeCollide(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2,
+                               const GJKSolver* nsolver,
+                               const CollisionRequest& request, CollisionResult& result)
+{
+  if(request.isSatisfied(result)) return result.numContacts();
+
+  const BoxSet* set = static_cast<const BoxSet*>(ShapeFirst ? o2 : o1);
+  const T_SH* shape = static_cast<const T_SH*>(ShapeFirst ? o1 : o2);
+  const Transform3f& tf_set = ShapeFirst ? tf2 : tf1;
+  const Transform3f& tf_shape = ShapeFirst ? tf1 : tf2;
+  const std::vector<BoxSet::Node>& nodes = set->getNodes();
+  if(nodes.empty()) return result.numContacts();
+
+  AABB aabb;
+  computeBV<AABB, T_SH>(*shape, tf_set.inverseTimes(tf_shape), aabb);
+
+  // With a negative margin, the boxes of the nodes must still be tested
+  // when they overlap the bounding box of the shape.
+  const FCL_REAL margin = (std::max)(request.security_margin, FCL_REAL(0));
+  std::vector<int> stack (1, 0);
+  while(!stack.empty())
+  {
+    const BoxSet::Node& node = nodes[stack.back()];
+    stack.pop_back();
+    FCL_REAL distance = node.bv.distance(aabb);
+    if(distance > margin)
+    {
+      result.updateDistanceLowerBound(distance);
+      continue;
+    }
+    if(!node.isLeaf())
+    {
+      // The second child is pushed first, so that the boxes are visited in
+      // the order of the hierarchy.
+      stack.push_back(node.first_child + 1);
+      stack.push_back(node.first_child);
+      continue;
+    }
+
+    const AABB& bv = set->getBoxes()[node.box];
+    Box box (bv.max_ - bv.min_);
+    Transform3f box_tf (tf_set * Transform3f(bv.center()));
+    CollisionResult box_result;
+    std::size_t n = ShapeFirst
+      ? ShapeShapeCollide<T_SH, Box>(shape, tf_shape, &box, box_tf, nsolver, request, box_result)
+      : ShapeShapeCollide<Box, T_SH>(&box, box_tf, shape, tf_shape, nsolver, request, box_result);
+    result.updateDistanceLowerBound(box_result.distance_lower_bound);
+    // box_result has no contact when num_max_contacts is 0.
+    if(n == 0 || box_result.numContacts() == 0) continue;
+
+    Contact contact (box_result.getContact(0));
+    contact.o1 = o1;
+    contact.o2 = o2;
+    (ShapeFirst ? contact.b2 : contact.b1) = node.box;
+    result.addContact(contact);
+    if(request.isSatisfied(result)) break;
+  }
+  return result.numContacts();
+}
+
 namespace details
 {
   template<typename T_BVH, typename T_SH> struct bvh_shape_traits
@@ -162,7 +289,7 @@ struct HPP_FCL_LOCAL BVHShapeCollider
     const T_SH* obj2 = static_cast<const T_SH*>(o2);
 
     initialize(node, *obj1_tmp, tf1_tmp, *obj2, tf2, nsolver, result);
-    fcl::collide(&node, request, result);
+    staticCollide(node, request, result);
 
     delete obj1_tmp;
     return result.numContacts();
@@ -179,7 +306,7 @@ struct HPP_FCL_LOCAL BVHShapeCollider
     const T_SH* obj2 = static_cast<const T_SH*>(o2);
 
     initialize(node, *obj1, tf1, *obj2, tf2, nsolver, result);
-    fcl::collide(&node, request, result);
+    staticCollide(node, request, result);
     return result.numContacts();
   }
 
@@ -188,7 +315,7 @@ struct HPP_FCL_LOCAL BVHShapeCollider
 namespace details
 {
 template<typename OrientedMeshCollisionTraversalNode, typename T_BVH>
-std::size_t orientedMeshCollide(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const CollisionRequest& request, CollisionResult& result)
+std::size_t orientedMeshCollide(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const CollisionRequest& request, CollisionResult& result, BVHFrontList* front_list)
 {
   if(request.isSatisfied(result)) return result.numContacts();
 
@@ -197,7 +324,7 @@ std::size_t orientedMeshCollide(const CollisionGeometry* o1, const Transform3f&
   const BVHModel<T_BVH>* obj2 = static_cast<const BVHModel<T_BVH>* >(o2);
 
   initialize(node, *obj1, tf1, *obj2, tf2, result);
-  collide(&node, request, result);
+  parallelCollide(node, request, result, front_list);
 
   return result.numContacts();
 }
@@ -205,7 +332,7 @@ std::size_t orientedMeshCollide(const CollisionGeometry* o1, const Transform3f&
 }
 
 template<typename T_BVH>
-std::size_t BVHCollide(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const CollisionRequest& request, CollisionResult& result)
+std::size_t BVHCollide(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const CollisionRequest& request, CollisionResult& result, BVHFrontList* front_list)
 {
   if(request.isSatisfied(result)) return result.numContacts();
   
@@ -217,8 +344,12 @@ std::size_t BVHCollide(const CollisionGeometry* o1, const Transform3f& tf1, cons
   BVHModel<T_BVH>* obj2_tmp = new BVHModel<T_BVH>(*obj2);
   Transform3f tf2_tmp = tf2;
   
-  initialize(node, *obj1_tmp, tf1_tmp, *obj2_tmp, tf2_tmp, result);
-  fcl::collide(&node, request, result);
+  // A front refers to nodes of the hierarchies: keep their topology by
+  // refitting the transformed copies instead of rebuilding them.
+  bool refit = (front_list != NULL);
+  initialize(node, *obj1_tmp, tf1_tmp, *obj2_tmp, tf2_tmp, result,
+             refit, refit);
+  parallelCollide(node, request, result, front_list);
 
   delete obj1_tmp;
   delete obj2_tmp;
@@ -227,22 +358,22 @@ std::size_t BVHCollide(const CollisionGeometry* o1, const Transform3f& tf1, cons
 }
 
 template<>
-std::size_t BVHCollide<OBB>(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const CollisionRequest& request, CollisionResult& result)
+std::size_t BVHCollide<OBB>(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const CollisionRequest& request, CollisionResult& result, BVHFrontList* front_list)
 {
-  return details::orientedMeshCollide<MeshCollisionTraversalNodeOBB, OBB>(o1, tf1, o2, tf2, request, result);
+  return details::orientedMeshCollide<MeshCollisionTraversalNodeOBB, OBB>(o1, tf1, o2, tf2, request, result, front_list);
 }
 
 template<>
-std::size_t BVHCollide<OBBRSS>(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const CollisionRequest& request, CollisionResult& result)
+std::size_t BVHCollide<OBBRSS>(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const CollisionRequest& request, CollisionResult& result, BVHFrontList* front_list)
 {
-  return details::orientedMeshCollide<MeshCollisionTraversalNodeOBBRSS, OBBRSS>(o1, tf1, o2, tf2, request, result);
+  return details::orientedMeshCollide<MeshCollisionTraversalNodeOBBRSS, OBBRSS>(o1, tf1, o2, tf2, request, result, front_list);
 }
 
 
 template<>
-std::size_t BVHCollide<kIOS>(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const CollisionRequest& request, CollisionResult& result)
+std::size_t BVHCollide<kIOS>(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const CollisionRequest& request, CollisionResult& result, BVHFrontList* front_list)
 {
-  return details::orientedMeshCollide<MeshCollisionTraversalNodekIOS, kIOS>(o1, tf1, o2, tf2, request, result);
+  return details::orientedMeshCollide<MeshCollisionTraversalNodekIOS, kIOS>(o1, tf1, o2, tf2, request, result, front_list);
 }
 
 
@@ -251,7 +382,7 @@ std::size_t BVHCollide(const CollisionGeometry* o1, const Transform3f& tf1, cons
                        const GJKSolver* /*nsolver*/,
                        const CollisionRequest& request, CollisionResult& result)
 {
-  return BVHCollide<T_BVH>(o1, tf1, o2, tf2, request, result);
+  return BVHCollide<T_BVH>(o1, tf1, o2, tf2, request, result, NULL);
 }
 
 
@@ -260,7 +391,10 @@ CollisionFunctionMatrix::CollisionFunctionMatrix()
   for(int i = 0; i < NODE_COUNT; ++i)
   {
     for(int j = 0; j < NODE_COUNT; ++j)
+    {
       collision_matrix[i][j] = NULL;
+      collision_front_matrix[i][j] = NULL;
+    }
   }
 
   collision_matrix[GEOM_BOX][GEOM_BOX] = &ShapeShapeCollide<Box, Box>;
@@ -416,6 +550,15 @@ CollisionFunctionMatrix::CollisionFunctionMatrix()
   collision_matrix[BV_kIOS][BV_kIOS] = &BVHCollide<kIOS>;
   collision_matrix[BV_OBBRSS][BV_OBBRSS] = &BVHCollide<OBBRSS>;
 
+  collision_front_matrix[BV_AABB][BV_AABB] = &BVHCollide<AABB>;
+  collision_front_matrix[BV_OBB][BV_OBB] = &BVHCollide<OBB>;
+  collision_front_matrix[BV_RSS][BV_RSS] = &BVHCollide<RSS>;
+  collision_front_matrix[BV_KDOP16][BV_KDOP16] = &BVHCollide<KDOP<16> >;
+  collision_front_matrix[BV_KDOP18][BV_KDOP18] = &BVHCollide<KDOP<18> >;
+  collision_front_matrix[BV_KDOP24][BV_KDOP24] = &BVHCollide<KDOP<24> >;
+  collision_front_matrix[BV_kIOS][BV_kIOS] = &BVHCollide<kIOS>;
+  collision_front_matrix[BV_OBBRSS][BV_OBBRSS] = &BVHCollide<OBBRSS>;
+
 #ifdef HPP_FCL_HAVE_OCTOMAP
   collision_matrix[GEOM_OCTREE][GEOM_BOX] = &Collide<OcTree, Box>;
   collision_matrix[GEOM_OCTREE][GEOM_SPHERE] = &Collide<OcTree, Sphere>;
@@ -455,6 +598,67 @@ CollisionFunctionMatrix::CollisionFunctionMatrix()
   collision_matrix[BV_KDOP18][GEOM_OCTREE] = &Collide<BVHModel<KDOP<18> >, OcTree>;
   collision_matrix[BV_KDOP24][GEOM_OCTREE] = &Collide<BVHModel<KDOP<24> >, OcTree>;
 #endif
+
+  collision_matrix[GEOM_LINEAR_OCTREE][GEOM_BOX] = &Collide<LinearOcTree, Box>;
+  collision_matrix[GEOM_LINEAR_OCTREE][GEOM_SPHERE] = &Collide<LinearOcTree, Sphere>;
+  collision_matrix[GEOM_LINEAR_OCTREE][GEOM_CAPSULE] = &Collide<LinearOcTree, Capsule>;
+  collision_matrix[GEOM_LINEAR_OCTREE][GEOM_CONE] = &Collide<LinearOcTree, Cone>;
+  collision_matrix[GEOM_LINEAR_OCTREE][GEOM_CYLINDER] = &Collide<LinearOcTree, Cylinder>;
+  collision_matrix[GEOM_LINEAR_OCTREE][GEOM_CONVEX] = &Collide<LinearOcTree, ConvexBase>;
+  collision_matrix[GEOM_LINEAR_OCTREE][GEOM_PLANE] = &Collide<LinearOcTree, Plane>;
+  collision_matrix[GEOM_LINEAR_OCTREE][GEOM_HALFSPACE] = &Collide<LinearOcTree, Halfspace>;
+
+  collision_matrix[GEOM_BOX][GEOM_LINEAR_OCTREE] = &Collide<Box, LinearOcTree>;
+  collision_matrix[GEOM_SPHERE][GEOM_LINEAR_OCTREE] = &Collide<Sphere, LinearOcTree>;
+  collision_matrix[GEOM_CAPSULE][GEOM_LINEAR_OCTREE] = &Collide<Capsule, LinearOcTree>;
+  collision_matrix[GEOM_CONE][GEOM_LINEAR_OCTREE] = &Collide<Cone, LinearOcTree>;
+  collision_matrix[GEOM_CYLINDER][GEOM_LINEAR_OCTREE] = &Collide<Cylinder, LinearOcTree>;
+  collision_matrix[GEOM_CONVEX][GEOM_LINEAR_OCTREE] = &Collide<ConvexBase, LinearOcTree>;
+  collision_matrix[GEOM_PLANE][GEOM_LINEAR_OCTREE] = &Collide<Plane, LinearOcTree>;
+  collision_matrix[GEOM_HALFSPACE][GEOM_LINEAR_OCTREE] = &Collide<Halfspace, LinearOcTree>;
+
+  collision_matrix[GEOM_LINEAR_OCTREE][GEOM_LINEAR_OCTREE] = &Collide<LinearOcTree, LinearOcTree>;
+
+  collision_matrix[GEOM_LINEAR_OCTREE][BV_AABB  ] = &Collide<LinearOcTree, BVHModel<AABB     > >;
+  collision_matrix[GEOM_LINEAR_OCTREE][BV_OBB   ] = &Collide<LinearOcTree, BVHModel<OBB      > >;
+  collision_matrix[GEOM_LINEAR_OCTREE][BV_RSS   ] = &Collide<LinearOcTree, BVHModel<RSS      > >;
+  collision_matrix[GEOM_LINEAR_OCTREE][BV_OBBRSS] = &Collide<LinearOcTree, BVHModel<OBBRSS   > >;
+  collision_matrix[GEOM_LINEAR_OCTREE][BV_kIOS  ] = &Collide<LinearOcTree, BVHModel<kIOS     > >;
+  collision_matrix[GEOM_LINEAR_OCTREE][BV_KDOP16] = &Collide<LinearOcTree, BVHModel<KDOP<16> > >;
+  collision_matrix[GEOM_LINEAR_OCTREE][BV_KDOP18] = &Collide<LinearOcTree, BVHModel<KDOP<18> > >;
+  collision_matrix[GEOM_LINEAR_OCTREE][BV_KDOP24] = &Collide<LinearOcTree, BVHModel<KDOP<24> > >;
+
+  collision_matrix[BV_AABB  ][GEOM_LINEAR_OCTREE] = &Collide<BVHModel<AABB     >, LinearOcTree>;
+  collision_matrix[BV_OBB   ][GEOM_LINEAR_OCTREE] = &Collide<BVHModel<OBB      >, LinearOcTree>;
+  collision_matrix[BV_RSS   ][GEOM_LINEAR_OCTREE] = &Collide<BVHModel<RSS      >, LinearOcTree>;
+  collision_matrix[BV_OBBRSS][GEOM_LINEAR_OCTREE] = &Collide<BVHModel<OBBRSS   >, LinearOcTree>;
+  collision_matrix[BV_kIOS  ][GEOM_LINEAR_OCTREE] = &Collide<BVHModel<kIOS     >, LinearOcTree>;
+  collision_matrix[BV_KDOP16][GEOM_LINEAR_OCTREE] = &Collide<BVHModel<KDOP<16> >, LinearOcTree>;
+  collision_matrix[BV_KDOP18][GEOM_LINEAR_OCTREE] = &Collide<BVHModel<KDOP<18> >, LinearOcTree>;
+  collision_matrix[BV_KDOP24][GEOM_LINEAR_OCTREE] = &Collide<BVHModel<KDOP<24> >, LinearOcTree>;
+
+  collision_matrix[GEOM_DISTANCE_FIELD][GEOM_SPHERE] = &DistanceFieldShapeCollide<Sphere, false>;
+  collision_matrix[GEOM_DISTANCE_FIELD][GEOM_CAPSULE] = &DistanceFieldShapeCollide<Capsule, false>;
+  collision_matrix[GEOM_SPHERE][GEOM_DISTANCE_FIELD] = &DistanceFieldShapeCollide<Sphere, true>;
+  collision_matrix[GEOM_CAPSULE][GEOM_DISTANCE_FIELD] = &DistanceFieldShapeCollide<Capsule, true>;
+
+  collision_matrix[GEOM_BOX_SET][GEOM_BOX] = &BoxSetShapeCollide<Box, false>;
+  collision_matrix[GEOM_BOX_SET][GEOM_SPHERE] = &BoxSetShapeCollide<Sphere, false>;
+  collision_matrix[GEOM_BOX_SET][GEOM_CAPSULE] = &BoxSetShapeCollide<Capsule, false>;
+  collision_matrix[GEOM_BOX_SET][GEOM_CONE] = &BoxSetShapeCollide<Cone, false>;
+  collision_matrix[GEOM_BOX_SET][GEOM_CYLINDER] = &BoxSetShapeCollide<Cylinder, false>;
+  collision_matrix[GEOM_BOX_SET][GEOM_CONVEX] = &BoxSetShapeCollide<ConvexBase, false>;
+  collision_matrix[GEOM_BOX_SET][GEOM_PLANE] = &BoxSetShapeCollide<Plane, false>;
+  collision_matrix[GEOM_BOX_SET][GEOM_HALFSPACE] = &BoxSetShapeCollide<Halfspace, false>;
+
+  collision_matrix[GEOM_BOX][GEOM_BOX_SET] = &BoxSetShapeCollide<Box, true>;
+  collision_matrix[GEOM_SPHERE][GEOM_BOX_SET] = &BoxSetShapeCollide<Sphere, true>;
+  collision_matrix[GEOM_CAPSULE][GEOM_BOX_SET] = &BoxSetShapeCollide<Capsule, true>;
+  collision_matrix[GEOM_CONE][GEOM_BOX_SET] = &BoxSetShapeCollide<Cone, true>;
+  collision_matrix[GEOM_CYLINDER][GEOM_BOX_SET] = &BoxSetShapeCollide<Cylinder, true>;
+  collision_matrix[GEOM_CONVEX][GEOM_BOX_SET] = &BoxSetShapeCollide<ConvexBase, true>;
+  collision_matrix[GEOM_PLANE][GEOM_BOX_SET] = &BoxSetShapeCollide<Plane, true>;
+  collision_matrix[GEOM_HALFSPACE][GEOM_BOX_SET] = &BoxSetShapeCollide<Halfspace, true>;
 }
 //template struct CollisionFunctionMatrix;
 }
@@ -49,6 +49,9 @@ void collide(CollisionTraversalNodeBase* node,
 	     BVHFrontList* front_list,
              bool recursive)
 {
+  node->budget.start(request);
+  if(request.enable_statistics && front_list)
+    result.statistics.num_front_nodes_reused += front_list->size();
   if(front_list && front_list->size() > 0)
   {
     propagateBVHFrontListCollisionRecurse(node, request, result, front_list);
@@ -62,18 +65,41 @@ void collide(CollisionTraversalNodeBase* node,
       collisionNonRecurse(node, front_list, sqrDistLowerBound);
     result.updateDistanceLowerBound (sqrt (sqrDistLowerBound));
   }
+  if(node->budget.isExhausted())
+  {
+    result.completed = false;
+    result.updateDistanceLowerBound (0);
+    // The front of an interrupted traversal is incomplete.
+    if(front_list) front_list->clear();
+  }
 }
 
 void distance(DistanceTraversalNodeBase* node, BVHFrontList* front_list, int qsize)
 {
+  DistanceTraversalWorkspace workspace;
+  distance(node, workspace, front_list, qsize);
+}
+
+void distance(DistanceTraversalNodeBase* node,
+              DistanceTraversalWorkspace& workspace,
+              BVHFrontList* front_list, int qsize)
+{
+  node->budget.start(node->request);
+  if(node->request.enable_statistics && front_list)
+    node->result->statistics.num_front_nodes_reused += front_list->size();
   node->preprocess();
   
-  if(qsize <= 2)
-    distanceRecurse(node, 0, 0, front_list);
+  if(front_list && front_list->size() > 0)
+    propagateBVHFrontListDistance(node, front_list, workspace);
+  else if(qsize <= 2 || front_list)
+    distanceNonRecurse(node, 0, 0, front_list, workspace);
   else
-    distanceQueueRecurse(node, 0, 0, front_list, qsize);
+    distanceQueueNonRecurse(node, 0, 0, front_list, qsize, workspace);
 
   node->postprocess();
+  node->finishTraversal();
+  // The front of an interrupted traversal is incomplete.
+  if(node->budget.isExhausted() && front_list) front_list->clear();
 }
 
 }
@@ -43,6 +43,8 @@
 #include <hpp/fcl/BVH/BVH_front.h>
 #include <hpp/fcl/internal/traversal_node_base.h>
 #include <hpp/fcl/internal/traversal_node_bvhs.h>
+#include <hpp/fcl/internal/traversal_recurse.h>
+#include <hpp/fcl/internal/traversal_parallel.h>
 
 /// @brief collision and distance function on traversal nodes. these functions provide a higher level abstraction for collision functions provided in collision_func_matrix
 namespace hpp
@@ -64,9 +66,182 @@ HPP_FCL_DLLAPI void collide(CollisionTraversalNodeBase* node, const CollisionReq
                             bool recursive = true);
 
 /// @brief distance computation on distance traversal node; can use front list to accelerate
+/// @param front_list if not empty, the traversal starts from this front
+///        instead of the roots. It is replaced by the front of the traversal.
+/// @param qsize size of the queue of the best first traversal. Not used when
+///        a front list is given, since the best first traversal does not
+///        build a complete front.
 /// \todo should be HPP_FCL_LOCAL but used in unit test.
 HPP_FCL_DLLAPI void distance(DistanceTraversalNodeBase* node,
                              BVHFrontList* front_list = NULL, int qsize = 2);
+
+/// @brief distance computation on distance traversal node, reusing the
+///        memory of a workspace owned by the caller.
+/// \todo should be HPP_FCL_LOCAL but used in unit test.
+HPP_FCL_DLLAPI void distance(DistanceTraversalNodeBase* node,
+                             DistanceTraversalWorkspace& workspace,
+                             BVHFrontList* front_list = NULL, int qsize = 2);
+
+namespace details
+{
+/// @brief Add the tests of a traversal node to QueryResult::statistics,
+///        when QueryRequest::enable_statistics is true.
+///
+/// The tests are counted from the construction, since the node may have
+/// been used by earlier traversals.
+/// \tparam TraversalNode a node with the num_bv_tests and num_leaf_tests
+///         counters.
+template<typename TraversalNode>
+struct TraversalStatistics
+{
+  TraversalNode& node;
+  QueryResult* result;
+  int num_bv_tests, num_leaf_tests;
+
+  TraversalStatistics(TraversalNode& n, const QueryRequest& request,
+                      QueryResult& r, const BVHFrontList* front_list)
+    : node(n), result(request.enable_statistics ? &r : NULL),
+      num_bv_tests(n.num_bv_tests), num_leaf_tests(n.num_leaf_tests)
+  {
+    if(!result) return;
+    node.enable_statistics = true;
+    if(front_list)
+      result->statistics.num_front_nodes_reused += front_list->size();
+  }
+
+  void finish() const
+  {
+    if(!result) return;
+    result->statistics.num_bv_tests +=
+      (size_t) (node.num_bv_tests - num_bv_tests);
+    result->statistics.num_leaf_tests +=
+      (size_t) (node.num_leaf_tests - num_leaf_tests);
+  }
+};
+} // namespace details
+
+/// @brief collision on collision traversal node, without virtual dispatch
+///        of the methods of the node during the traversal.
+/// \tparam TraversalNode the dynamic type of node.
+/// \sa collide
+template<typename TraversalNode>
+void staticCollide(TraversalNode& node, const CollisionRequest& request,
+                   CollisionResult& result, BVHFrontList* front_list = NULL,
+                   bool recursive = true)
+{
+  details::StaticDispatch<TraversalNode> dispatch (node);
+  details::TraversalStatistics<TraversalNode> statistics (node, request,
+                                                          result, front_list);
+  node.budget.start(request);
+  if(front_list && front_list->size() > 0)
+    details::propagateBVHFrontListCollisionRecurse(dispatch, result, front_list);
+  else
+  {
+    FCL_REAL sqrDistLowerBound=0;
+    if (recursive)
+      details::collisionRecurse(dispatch, 0, 0, front_list, sqrDistLowerBound);
+    else
+      details::collisionNonRecurse(dispatch, front_list, sqrDistLowerBound);
+    result.updateDistanceLowerBound (sqrt (sqrDistLowerBound));
+  }
+  if(node.budget.isExhausted())
+  {
+    result.completed = false;
+    result.updateDistanceLowerBound (0);
+    // The front of an interrupted traversal is incomplete.
+    if(front_list) front_list->clear();
+  }
+  statistics.finish();
+}
+
+/// @brief distance computation on distance traversal node, without virtual
+///        dispatch of the methods of the node during the traversal.
+/// \tparam TraversalNode the dynamic type of node.
+/// \sa distance
+template<typename TraversalNode>
+void staticDistance(TraversalNode& node, DistanceTraversalWorkspace& workspace,
+                    BVHFrontList* front_list = NULL, int qsize = 2)
+{
+  details::StaticDispatch<TraversalNode> dispatch (node);
+  details::TraversalStatistics<TraversalNode> statistics (
+      node, node.request, *node.result, front_list);
+  node.budget.start(node.request);
+  node.preprocess();
+  if(front_list && front_list->size() > 0)
+    details::propagateBVHFrontListDistance(dispatch, front_list, workspace);
+  else if(qsize <= 2 || front_list)
+    details::distanceNonRecurse(dispatch, 0, 0, front_list, workspace);
+  else
+    details::distanceQueueNonRecurse(dispatch, 0, 0, front_list, qsize,
+                                     workspace);
+  node.postprocess();
+  node.finishTraversal();
+  // The front of an interrupted traversal is incomplete.
+  if(node.budget.isExhausted() && front_list) front_list->clear();
+  statistics.finish();
+}
+
+/// @brief distance computation on distance traversal node, without virtual
+///        dispatch of the methods of the node during the traversal.
+/// \tparam TraversalNode the dynamic type of node.
+/// \sa distance
+template<typename TraversalNode>
+void staticDistance(TraversalNode& node, BVHFrontList* front_list = NULL,
+                    int qsize = 2)
+{
+  DistanceTraversalWorkspace workspace;
+  staticDistance(node, workspace, front_list, qsize);
+}
+
+/// @brief collision between two hierarchies with request.num_threads
+///        threads. Falls back to staticCollide with a single thread, when
+///        a front list is used or when the request has a budget.
+/// \tparam TraversalNode the dynamic type of node.
+/// \sa details::collisionParallel
+template<typename TraversalNode>
+void parallelCollide(TraversalNode& node, const CollisionRequest& request,
+                     CollisionResult& result, BVHFrontList* front_list = NULL)
+{
+  if(request.num_threads == 1 || front_list || request.hasBudget())
+    staticCollide(node, request, result, front_list);
+  else
+  {
+    details::TraversalStatistics<TraversalNode> statistics (node, request,
+                                                            result, NULL);
+    details::collisionParallel(node, request, result, request.num_threads);
+    statistics.finish();
+  }
+}
+
+/// @brief distance between two hierarchies with request.num_threads
+///        threads. Falls back to staticDistance with a single thread, when
+///        a front list is used, when closest pairs are requested or when the
+///        request has a budget.
+/// @param workspace the memory reused by the single thread traversal, if not
+///        NULL.
+/// \tparam TraversalNode the dynamic type of node.
+/// \sa details::distanceParallel
+template<typename TraversalNode>
+void parallelDistance(TraversalNode& node, const DistanceRequest& request,
+                      BVHFrontList* front_list = NULL,
+                      DistanceTraversalWorkspace* workspace = NULL)
+{
+  if(request.num_threads == 1 || front_list || request.num_closest_pairs > 0
+     || request.hasBudget())
+  {
+    if(workspace)
+      staticDistance(node, *workspace, front_list);
+    else
+      staticDistance(node, front_list);
+  }
+  else
+  {
+    details::TraversalStatistics<TraversalNode> statistics (
+        node, request, *node.result, NULL);
+    details::distanceParallel(node, request.num_threads);
+    statistics.finish();
+  }
+}
 }
 
 } // namespace hpp
@@ -38,6 +38,8 @@
 #include <hpp/fcl/distance.h>
 #include <hpp/fcl/distance_func_matrix.h>
 #include <hpp/fcl/narrowphase/narrowphase.h>
+#include <hpp/fcl/internal/traversal_recurse.h>
+#include <hpp/fcl/profile.h>
 
 #include <iostream>
 
@@ -64,7 +66,12 @@ FCL_REAL distance(const CollisionGeometry* o1, const Transform3f& tf1,
                   const CollisionGeometry* o2, const Transform3f& tf2,
                   const DistanceRequest& request, DistanceResult& result)
 {
+  time::point start;
   GJKSolver solver;
+  if (request.enable_statistics) {
+    start = time::now();
+    solver.statistics = &result.statistics;
+  }
   solver.enable_cached_guess = request.enable_cached_gjk_guess;
   if (solver.enable_cached_guess) {
     solver.cached_guess = request.cached_gjk_guess;
@@ -115,13 +122,20 @@ FCL_REAL distance(const CollisionGeometry* o1, const Transform3f& tf1,
     result.cached_gjk_guess = solver.cached_guess;
     result.cached_support_func_guess = solver.support_func_cached_guess;
   }
+  // Narrow phase queries are not interrupted: their result is a lower bound.
+  result.distance_lower_bound = std::min(result.distance_lower_bound,
+                                         result.min_distance);
+  if (request.enable_statistics)
+    result.statistics.time +=
+      (FCL_REAL) (time::now() - start).total_microseconds();
 
   return res;
 }
 
 ComputeDistance::ComputeDistance(const CollisionGeometry* o1,
     const CollisionGeometry* o2)
-  : o1(o1), o2(o2)
+  : o1(o1), o2(o2), front_list_enabled(false),
+    workspace(new DistanceTraversalWorkspace)
 {
   const DistanceFunctionMatrix& looktable = getDistanceFunctionLookTable();
 
@@ -144,6 +158,36 @@ ComputeDistance::ComputeDistance(const CollisionGeometry* o1,
     func = looktable.distance_matrix[node_type2][node_type1];
   else
     func = looktable.distance_matrix[node_type1][node_type2];
+
+  if (swap_geoms)
+    front_func = NULL;
+  else
+    front_func = looktable.distance_front_matrix[node_type1][node_type2];
+}
+
+ComputeDistance::ComputeDistance(const ComputeDistance& other)
+  : o1(other.o1), o2(other.o2), solver(other.solver), func(other.func),
+    swap_geoms(other.swap_geoms), front_func(other.front_func),
+    front_list_enabled(other.front_list_enabled), front_list(other.front_list),
+    workspace(new DistanceTraversalWorkspace)
+{}
+
+ComputeDistance& ComputeDistance::operator=(const ComputeDistance& other)
+{
+  o1 = other.o1;
+  o2 = other.o2;
+  solver = other.solver;
+  func = other.func;
+  swap_geoms = other.swap_geoms;
+  front_func = other.front_func;
+  front_list_enabled = other.front_list_enabled;
+  front_list = other.front_list;
+  return *this;
+}
+
+ComputeDistance::~ComputeDistance()
+{
+  delete workspace;
 }
 
 } // namespace fcl
@@ -0,0 +1,341 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <hpp/fcl/distance_field.h>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace hpp
+{
+namespace fcl
+{
+
+namespace details
+{
+
+/// @brief Squared distance of the sites which are too far to matter. It
+///        stays finite so that the lower envelope below is well defined.
+static const FCL_REAL farSquaredDistance = 1e20;
+
+/// @brief One dimensional squared Euclidean distance transform of the n
+///        values of f starting at first, with a stride.
+///
+/// This is the lower envelope of parabolas algorithm of Felzenszwalb and
+/// Huttenlocher, linear in n.
+static void distanceTransform(std::vector<FCL_REAL>& f, std::size_t first,
+                              std::size_t n, std::size_t stride,
+                              std::vector<FCL_REAL>& g,
+                              std::vector<std::size_t>& v,
+                              std::vector<FCL_REAL>& z)
+{
+  g.resize(n);
+  v.resize(n);
+  z.resize(n + 1);
+  for(std::size_t q = 0; q < n; ++q)
+    g[q] = f[first + q * stride];
+
+  std::size_t k = 0;
+  v[0] = 0;
+  z[0] = -std::numeric_limits<FCL_REAL>::infinity();
+  z[1] = std::numeric_limits<FCL_REAL>::infinity();
+  for(std::size_t q = 1; q < n; ++q)
+  {
+    FCL_REAL s;
+    while(true)
+    {
+      const FCL_REAL p = (FCL_REAL) v[k];
+      s = ((g[q] + (FCL_REAL) (q * q)) - (g[v[k]] + p * p))
+        / (2 * ((FCL_REAL) q - p));
+      if(s > z[k]) break;
+      --k;
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = std::numeric_limits<FCL_REAL>::infinity();
+  }
+
+  k = 0;
+  for(std::size_t q = 0; q < n; ++q)
+  {
+    while(z[k + 1] < (FCL_REAL) q) ++k;
+    const FCL_REAL d = (FCL_REAL) q - (FCL_REAL) v[k];
+    f[first + q * stride] = d * d + g[v[k]];
+  }
+}
+
+} // namespace details
+
+void DistanceField::init(FCL_REAL resolution_, const AABB& bounds,
+                         FCL_REAL max_distance_)
+{
+  if(resolution_ <= 0)
+    throw std::invalid_argument("The resolution of a DistanceField must be "
+                                "positive.");
+  if(max_distance_ <= 0)
+    throw std::invalid_argument("The maximal distance of a DistanceField must "
+                                "be positive.");
+  resolution = resolution_;
+  max_distance = max_distance_;
+  origin = bounds.min_;
+  std::size_t n = 1;
+  for(int a = 0; a < 3; ++a)
+  {
+    FCL_REAL w = (bounds.max_[a] - bounds.min_[a]) / resolution;
+    size[a] = std::max((std::size_t) std::ceil(w - 1e-6), std::size_t(2));
+    n *= size[a];
+  }
+  values.assign(n, (float) max_distance);
+  occupied.assign(n, 0);
+}
+
+bool DistanceField::voxelRange(const AABB& box, std::size_t imin[3],
+                               std::size_t imax[3]) const
+{
+  // A small tolerance keeps the cells of an octree aligned with the grid
+  // from overlapping their neighbours.
+  const FCL_REAL eps = 1e-6;
+  for(int a = 0; a < 3; ++a)
+  {
+    FCL_REAL lo = std::floor((box.min_[a] - origin[a]) / resolution + eps);
+    FCL_REAL hi = std::ceil((box.max_[a] - origin[a]) / resolution - eps) - 1;
+    hi = std::max(lo, hi);
+    if(hi < 0 || lo > (FCL_REAL) (size[a] - 1)) return false;
+    imin[a] = (std::size_t) std::max(lo, (FCL_REAL) 0);
+    imax[a] = (std::size_t) std::min(hi, (FCL_REAL) (size[a] - 1));
+  }
+  return true;
+}
+
+void DistanceField::computeDistances(const std::size_t imin[3],
+                                     const std::size_t imax[3])
+{
+  // The distances of the voxels at less than max_distance from [imin, imax]
+  // may change. They only depend on the voxels at less than max_distance
+  // from them.
+  const std::size_t r = (std::size_t) std::ceil(max_distance / resolution) + 1;
+  std::size_t omin[3], omax[3], smin[3], smax[3], m[3];
+  for(int a = 0; a < 3; ++a)
+  {
+    omin[a] = imin[a] > r ? imin[a] - r : 0;
+    omax[a] = std::min(imax[a] + r, size[a] - 1);
+    smin[a] = omin[a] > r ? omin[a] - r : 0;
+    smax[a] = std::min(omax[a] + r, size[a] - 1);
+    m[a] = smax[a] - smin[a] + 1;
+  }
+
+  std::vector<FCL_REAL> f (m[0] * m[1] * m[2]);
+  std::vector<FCL_REAL> g, z;
+  std::vector<std::size_t> v;
+
+  // Distance to the occupied voxels for the free voxels, then distance to
+  // the free voxels for the occupied voxels.
+  for(int inside = 0; inside < 2; ++inside)
+  {
+    for(std::size_t k = 0; k < m[2]; ++k)
+      for(std::size_t j = 0; j < m[1]; ++j)
+        for(std::size_t i = 0; i < m[0]; ++i)
+        {
+          bool site = (occupied[index(smin[0] + i, smin[1] + j, smin[2] + k)] != 0)
+            != (inside == 1);
+          f[i + m[0] * (j + m[1] * k)] = site ? 0 : details::farSquaredDistance;
+        }
+
+    for(std::size_t k = 0; k < m[2]; ++k)
+      for(std::size_t j = 0; j < m[1]; ++j)
+        details::distanceTransform(f, m[0] * (j + m[1] * k), m[0], 1, g, v, z);
+    for(std::size_t k = 0; k < m[2]; ++k)
+      for(std::size_t i = 0; i < m[0]; ++i)
+        details::distanceTransform(f, i + m[0] * m[1] * k, m[1], m[0], g, v, z);
+    for(std::size_t j = 0; j < m[1]; ++j)
+      for(std::size_t i = 0; i < m[0]; ++i)
+        details::distanceTransform(f, i + m[0] * j, m[2], m[0] * m[1], g, v, z);
+
+    // The boundary of the obstacles is half a voxel from the centers of the
+    // voxels on both sides.
+    for(std::size_t k = omin[2]; k <= omax[2]; ++k)
+      for(std::size_t j = omin[1]; j <= omax[1]; ++j)
+        for(std::size_t i = omin[0]; i <= omax[0]; ++i)
+        {
+          std::size_t id = index(i, j, k);
+          if((occupied[id] != 0) != (inside == 1)) continue;
+          FCL_REAL d2 = f[(i - smin[0]) + m[0] * ((j - smin[1]) + m[1] * (k - smin[2]))];
+          FCL_REAL d = (std::sqrt(d2) - 0.5) * resolution;
+          values[id] = (float) (inside ? -std::min(d, max_distance)
+                                       :  std::min(d, max_distance));
+        }
+  }
+}
+
+FCL_REAL DistanceField::distance(const Vec3f& p, Vec3f* gradient) const
+{
+  std::size_t i[3];
+  FCL_REAL t[3];
+  bool inside[3];
+  for(int a = 0; a < 3; ++a)
+  {
+    // Coordinate of p in the grid of the voxel centers.
+    FCL_REAL x = (p[a] - origin[a]) / resolution - 0.5;
+    inside[a] = (x > 0 && x < (FCL_REAL) (size[a] - 1));
+    x = std::min(std::max(x, (FCL_REAL) 0), (FCL_REAL) (size[a] - 1));
+    i[a] = std::min((std::size_t) x, size[a] - 2);
+    t[a] = x - (FCL_REAL) i[a];
+  }
+
+  const std::size_t dj = size[0], dk = size[0] * size[1];
+  const std::size_t id = index(i[0], i[1], i[2]);
+  const FCL_REAL
+    c000 = values[id          ], c100 = values[id + 1          ],
+    c010 = values[id + dj     ], c110 = values[id + 1 + dj     ],
+    c001 = values[id      + dk], c101 = values[id + 1      + dk],
+    c011 = values[id + dj + dk], c111 = values[id + 1 + dj + dk];
+
+  const FCL_REAL
+    c00 = c000 + t[0] * (c100 - c000), c10 = c010 + t[0] * (c110 - c010),
+    c01 = c001 + t[0] * (c101 - c001), c11 = c011 + t[0] * (c111 - c011),
+    c0 = c00 + t[1] * (c10 - c00), c1 = c01 + t[1] * (c11 - c01);
+
+  if(gradient)
+  {
+    const FCL_REAL
+      dx0 = (c100 - c000) + t[1] * ((c110 - c010) - (c100 - c000)),
+      dx1 = (c101 - c001) + t[1] * ((c111 - c011) - (c101 - c001));
+    (*gradient)[0] = (dx0 + t[2] * (dx1 - dx0)) / resolution;
+    (*gradient)[1] = ((c10 - c00) + t[2] * ((c11 - c01) - (c10 - c00))) / resolution;
+    (*gradient)[2] = (c1 - c0) / resolution;
+    // The distance is constant along the axes where p is out of the grid.
+    for(int a = 0; a < 3; ++a)
+      if(!inside[a]) (*gradient)[a] = 0;
+  }
+  return c0 + t[2] * (c1 - c0);
+}
+
+FCL_REAL DistanceField::capsuleDistance(const Vec3f& a, const Vec3f& b,
+                                        FCL_REAL radius, Vec3f* gradient,
+                                        Vec3f* nearest) const
+{
+  const FCL_REAL length = (b - a).norm();
+  // The tolerance makes the samples independent of rounding errors on the
+  // length.
+  const std::size_t n = (std::size_t) std::ceil(2 * length / resolution - 1e-6);
+  FCL_REAL best = std::numeric_limits<FCL_REAL>::max();
+  FCL_REAL best_t = 0;
+  for(std::size_t k = 0; k <= n; ++k)
+  {
+    FCL_REAL t = (n == 0) ? 0 : (FCL_REAL) k / (FCL_REAL) n;
+    FCL_REAL d = distance(a + t * (b - a));
+    if(d < best) { best = d; best_t = t; }
+  }
+  const Vec3f p (a + best_t * (b - a));
+  if(gradient) distance(p, gradient);
+  if(nearest) *nearest = p;
+  return best - radius;
+}
+
+void DistanceField::sphereDistances(const std::vector<Vec3f>& centers,
+                                    const std::vector<FCL_REAL>& radii,
+                                    std::vector<FCL_REAL>& distances,
+                                    std::vector<Vec3f>* gradients) const
+{
+  distances.resize(centers.size());
+  if(gradients) gradients->resize(centers.size());
+  for(std::size_t i = 0; i < centers.size(); ++i)
+    distances[i] = sphereDistance(centers[i], radii[i],
+                                  gradients ? &(*gradients)[i] : NULL);
+}
+
+void DistanceField::capsuleDistances(const std::vector<Vec3f>& a,
+                                     const std::vector<Vec3f>& b,
+                                     const std::vector<FCL_REAL>& radii,
+                                     std::vector<FCL_REAL>& distances,
+                                     std::vector<Vec3f>* gradients) const
+{
+  distances.resize(a.size());
+  if(gradients) gradients->resize(a.size());
+  for(std::size_t i = 0; i < a.size(); ++i)
+    distances[i] = capsuleDistance(a[i], b[i], radii[i],
+                                   gradients ? &(*gradients)[i] : NULL);
+}
+
+namespace details
+{
+
+/// @brief Nearest points and normal of a sphere of center c and radius r
+///        at distance d of the obstacles, given the gradient at c.
+static void nearestPoints(const Vec3f& c, FCL_REAL r, FCL_REAL d,
+                          const Vec3f& gradient,
+                          Vec3f& p1, Vec3f& p2, Vec3f& normal)
+{
+  FCL_REAL norm = gradient.norm();
+  if(norm > 0)
+    normal = gradient / norm;
+  else
+    normal = Vec3f(0, 0, 1);
+  p2 = c - r * normal;
+  p1 = p2 - d * normal;
+}
+
+} // namespace details
+
+FCL_REAL DistanceField::shapeDistance(const Sphere& s, const Transform3f& tf,
+                                      Vec3f& p1, Vec3f& p2, Vec3f& normal,
+                                      bool* truncated) const
+{
+  Vec3f gradient;
+  const Vec3f& c = tf.getTranslation();
+  FCL_REAL d = distance(c, &gradient);
+  if(truncated) *truncated = isTruncated(d);
+  d -= s.radius;
+  details::nearestPoints(c, s.radius, d, gradient, p1, p2, normal);
+  return d;
+}
+
+FCL_REAL DistanceField::shapeDistance(const Capsule& s, const Transform3f& tf,
+                                      Vec3f& p1, Vec3f& p2, Vec3f& normal,
+                                      bool* truncated) const
+{
+  Vec3f gradient, c;
+  const Vec3f u (s.halfLength * tf.getRotation().col(2));
+  FCL_REAL d = capsuleDistance(tf.getTranslation() - u, tf.getTranslation() + u,
+                               s.radius, &gradient, &c);
+  if(truncated) *truncated = isTruncated(distance(c));
+  details::nearestPoints(c, s.radius, d, gradient, p1, p2, normal);
+  return d;
+}
+
+}
+
+} // namespace hpp
@@ -40,6 +40,8 @@
 #include <../src/collision_node.h>
 #include <../src/distance_func_matrix.h>
 #include <hpp/fcl/internal/traversal_node_setup.h>
+#include <hpp/fcl/distance_field.h>
+#include <hpp/fcl/box_set.h>
 #include <../src/traits_traversal.h>
 
 namespace hpp
@@ -47,13 +49,32 @@ namespace hpp
 namespace fcl
 {
 
-#ifdef HPP_FCL_HAVE_OCTOMAP
-
 template<typename TypeA, typename TypeB>
 FCL_REAL Distance(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const GJKSolver* nsolver,
                              const DistanceRequest& request, DistanceResult& result)
 {
   if(request.isSatisfied(result)) return result.min_distance;
+
+  if(request.octree_refine && request.hasOcTreeMaxDepth())
+  {
+    // The distance of the coarse query is a lower bound of the distance.
+    // The query at full depth is only needed below octree_refine_distance.
+    DistanceRequest coarse_request (request);
+    coarse_request.octree_refine = false;
+    DistanceResult coarse_result;
+    Distance<TypeA, TypeB>(o1, tf1, o2, tf2, nsolver, coarse_request, coarse_result);
+    if(coarse_result.min_distance > request.octree_refine_distance)
+    {
+      result.update(coarse_result);
+      return result.min_distance;
+    }
+
+    DistanceRequest fine_request (request);
+    fine_request.octree_refine = false;
+    fine_request.octree_max_depth = DistanceRequest().octree_max_depth;
+    return Distance<TypeA, TypeB>(o1, tf1, o2, tf2, nsolver, fine_request, result);
+  }
+
   typename TraversalTraitsDistance<TypeA, TypeB>::CollisionTraversal_t node;
   const TypeA* obj1 = static_cast<const TypeA*>(o1);
   const TypeB* obj2 = static_cast<const TypeB*>(o2);
@@ -65,8 +86,6 @@ FCL_REAL Distance(const CollisionGeometry* o1, const Transform3f& tf1, const Col
   return result.min_distance;
 }
 
-#endif
-
 template<typename T_SH1, typename T_SH2>
  FCL_REAL ShapeShapeDistance(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const GJKSolver* nsolver,
                         const DistanceRequest& request, DistanceResult& result)
@@ -82,6 +101,107 @@ template<typename T_SH1, typename T_SH2>
   return result.min_distance;
 }
 
+/// @brief Distance between a distance field and a sphere or a capsule.
+///
+/// When the distance of the field is truncated, the shape is only known to be
+/// at least at the maximal distance minus its radius of the obstacles: this
+/// bound goes to DistanceResult::distance_lower_bound.
+/// \tparam ShapeFirst whether the shape is the first object.
+template<typename T_SH, bool ShapeFirst>
+FCL_REAL DistanceFieldShapeDistance(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const GJKSolver*,
+                                    const DistanceRequest& request, DistanceResult& result)
+{
+  if(request.isSatisfied(result)) return result.min_distance;
+  const DistanceField* field = static_cast<const DistanceField*>(ShapeFirst ? o2 : o1);
+  const T_SH* shape = static_cast<const T_SH*>(ShapeFirst ? o1 : o2);
+  const Transform3f& tf_field = ShapeFirst ? tf2 : tf1;
+  const Transform3f& tf_shape = ShapeFirst ? tf1 : tf2;
+
+  Vec3f p1, p2, normal;
+  bool truncated;
+  FCL_REAL distance = field->shapeDistance
+    (*shape, tf_field.inverseTimes(tf_shape), p1, p2, normal, &truncated);
+  if(truncated)
+  {
+    result.distance_lower_bound = (std::min)(result.distance_lower_bound,
+        field->getMaxDistance() - shape->radius);
+    return result.min_distance;
+  }
+  p1 = tf_field.transform(p1);
+  p2 = tf_field.transform(p2);
+  normal = tf_field.getRotation() * normal;
+  if(ShapeFirst)
+    result.update(distance, o1, o2, DistanceResult::NONE, DistanceResult::NONE,
+                  p2, p1, -normal);
+  else
+    result.update(distance, o1, o2, DistanceResult::NONE, DistanceResult::NONE,
+                  p1, p2, normal);
+  return result.min_distance;
+}
+
+/// @brief Distance between a set of boxes and a shape.
+///
+/// The hierarchy is traversed depth first, the nearest child first, and the
+/// nodes whose distance to the bounding box of the shape is not below the
+/// best distance are pruned. The boxes of the leaves are tested with
+/// ShapeShapeDistance.
+/// \tparam ShapeFirst whether the shape is the first object.
+template<typename T_SH, bool ShapeFirst>
+FCL_REAL BoxSetShapeDistance(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2, const GJKSolver* nsolver,
+                             const DistanceRequest& request, DistanceResult& result)
+{
+  if(request.isSatisfied(result)) return result.min_distance;
+
+  const BoxSet* set = static_cast<const BoxSet*>(ShapeFirst ? o2 : o1);
+  const T_SH* shape = static_cast<const T_SH*>(ShapeFirst ? o1 : o2);
+  const Transform3f& tf_set = ShapeFirst ? tf2 : tf1;
+  const Transform3f& tf_shape = ShapeFirst ? tf1 : tf2;
+  const std::vector<BoxSet::Node>& nodes = set->getNodes();
+  if(nodes.empty()) return result.min_distance;
+
+  AABB aabb;
+  computeBV<AABB, T_SH>(*shape, tf_set.inverseTimes(tf_shape), aabb);
+
+  std::vector<int> stack (1, 0);
+  while(!stack.empty() && result.min_distance > 0)
+  {
+    const BoxSet::Node& node = nodes[stack.back()];
+    stack.pop_back();
+    if(node.bv.distance(aabb) >= result.min_distance) continue;
+    if(!node.isLeaf())
+    {
+      int first = node.first_child, second = node.first_child + 1;
+      if(nodes[first].bv.distance(aabb) > nodes[second].bv.distance(aabb))
+        std::swap(first, second);
+      stack.push_back(second);
+      stack.push_back(first);
+      continue;
+    }
+
+    const AABB& bv = set->getBoxes()[node.box];
+    Box box (bv.max_ - bv.min_);
+    Transform3f box_tf (tf_set * Transform3f(bv.center()));
+    DistanceResult box_result;
+    if(ShapeFirst)
+    {
+      ShapeShapeDistance<T_SH, Box>(shape, tf_shape, &box, box_tf, nsolver,
+                                    request, box_result);
+      result.update(box_result.min_distance, o1, o2, DistanceResult::NONE,
+                    node.box, box_result.nearest_points[0],
+                    box_result.nearest_points[1], box_result.normal);
+    }
+    else
+    {
+      ShapeShapeDistance<Box, T_SH>(&box, box_tf, shape, tf_shape, nsolver,
+                                    request, box_result);
+      result.update(box_result.min_distance, o1, o2, node.box,
+                    DistanceResult::NONE, box_result.nearest_points[0],
+                    box_result.nearest_points[1], box_result.normal);
+    }
+  }
+  return result.min_distance;
+}
+
 template<typename T_BVH, typename T_SH>
 struct HPP_FCL_LOCAL BVHShapeDistancer
 {
@@ -96,7 +216,7 @@ struct HPP_FCL_LOCAL BVHShapeDistancer
     const T_SH* obj2 = static_cast<const T_SH*>(o2);
 
     initialize(node, *obj1_tmp, tf1_tmp, *obj2, tf2, nsolver, request, result);
-    fcl::distance(&node);
+    staticDistance(node);
     
     delete obj1_tmp;
     return result.min_distance;
@@ -116,7 +236,7 @@ FCL_REAL orientedBVHShapeDistance(const CollisionGeometry* o1, const Transform3f
   const T_SH* obj2 = static_cast<const T_SH*>(o2);
 
   initialize(node, *obj1, tf1, *obj2, tf2, nsolver, request, result);
-  fcl::distance(&node);
+  staticDistance(node);
 
   return result.min_distance;  
 }
@@ -157,7 +277,9 @@ struct HPP_FCL_LOCAL BVHShapeDistancer<OBBRSS, T_SH>
 
 template<typename T_BVH>
 FCL_REAL BVHDistance(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2,
-                     const DistanceRequest& request, DistanceResult& result)
+                     const DistanceRequest& request, DistanceResult& result,
+                     BVHFrontList* front_list,
+                     DistanceTraversalWorkspace* workspace)
 {
   if(request.isSatisfied(result)) return result.min_distance;
   MeshDistanceTraversalNode<T_BVH> node;
@@ -168,8 +290,12 @@ FCL_REAL BVHDistance(const CollisionGeometry* o1, const Transform3f& tf1, const
   BVHModel<T_BVH>* obj2_tmp = new BVHModel<T_BVH>(*obj2);
   Transform3f tf2_tmp = tf2;
 
-  initialize(node, *obj1_tmp, tf1_tmp, *obj2_tmp, tf2_tmp, request, result);
-  distance(&node);
+  // A front refers to nodes of the hierarchies: keep their topology by
+  // refitting the transformed copies instead of rebuilding them.
+  bool refit = (front_list != NULL);
+  initialize(node, *obj1_tmp, tf1_tmp, *obj2_tmp, tf2_tmp, request, result,
+             refit, refit);
+  parallelDistance(node, request, front_list, workspace);
   delete obj1_tmp;
   delete obj2_tmp;
   
@@ -180,7 +306,9 @@ namespace details
 {
 template<typename OrientedMeshDistanceTraversalNode, typename T_BVH>
 FCL_REAL orientedMeshDistance(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2,
-                              const DistanceRequest& request, DistanceResult& result)
+                              const DistanceRequest& request, DistanceResult& result,
+                              BVHFrontList* front_list,
+                              DistanceTraversalWorkspace* workspace)
 {
   if(request.isSatisfied(result)) return result.min_distance;
   OrientedMeshDistanceTraversalNode node;
@@ -188,7 +316,7 @@ FCL_REAL orientedMeshDistance(const CollisionGeometry* o1, const Transform3f& tf
   const BVHModel<T_BVH>* obj2 = static_cast<const BVHModel<T_BVH>* >(o2);
 
   initialize(node, *obj1, tf1, *obj2, tf2, request, result);
-  distance(&node);
+  parallelDistance(node, request, front_list, workspace);
 
   return result.min_distance;
 }
@@ -197,24 +325,30 @@ FCL_REAL orientedMeshDistance(const CollisionGeometry* o1, const Transform3f& tf
 
 template<>
 FCL_REAL BVHDistance<RSS>(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2,
-                          const DistanceRequest& request, DistanceResult& result)
+                          const DistanceRequest& request, DistanceResult& result,
+                          BVHFrontList* front_list,
+                          DistanceTraversalWorkspace* workspace)
 {
-  return details::orientedMeshDistance<MeshDistanceTraversalNodeRSS, RSS>(o1, tf1, o2, tf2, request, result);
+  return details::orientedMeshDistance<MeshDistanceTraversalNodeRSS, RSS>(o1, tf1, o2, tf2, request, result, front_list, workspace);
 }
 
 template<>
 FCL_REAL BVHDistance<kIOS>(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2,
-                           const DistanceRequest& request, DistanceResult& result)
+                           const DistanceRequest& request, DistanceResult& result,
+                           BVHFrontList* front_list,
+                           DistanceTraversalWorkspace* workspace)
 {
-  return details::orientedMeshDistance<MeshDistanceTraversalNodekIOS, kIOS>(o1, tf1, o2, tf2, request, result);
+  return details::orientedMeshDistance<MeshDistanceTraversalNodekIOS, kIOS>(o1, tf1, o2, tf2, request, result, front_list, workspace);
 }
 
 
 template<>
 FCL_REAL BVHDistance<OBBRSS>(const CollisionGeometry* o1, const Transform3f& tf1, const CollisionGeometry* o2, const Transform3f& tf2,
-                             const DistanceRequest& request, DistanceResult& result)
+                             const DistanceRequest& request, DistanceResult& result,
+                             BVHFrontList* front_list,
+                             DistanceTraversalWorkspace* workspace)
 {
-  return details::orientedMeshDistance<MeshDistanceTraversalNodeOBBRSS, OBBRSS>(o1, tf1, o2, tf2, request, result);
+  return details::orientedMeshDistance<MeshDistanceTraversalNodeOBBRSS, OBBRSS>(o1, tf1, o2, tf2, request, result, front_list, workspace);
 }
 
 
@@ -223,7 +357,7 @@ FCL_REAL BVHDistance(const CollisionGeometry* o1, const Transform3f& tf1, const
                      const GJKSolver* /*nsolver*/,
                      const DistanceRequest& request, DistanceResult& result)
 {
-  return BVHDistance<T_BVH>(o1, tf1, o2, tf2, request, result);
+  return BVHDistance<T_BVH>(o1, tf1, o2, tf2, request, result, NULL, NULL);
 }
 
 DistanceFunctionMatrix::DistanceFunctionMatrix()
@@ -231,7 +365,10 @@ DistanceFunctionMatrix::DistanceFunctionMatrix()
   for(int i = 0; i < NODE_COUNT; ++i)
   {
     for(int j = 0; j < NODE_COUNT; ++j)
+    {
       distance_matrix[i][j] = NULL;
+      distance_front_matrix[i][j] = NULL;
+    }
   }
 
   distance_matrix[GEOM_BOX][GEOM_BOX] = &ShapeShapeDistance<Box, Box>;
@@ -390,6 +527,12 @@ DistanceFunctionMatrix::DistanceFunctionMatrix()
   distance_matrix[BV_kIOS][BV_kIOS] = &BVHDistance<kIOS>;
   distance_matrix[BV_OBBRSS][BV_OBBRSS] = &BVHDistance<OBBRSS>;
 
+  distance_front_matrix[BV_AABB][BV_AABB] = &BVHDistance<AABB>;
+  distance_front_matrix[BV_OBB][BV_OBB] = &BVHDistance<OBB>;
+  distance_front_matrix[BV_RSS][BV_RSS] = &BVHDistance<RSS>;
+  distance_front_matrix[BV_kIOS][BV_kIOS] = &BVHDistance<kIOS>;
+  distance_front_matrix[BV_OBBRSS][BV_OBBRSS] = &BVHDistance<OBBRSS>;
+
 #ifdef HPP_FCL_HAVE_OCTOMAP
   distance_matrix[GEOM_OCTREE][GEOM_BOX] = &Distance<OcTree, Box>;
   distance_matrix[GEOM_OCTREE][GEOM_SPHERE] = &Distance<OcTree, Sphere>;
@@ -430,7 +573,66 @@ DistanceFunctionMatrix::DistanceFunctionMatrix()
   distance_matrix[BV_KDOP24][GEOM_OCTREE] = &Distance<BVHModel<KDOP<24> >, OcTree>;
 #endif
 
-
+  distance_matrix[GEOM_LINEAR_OCTREE][GEOM_BOX] = &Distance<LinearOcTree, Box>;
+  distance_matrix[GEOM_LINEAR_OCTREE][GEOM_SPHERE] = &Distance<LinearOcTree, Sphere>;
+  distance_matrix[GEOM_LINEAR_OCTREE][GEOM_CAPSULE] = &Distance<LinearOcTree, Capsule>;
+  distance_matrix[GEOM_LINEAR_OCTREE][GEOM_CONE] = &Distance<LinearOcTree, Cone>;
+  distance_matrix[GEOM_LINEAR_OCTREE][GEOM_CYLINDER] = &Distance<LinearOcTree, Cylinder>;
+  distance_matrix[GEOM_LINEAR_OCTREE][GEOM_CONVEX] = &Distance<LinearOcTree, ConvexBase>;
+  distance_matrix[GEOM_LINEAR_OCTREE][GEOM_PLANE] = &Distance<LinearOcTree, Plane>;
+  distance_matrix[GEOM_LINEAR_OCTREE][GEOM_HALFSPACE] = &Distance<LinearOcTree, Halfspace>;
+
+  distance_matrix[GEOM_BOX][GEOM_LINEAR_OCTREE] = &Distance<Box, LinearOcTree>;
+  distance_matrix[GEOM_SPHERE][GEOM_LINEAR_OCTREE] = &Distance<Sphere, LinearOcTree>;
+  distance_matrix[GEOM_CAPSULE][GEOM_LINEAR_OCTREE] = &Distance<Capsule, LinearOcTree>;
+  distance_matrix[GEOM_CONE][GEOM_LINEAR_OCTREE] = &Distance<Cone, LinearOcTree>;
+  distance_matrix[GEOM_CYLINDER][GEOM_LINEAR_OCTREE] = &Distance<Cylinder, LinearOcTree>;
+  distance_matrix[GEOM_CONVEX][GEOM_LINEAR_OCTREE] = &Distance<ConvexBase, LinearOcTree>;
+  distance_matrix[GEOM_PLANE][GEOM_LINEAR_OCTREE] = &Distance<Plane, LinearOcTree>;
+  distance_matrix[GEOM_HALFSPACE][GEOM_LINEAR_OCTREE] = &Distance<Halfspace, LinearOcTree>;
+
+  distance_matrix[GEOM_LINEAR_OCTREE][GEOM_LINEAR_OCTREE] = &Distance<LinearOcTree, LinearOcTree>;
+
+  distance_matrix[GEOM_LINEAR_OCTREE][BV_AABB  ] = &Distance<LinearOcTree, BVHModel<AABB     > >;
+  distance_matrix[GEOM_LINEAR_OCTREE][BV_OBB   ] = &Distance<LinearOcTree, BVHModel<OBB      > >;
+  distance_matrix[GEOM_LINEAR_OCTREE][BV_RSS   ] = &Distance<LinearOcTree, BVHModel<RSS      > >;
+  distance_matrix[GEOM_LINEAR_OCTREE][BV_OBBRSS] = &Distance<LinearOcTree, BVHModel<OBBRSS   > >;
+  distance_matrix[GEOM_LINEAR_OCTREE][BV_kIOS  ] = &Distance<LinearOcTree, BVHModel<kIOS     > >;
+  distance_matrix[GEOM_LINEAR_OCTREE][BV_KDOP16] = &Distance<LinearOcTree, BVHModel<KDOP<16> > >;
+  distance_matrix[GEOM_LINEAR_OCTREE][BV_KDOP18] = &Distance<LinearOcTree, BVHModel<KDOP<18> > >;
+  distance_matrix[GEOM_LINEAR_OCTREE][BV_KDOP24] = &Distance<LinearOcTree, BVHModel<KDOP<24> > >;
+
+  distance_matrix[BV_AABB][GEOM_LINEAR_OCTREE] = &Distance<BVHModel<AABB     >, LinearOcTree>;
+  distance_matrix[BV_OBB][GEOM_LINEAR_OCTREE] = &Distance<BVHModel<OBB      >, LinearOcTree>;
+  distance_matrix[BV_RSS][GEOM_LINEAR_OCTREE] = &Distance<BVHModel<RSS      >, LinearOcTree>;
+  distance_matrix[BV_OBBRSS][GEOM_LINEAR_OCTREE] = &Distance<BVHModel<OBBRSS   >, LinearOcTree>;
+  distance_matrix[BV_kIOS][GEOM_LINEAR_OCTREE] = &Distance<BVHModel<kIOS     >, LinearOcTree>;
+  distance_matrix[BV_KDOP16][GEOM_LINEAR_OCTREE] = &Distance<BVHModel<KDOP<16> >, LinearOcTree>;
+  distance_matrix[BV_KDOP18][GEOM_LINEAR_OCTREE] = &Distance<BVHModel<KDOP<18> >, LinearOcTree>;
+  distance_matrix[BV_KDOP24][GEOM_LINEAR_OCTREE] = &Distance<BVHModel<KDOP<24> >, LinearOcTree>;
+
+  distance_matrix[GEOM_DISTANCE_FIELD][GEOM_SPHERE] = &DistanceFieldShapeDistance<Sphere, false>;
+  distance_matrix[GEOM_DISTANCE_FIELD][GEOM_CAPSULE] = &DistanceFieldShapeDistance<Capsule, false>;
+  distance_matrix[GEOM_SPHERE][GEOM_DISTANCE_FIELD] = &DistanceFieldShapeDistance<Sphere, true>;
+  distance_matrix[GEOM_CAPSULE][GEOM_DISTANCE_FIELD] = &DistanceFieldShapeDistance<Capsule, true>;
+
+  distance_matrix[GEOM_BOX_SET][GEOM_BOX] = &BoxSetShapeDistance<Box, false>;
+  distance_matrix[GEOM_BOX_SET][GEOM_SPHERE] = &BoxSetShapeDistance<Sphere, false>;
+  distance_matrix[GEOM_BOX_SET][GEOM_CAPSULE] = &BoxSetShapeDistance<Capsule, false>;
+  distance_matrix[GEOM_BOX_SET][GEOM_CONE] = &BoxSetShapeDistance<Cone, false>;
+  distance_matrix[GEOM_BOX_SET][GEOM_CYLINDER] = &BoxSetShapeDistance<Cylinder, false>;
+  distance_matrix[GEOM_BOX_SET][GEOM_CONVEX] = &BoxSetShapeDistance<ConvexBase, false>;
+  distance_matrix[GEOM_BOX_SET][GEOM_PLANE] = &BoxSetShapeDistance<Plane, false>;
+  distance_matrix[GEOM_BOX_SET][GEOM_HALFSPACE] = &BoxSetShapeDistance<Halfspace, false>;
+
+  distance_matrix[GEOM_BOX][GEOM_BOX_SET] = &BoxSetShapeDistance<Box, true>;
+  distance_matrix[GEOM_SPHERE][GEOM_BOX_SET] = &BoxSetShapeDistance<Sphere, true>;
+  distance_matrix[GEOM_CAPSULE][GEOM_BOX_SET] = &BoxSetShapeDistance<Capsule, true>;
+  distance_matrix[GEOM_CONE][GEOM_BOX_SET] = &BoxSetShapeDistance<Cone, true>;
+  distance_matrix[GEOM_CYLINDER][GEOM_BOX_SET] = &BoxSetShapeDistance<Cylinder, true>;
+  distance_matrix[GEOM_CONVEX][GEOM_BOX_SET] = &BoxSetShapeDistance<ConvexBase, true>;
+  distance_matrix[GEOM_PLANE][GEOM_BOX_SET] = &BoxSetShapeDistance<Plane, true>;
+  distance_matrix[GEOM_HALFSPACE][GEOM_BOX_SET] = &BoxSetShapeDistance<Halfspace, true>;
 }
 //template struct DistanceFunctionMatrix;
 }
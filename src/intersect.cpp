@@ -36,6 +36,7 @@
 /** \author Jia Pan */
 
 #include <hpp/fcl/internal/intersect.h>
+#include <algorithm>
 #include <iostream>
 #include <limits>
 #include <vector>
@@ -61,6 +62,172 @@ bool Intersect::buildTrianglePlane
   return false;
 }
 
+namespace
+{
+  /// Gap between the projections of two triangles on an axis,
+  /// scaled by the norm of the axis. Non positive if the projections overlap.
+  inline FCL_REAL projectionGap (const Vec3f& axis,
+                                 const Vec3f P[3], const Vec3f Q[3])
+  {
+    FCL_REAL p0 = axis.dot(P[0]), p1 = axis.dot(P[1]), p2 = axis.dot(P[2]),
+             q0 = axis.dot(Q[0]), q1 = axis.dot(Q[1]), q2 = axis.dot(Q[2]);
+    FCL_REAL pmin = std::min(p0, std::min(p1, p2)),
+             pmax = std::max(p0, std::max(p1, p2)),
+             qmin = std::min(q0, std::min(q1, q2)),
+             qmax = std::max(q0, std::max(q1, q2));
+    return std::max(qmin - pmax, pmin - qmax);
+  }
+
+  /// Whether axis = u x v separates the triangles.
+  /// Axes built from almost parallel vectors are ignored since their
+  /// direction is dominated by rounding errors.
+  inline bool separatedOnAxis (const Vec3f& u, const Vec3f& v,
+                               const Vec3f P[3], const Vec3f Q[3],
+                               FCL_REAL* sqrDistLowerBound)
+  {
+    const Vec3f axis (u.cross(v));
+    FCL_REAL sqrNorm = axis.squaredNorm();
+    if (sqrNorm <= 1e-12 * u.squaredNorm() * v.squaredNorm()) return false;
+    FCL_REAL gap = projectionGap (axis, P, Q);
+    if (gap <= 0) return false;
+    if (sqrDistLowerBound)
+      *sqrDistLowerBound = gap * gap / sqrNorm;
+    return true;
+  }
+}
+
+bool Intersect::intersectTriangles
+(const Vec3f& P1, const Vec3f& P2, const Vec3f& P3,
+ const Vec3f& Q1, const Vec3f& Q2, const Vec3f& Q3,
+ FCL_REAL* sqrDistLowerBound)
+{
+  const Vec3f P[3] = { P1, P2, P3 };
+  const Vec3f Q[3] = { Q1, Q2, Q3 };
+  const Vec3f eP[3] = { P2 - P1, P3 - P2, P1 - P3 };
+  const Vec3f eQ[3] = { Q2 - Q1, Q3 - Q2, Q1 - Q3 };
+
+  // Normals of the triangles.
+  if (separatedOnAxis (eP[0], eP[1], P, Q, sqrDistLowerBound)) return false;
+  if (separatedOnAxis (eQ[0], eQ[1], P, Q, sqrDistLowerBound)) return false;
+  // Cross products of the edges.
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      if (separatedOnAxis (eP[i], eQ[j], P, Q, sqrDistLowerBound))
+        return false;
+  // Normals of the edges in the plane of the triangles, only needed when
+  // the triangles are coplanar.
+  const Vec3f nP (eP[0].cross(eP[1])), nQ (eQ[0].cross(eQ[1]));
+  for (int i = 0; i < 3; ++i) {
+    if (separatedOnAxis (nP, eP[i], P, Q, sqrDistLowerBound)) return false;
+    if (separatedOnAxis (nQ, eQ[i], P, Q, sqrDistLowerBound)) return false;
+  }
+  return true;
+}
+
+namespace
+{
+  /// Whether axis separates the triangle from the box by more than margin.
+  inline bool separatedFromBox (const Vec3f& axis, const Vec3f P[3],
+                                const Vec3f& halfSide, FCL_REAL margin,
+                                FCL_REAL* sqrDistLowerBound)
+  {
+    FCL_REAL p0 = axis.dot(P[0]), p1 = axis.dot(P[1]), p2 = axis.dot(P[2]);
+    FCL_REAL r = halfSide.dot(axis.cwiseAbs());
+    FCL_REAL gap = std::max(std::min(p0, std::min(p1, p2)) - r,
+                            -r - std::max(p0, std::max(p1, p2)));
+    if (gap <= 0) return false;
+    FCL_REAL sqrGap = gap * gap, sqrNorm = axis.squaredNorm();
+    if (sqrGap <= margin * margin * sqrNorm) return false;
+    if (sqrDistLowerBound)
+      *sqrDistLowerBound = sqrGap / sqrNorm;
+    return true;
+  }
+}
+
+bool Intersect::intersectTriangleBox
+(const Vec3f& P1, const Vec3f& P2, const Vec3f& P3,
+ const Vec3f& halfSide, FCL_REAL margin, FCL_REAL* sqrDistLowerBound)
+{
+  const Vec3f P[3] = { P1, P2, P3 };
+  const Vec3f e[3] = { P2 - P1, P3 - P2, P1 - P3 };
+
+  // Axes of the box.
+  for (int i = 0; i < 3; ++i) {
+    FCL_REAL pmin = std::min(P1[i], std::min(P2[i], P3[i])),
+             pmax = std::max(P1[i], std::max(P2[i], P3[i]));
+    FCL_REAL gap = std::max(pmin - halfSide[i], -halfSide[i] - pmax);
+    if (gap > margin) {
+      if (sqrDistLowerBound) *sqrDistLowerBound = gap * gap;
+      return false;
+    }
+  }
+  // Normal of the triangle.
+  const Vec3f n (e[0].cross(e[1]));
+  if (separatedFromBox (n, P, halfSide, margin, sqrDistLowerBound))
+    return false;
+  // Cross products of the axes of the box with the edges. Axes almost
+  // parallel to an edge are ignored since their direction is dominated by
+  // rounding errors.
+  for (int j = 0; j < 3; ++j) {
+    FCL_REAL threshold = 1e-12 * e[j].squaredNorm();
+    for (int i = 0; i < 3; ++i) {
+      Vec3f axis (Vec3f::Zero());
+      axis[(i+1)%3] = -e[j][(i+2)%3];
+      axis[(i+2)%3] =  e[j][(i+1)%3];
+      if (axis.squaredNorm() <= threshold) continue;
+      if (separatedFromBox (axis, P, halfSide, margin, sqrDistLowerBound))
+        return false;
+    }
+  }
+  return true;
+}
+
+FCL_REAL Intersect::sqrDistanceSegmentBox
+(const Vec3f& P1, const Vec3f& P2, const Vec3f& halfSide)
+{
+  const Vec3f D (P2 - P1);
+  // Parameters where the segment crosses the planes of the faces.
+  FCL_REAL t[8];
+  int n = 0;
+  t[n++] = 0;
+  t[n++] = 1;
+  for (int i = 0; i < 3; ++i) {
+    if (D[i] == 0) continue;
+    for (int s = -1; s <= 1; s += 2) {
+      FCL_REAL ti = (s * halfSide[i] - P1[i]) / D[i];
+      if (ti > 0 && ti < 1) t[n++] = ti;
+    }
+  }
+  std::sort (t, t + n);
+
+  FCL_REAL sqrDist = std::numeric_limits<FCL_REAL>::max();
+  for (int k = 0; k + 1 < n; ++k) {
+    // On [t[k], t[k+1]], each coordinate is either inside the slab of the
+    // box or on a fixed side, and the squared distance is a*t^2 + b*t + c.
+    FCL_REAL tm = (t[k] + t[k+1]) / 2, a = 0, b = 0;
+    Vec3f side;
+    bool outside[3];
+    for (int i = 0; i < 3; ++i) {
+      FCL_REAL p = P1[i] + tm * D[i];
+      outside[i] = (p > halfSide[i] || p < -halfSide[i]);
+      if (!outside[i]) continue;
+      side[i] = (p > 0) ? halfSide[i] : -halfSide[i];
+      a += D[i] * D[i];
+      b += 2 * D[i] * (P1[i] - side[i]);
+    }
+    FCL_REAL ts = (a > 0) ? std::min (std::max (-b / (2 * a), t[k]), t[k+1])
+                          : t[k];
+    FCL_REAL d = 0;
+    for (int i = 0; i < 3; ++i) {
+      if (!outside[i]) continue;
+      FCL_REAL e = P1[i] + ts * D[i] - side[i];
+      d += e * e;
+    }
+    sqrDist = std::min (sqrDist, d);
+  }
+  return sqrDist;
+}
+
 void TriangleDistance::segPoints(const Vec3f& P, const Vec3f& A, const Vec3f& Q, const Vec3f& B,
                                  Vec3f& VEC, Vec3f& X, Vec3f& Y)
 {
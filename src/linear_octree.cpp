@@ -0,0 +1,524 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <hpp/fcl/linear_octree.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#ifdef HPP_FCL_HAVE_OCTOMAP
+#include <hpp/fcl/octree.h>
+#endif
+
+namespace hpp
+{
+namespace fcl
+{
+
+namespace details
+{
+
+/// @brief A cell of one level of the tree, identified by its Morton code.
+struct LinearOcTreeCell
+{
+  boost::uint64_t code;
+  float occupancy;
+  unsigned char child_mask;
+
+  LinearOcTreeCell(boost::uint64_t code_, float occupancy_,
+                   unsigned char child_mask_ = 0)
+    : code(code_), occupancy(occupancy_), child_mask(child_mask_)
+  {}
+
+  bool operator< (const LinearOcTreeCell& other) const
+  {
+    return code < other.code;
+  }
+};
+
+typedef std::vector<LinearOcTreeCell> LinearOcTreeLevel;
+
+/// @brief Sort the cells of a level and merge the cells with the same code.
+static void sortAndMerge(LinearOcTreeLevel& level)
+{
+  if(level.empty()) return;
+  std::sort(level.begin(), level.end());
+  std::size_t last = 0;
+  for(std::size_t i = 1; i < level.size(); ++i)
+  {
+    if(level[i].code == level[last].code)
+    {
+      level[last].child_mask |= level[i].child_mask;
+      level[last].occupancy = std::max(level[last].occupancy, level[i].occupancy);
+    }
+    else
+      level[++last] = level[i];
+  }
+  level.erase(level.begin() + last + 1, level.end());
+}
+
+/// @brief Build the node array from the cells given at each level.
+///
+/// The parents of the cells of a level are added to the level above, from
+/// the finest level to the root. Each level is then sorted by Morton code,
+/// which makes the children of a node contiguous in the level below.
+static void buildLinearOcTree(std::vector<LinearOcTreeLevel>& levels,
+                              std::vector<LinearOcTree::Node>& nodes)
+{
+  nodes.clear();
+  for(std::size_t d = levels.size() - 1; d > 0; --d)
+  {
+    LinearOcTreeLevel& level = levels[d];
+    sortAndMerge(level);
+    LinearOcTreeLevel& parents = levels[d - 1];
+    for(std::size_t i = 0; i < level.size(); ++i)
+      parents.push_back(LinearOcTreeCell(level[i].code >> 3, level[i].occupancy,
+                                         (unsigned char)(1u << (level[i].code & 7))));
+  }
+  sortAndMerge(levels[0]);
+  if(levels[0].empty()) return;
+
+  std::size_t num_nodes = 0;
+  for(std::size_t d = 0; d < levels.size(); ++d)
+    num_nodes += levels[d].size();
+  if(num_nodes > std::numeric_limits<boost::uint32_t>::max())
+    throw std::length_error("Too many nodes for a LinearOcTree.");
+  nodes.resize(num_nodes);
+
+  std::size_t offset = 0;
+  for(std::size_t d = 0; d < levels.size(); ++d)
+  {
+    const LinearOcTreeLevel& level = levels[d];
+    std::size_t child = offset + level.size();
+    for(std::size_t i = 0; i < level.size(); ++i)
+    {
+      LinearOcTree::Node& node = nodes[offset + i];
+      node.child_mask = level[i].child_mask;
+      node.occupancy = level[i].occupancy;
+      node.flags = 0;
+      node.first_child = 0;
+      for(unsigned int c = 0; c < 8; ++c)
+      {
+        if(node.child_mask & (1u << c))
+        {
+          if(!node.first_child) node.first_child = (boost::uint32_t)child;
+          ++child;
+        }
+      }
+    }
+    offset += level.size();
+  }
+}
+
+/// @brief Interleave the bits of the cell key: bit 3*b + a of the code is the
+///        bit b of the coordinate a, as in \ref computeChildBV.
+static boost::uint64_t mortonCode(const boost::uint64_t key[3], unsigned int depth)
+{
+  boost::uint64_t code = 0;
+  for(unsigned int b = 0; b < depth; ++b)
+    for(unsigned int a = 0; a < 3; ++a)
+      code |= ((key[a] >> b) & 1) << (3 * b + a);
+  return code;
+}
+
+/// @brief A box of cells of the finest level, [lo, hi) along each axis.
+struct CellBox
+{
+  boost::uint64_t lo[3], hi[3];
+};
+
+/// @brief Order the boxes by cross section orthogonal to an axis, then
+///        along the axis.
+struct CellBoxLess
+{
+  int axis;
+
+  explicit CellBoxLess(int axis_) : axis(axis_) {}
+
+  bool operator() (const CellBox& a, const CellBox& b) const
+  {
+    for(int k = 1; k < 3; ++k)
+    {
+      int j = (axis + k) % 3;
+      if(a.lo[j] != b.lo[j]) return a.lo[j] < b.lo[j];
+      if(a.hi[j] != b.hi[j]) return a.hi[j] < b.hi[j];
+    }
+    return a.lo[axis] < b.lo[axis];
+  }
+};
+
+/// @brief Merge the consecutive boxes with the same cross section along an
+///        axis.
+/// @return whether some boxes were merged.
+static bool mergeCellBoxes(std::vector<CellBox>& boxes, int axis)
+{
+  if(boxes.empty()) return false;
+  std::sort(boxes.begin(), boxes.end(), CellBoxLess(axis));
+  std::size_t last = 0;
+  for(std::size_t i = 1; i < boxes.size(); ++i)
+  {
+    CellBox& box = boxes[last];
+    const CellBox& next = boxes[i];
+    bool merge = box.hi[axis] == next.lo[axis];
+    for(int k = 1; k < 3 && merge; ++k)
+    {
+      int j = (axis + k) % 3;
+      merge = box.lo[j] == next.lo[j] && box.hi[j] == next.hi[j];
+    }
+    if(merge)
+      box.hi[axis] = next.hi[axis];
+    else
+      boxes[++last] = next;
+  }
+  bool merged = last + 1 < boxes.size();
+  boxes.erase(boxes.begin() + last + 1, boxes.end());
+  return merged;
+}
+
+/// @brief the node which covers the i-th child of a node. A leaf covers its
+///        children, and NULL stands for unknown space.
+static const LinearOcTree::Node* coveringChild(const LinearOcTree& tree,
+                                               const LinearOcTree::Node* node,
+                                               unsigned int i)
+{
+  if(node == NULL || !tree.nodeHasChildren(node)) return node;
+  return tree.nodeChildExists(node, i) ? tree.getNodeChild(node, i) : NULL;
+}
+
+/// @brief collect the regions where two octrees differ below a pair of nodes
+/// @return whether the whole cell bv changed.
+static bool collectChangedRegions(const LinearOcTree& tree1,
+                                  const LinearOcTree::Node* node1,
+                                  const LinearOcTree& tree2,
+                                  const LinearOcTree::Node* node2,
+                                  const AABB& bv, std::vector<AABB>& regions)
+{
+  bool leaf1 = node1 == NULL || !tree1.nodeHasChildren(node1);
+  bool leaf2 = node2 == NULL || !tree2.nodeHasChildren(node2);
+  if(leaf1 && leaf2)
+  {
+    unsigned char flags1 = node1 ? node1->flags : 0;
+    unsigned char flags2 = node2 ? node2->flags : 0;
+    if(flags1 == flags2) return false;
+    regions.push_back(bv);
+    return true;
+  }
+
+  std::size_t n = regions.size();
+  unsigned int changed = 0;
+  for(unsigned int i = 0; i < 8; ++i)
+  {
+    AABB child_bv;
+    computeChildBV(bv, i, child_bv);
+    if(collectChangedRegions(tree1, coveringChild(tree1, node1, i),
+                             tree2, coveringChild(tree2, node2, i),
+                             child_bv, regions))
+      ++changed;
+  }
+  // When all the children changed, the node is reported instead.
+  if(changed < 8) return false;
+  regions.resize(n);
+  regions.push_back(bv);
+  return true;
+}
+
+#ifdef HPP_FCL_HAVE_OCTOMAP
+static void collectOcTreeCells(const OcTree& tree, const OcTree::OcTreeNode* node,
+                               unsigned int depth, boost::uint64_t code,
+                               std::vector<LinearOcTreeLevel>& levels)
+{
+  if(!tree.nodeHasChildren(node))
+  {
+    levels[depth].push_back(LinearOcTreeCell(code, (float)node->getOccupancy()));
+    return;
+  }
+  for(unsigned int i = 0; i < 8; ++i)
+  {
+    if(tree.nodeChildExists(node, i))
+      collectOcTreeCells(tree, tree.getNodeChild(node, i), depth + 1,
+                         (code << 3) | i, levels);
+  }
+}
+#endif
+
+} // namespace details
+
+void LinearOcTree::init(FCL_REAL resolution_, unsigned int depth_)
+{
+  if(depth_ > MAX_DEPTH)
+    throw std::invalid_argument("The depth of a LinearOcTree cannot be "
+                                "larger than 21.");
+  resolution = resolution_;
+  depth = depth_;
+  node_data = NULL;
+  num_nodes = 0;
+
+  // default occupancy/free threshold is consistent with default setting from octomap
+  default_occupancy = 0.5;
+  occupancy_threshold = 0.5;
+  free_threshold = 0;
+}
+
+LinearOcTree::LinearOcTree(FCL_REAL resolution_, unsigned int depth_)
+{
+  init(resolution_, depth_);
+}
+
+LinearOcTree::LinearOcTree(FCL_REAL resolution_,
+                           const std::vector<Vec3f>& occupied_points,
+                           unsigned int depth_)
+{
+  init(resolution_, depth_);
+
+  std::vector<details::LinearOcTreeLevel> levels(depth + 1);
+  levels[depth].reserve(occupied_points.size());
+  const FCL_REAL half = (FCL_REAL)((boost::uint64_t)1 << depth) / 2;
+  const FCL_REAL full = 2 * half;
+  for(std::size_t i = 0; i < occupied_points.size(); ++i)
+  {
+    boost::uint64_t key[3];
+    bool inside = true;
+    for(int a = 0; a < 3; ++a)
+    {
+      FCL_REAL k = std::floor(occupied_points[i][a] / resolution) + half;
+      if(!(k >= 0 && k < full)) { inside = false; break; }
+      key[a] = (boost::uint64_t)k;
+    }
+    if(inside)
+      levels[depth].push_back(details::LinearOcTreeCell
+                              (details::mortonCode(key, depth), 1.f));
+  }
+  details::buildLinearOcTree(levels, nodes);
+  useOwnedNodes();
+  updateFlags();
+}
+
+#ifdef HPP_FCL_HAVE_OCTOMAP
+LinearOcTree::LinearOcTree(const OcTree& tree)
+{
+  init(tree.getTree()->getResolution(), tree.getTree()->getTreeDepth());
+  default_occupancy = tree.getDefaultOccupancy();
+  occupancy_threshold = tree.getOccupancyThres();
+  free_threshold = tree.getFreeThres();
+
+  std::vector<details::LinearOcTreeLevel> levels(depth + 1);
+  if(tree.getRoot())
+    details::collectOcTreeCells(tree, tree.getRoot(), 0, 0, levels);
+  details::buildLinearOcTree(levels, nodes);
+  useOwnedNodes();
+  updateFlags();
+}
+#endif
+
+LinearOcTree::LinearOcTree(const LinearOcTree& other)
+  : CollisionGeometry(other), nodes(other.nodes),
+    mapped_storage(other.mapped_storage), node_data(other.node_data),
+    num_nodes(other.num_nodes),
+    resolution(other.resolution), depth(other.depth),
+    default_occupancy(other.default_occupancy),
+    occupancy_threshold(other.occupancy_threshold),
+    free_threshold(other.free_threshold)
+{
+  if(!mapped_storage) useOwnedNodes();
+}
+
+LinearOcTree& LinearOcTree::operator=(const LinearOcTree& other)
+{
+  if(this == &other) return *this;
+  CollisionGeometry::operator=(other);
+  nodes = other.nodes;
+  mapped_storage = other.mapped_storage;
+  node_data = other.node_data;
+  num_nodes = other.num_nodes;
+  resolution = other.resolution;
+  depth = other.depth;
+  default_occupancy = other.default_occupancy;
+  occupancy_threshold = other.occupancy_threshold;
+  free_threshold = other.free_threshold;
+  if(!mapped_storage) useOwnedNodes();
+  return *this;
+}
+
+void LinearOcTree::useOwnedNodes()
+{
+  node_data = nodes.empty() ? NULL : &nodes[0];
+  num_nodes = nodes.size();
+}
+
+void LinearOcTree::setOccupancyThres(FCL_REAL d)
+{
+  occupancy_threshold = d;
+  updateFlags();
+}
+
+void LinearOcTree::setFreeThres(FCL_REAL d)
+{
+  free_threshold = d;
+  updateFlags();
+}
+
+void LinearOcTree::updateFlags()
+{
+  if(mapped_storage)
+  {
+    // The mapping is read-only.
+    nodes.assign(node_data, node_data + num_nodes);
+    mapped_storage.reset();
+    useOwnedNodes();
+  }
+  for(std::size_t i = 0; i < nodes.size(); ++i)
+  {
+    Node& node = nodes[i];
+    node.flags = 0;
+    if(node.occupancy >= occupancy_threshold) node.flags |= Occupied;
+    if(node.occupancy <= free_threshold) node.flags |= Free;
+  }
+}
+
+std::vector<boost::array<FCL_REAL, 6> > LinearOcTree::toBoxes() const
+{
+  std::vector<boost::array<FCL_REAL, 6> > boxes;
+  if(!num_nodes) return boxes;
+
+  std::vector<std::pair<const Node*, AABB> > stack;
+  stack.push_back(std::make_pair(getRoot(), getRootBV()));
+  while(!stack.empty())
+  {
+    const Node* node = stack.back().first;
+    AABB bv = stack.back().second;
+    stack.pop_back();
+
+    if(!nodeHasChildren(node))
+    {
+      if(isNodeOccupied(node))
+      {
+        Vec3f c = bv.center();
+        boost::array<FCL_REAL, 6> box = {{c[0], c[1], c[2], bv.width(),
+                                          node->occupancy, occupancy_threshold}};
+        boxes.push_back(box);
+      }
+      continue;
+    }
+    for(unsigned int i = 8; i-- > 0;)
+    {
+      if(nodeChildExists(node, i))
+      {
+        AABB child_bv;
+        computeChildBV(bv, i, child_bv);
+        stack.push_back(std::make_pair(getNodeChild(node, i), child_bv));
+      }
+    }
+  }
+  return boxes;
+}
+
+std::vector<AABB> LinearOcTree::changedRegions(const LinearOcTree& previous) const
+{
+  if(previous.resolution != resolution || previous.depth != depth)
+    throw std::invalid_argument("The octrees must have the same resolution "
+                                "and depth.");
+  std::vector<AABB> regions;
+  details::collectChangedRegions(*this, getRoot(), previous, previous.getRoot(),
+                                 getRootBV(), regions);
+  return regions;
+}
+
+std::vector<AABB> LinearOcTree::toMergedBoxes() const
+{
+  std::vector<AABB> result;
+  if(!num_nodes) return result;
+
+  // Collect the occupied leaves, in units of the finest cells.
+  std::vector<details::CellBox> boxes;
+  std::vector<std::pair<const Node*, details::CellBox> > stack;
+  details::CellBox root;
+  for(int a = 0; a < 3; ++a)
+  {
+    root.lo[a] = 0;
+    root.hi[a] = (boost::uint64_t)1 << depth;
+  }
+  stack.push_back(std::make_pair(getRoot(), root));
+  while(!stack.empty())
+  {
+    const Node* node = stack.back().first;
+    details::CellBox cell = stack.back().second;
+    stack.pop_back();
+
+    if(!nodeHasChildren(node))
+    {
+      if(isNodeOccupied(node)) boxes.push_back(cell);
+      continue;
+    }
+    const boost::uint64_t half = (cell.hi[0] - cell.lo[0]) / 2;
+    for(unsigned int i = 0; i < 8; ++i)
+    {
+      if(!nodeChildExists(node, i)) continue;
+      details::CellBox child;
+      for(unsigned int a = 0; a < 3; ++a)
+      {
+        child.lo[a] = cell.lo[a] + (((i >> a) & 1) ? half : 0);
+        child.hi[a] = child.lo[a] + half;
+      }
+      stack.push_back(std::make_pair(getNodeChild(node, i), child));
+    }
+  }
+
+  // Merge along each axis in turn, until no pass merges two boxes.
+  int unchanged = 0;
+  for(int axis = 0; unchanged < 3; axis = (axis + 1) % 3)
+  {
+    if(details::mergeCellBoxes(boxes, axis)) unchanged = 0;
+    else ++unchanged;
+  }
+
+  const Vec3f origin (getRootBV().min_);
+  result.reserve(boxes.size());
+  for(std::size_t i = 0; i < boxes.size(); ++i)
+  {
+    Vec3f lower, upper;
+    for(int a = 0; a < 3; ++a)
+    {
+      lower[a] = origin[a] + resolution * (FCL_REAL) boxes[i].lo[a];
+      upper[a] = origin[a] + resolution * (FCL_REAL) boxes[i].hi[a];
+    }
+    result.push_back(AABB(lower, upper));
+  }
+  return result;
+}
+
+}
+
+} // namespace hpp
@@ -0,0 +1,298 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <hpp/fcl/linear_octree_serialization.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace hpp
+{
+namespace fcl
+{
+
+namespace details
+{
+
+/// @brief Fixed size header at the beginning of a LinearOcTree file.
+/// The nodes follow, starting at an offset aligned on
+/// LINEAR_OCTREE_FILE_ALIGNMENT bytes.
+struct HPP_FCL_LOCAL LinearOcTreeFileHeader
+{
+  char magic[8];
+  boost::uint32_t version;
+  boost::uint32_t endianness;
+  boost::uint32_t sizeof_node;
+  boost::uint32_t depth;
+  double resolution;
+  double default_occupancy;
+  double occupancy_threshold;
+  double free_threshold;
+  boost::uint64_t num_nodes;
+  boost::uint64_t nodes_offset;
+  boost::uint64_t file_size;
+};
+
+static const char LINEAR_OCTREE_FILE_MAGIC[8] = { 'H', 'P', 'P', 'F', 'C', 'L', 'O', 'T' };
+static const boost::uint32_t LINEAR_OCTREE_FILE_ENDIANNESS = 0x01020304;
+/// The nodes are aligned on cache lines.
+static const boost::uint64_t LINEAR_OCTREE_FILE_ALIGNMENT = 64;
+
+inline boost::uint64_t alignOffset (boost::uint64_t offset)
+{
+  return (offset + LINEAR_OCTREE_FILE_ALIGNMENT - 1)
+    / LINEAR_OCTREE_FILE_ALIGNMENT * LINEAR_OCTREE_FILE_ALIGNMENT;
+}
+
+/// @brief Check the header of a file of file_size bytes.
+static void checkHeader (const LinearOcTreeFileHeader& header,
+                  boost::uint64_t file_size, const std::string& filename)
+{
+  std::ostringstream error;
+  error << "Cannot load LinearOcTree file " << filename << ": ";
+  if(std::memcmp(header.magic, LINEAR_OCTREE_FILE_MAGIC,
+                 sizeof(LINEAR_OCTREE_FILE_MAGIC)) != 0)
+  {
+    error << "not a LinearOcTree file.";
+    throw std::runtime_error (error.str());
+  }
+  if(header.version != LINEAR_OCTREE_FILE_FORMAT_VERSION)
+  {
+    error << "unsupported format version " << header.version
+          << " (expected " << LINEAR_OCTREE_FILE_FORMAT_VERSION << ").";
+    throw std::runtime_error (error.str());
+  }
+  if(header.endianness != LINEAR_OCTREE_FILE_ENDIANNESS)
+  {
+    error << "the file was written on a machine with a different endianness.";
+    throw std::runtime_error (error.str());
+  }
+  if(header.sizeof_node != sizeof(LinearOcTree::Node))
+  {
+    error << "the file was written with a different node layout.";
+    throw std::runtime_error (error.str());
+  }
+  if(header.file_size != file_size)
+  {
+    error << "the file is truncated (" << file_size << " bytes instead of "
+          << header.file_size << ").";
+    throw std::runtime_error (error.str());
+  }
+  // The size of the nodes is compared without computing it, which could
+  // overflow. The nodes are mapped in place, so they must be aligned.
+  if(header.depth > LinearOcTree::MAX_DEPTH || !(header.resolution > 0)
+     || header.nodes_offset < sizeof(LinearOcTreeFileHeader)
+     || header.nodes_offset % LINEAR_OCTREE_FILE_ALIGNMENT != 0
+     || header.nodes_offset > file_size
+     || header.num_nodes > (file_size - header.nodes_offset)
+                           / sizeof(LinearOcTree::Node))
+  {
+    error << "the file is corrupted.";
+    throw std::runtime_error (error.str());
+  }
+}
+
+struct HPP_FCL_LOCAL LinearOcTreeIO
+{
+  static void save (const LinearOcTree& tree, const std::string& filename)
+  {
+    LinearOcTreeFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, LINEAR_OCTREE_FILE_MAGIC,
+                sizeof(LINEAR_OCTREE_FILE_MAGIC));
+    header.version = LINEAR_OCTREE_FILE_FORMAT_VERSION;
+    header.endianness = LINEAR_OCTREE_FILE_ENDIANNESS;
+    header.sizeof_node = sizeof(LinearOcTree::Node);
+    header.depth = tree.depth;
+    header.resolution = tree.resolution;
+    header.default_occupancy = tree.default_occupancy;
+    header.occupancy_threshold = tree.occupancy_threshold;
+    header.free_threshold = tree.free_threshold;
+    header.num_nodes = tree.num_nodes;
+    header.nodes_offset = alignOffset(sizeof(LinearOcTreeFileHeader));
+    header.file_size = header.nodes_offset
+      + tree.num_nodes * sizeof(LinearOcTree::Node);
+
+    std::ofstream os (filename.c_str(), std::ios::binary | std::ios::trunc);
+    if(!os)
+      throw std::runtime_error ("Cannot open " + filename + " for writing.");
+    static const char zeros[LINEAR_OCTREE_FILE_ALIGNMENT] = { 0 };
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(zeros, (std::streamsize)(header.nodes_offset - sizeof(header)));
+    if(tree.num_nodes > 0)
+      os.write(reinterpret_cast<const char*>(tree.node_data),
+               (std::streamsize)(tree.num_nodes * sizeof(LinearOcTree::Node)));
+    os.close();
+    if(!os)
+      throw std::runtime_error ("Failed to write " + filename + ".");
+  }
+
+  /// @brief Build an octree whose nodes point into the mapped buffer \c data.
+  static boost::shared_ptr<LinearOcTree> map
+  (const LinearOcTreeFileHeader& header, const char* data,
+   const boost::shared_ptr<const void>& storage, const std::string& filename)
+  {
+    const LinearOcTree::Node* nodes = reinterpret_cast<const LinearOcTree::Node*>
+      (data + header.nodes_offset);
+    checkNodes(nodes, header.num_nodes, filename);
+    boost::shared_ptr<LinearOcTree> tree (create(header));
+    tree->mapped_storage = storage;
+    tree->node_data = nodes;
+    tree->num_nodes = (std::size_t)header.num_nodes;
+    return tree;
+  }
+
+  /// @brief Build an octree which owns a copy of the nodes stored in \c is.
+  static boost::shared_ptr<LinearOcTree> copy
+  (const LinearOcTreeFileHeader& header, std::istream& is,
+   const std::string& filename)
+  {
+    boost::shared_ptr<LinearOcTree> tree (create(header));
+    tree->nodes.resize((std::size_t)header.num_nodes);
+    is.seekg((std::streamoff)header.nodes_offset);
+    if(header.num_nodes > 0
+       && !is.read(reinterpret_cast<char*>(&tree->nodes[0]),
+                   (std::streamsize)(header.num_nodes
+                                     * sizeof(LinearOcTree::Node))))
+      throw std::runtime_error ("Cannot load LinearOcTree file: read error.");
+    if(header.num_nodes > 0)
+      checkNodes(&tree->nodes[0], header.num_nodes, filename);
+    tree->useOwnedNodes();
+    return tree;
+  }
+
+private:
+  /// @brief Check that the children of each node are stored after it and
+  /// inside the node array, so that the traversals, which do not check the
+  /// indices, stay inside the array and terminate.
+  static void checkNodes (const LinearOcTree::Node* nodes,
+                          boost::uint64_t num_nodes, const std::string& filename)
+  {
+    for(boost::uint64_t i = 0; i < num_nodes; ++i)
+    {
+      const LinearOcTree::Node& node = nodes[i];
+      if(node.child_mask == 0) continue;
+      if(node.first_child <= i
+         || (boost::uint64_t) node.first_child
+            + LinearOcTree::bitCount(node.child_mask) > num_nodes)
+        throw std::runtime_error ("Cannot load LinearOcTree file " + filename
+                                  + ": the file is corrupted.");
+    }
+  }
+
+  static LinearOcTree* create (const LinearOcTreeFileHeader& header)
+  {
+    LinearOcTree* tree = new LinearOcTree(header.resolution, header.depth);
+    tree->default_occupancy = header.default_occupancy;
+    tree->occupancy_threshold = header.occupancy_threshold;
+    tree->free_threshold = header.free_threshold;
+    return tree;
+  }
+};
+
+boost::shared_ptr<LinearOcTree> mapLinearOcTree (const std::string& filename)
+{
+  namespace bip = boost::interprocess;
+  boost::shared_ptr<bip::mapped_region> region;
+  try {
+    bip::file_mapping file (filename.c_str(), bip::read_only);
+    region.reset (new bip::mapped_region (file, bip::read_only));
+  } catch (const bip::interprocess_exception& e) {
+    throw std::runtime_error ("Cannot map LinearOcTree file " + filename + ": "
+                              + e.what());
+  }
+
+  if(region->get_size() < sizeof(LinearOcTreeFileHeader))
+    throw std::runtime_error ("Cannot load LinearOcTree file " + filename
+                              + ": not a LinearOcTree file.");
+  const char* data = static_cast<const char*>(region->get_address());
+  const LinearOcTreeFileHeader& header =
+    *reinterpret_cast<const LinearOcTreeFileHeader*>(data);
+  checkHeader(header, region->get_size(), filename);
+
+  boost::shared_ptr<const void> storage (region);
+  return LinearOcTreeIO::map(header, data, storage, filename);
+}
+
+boost::shared_ptr<LinearOcTree> readLinearOcTree (const std::string& filename)
+{
+  std::ifstream is (filename.c_str(), std::ios::binary);
+  if(!is)
+    throw std::runtime_error ("Cannot open LinearOcTree file " + filename + ".");
+  is.seekg(0, std::ios::end);
+  boost::uint64_t file_size = (boost::uint64_t)is.tellg();
+  is.seekg(0, std::ios::beg);
+
+  LinearOcTreeFileHeader header;
+  if(file_size < sizeof(header)
+     || !is.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    throw std::runtime_error ("Cannot load LinearOcTree file " + filename
+                              + ": not a LinearOcTree file.");
+  checkHeader(header, file_size, filename);
+  return LinearOcTreeIO::copy(header, is, filename);
+}
+} // namespace details
+
+void saveLinearOcTree (const LinearOcTree& tree, const std::string& filename)
+{
+  details::LinearOcTreeIO::save(tree, filename);
+}
+
+boost::shared_ptr<LinearOcTree> loadLinearOcTree (const std::string& filename,
+                                                  bool memory_map)
+{
+  if(memory_map)
+    return details::mapLinearOcTree(filename);
+  else
+    return details::readLinearOcTree(filename);
+}
+
+bool isLinearOcTreeFile (const std::string& filename)
+{
+  std::ifstream is (filename.c_str(), std::ios::binary);
+  char magic[sizeof(details::LINEAR_OCTREE_FILE_MAGIC)];
+  if(!is.read(magic, sizeof(magic))) return false;
+  return std::memcmp(magic, details::LINEAR_OCTREE_FILE_MAGIC,
+                     sizeof(magic)) == 0;
+}
+
+}
+
+} // namespace hpp
@@ -0,0 +1,70 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/// Convert an octree in binary octomap format (.bt) to a LinearOcTree file,
+/// which MeshLoader::loadOctree maps into memory instead of parsing it.
+///
+/// Usage: hpp-fcl-convert-octree input.bt output
+
+#include <exception>
+#include <iostream>
+
+#include <boost/shared_ptr.hpp>
+
+#include <hpp/fcl/octree.h>
+#include <hpp/fcl/linear_octree_serialization.h>
+
+int main (int argc, char** argv)
+{
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " input.bt output" << std::endl;
+    return 1;
+  }
+  try {
+    boost::shared_ptr<octomap::OcTree> octree (new octomap::OcTree (1.));
+    if (!octree->readBinary (argv[1])) {
+      std::cerr << "Cannot read " << argv[1] << std::endl;
+      return 1;
+    }
+    hpp::fcl::LinearOcTree tree ((hpp::fcl::OcTree (octree)));
+    hpp::fcl::saveLinearOcTree (tree, argv[2]);
+    std::cout << argv[1] << ": " << tree.size () << " nodes, resolution "
+      << tree.getResolution () << ", depth " << tree.getTreeDepth ()
+      << std::endl;
+  } catch (const std::exception& e) {
+    std::cerr << e.what () << std::endl;
+    return 1;
+  }
+  return 0;
+}
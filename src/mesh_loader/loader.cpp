@@ -40,8 +40,20 @@
 #ifdef HPP_FCL_HAVE_OCTOMAP
 # include <hpp/fcl/octree.h>
 #endif
+#include <hpp/fcl/linear_octree_serialization.h>
 
 #include <hpp/fcl/BV/BV.h>
+#include <hpp/fcl/BVH/BVH_serialization.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
 
 namespace hpp
 {
@@ -83,6 +95,8 @@ namespace fcl {
 
   CollisionGeometryPtr_t MeshLoader::loadOctree (const std::string& filename)
   {
+    if (isLinearOcTreeFile (filename))
+      return loadLinearOcTree (filename);
 #ifdef HPP_FCL_HAVE_OCTOMAP
     boost::shared_ptr<octomap::OcTree> octree (new octomap::OcTree (filename));
     return CollisionGeometryPtr_t (new hpp::fcl::OcTree (octree));
@@ -91,18 +105,268 @@ namespace fcl {
 #endif
   }
 
+  namespace internal
+  {
+    /// 64 bits FNV-1a hash of the content of a file.
+    boost::uint64_t hashFileContent (const std::string& filename)
+    {
+      std::ifstream is (filename.c_str(), std::ios::binary);
+      if (!is)
+        throw std::invalid_argument ("Cannot open file " + filename + ".");
+
+      boost::uint64_t hash = 0xcbf29ce484222325ULL;
+      const boost::uint64_t prime = 0x100000001b3ULL;
+      std::vector<char> buffer (1 << 16);
+      while (is) {
+        is.read (&buffer[0], (std::streamsize)buffer.size());
+        const std::streamsize n = is.gcount();
+        for (std::streamsize i = 0; i < n; ++i) {
+          hash ^= (unsigned char)buffer[(std::size_t)i];
+          hash *= prime;
+        }
+      }
+      return hash;
+    }
+
+    /// Hexadecimal representation of the hash of the content of a file.
+    std::string contentHash (const std::string& filename)
+    {
+      std::ostringstream oss;
+      oss << std::hex << std::setfill ('0') << std::setw (16)
+          << hashFileContent (filename);
+      return oss.str();
+    }
+
+    /// Name of the disk cache entry of a mesh.
+    std::string diskCacheEntry (const std::string& contentHash,
+                                const Vec3f& scale, const NODE_TYPE& bvType)
+    {
+      std::ostringstream oss;
+      oss << contentHash << '_' << bvType << std::setprecision (17);
+      for (int i = 0; i < 3; ++i) oss << '_' << scale[i];
+      oss << ".bvh";
+      return oss.str();
+    }
+  } // namespace internal
+
+  BVHModelPtr_t CachedMeshLoader::loadWithDiskCache
+  (const std::string& filename, const Vec3f& scale,
+   const std::string& contentHash)
+  {
+    namespace fs = boost::filesystem;
+    const fs::path entry = fs::path (cacheDirectory_)
+      / internal::diskCacheEntry (contentHash, scale, getNodeType());
+
+    if (fs::exists (entry)) {
+      try {
+        BVHModelPtr_t geom = loadBVHModel (entry.string());
+        if (geom->getNodeType() == getNodeType()) return geom;
+      } catch (const std::runtime_error& e) {
+        std::cerr << "Warning: ignoring cache entry " << entry.string()
+                  << ": " << e.what() << std::endl;
+      }
+    }
+
+    BVHModelPtr_t geom = MeshLoader::load (filename, scale);
+
+    // Write to a temporary file and rename it so that other processes never
+    // read a partially written entry. Failing to update the cache is not an
+    // error.
+    const fs::path tmp (entry.string() + fs::unique_path (".%%%%-%%%%-%%%%").string());
+    try {
+      fs::create_directories (cacheDirectory_);
+      saveBVHModel (*geom, tmp.string());
+      fs::rename (tmp, entry);
+    } catch (const std::exception& e) {
+      std::cerr << "Warning: cannot store " << filename << " in cache directory "
+                << cacheDirectory_ << ": " << e.what() << std::endl;
+      boost::system::error_code ec;
+      fs::remove (tmp, ec);
+    }
+    return geom;
+  }
+
   BVHModelPtr_t CachedMeshLoader::load (const std::string& filename,
       const Vec3f& scale)
   {
     Key key (filename, scale);
-    Cache_t::const_iterator _cached = cache_.find (key);
-    if (_cached == cache_.end()) {
-      BVHModelPtr_t geom = MeshLoader::load (filename, scale);
-      cache_.insert (std::make_pair(key, geom));
-      return geom;
-    } else {
-      return _cached->second;
+    boost::mutex::scoped_lock lock (mutex_);
+    while (true) {
+      std::map<Key, Entry>::iterator _cached = entries_.find (key);
+      if (_cached != entries_.end()) {
+        ++statistics_.hits;
+        lru_.splice (lru_.begin(), lru_, _cached->second.lru);
+        return _cached->second.geom;
+      }
+      // Wait for the thread loading the same mesh, if any.
+      if (loading_.find (key) == loading_.end()) break;
+      loaded_.wait (lock);
+    }
+    ++statistics_.misses;
+    loading_.insert (key);
+    lock.unlock();
+
+    BVHModelPtr_t geom;
+    Key contentKey (std::string(), scale);
+    try {
+      contentKey.filename = internal::contentHash (filename);
+      lock.lock();
+      std::map<Key, Content>::const_iterator _content = contents_.find (contentKey);
+      if (_content != contents_.end()) {
+        ++statistics_.deduplicated;
+        geom = _content->second.geom;
+      }
+      lock.unlock();
+
+      if (!geom)
+        geom = cacheDirectory_.empty()
+          ? MeshLoader::load (filename, scale)
+          : loadWithDiskCache (filename, scale, contentKey.filename);
+    } catch (...) {
+      if (!lock.owns_lock()) lock.lock();
+      loading_.erase (key);
+      loaded_.notify_all();
+      throw;
+    }
+
+    lock.lock();
+    geom = insert (key, contentKey, geom);
+    loading_.erase (key);
+    loaded_.notify_all();
+    return geom;
+  }
+
+  BVHModelPtr_t CachedMeshLoader::insert (const Key& key, const Key& contentKey,
+                                          const BVHModelPtr_t& geom)
+  {
+    std::map<Key, Content>::iterator _content = contents_.find (contentKey);
+    if (_content == contents_.end()) {
+      Content content;
+      content.geom = geom;
+      content.bytes = (std::size_t)geom->memUsage(0);
+      content.uses = 0;
+      _content = contents_.insert (std::make_pair (contentKey, content)).first;
+      statistics_.bytes += content.bytes;
     }
+    ++_content->second.uses;
+
+    lru_.push_front (key);
+    entries_.insert (std::make_pair (key,
+          Entry (_content->second.geom, contentKey, lru_.begin())));
+    evict();
+    return _content->second.geom;
+  }
+
+  void CachedMeshLoader::evict ()
+  {
+    if (memoryBudget_ == 0) return;
+    while (statistics_.bytes > memoryBudget_ && lru_.size() > 1) {
+      std::map<Key, Entry>::iterator _entry = entries_.find (lru_.back());
+      std::map<Key, Content>::iterator _content =
+        contents_.find (_entry->second.contentKey);
+      if (--_content->second.uses == 0) {
+        statistics_.bytes -= _content->second.bytes;
+        contents_.erase (_content);
+      }
+      entries_.erase (_entry);
+      lru_.pop_back();
+      ++statistics_.evictions;
+    }
+  }
+
+  const CachedMeshLoader::Cache_t CachedMeshLoader::cache () const
+  {
+    boost::mutex::scoped_lock lock (mutex_);
+    Cache_t cache;
+    for (std::map<Key, Entry>::const_iterator _entry = entries_.begin();
+        _entry != entries_.end(); ++_entry)
+      cache.insert (cache.end(),
+          std::make_pair (_entry->first, _entry->second.geom));
+    return cache;
+  }
+
+  void CachedMeshLoader::setMemoryBudget (std::size_t bytes)
+  {
+    boost::mutex::scoped_lock lock (mutex_);
+    memoryBudget_ = bytes;
+    evict();
+  }
+
+  void CachedMeshLoader::resetStatistics ()
+  {
+    boost::mutex::scoped_lock lock (mutex_);
+    std::size_t bytes = statistics_.bytes;
+    statistics_ = Statistics();
+    statistics_.bytes = bytes;
+  }
+
+  namespace internal
+  {
+    /// Shared state of the threads of MeshLoader::loadMany.
+    struct LoadManyTask
+    {
+      MeshLoader* loader;
+      const std::vector<std::string>* filenames;
+      const std::vector<Vec3f>* scales;
+      std::vector<BVHModelPtr_t>* results;
+
+      boost::mutex mutex;
+      std::size_t next;
+      std::string error;
+
+      void operator() ()
+      {
+        while (true) {
+          std::size_t i;
+          {
+            boost::mutex::scoped_lock lock (mutex);
+            if (next >= filenames->size()) return;
+            i = next++;
+          }
+          try {
+            (*results)[i] = loader->load ((*filenames)[i],
+                scales->empty() ? Vec3f::Ones() : (*scales)[i]);
+          } catch (const std::exception& e) {
+            boost::mutex::scoped_lock lock (mutex);
+            if (error.empty())
+              error = "Cannot load " + (*filenames)[i] + ": " + e.what();
+          }
+        }
+      }
+    };
+  } // namespace internal
+
+  std::vector<BVHModelPtr_t> MeshLoader::loadMany
+  (const std::vector<std::string>& filenames, const std::vector<Vec3f>& scales,
+   unsigned int numThreads)
+  {
+    if (!scales.empty() && scales.size() != filenames.size())
+      throw std::invalid_argument ("MeshLoader::loadMany: there must be as "
+                                   "many scales as filenames.");
+    std::vector<BVHModelPtr_t> results (filenames.size());
+
+    internal::LoadManyTask task;
+    task.loader = this;
+    task.filenames = &filenames;
+    task.scales = &scales;
+    task.results = &results;
+    task.next = 0;
+
+    if (numThreads == 0)
+      numThreads = std::max (boost::thread::hardware_concurrency(), 1u);
+    if (numThreads > filenames.size())
+      numThreads = (unsigned int)filenames.size();
+
+    // The calling thread is one of the workers.
+    boost::thread_group threads;
+    for (unsigned int i = 1; i < numThreads; ++i)
+      threads.create_thread (boost::ref (task));
+    task();
+    threads.join_all();
+
+    if (!task.error.empty())
+      throw std::runtime_error (task.error);
+    return results;
   }
 }
 
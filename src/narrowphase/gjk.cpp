@@ -472,6 +472,8 @@ void GJK::initialize()
   status = Failed;
   distance_upper_bound = std::numeric_limits<FCL_REAL>::max();
   simplex = NULL;
+  iterations = 0;
+  num_support_calls = 0;
 }
 
 Vec3f GJK::getGuessFromSimplex() const
@@ -579,7 +581,8 @@ bool GJK::getClosestPoints (const MinkowskiDiff& shape, Vec3f& w0, Vec3f& w1)
 GJK::Status GJK::evaluate(const MinkowskiDiff& shape_, const Vec3f& guess,
     const support_func_guess_t& supportHint)
 {
-  size_t iterations = 0;
+  iterations = 0;
+  num_support_calls = 0;
   FCL_REAL alpha = 0;
   const FCL_REAL inflation = shape_.inflation.sum();
   const FCL_REAL upper_bound = distance_upper_bound + inflation;
@@ -1244,6 +1247,8 @@ void EPA::initialize()
   normal = Vec3f(0, 0, 0);
   depth = 0;
   nextsv = 0;
+  iterations = 0;
+  num_support_calls = 0;
   for(size_t i = 0; i < max_face_num; ++i)
     stock.append(&fc_store[max_face_num-i-1]);
 }
@@ -1341,6 +1346,8 @@ EPA::Status EPA::evaluate(GJK& gjk, const Vec3f& guess)
 {
   GJK::Simplex& simplex = *gjk.getSimplex();
   support_func_guess_t hint (gjk.support_hint);
+  const size_t gjk_support_calls = gjk.num_support_calls;
+  iterations = 0;
   if((simplex.rank > 1) && gjk.encloseOrigin())
   {
     while(hull.root)
@@ -1376,7 +1383,6 @@ EPA::Status EPA::evaluate(GJK& gjk, const Vec3f& guess)
       SimplexF* best = findBest(); // find the best face (the face with the minimum distance to origin) to split
       SimplexF outer = *best;
       size_t pass = 0;
-      size_t iterations = 0;
         
       // set the face connectivity
       bind(tetrahedron[0], 0, tetrahedron[1], 0);
@@ -1427,6 +1433,7 @@ EPA::Status EPA::evaluate(GJK& gjk, const Vec3f& guess)
       result.vertex[0] = outer.vertex[0];
       result.vertex[1] = outer.vertex[1];
       result.vertex[2] = outer.vertex[2];
+      num_support_calls = gjk.num_support_calls - gjk_support_calls;
       return status;
     }
   }
@@ -1439,6 +1446,7 @@ EPA::Status EPA::evaluate(GJK& gjk, const Vec3f& guess)
   depth = 0;
   result.rank = 1;
   result.vertex[0] = simplex.vertex[0];
+  num_support_calls = gjk.num_support_calls - gjk_support_calls;
   return status;
 }
 
@@ -41,12 +41,29 @@
 
 #include <hpp/fcl/shape/geometric_shapes_utility.h>
 #include <hpp/fcl/internal/intersect.h>
+#include <hpp/fcl/collision_data.h>
 #include "details.h"
 
 namespace hpp
 {
 namespace fcl
 {
+void GJKSolver::updateStatistics(const details::GJK& gjk) const
+{
+  ++statistics->num_gjk_calls;
+  statistics->num_gjk_iterations += gjk.iterations;
+  statistics->num_support_calls += gjk.num_support_calls;
+}
+
+void GJKSolver::updateStatistics(const details::EPA& epa) const
+{
+  ++statistics->num_epa_calls;
+  statistics->num_epa_iterations += epa.iterations;
+  statistics->num_support_calls += epa.num_support_calls;
+  if(!(epa.status & details::EPA::Valid))
+    ++statistics->num_epa_failures;
+}
+
 // Shape intersect algorithms based on:
 // - built-in function: 0
 // - GJK:               1
@@ -509,6 +526,7 @@ bool GJKSolver::shapeDistance<TriangleP, TriangleP>
   
   details::GJK gjk((unsigned int) gjk_max_iterations, gjk_tolerance);
   details::GJK::Status gjk_status = gjk.evaluate(shape, guess, support_hint);
+  if(statistics) updateStatistics(gjk);
   if(enable_cached_guess) {
     cached_guess = gjk.getGuessFromSimplex();
     support_func_cached_guess = gjk.support_hint;
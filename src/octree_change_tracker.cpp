@@ -0,0 +1,114 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <hpp/fcl/octree_change_tracker.h>
+
+#include <limits>
+
+#include <hpp/fcl/BV/BV.h>
+
+namespace hpp
+{
+namespace fcl
+{
+
+OcTreeChangeTracker::OcTreeChangeTracker(std::size_t max_updates_)
+  : stamp(0), max_updates(max_updates_)
+{
+}
+
+OcTreeChangeTracker::Stamp OcTreeChangeTracker::addUpdate
+(const std::vector<AABB>& regions)
+{
+  updates.push_back(Update());
+  Update& update = updates.back();
+  update.regions = regions;
+  for(std::size_t i = 0; i < regions.size(); ++i)
+    update.bounds += regions[i];
+  while(updates.size() > max_updates) updates.pop_front();
+  return ++stamp;
+}
+
+bool OcTreeChangeTracker::isValid(const AABB& bv, Stamp result_stamp,
+                                  FCL_REAL margin) const
+{
+  if(result_stamp > stamp) return false;
+  if(stamp - result_stamp > updates.size()) return false;
+
+  AABB volume (bv);
+  volume.expand(Vec3f::Constant(margin));
+  for(std::size_t i = updates.size() - (std::size_t)(stamp - result_stamp);
+      i < updates.size(); ++i)
+  {
+    const Update& update = updates[i];
+    if(!update.bounds.overlap(volume)) continue;
+    for(std::size_t j = 0; j < update.regions.size(); ++j)
+      if(update.regions[j].overlap(volume)) return false;
+  }
+  return true;
+}
+
+bool OcTreeChangeTracker::isValid(const CollisionGeometry* o,
+                                  const Transform3f& tf,
+                                  const Transform3f& tf_tree,
+                                  Stamp result_stamp, FCL_REAL margin) const
+{
+  AABB bv;
+  convertBV(o->aabb_local, tf_tree.inverseTimes(tf), bv);
+  return isValid(bv, result_stamp, margin);
+}
+
+AABB OcTreeChangeTracker::getDirtyRegion(Stamp since) const
+{
+  AABB region;
+  if(since > stamp || stamp - since > updates.size())
+  {
+    const FCL_REAL inf = std::numeric_limits<FCL_REAL>::max();
+    return AABB(Vec3f::Constant(-inf), Vec3f::Constant(inf));
+  }
+  for(std::size_t i = updates.size() - (std::size_t)(stamp - since);
+      i < updates.size(); ++i)
+    region += updates[i].bounds;
+  return region;
+}
+
+void OcTreeChangeTracker::clear()
+{
+  updates.clear();
+  ++stamp;
+}
+
+}
+
+} // namespace hpp
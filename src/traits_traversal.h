@@ -59,6 +59,36 @@ struct HPP_FCL_LOCAL TraversalTraitsCollision <BVHModel<T_BVH>, OcTree>
 
 #endif
 
+template <typename T_SH>
+struct HPP_FCL_LOCAL TraversalTraitsCollision <T_SH, LinearOcTree>
+{
+  typedef ShapeOcTreeCollisionTraversalNode<T_SH, LinearOcTree> CollisionTraversal_t;
+};
+
+template <typename T_SH>
+struct HPP_FCL_LOCAL TraversalTraitsCollision <LinearOcTree, T_SH>
+{
+  typedef OcTreeShapeCollisionTraversalNode<T_SH, LinearOcTree> CollisionTraversal_t;
+};
+
+template <>
+struct HPP_FCL_LOCAL TraversalTraitsCollision <LinearOcTree, LinearOcTree>
+{
+  typedef OcTreeCollisionTraversalNodeTpl<LinearOcTree, LinearOcTree> CollisionTraversal_t;
+};
+
+template <typename T_BVH>
+struct HPP_FCL_LOCAL TraversalTraitsCollision <LinearOcTree, BVHModel<T_BVH> >
+{
+  typedef OcTreeMeshCollisionTraversalNode<T_BVH, LinearOcTree> CollisionTraversal_t;
+};
+
+template <typename T_BVH>
+struct HPP_FCL_LOCAL TraversalTraitsCollision <BVHModel<T_BVH>, LinearOcTree>
+{
+  typedef MeshOcTreeCollisionTraversalNode<T_BVH, LinearOcTree> CollisionTraversal_t;
+};
+
 // TraversalTraitsDistance for distance_func_matrix.cpp
 
 template <typename TypeA, typename TypeB>
@@ -100,6 +130,36 @@ struct HPP_FCL_LOCAL TraversalTraitsDistance <BVHModel<T_BVH>, OcTree>
 
 #endif
 
+template <typename T_SH>
+struct HPP_FCL_LOCAL TraversalTraitsDistance <T_SH, LinearOcTree>
+{
+  typedef ShapeOcTreeDistanceTraversalNode<T_SH, LinearOcTree> CollisionTraversal_t;
+};
+
+template <typename T_SH>
+struct HPP_FCL_LOCAL TraversalTraitsDistance <LinearOcTree, T_SH>
+{
+  typedef OcTreeShapeDistanceTraversalNode<T_SH, LinearOcTree> CollisionTraversal_t;
+};
+
+template <>
+struct HPP_FCL_LOCAL TraversalTraitsDistance <LinearOcTree, LinearOcTree>
+{
+  typedef OcTreeDistanceTraversalNodeTpl<LinearOcTree, LinearOcTree> CollisionTraversal_t;
+};
+
+template <typename T_BVH>
+struct HPP_FCL_LOCAL TraversalTraitsDistance <LinearOcTree, BVHModel<T_BVH> >
+{
+  typedef OcTreeMeshDistanceTraversalNode<T_BVH, LinearOcTree> CollisionTraversal_t;
+};
+
+template <typename T_BVH>
+struct HPP_FCL_LOCAL TraversalTraitsDistance <BVHModel<T_BVH>, LinearOcTree>
+{
+  typedef MeshOcTreeDistanceTraversalNode<T_BVH, LinearOcTree> CollisionTraversal_t;
+};
+
 }
 
 } //hpp
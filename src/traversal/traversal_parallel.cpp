@@ -0,0 +1,146 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Open Source Robotics Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <hpp/fcl/internal/traversal_parallel.h>
+
+namespace hpp
+{
+namespace fcl
+{
+namespace details
+{
+
+unsigned int numTraversalThreads(unsigned int num_threads)
+{
+  if(num_threads == 0)
+    num_threads = std::max(boost::thread::hardware_concurrency(), 1u);
+  return num_threads;
+}
+
+WorkStealingQueues::WorkStealingQueues(unsigned int num_workers)
+  : queues(num_workers)
+{
+  for(std::size_t i = 0; i < queues.size(); ++i)
+    queues[i] = new Queue;
+}
+
+WorkStealingQueues::~WorkStealingQueues()
+{
+  for(std::size_t i = 0; i < queues.size(); ++i)
+    delete queues[i];
+}
+
+void WorkStealingQueues::distribute(std::size_t num_tasks)
+{
+  for(std::size_t t = 0; t < num_tasks; ++t)
+    queues[t % queues.size()]->tasks.push_back(t);
+}
+
+bool WorkStealingQueues::pop(unsigned int worker, std::size_t& task)
+{
+  {
+    Queue& own = *queues[worker];
+    boost::mutex::scoped_lock lock (own.mutex);
+    if(!own.tasks.empty())
+    {
+      task = own.tasks.front();
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+  // Steal the last task of another worker, which is the furthest from the
+  // tasks this worker is processing.
+  for(std::size_t i = 1; i < queues.size(); ++i)
+  {
+    Queue& other = *queues[(worker + i) % queues.size()];
+    boost::mutex::scoped_lock lock (other.mutex);
+    if(!other.tasks.empty())
+    {
+      task = other.tasks.back();
+      other.tasks.pop_back();
+      return true;
+    }
+  }
+  // Tasks do not create new tasks: no task will be available anymore.
+  return false;
+}
+
+TaskContactCounter::TaskContactCounter(std::size_t num_tasks,
+                                       std::size_t max_contacts_)
+  : counts(num_tasks, 0), finished(num_tasks, false),
+    max_contacts(max_contacts_),
+    last_needed(std::numeric_limits<std::size_t>::max())
+{}
+
+void TaskContactCounter::finish(std::size_t task, std::size_t num_contacts)
+{
+  boost::mutex::scoped_lock lock (mutex);
+  counts[task] = num_contacts;
+  finished[task] = true;
+  if(num_contacts == 0) return;
+
+  std::size_t sum = 0;
+  std::size_t last = last_needed.load(boost::memory_order_relaxed);
+  for(std::size_t t = 0; t < counts.size() && t < last; ++t)
+  {
+    if(!finished[t]) continue;
+    sum += counts[t];
+    if(sum >= max_contacts)
+    {
+      last_needed.store(t, boost::memory_order_relaxed);
+      return;
+    }
+  }
+}
+
+SharedBestDistance::SharedBestDistance(const DistanceResult& result)
+  : best(result.min_distance), best_result(result)
+{}
+
+void SharedBestDistance::submit(const DistanceResult& result)
+{
+  FCL_REAL current = best.load(boost::memory_order_relaxed);
+  while(result.min_distance < current
+        && !best.compare_exchange_weak(current, result.min_distance))
+    ;
+
+  boost::mutex::scoped_lock lock (mutex);
+  if(result.min_distance < best_result.min_distance)
+    best_result = result;
+}
+
+} // namespace details
+}
+
+} // namespace hpp
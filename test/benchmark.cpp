@@ -16,10 +16,17 @@
 
 #include <boost/filesystem.hpp>
 
+#include <hpp/fcl/fwd.hh>
+#include <hpp/fcl/collision.h>
+#include <hpp/fcl/distance.h>
 #include <hpp/fcl/internal/traversal_node_setup.h>
 #include <hpp/fcl/internal/traversal_node_bvhs.h>
+#include <hpp/fcl/internal/traversal_node_bvh_shape.h>
+#include <hpp/fcl/internal/traversal_node_octree.h>
+#include <hpp/fcl/narrowphase/narrowphase.h>
 #include "../src/collision_node.h"
 #include <hpp/fcl/internal/BV_splitter.h>
+#include <hpp/fcl/BVH/BVH_utility.h>
 
 #include "utility.h"
 #include "fcl_resources/config.h"
@@ -39,12 +46,12 @@ void makeModel (const std::vector<Vec3f>& vertices, const std::vector<Triangle>&
 template<typename BV, typename TraversalNode>
 double distance (const std::vector<Transform3f>& tf,
                const BVHModel<BV>& m1, const BVHModel<BV>& m2,
-               bool verbose);
+               bool verbose, bool devirtualized = false);
 
 template<typename BV, typename TraversalNode>
 double collide (const std::vector<Transform3f>& tf,
                const BVHModel<BV>& m1, const BVHModel<BV>& m2,
-               bool verbose);
+               bool verbose, bool devirtualized = false);
 
 template<typename BV>
 double run (const std::vector<Transform3f>& tf,
@@ -89,13 +96,14 @@ void makeModel (const std::vector<Vec3f>& vertices, const std::vector<Triangle>&
 template<typename BV, typename TraversalNode>
 double distance (const std::vector<Transform3f>& tf,
                const BVHModel<BV>& m1, const BVHModel<BV>& m2,
-               bool verbose)
+               bool verbose, bool devirtualized)
 {
   Transform3f pose2;
 
   DistanceResult local_result;
   DistanceRequest request(true);
   TraversalNode node;
+  DistanceTraversalWorkspace workspace;
 
   node.enable_statistics = verbose;
 
@@ -106,7 +114,8 @@ double distance (const std::vector<Transform3f>& tf,
     if(!initialize(node, m1, tf[i], m2, pose2, request, local_result))
       std::cout << "initialize error" << std::endl;
 
-    distance(&node, NULL);
+    if (devirtualized) staticDistance(node, workspace);
+    else distance(&node, workspace);
   }
   timer.stop();
   return timer.getElapsedTimeInMicroSec();
@@ -115,7 +124,7 @@ double distance (const std::vector<Transform3f>& tf,
 template<typename BV, typename TraversalNode>
 double collide (const std::vector<Transform3f>& tf,
                const BVHModel<BV>& m1, const BVHModel<BV>& m2,
-               bool verbose)
+               bool verbose, bool devirtualized)
 {
   Transform3f pose2;
 
@@ -134,13 +143,370 @@ double collide (const std::vector<Transform3f>& tf,
     assert (success);
 
     CollisionResult result;
-    collide(&node, request, result);
+    if (devirtualized) staticCollide(node, request, result);
+    else collide(&node, request, result);
   }
 
   timer.stop();
   return timer.getElapsedTimeInMicroSec();
 }
 
+/// Time the queries between a mesh and a capsule.
+template<typename CollisionTraversalNode, typename DistanceTraversalNode,
+  typename BV>
+void meshShape (const std::vector<Transform3f>& tf, const BVHModel<BV>& m1,
+    const Capsule& capsule, bool devirtualized, double& col, double& dist)
+{
+  GJKSolver solver;
+  Transform3f pose1;
+  Timer timer;
+
+  CollisionRequest colRequest;
+  timer.start();
+  for (std::size_t i = 0; i < tf.size(); ++i) {
+    CollisionResult result;
+    CollisionTraversalNode node (colRequest);
+    initialize (node, m1, pose1, capsule, tf[i], &solver, result);
+    if (devirtualized) staticCollide(node, colRequest, result);
+    else collide(&node, colRequest, result);
+  }
+  timer.stop();
+  col = timer.getElapsedTimeInMicroSec();
+
+  DistanceRequest distRequest (true);
+  timer.start();
+  for (std::size_t i = 0; i < tf.size(); ++i) {
+    DistanceResult result;
+    DistanceTraversalNode node;
+    initialize (node, m1, pose1, capsule, tf[i], &solver, distRequest, result);
+    if (devirtualized) staticDistance(node);
+    else distance(&node);
+  }
+  timer.stop();
+  dist = timer.getElapsedTimeInMicroSec();
+}
+
+/// Compare the traversal with virtual calls to the devirtualized one.
+template<typename BV>
+void dispatch (const std::vector<Transform3f>& tf,
+    const BVHModel<BV>& m1, const BVHModel<BV>& m2, const char* name)
+{
+  typedef typename traits<BV>::CollisionTraversalNode CollisionNode;
+  typedef typename traits<BV>::DistanceTraversalNode  DistanceNode;
+  double col  = collide <BV, CollisionNode> (tf, m1, m2, false, false),
+         dist = distance<BV, DistanceNode>  (tf, m1, m2, false, false),
+         scol  = collide <BV, CollisionNode> (tf, m1, m2, false, true),
+         sdist = distance<BV, DistanceNode>  (tf, m1, m2, false, true);
+  std::cout << name << " - virtual:\t (" << col << ", " << dist << ")\n"
+            << name << " - devirtualized:\t (" << scol << ", " << sdist << ")\n";
+}
+
+/// Count the bounding volume and leaf tests, with and without testing the
+/// triangle of a leaf against the bounding volumes of the other model.
+template<typename BV>
+void triangleBVTests (const std::vector<Transform3f>& tf,
+    const BVHModel<BV>& m1, const BVHModel<BV>& m2, const char* name)
+{
+  Transform3f pose2;
+  CollisionRequest request;
+  Timer timer;
+  for (int enable = 1; enable >= 0; --enable) {
+    MeshCollisionTraversalNode<BV, 0> node (request);
+    node.enable_statistics = true;
+    node.enable_triangle_bv_tests = (enable == 1);
+    int num_bv_tests = 0, num_leaf_tests = 0;
+    std::size_t num_collisions = 0;
+    timer.start();
+    for (std::size_t i = 0; i < tf.size(); ++i) {
+      CollisionResult result;
+      initialize(node, m1, tf[i], m2, pose2, result);
+      node.num_bv_tests = node.num_leaf_tests = 0;
+      staticCollide(node, request, result);
+      num_bv_tests += node.num_bv_tests;
+      num_leaf_tests += node.num_leaf_tests;
+      if (result.isCollision()) ++num_collisions;
+    }
+    timer.stop();
+    std::cout << name << (enable ? " - triangle / BV tests:\t " : " - BV / BV tests only:\t ")
+              << timer.getElapsedTimeInMicroSec() << " (" << num_bv_tests
+              << " BV tests, " << num_leaf_tests << " leaf tests, "
+              << num_collisions << " collisions)\n";
+  }
+
+  DistanceRequest drequest (true);
+  DistanceTraversalWorkspace workspace;
+  for (int enable = 1; enable >= 0; --enable) {
+    MeshDistanceTraversalNode<BV, 0> node;
+    node.enable_statistics = true;
+    node.enable_triangle_bv_tests = (enable == 1);
+    int num_bv_tests = 0, num_leaf_tests = 0;
+    FCL_REAL sum_distances = 0;
+    timer.start();
+    for (std::size_t i = 0; i < tf.size(); ++i) {
+      DistanceResult result;
+      initialize(node, m1, tf[i], m2, pose2, drequest, result);
+      node.num_bv_tests = node.num_leaf_tests = 0;
+      staticDistance(node, workspace);
+      num_bv_tests += node.num_bv_tests;
+      num_leaf_tests += node.num_leaf_tests;
+      sum_distances += result.min_distance;
+    }
+    timer.stop();
+    std::cout << name << (enable ? " - triangle / BV distance:\t " : " - BV / BV distance only:\t ")
+              << timer.getElapsedTimeInMicroSec() << " (" << num_bv_tests
+              << " BV tests, " << num_leaf_tests << " leaf tests, sum of distances "
+              << sum_distances << ")\n";
+  }
+}
+
+template<typename S>
+double octreeShape (const std::vector<Transform3f>& tf, const LinearOcTree& tree,
+    const S& s, const OcTreeSolver& otsolver, std::size_t& num_collisions)
+{
+  Transform3f pose1;
+  CollisionRequest request;
+  Timer timer;
+  num_collisions = 0;
+  timer.start();
+  for (std::size_t i = 0; i < tf.size(); ++i) {
+    CollisionResult result;
+    OcTreeShapeCollisionTraversalNode<S, LinearOcTree> node (request);
+    initialize (node, tree, pose1, s, tf[i], &otsolver, result);
+    collide(&node, request, result);
+    if (result.isCollision()) ++num_collisions;
+  }
+  timer.stop();
+  return timer.getElapsedTimeInMicroSec();
+}
+
+/// Compare the closed form tests between the octree cells and the shapes or
+/// the triangles to the tests with GJK. The octree is made of the cells
+/// crossed by the triangles of the environment.
+/// Sample the surface of a mesh with points, at the given resolution.
+std::vector<Vec3f> samplePoints (const std::vector<Vec3f>& p1,
+    const std::vector<Triangle>& t1, FCL_REAL resolution)
+{
+  std::vector<Vec3f> points;
+  for (std::size_t i = 0; i < t1.size(); ++i) {
+    const Vec3f& a = p1[t1[i][0]];
+    const Vec3f& b = p1[t1[i][1]];
+    const Vec3f& c = p1[t1[i][2]];
+    int n = (int) std::ceil (std::max ((b - a).norm (), (c - a).norm ())
+                             / (resolution / 2)) + 1;
+    for (int u = 0; u <= n; ++u)
+      for (int v = 0; u + v <= n; ++v)
+        points.push_back (a + (b - a) * ((FCL_REAL)u / n)
+                            + (c - a) * ((FCL_REAL)v / n));
+  }
+  return points;
+}
+
+void octreeCellKernels (const std::vector<Transform3f>& tf,
+    const std::vector<Vec3f>& p1, const std::vector<Triangle>& t1,
+    const BVHModel<OBBRSS>& robot)
+{
+  const FCL_REAL resolution = 50;
+  LinearOcTree tree (resolution, samplePoints (p1, t1, resolution));
+
+  GJKSolver solver;
+  Sphere sphere (200);
+  Capsule capsule (100, 400);
+  Box box (200, 300, 400);
+  Transform3f pose1;
+  CollisionRequest request;
+  Timer timer;
+  for (int enable = 1; enable >= 0; --enable) {
+    OcTreeSolver otsolver (&solver);
+    otsolver.enable_cell_kernels = (enable == 1);
+    std::size_t ns, nc, nb, nm = 0;
+    double ts = octreeShape (tf, tree, sphere, otsolver, ns),
+           tc = octreeShape (tf, tree, capsule, otsolver, nc),
+           tb = octreeShape (tf, tree, box, otsolver, nb);
+
+    timer.start();
+    for (std::size_t i = 0; i < tf.size(); ++i) {
+      CollisionResult result;
+      OcTreeMeshCollisionTraversalNode<OBBRSS, LinearOcTree> node (request);
+      initialize (node, tree, pose1, robot, tf[i], &otsolver, result);
+      collide(&node, request, result);
+      if (result.isCollision()) ++nm;
+    }
+    timer.stop();
+    double tm = timer.getElapsedTimeInMicroSec();
+
+    const char* name = enable ? "LinearOcTree - cell kernels" : "LinearOcTree - GJK";
+    std::cout << name << " / Sphere:\t " << ts << " (" << ns << " collisions)\n"
+              << name << " / Capsule:\t " << tc << " (" << nc << " collisions)\n"
+              << name << " / Box:\t " << tb << " (" << nb << " collisions)\n"
+              << name << " / rob.obj:\t " << tm << " (" << nm << " collisions)\n";
+  }
+}
+
+/// Compare one collision query per shape of a robot made of 40 spheres and
+/// capsules to a single query with all the shapes.
+void octreeBatch (const std::vector<Transform3f>& tf,
+    const std::vector<Vec3f>& p1, const std::vector<Triangle>& t1)
+{
+  const FCL_REAL resolution = 50;
+  LinearOcTree tree (resolution, samplePoints (p1, t1, resolution));
+
+  std::vector<CollisionGeometryPtr_t> geoms;
+  std::vector<const CollisionGeometry*> shapes;
+  std::vector<Transform3f> offsets;
+  for (int i = 0; i < 40; ++i) {
+    if (i % 2) geoms.push_back (CollisionGeometryPtr_t (new Sphere (60)));
+    else       geoms.push_back (CollisionGeometryPtr_t (new Capsule (40, 150)));
+    shapes.push_back (geoms.back ().get ());
+    offsets.push_back (Transform3f (Vec3f (100 * (i % 10) - 450,
+                                           150 * (i / 10) - 225, 0)));
+  }
+
+  Transform3f pose1;
+  CollisionRequest request;
+  std::vector<Transform3f> tfs (shapes.size ());
+  std::size_t n1 = 0, n2 = 0;
+  Timer timer;
+  timer.start();
+  for (std::size_t i = 0; i < tf.size(); ++i) {
+    for (std::size_t j = 0; j < shapes.size (); ++j) {
+      CollisionResult result;
+      if (collide (&tree, pose1, shapes[j], tf[i] * offsets[j], request, result))
+        ++n1;
+    }
+  }
+  timer.stop();
+  double t1s = timer.getElapsedTimeInMicroSec();
+
+  timer.start();
+  for (std::size_t i = 0; i < tf.size(); ++i) {
+    for (std::size_t j = 0; j < shapes.size (); ++j)
+      tfs[j] = tf[i] * offsets[j];
+    std::vector<CollisionResult> results;
+    n2 += collide (&tree, pose1, shapes, tfs, request, results);
+  }
+  timer.stop();
+  double t2s = timer.getElapsedTimeInMicroSec();
+
+  std::cout << "LinearOcTree / 40 shapes - one query per shape:\t " << t1s << " (" << n1 << " collisions)\n"
+            << "LinearOcTree / 40 shapes - single query:\t " << t2s << " (" << n2 << " collisions)\n";
+}
+
+/// Compare a collision query followed by a distance query to the combined
+/// query.
+void combinedQuery (const std::vector<Transform3f>& tf,
+    const BVHModel<OBBRSS>& m1, const BVHModel<OBBRSS>& m2)
+{
+  Transform3f pose2;
+  CollisionRequest colRequest (CONTACT, 1);
+  DistanceRequest distRequest (true);
+  Timer timer;
+
+  timer.start();
+  for (std::size_t i = 0; i < tf.size(); ++i) {
+    CollisionResult colResult;
+    DistanceResult distResult;
+    hpp::fcl::collide (&m1, tf[i], &m2, pose2, colRequest, colResult);
+    hpp::fcl::distance (&m1, tf[i], &m2, pose2, distRequest, distResult);
+  }
+  timer.stop();
+  double separate = timer.getElapsedTimeInMicroSec();
+
+  timer.start();
+  for (std::size_t i = 0; i < tf.size(); ++i) {
+    CollisionResult colResult;
+    DistanceResult distResult;
+    collideAndDistance (&m1, tf[i], &m2, pose2, colRequest, colResult,
+        distRequest, distResult);
+  }
+  timer.stop();
+  double combined = timer.getElapsedTimeInMicroSec();
+
+  std::cout << "OBBRSS - collide and distance:\t " << separate << '\n'
+            << "OBBRSS - combined query:\t " << combined << '\n';
+}
+
+/// Time the leaf tests between pairs of triangles of the two meshes, placed
+/// close to each other: with GJK, as when the contact information is
+/// requested, and with the dedicated triangle kernels otherwise.
+void leafKernels (const std::vector<Vec3f>& p1, const std::vector<Triangle>& t1,
+    const std::vector<Vec3f>& p2, const std::vector<Triangle>& t2)
+{
+  const std::size_t n = 100000;
+  std::vector<Vec3f> P (3 * n), Q (3 * n);
+  for (std::size_t i = 0; i < n; ++i) {
+    const Triangle& a = t1[i % t1.size()];
+    const Triangle& b = t2[(7 * i) % t2.size()];
+    Vec3f ca ((p1[a[0]] + p1[a[1]] + p1[a[2]]) / 3),
+          cb ((p2[b[0]] + p2[b[1]] + p2[b[2]]) / 3);
+    FCL_REAL size = (p1[a[1]] - p1[a[0]]).norm();
+    Vec3f offset (ca - cb + size * Vec3f (rand_interval(-1, 1),
+          rand_interval(-1, 1), rand_interval(-1, 1)));
+    for (int k = 0; k < 3; ++k) {
+      P[3*i+k] = p1[a[k]];
+      Q[3*i+k] = p2[b[k]] + offset;
+    }
+  }
+
+  Timer timer;
+  std::size_t gjk_collisions = 0, sat_collisions = 0, dist_collisions = 0;
+  GJKSolver solver;
+  Transform3f id;
+  timer.start();
+  for (std::size_t i = 0; i < n; ++i) {
+    TriangleP tri1 (P[3*i], P[3*i+1], P[3*i+2]), tri2 (Q[3*i], Q[3*i+1], Q[3*i+2]);
+    Vec3f c1, c2, normal;
+    FCL_REAL distance;
+    solver.shapeDistance (tri1, id, tri2, id, distance, c1, c2, normal);
+    if (distance <= 0) ++gjk_collisions;
+  }
+  timer.stop();
+  double gjk = timer.getElapsedTimeInMicroSec();
+
+  timer.start();
+  for (std::size_t i = 0; i < n; ++i) {
+    FCL_REAL sqrDistLowerBound;
+    if (Intersect::intersectTriangles (P[3*i], P[3*i+1], P[3*i+2],
+          Q[3*i], Q[3*i+1], Q[3*i+2], &sqrDistLowerBound))
+      ++sat_collisions;
+  }
+  timer.stop();
+  double sat = timer.getElapsedTimeInMicroSec();
+
+  timer.start();
+  for (std::size_t i = 0; i < n; ++i) {
+    Vec3f c1, c2;
+    if (TriangleDistance::sqrTriDistance (P[3*i], P[3*i+1], P[3*i+2],
+          Q[3*i], Q[3*i+1], Q[3*i+2], c1, c2) <= 0)
+      ++dist_collisions;
+  }
+  timer.stop();
+  double dist = timer.getElapsedTimeInMicroSec();
+
+  std::cout << "Leaf tests (" << n << " triangle pairs) - GJK:\t " << gjk
+            << " (" << gjk_collisions << " collisions)\n"
+            << "Leaf tests - separating axes:\t " << sat
+            << " (" << sat_collisions << " collisions)\n"
+            << "Leaf tests - triangle distance:\t " << dist
+            << " (" << dist_collisions << " collisions)\n";
+}
+
+template<typename BV>
+void optimizeModels (BVHModel<BV> (&models)[2][3], const char* name)
+{
+  for (int i = 0; i < 2; ++i) {
+    for (int sm = 0; sm < 3; ++sm) {
+      BVHQuality before = computeBVHQuality (models[i][sm]);
+      models[i][sm].optimizeTree (2);
+      BVHQuality after = computeBVHQuality (models[i][sm]);
+      std::cout << name << " - model " << i << " - split " << sm
+        << " - SAH cost: " << before.sah_cost << " -> " << after.sah_cost
+        << ", mean leaf depth: " << before.mean_leaf_depth << " -> "
+        << after.mean_leaf_depth << ", overlap ratio: "
+        << before.overlap_ratio << " -> " << after.overlap_ratio << '\n';
+    }
+  }
+}
+
 template<typename BV>
 double run (const std::vector<Transform3f>& tf,
           const BVHModel<BV> (&models)[2][3], int split_method,
@@ -233,5 +599,59 @@ int main (int, char*[])
   total_time += RUN_CASE(OBBRSS, transforms, ms_obbrss, SPLIT_METHOD_BV_CENTER);
   total_time += RUN_CASE(OBBRSS, transforms, ms_obbrss, SPLIT_METHOD_MEDIAN);
 
+  // Same models, optimized with tree rotations.
+  BVHModel<RSS> ms_rss_opt[2][3];
+  BVHModel<OBBRSS> ms_obbrss_opt[2][3];
+  for (int sm = 0; sm < 3; ++sm) {
+    makeModel (p1, t1, (SplitMethodType)sm, ms_rss_opt[0][sm]);
+    makeModel (p2, t2, (SplitMethodType)sm, ms_rss_opt[1][sm]);
+    makeModel (p1, t1, (SplitMethodType)sm, ms_obbrss_opt[0][sm]);
+    makeModel (p2, t2, (SplitMethodType)sm, ms_obbrss_opt[1][sm]);
+  }
+  std::cout << '\n';
+  optimizeModels (ms_rss_opt, "RSS");
+  optimizeModels (ms_obbrss_opt, "OBBRSS");
+
+  double optimized_time = 0;
+  optimized_time += run (transforms, ms_rss_opt, SPLIT_METHOD_MEAN, "RSS - SPLIT_METHOD_MEAN - optimized:\t");
+  optimized_time += run (transforms, ms_rss_opt, SPLIT_METHOD_BV_CENTER, "RSS - SPLIT_METHOD_BV_CENTER - optimized:\t");
+  optimized_time += run (transforms, ms_rss_opt, SPLIT_METHOD_MEDIAN, "RSS - SPLIT_METHOD_MEDIAN - optimized:\t");
+  optimized_time += run (transforms, ms_obbrss_opt, SPLIT_METHOD_MEAN, "OBBRSS - SPLIT_METHOD_MEAN - optimized:\t");
+  optimized_time += run (transforms, ms_obbrss_opt, SPLIT_METHOD_BV_CENTER, "OBBRSS - SPLIT_METHOD_BV_CENTER - optimized:\t");
+  optimized_time += run (transforms, ms_obbrss_opt, SPLIT_METHOD_MEDIAN, "OBBRSS - SPLIT_METHOD_MEDIAN - optimized:\t");
+
+  // Dispatch overhead of the traversal.
+  std::cout << '\n';
+  dispatch (transforms, ms_rss[0][SPLIT_METHOD_MEAN], ms_rss[1][SPLIT_METHOD_MEAN], "RSS");
+  dispatch (transforms, ms_obbrss[0][SPLIT_METHOD_MEAN], ms_obbrss[1][SPLIT_METHOD_MEAN], "OBBRSS");
+  {
+    Capsule capsule (50, 200);
+    double col, dist, scol, sdist;
+    meshShape<MeshShapeCollisionTraversalNode<OBBRSS, Capsule, 0>,
+      MeshShapeDistanceTraversalNodeOBBRSS<Capsule> >
+      (transforms, ms_obbrss[0][SPLIT_METHOD_MEAN], capsule, false, col, dist);
+    meshShape<MeshShapeCollisionTraversalNode<OBBRSS, Capsule, 0>,
+      MeshShapeDistanceTraversalNodeOBBRSS<Capsule> >
+      (transforms, ms_obbrss[0][SPLIT_METHOD_MEAN], capsule, true, scol, sdist);
+    std::cout << "OBBRSS / Capsule - virtual:\t (" << col << ", " << dist << ")\n"
+              << "OBBRSS / Capsule - devirtualized:\t (" << scol << ", " << sdist << ")\n";
+  }
+
+  std::cout << '\n';
+  leafKernels (p1, t1, p2, t2);
+
+  std::cout << '\n';
+  triangleBVTests (transforms, ms_obb[0][SPLIT_METHOD_MEAN], ms_obb[1][SPLIT_METHOD_MEAN], "OBB");
+  triangleBVTests (transforms, ms_rss[0][SPLIT_METHOD_MEAN], ms_rss[1][SPLIT_METHOD_MEAN], "RSS");
+  triangleBVTests (transforms, ms_obbrss[0][SPLIT_METHOD_MEAN], ms_obbrss[1][SPLIT_METHOD_MEAN], "OBBRSS");
+
+  std::cout << '\n';
+  octreeCellKernels (transforms, p1, t1, ms_obbrss[1][SPLIT_METHOD_MEAN]);
+  octreeBatch (transforms, p1, t1);
+
+  std::cout << '\n';
+  combinedQuery (transforms, ms_obbrss[0][SPLIT_METHOD_MEAN], ms_obbrss[1][SPLIT_METHOD_MEAN]);
+
   std::cout << "\n\nTotal time: " << total_time << std::endl;
+  std::cout << "Total time with optimized RSS and OBBRSS models: " << optimized_time << std::endl;
 }
@@ -44,12 +44,15 @@
 #include <hpp/fcl/collision.h>
 #include <hpp/fcl/BVH/BVH_model.h>
 #include <hpp/fcl/BVH/BVH_utility.h>
+#include <hpp/fcl/BVH/BVH_serialization.h>
 #include <hpp/fcl/math/transform.h>
 #include <hpp/fcl/shape/geometric_shapes.h>
 #include <hpp/fcl/mesh_loader/assimp.h>
 #include <hpp/fcl/mesh_loader/loader.h>
 #include "utility.h"
 #include <iostream>
+#include <algorithm>
+#include <fstream>
 
 using namespace hpp::fcl;
 
@@ -265,6 +268,177 @@ BOOST_AUTO_TEST_CASE(building_bvh_models)
   testBVHModel<KDOP<24> >();
 }
 
+/// Check that the bounding volumes of a refitted AABB model are exactly the
+/// ones of a full refit, and that each primitive is in exactly one leaf.
+void checkRefittedTree (const BVHModel<AABB>& model, int bv_id,
+                        std::vector<int>& leaves)
+{
+  const BVNode<AABB>& node = model.getBV(bv_id);
+  AABB expected;
+  if (node.isLeaf()) {
+    const Triangle& tri = model.tri_indices[node.primitiveId()];
+    expected = AABB (model.vertices[tri[0]]);
+    for (int i = 0; i < 3; ++i) {
+      expected += model.vertices[tri[i]];
+      if (model.prev_vertices) expected += model.prev_vertices[tri[i]];
+    }
+    leaves[node.primitiveId()]++;
+  } else {
+    checkRefittedTree (model, node.leftChild(), leaves);
+    checkRefittedTree (model, node.rightChild(), leaves);
+    expected = model.getBV(node.leftChild()).bv + model.getBV(node.rightChild()).bv;
+  }
+  BOOST_CHECK (node.bv.min_ == expected.min_);
+  BOOST_CHECK (node.bv.max_ == expected.max_);
+}
+
+void checkRefittedTree (const BVHModel<AABB>& model)
+{
+  std::vector<int> leaves (model.num_tris, 0);
+  checkRefittedTree (model, 0, leaves);
+  BOOST_CHECK (std::count (leaves.begin(), leaves.end(), 1) == model.num_tris);
+}
+
+BOOST_AUTO_TEST_CASE(incremental_refit)
+{
+  boost::filesystem::path path(TEST_RESOURCES_DIR);
+  std::vector<Vec3f> points;
+  std::vector<Triangle> triangles;
+  loadOBJFile((path / "env.obj").string().c_str(), points, triangles);
+
+  typedef boost::shared_ptr<BVHModel<AABB> > ModelPtr_t;
+  ModelPtr_t serial (new BVHModel<AABB>);
+  serial->beginModel();
+  serial->addSubModel (points, triangles);
+  serial->endModel();
+  ModelPtr_t parallel (new BVHModel<AABB> (*serial));
+  parallel->refit_num_threads = 4;
+
+  // Frame 1 moves some vertices, frame 2 none and frame 3 all of them.
+  for (int frame = 0; frame < 3; ++frame) {
+    std::vector<Vec3f> moved (points);
+    for (std::size_t i = 0; i < moved.size(); ++i)
+      if ((frame == 0 && i % 10 == 0) || frame == 2)
+        moved[i] += Vec3f (1, 2, 3) * (FCL_REAL)(i % 7);
+    points = moved;
+
+    serial->beginUpdateModel();
+    serial->updateSubModel (points);
+    serial->endUpdateModel();
+    parallel->beginUpdateModel();
+    parallel->updateSubModel (points);
+    parallel->endUpdateModel();
+
+    checkRefittedTree (*serial);
+    checkRefittedTree (*parallel);
+    for (int i = 0; i < serial->getNumBVs(); ++i) {
+      BOOST_CHECK (serial->getBV(i).bv.min_ == parallel->getBV(i).bv.min_);
+      BOOST_CHECK (serial->getBV(i).bv.max_ == parallel->getBV(i).bv.max_);
+    }
+  }
+
+  // Move half of the model far away, so that the subtrees mixing both halves
+  // are rebuilt.
+  ModelPtr_t replaced (new BVHModel<AABB>);
+  replaced->beginModel();
+  replaced->addSubModel (points, triangles);
+  replaced->endModel();
+  replaced->rebuild_threshold = 2;
+  replaced->beginReplaceModel();
+  for (std::size_t i = 0; i < points.size(); ++i) {
+    if (points[i][0] > 0) points[i][0] += 2000;
+    replaced->replaceVertex (points[i]);
+  }
+  replaced->endReplaceModel();
+  checkRefittedTree (*replaced);
+
+  ModelPtr_t rebuilt (new BVHModel<AABB>);
+  rebuilt->beginModel();
+  rebuilt->addSubModel (points, triangles);
+  rebuilt->endModel();
+
+  CollisionGeometryPtr_t box (new Box (200, 200, 200));
+  std::vector<Transform3f> transforms;
+  FCL_REAL extents[] = {-3000, -3000, -3000, 3000, 3000, 3000};
+  generateRandomTransforms(extents, transforms, 100);
+  CollisionObject o1 (replaced);
+  CollisionObject o2 (rebuilt);
+  for (std::size_t i = 0; i < transforms.size(); ++i) {
+    CollisionObject obj (box, transforms[i]);
+    CollisionRequest request (CONTACT, 100000);
+    CollisionResult r1, r2;
+    collide (&o1, &obj, request, r1);
+    collide (&o2, &obj, request, r2);
+    BOOST_CHECK_EQUAL (r1.numContacts(), r2.numContacts());
+  }
+}
+
+template<typename BV>
+void testOptimizeTree (bool checkQuality)
+{
+  boost::filesystem::path path(TEST_RESOURCES_DIR);
+  std::vector<Vec3f> points;
+  std::vector<Triangle> triangles;
+  loadOBJFile((path / "env.obj").string().c_str(), points, triangles);
+
+  typedef boost::shared_ptr<BVHModel<BV> > ModelPtr_t;
+  ModelPtr_t built (new BVHModel<BV>);
+  built->beginModel();
+  built->addSubModel (points, triangles);
+  built->endModel();
+  ModelPtr_t optimized (new BVHModel<BV> (*built));
+  BOOST_CHECK_EQUAL (optimized->optimizeTree (2), BVH_OK);
+  BOOST_CHECK_EQUAL (optimized->getNumBVs(), built->getNumBVs());
+
+  BVHQuality before = computeBVHQuality (*built),
+             after  = computeBVHQuality (*optimized);
+  BOOST_CHECK_EQUAL (before.num_leaves, built->num_tris);
+  BOOST_CHECK_EQUAL (after.num_leaves, built->num_tris);
+  BOOST_CHECK_EQUAL (after.min_leaf_primitives, 1);
+  BOOST_CHECK_EQUAL (after.max_leaf_primitives, 1);
+  int sum = 0;
+  for (std::size_t i = 0; i < after.depth_histogram.size(); ++i)
+    sum += after.depth_histogram[i];
+  BOOST_CHECK_EQUAL (sum, after.num_leaves);
+  BOOST_CHECK_EQUAL ((int)after.depth_histogram.size(), after.max_depth + 1);
+  BOOST_CHECK (after.overlap_ratio >= 0 && after.overlap_ratio <= 1);
+  if (checkQuality)
+    BOOST_CHECK (after.sah_cost <= before.sah_cost);
+
+  CollisionGeometryPtr_t box (new Box (200, 200, 200));
+  std::vector<Transform3f> transforms;
+  FCL_REAL extents[] = {-3000, -3000, -3000, 3000, 3000, 3000};
+  generateRandomTransforms(extents, transforms, 100);
+  CollisionObject o1 (built);
+  CollisionObject o2 (optimized);
+  for (std::size_t i = 0; i < transforms.size(); ++i) {
+    CollisionObject obj (box, transforms[i]);
+    CollisionRequest request (CONTACT, 100000);
+    CollisionResult r1, r2;
+    collide (&o1, &obj, request, r1);
+    collide (&o2, &obj, request, r2);
+    BOOST_CHECK_EQUAL (r1.numContacts(), r2.numContacts());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(optimize_tree)
+{
+  testOptimizeTree<AABB> (true);
+  testOptimizeTree<OBBRSS> (false);
+
+  boost::filesystem::path path(TEST_RESOURCES_DIR);
+  std::vector<Vec3f> points;
+  std::vector<Triangle> triangles;
+  loadOBJFile((path / "env.obj").string().c_str(), points, triangles);
+  BVHModel<AABB> model;
+  BOOST_CHECK_EQUAL (model.optimizeTree(), BVH_ERR_BUILD_OUT_OF_SEQUENCE);
+  model.beginModel();
+  model.addSubModel (points, triangles);
+  model.endModel();
+  model.optimizeTree();
+  checkRefittedTree (model);
+}
+
 template<class BoundingVolume>
 void testLoadPolyhedron ()
 {
@@ -331,6 +505,165 @@ BOOST_AUTO_TEST_CASE(load_polyhedron)
   testLoadPolyhedron<KDOP<24> >();
 }
 
+template<class BoundingVolume>
+void testLoadPolyhedronWithDiskCache ()
+{
+  namespace fs = boost::filesystem;
+  fs::path path(TEST_RESOURCES_DIR);
+  const fs::path cacheDir = fs::temp_directory_path()
+    / fs::unique_path("hpp-fcl-cache-%%%%-%%%%-%%%%");
+  const fs::path mesh = cacheDir / "env.obj";
+  fs::create_directories (cacheDir);
+  fs::copy_file (path / "env.obj", mesh);
+
+  typedef BVHModel<BoundingVolume> Polyhedron_t;
+  typedef boost::shared_ptr <Polyhedron_t> PolyhedronPtr_t;
+  Vec3f scale (1, 2, 3);
+  NODE_TYPE bvType = Polyhedron_t().getNodeType();
+
+  // First load builds the BVH and stores it on disk.
+  CachedMeshLoader loader1 (bvType, cacheDir.string());
+  PolyhedronPtr_t P1 = boost::dynamic_pointer_cast<Polyhedron_t>
+    (loader1.load (mesh.string(), scale));
+  BOOST_REQUIRE (P1);
+  BOOST_CHECK (!P1->isMemoryMapped());
+
+  // Another loader reads it back from the disk cache.
+  CachedMeshLoader loader2 (bvType, cacheDir.string());
+  PolyhedronPtr_t P2 = boost::dynamic_pointer_cast<Polyhedron_t>
+    (loader2.load (mesh.string(), scale));
+  BOOST_REQUIRE (P2);
+  BOOST_CHECK (P2->isMemoryMapped());
+  BOOST_CHECK_EQUAL(P1->num_tris    , P2->num_tris);
+  BOOST_CHECK_EQUAL(P1->num_vertices, P2->num_vertices);
+  BOOST_CHECK_EQUAL(P1->getNumBVs() , P2->getNumBVs());
+
+  // A different scale is a different entry.
+  CachedMeshLoader loader3 (bvType, cacheDir.string());
+  BVHModelPtr_t P3 = loader3.load (mesh.string(), Vec3f(1, 1, 1));
+  BOOST_CHECK (!P3->isMemoryMapped());
+
+  // Modifying the mesh invalidates the entry. The mesh gets a triangle on
+  // new vertices, since unreferenced vertices may be dropped by the loader.
+  std::size_t numVertices = 0;
+  {
+    std::ifstream is (mesh.string().c_str());
+    std::string line;
+    while (std::getline (is, line))
+      if (line.compare (0, 2, "v ") == 0) ++numVertices;
+  }
+  {
+    std::ofstream os (mesh.string().c_str(), std::ios::app);
+    os << "\nv 0 0 0\nv 1 0 0\nv 0 1 0\nf " << numVertices + 1 << ' '
+       << numVertices + 2 << ' ' << numVertices + 3 << '\n';
+  }
+  CachedMeshLoader loader4 (bvType, cacheDir.string());
+  BVHModelPtr_t P4 = loader4.load (mesh.string(), scale);
+  BOOST_CHECK (!P4->isMemoryMapped());
+  BOOST_CHECK_EQUAL(P1->num_tris + 1, P4->num_tris);
+
+  fs::remove_all (cacheDir);
+}
+
+BOOST_AUTO_TEST_CASE(load_polyhedron_with_disk_cache)
+{
+  testLoadPolyhedronWithDiskCache<AABB>();
+  testLoadPolyhedronWithDiskCache<OBB>();
+  testLoadPolyhedronWithDiskCache<RSS>();
+  testLoadPolyhedronWithDiskCache<kIOS>();
+  testLoadPolyhedronWithDiskCache<OBBRSS>();
+  testLoadPolyhedronWithDiskCache<KDOP<16> >();
+  testLoadPolyhedronWithDiskCache<KDOP<18> >();
+  testLoadPolyhedronWithDiskCache<KDOP<24> >();
+}
+
+BOOST_AUTO_TEST_CASE(load_many_polyhedra)
+{
+  boost::filesystem::path path(TEST_RESOURCES_DIR);
+  std::vector<std::string> filenames;
+  filenames.push_back ((path / "env.obj").string());
+  filenames.push_back ((path / "rob.obj").string());
+  filenames.push_back ((path / "env.obj").string());
+  filenames.push_back ((path / "rob.obj").string());
+  std::vector<Vec3f> scales (filenames.size(), Vec3f::Ones());
+  scales[3] = Vec3f (2, 2, 2);
+
+  CachedMeshLoader loader (BV_OBBRSS);
+  std::vector<BVHModelPtr_t> geoms = loader.loadMany (filenames, scales, 4);
+  BOOST_REQUIRE_EQUAL (geoms.size(), filenames.size());
+  for (std::size_t i = 0; i < geoms.size(); ++i) {
+    BOOST_REQUIRE (geoms[i]);
+    BOOST_CHECK_EQUAL (geoms[i], loader.load (filenames[i], scales[i]));
+  }
+  // Identical requests are loaded once.
+  BOOST_CHECK_EQUAL (geoms[0], geoms[2]);
+  BOOST_CHECK_NE    (geoms[1], geoms[3]);
+  BOOST_CHECK_EQUAL (loader.cache().size(), (std::size_t)3);
+
+  MeshLoader simpleLoader (BV_OBBRSS);
+  geoms = simpleLoader.loadMany (filenames);
+  BOOST_CHECK_NE (geoms[0], geoms[2]);
+  BOOST_CHECK_EQUAL (geoms[0]->num_tris, geoms[2]->num_tris);
+
+  filenames.push_back ((path / "does_not_exist.obj").string());
+  BOOST_CHECK_THROW (loader.loadMany (filenames), std::runtime_error);
+  BOOST_CHECK_THROW (loader.loadMany (filenames, scales), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(cached_mesh_loader_budget)
+{
+  namespace fs = boost::filesystem;
+  fs::path path(TEST_RESOURCES_DIR);
+  const fs::path dir = fs::temp_directory_path()
+    / fs::unique_path("hpp-fcl-meshes-%%%%-%%%%-%%%%");
+  fs::create_directories (dir);
+  const std::string env = (path / "env.obj").string(),
+                    rob = (path / "rob.obj").string(),
+                    env2 = (dir / "env_copy.obj").string();
+  fs::copy_file (env, env2);
+
+  CachedMeshLoader loader (BV_OBBRSS);
+  BVHModelPtr_t P1 = loader.load (env, Vec3f::Ones());
+  BVHModelPtr_t P2 = loader.load (rob, Vec3f::Ones());
+  BOOST_CHECK_EQUAL (P1, loader.load (env, Vec3f::Ones()));
+
+  // Identical content under another path is shared.
+  BOOST_CHECK_EQUAL (P1, loader.load (env2, Vec3f::Ones()));
+  BOOST_CHECK_NE    (P1, loader.load (env2, Vec3f(2, 2, 2)));
+
+  CachedMeshLoader::Statistics stats = loader.statistics();
+  BOOST_CHECK_EQUAL (stats.hits        , 1);
+  BOOST_CHECK_EQUAL (stats.misses      , 4);
+  BOOST_CHECK_EQUAL (stats.deduplicated, 1);
+  BOOST_CHECK_EQUAL (stats.evictions   , 0);
+  BOOST_CHECK_EQUAL (stats.bytes, (std::size_t)(2 * P1->memUsage(0)
+                                                + P2->memUsage(0)));
+  BOOST_CHECK_EQUAL (loader.cache().size(), (std::size_t)4);
+
+  // Only the most recently used polyhedron fits in the budget.
+  loader.load (rob, Vec3f::Ones());
+  loader.setMemoryBudget ((std::size_t)P2->memUsage(0));
+  stats = loader.statistics();
+  BOOST_CHECK_EQUAL (stats.evictions, 3);
+  BOOST_CHECK_EQUAL (stats.bytes, (std::size_t)P2->memUsage(0));
+  BOOST_REQUIRE_EQUAL (loader.cache().size(), (std::size_t)1);
+  BOOST_CHECK_EQUAL (loader.cache().begin()->second, P2);
+
+  // Evicted polyhedra are loaded again.
+  BVHModelPtr_t P3 = loader.load (env, Vec3f::Ones());
+  BOOST_CHECK_NE (P1, P3);
+  BOOST_CHECK_EQUAL (P1->num_tris, P3->num_tris);
+  BOOST_CHECK_EQUAL (loader.cache().size(), (std::size_t)1);
+
+  loader.resetStatistics();
+  stats = loader.statistics();
+  BOOST_CHECK_EQUAL (stats.hits  , 0);
+  BOOST_CHECK_EQUAL (stats.misses, 0);
+  BOOST_CHECK_EQUAL (stats.bytes, (std::size_t)P3->memUsage(0));
+
+  fs::remove_all (dir);
+}
+
 BOOST_AUTO_TEST_CASE (gerard_bauzil)
 {
   testLoadGerardBauzil<OBB>();
@@ -338,3 +671,145 @@ BOOST_AUTO_TEST_CASE (gerard_bauzil)
   testLoadGerardBauzil<kIOS>();
   testLoadGerardBauzil<OBBRSS>();
 }
+
+template<class BoundingVolume>
+void testSaveLoadBVHModel (bool memory_map)
+{
+  boost::filesystem::path path(TEST_RESOURCES_DIR);
+  std::vector<Vec3f> points;
+  std::vector<Triangle> triangles;
+  loadOBJFile((path / "env.obj").string().c_str(), points, triangles);
+
+  typedef BVHModel<BoundingVolume> Polyhedron_t;
+  typedef boost::shared_ptr <Polyhedron_t> PolyhedronPtr_t;
+  PolyhedronPtr_t P1 (new Polyhedron_t), P2;
+  P1->beginModel();
+  P1->addSubModel(points, triangles);
+  P1->endModel();
+
+  std::string filename = (boost::filesystem::temp_directory_path()
+      / boost::filesystem::unique_path("%%%%-%%%%-%%%%.bvh")).string();
+  saveBVHModel (*P1, filename);
+  P2 = boost::dynamic_pointer_cast<Polyhedron_t> (loadBVHModel (filename, memory_map));
+  BOOST_REQUIRE (P2);
+  BOOST_CHECK_EQUAL (P2->isMemoryMapped(), memory_map);
+
+  BOOST_REQUIRE_EQUAL(P1->num_tris    , P2->num_tris);
+  BOOST_REQUIRE_EQUAL(P1->num_vertices, P2->num_vertices);
+  BOOST_REQUIRE_EQUAL(P1->getNumBVs() , P2->getNumBVs());
+  BOOST_CHECK(P1->aabb_local.min_ == P2->aabb_local.min_);
+  BOOST_CHECK(P1->aabb_local.max_ == P2->aabb_local.max_);
+  for (int i = 0; i < P1->num_vertices; ++i)
+    BOOST_CHECK(P1->vertices[i] == P2->vertices[i]);
+  for (int i = 0; i < P1->num_tris; ++i)
+    BOOST_CHECK(P1->tri_indices[i] == P2->tri_indices[i]);
+  for (int i = 0; i < P1->getNumBVs(); ++i) {
+    const BVNode<BoundingVolume>& n1 = P1->getBV(i), n2 = P2->getBV(i);
+    BOOST_CHECK_EQUAL(n1.first_child    , n2.first_child);
+    BOOST_CHECK_EQUAL(n1.first_primitive, n2.first_primitive);
+    BOOST_CHECK_EQUAL(n1.num_primitives , n2.num_primitives);
+  }
+
+  // Both models must give the same collision results.
+  CollisionGeometryPtr_t box (new Box(20, 20, 20));
+  std::vector<Transform3f> transforms;
+  FCL_REAL extents[] = {-200, -200, -200, 200, 200, 200};
+  generateRandomTransforms(extents, transforms, 100);
+  CollisionObject o1 (P1), o2 (P2);
+  for (std::size_t i = 0; i < transforms.size(); ++i) {
+    CollisionObject obj (box, transforms[i]);
+    CollisionRequest request (CONTACT, 1000);
+    CollisionResult r1, r2;
+    collide (&o1, &obj, request, r1);
+    collide (&o2, &obj, request, r2);
+    BOOST_CHECK_EQUAL (r1.numContacts(), r2.numContacts());
+  }
+
+  // Updating a mapped model copies the data in memory first.
+  P2->beginReplaceModel();
+  BOOST_CHECK (!P2->isMemoryMapped());
+  for (int i = 0; i < P1->num_vertices; ++i)
+    P2->replaceVertex(P1->vertices[i] + Vec3f(1, 0, 0));
+  P2->endReplaceModel();
+  BOOST_CHECK (P2->vertices[0] == P1->vertices[0] + Vec3f(1, 0, 0));
+
+  // The mapping may outlive the file.
+  P2 = boost::dynamic_pointer_cast<Polyhedron_t> (loadBVHModel (filename, memory_map));
+  boost::filesystem::remove(filename);
+  BOOST_CHECK (P1->vertices[0] == P2->vertices[0]);
+}
+
+/// Check that both loaders reject a copy of a BVH file where the last
+/// occurrence of the bytes of data is replaced by those of corrupted.
+void checkCorruptedBVHFile (const std::string& filename, const void* data,
+                            const void* corrupted, std::size_t size)
+{
+  std::string content;
+  {
+    std::ifstream is (filename.c_str(), std::ios::binary);
+    content.assign (std::istreambuf_iterator<char> (is),
+                    std::istreambuf_iterator<char> ());
+  }
+  std::size_t position = content.rfind (std::string (static_cast<const char*> (data), size));
+  BOOST_REQUIRE (position != std::string::npos);
+  content.replace (position, size, static_cast<const char*> (corrupted), size);
+
+  std::string corrupted_filename = filename + ".corrupted";
+  {
+    std::ofstream os (corrupted_filename.c_str(), std::ios::binary);
+    os.write (content.data (), (std::streamsize) content.size ());
+  }
+  BOOST_CHECK_THROW (loadBVHModel (corrupted_filename), std::runtime_error);
+  BOOST_CHECK_THROW (loadBVHModel (corrupted_filename, false), std::runtime_error);
+  boost::filesystem::remove (corrupted_filename);
+}
+
+BOOST_AUTO_TEST_CASE (save_load_bvh_model)
+{
+  for (int i = 0; i < 2; ++i) {
+    bool memory_map = (i == 0);
+    testSaveLoadBVHModel<AABB>(memory_map);
+    testSaveLoadBVHModel<OBB>(memory_map);
+    testSaveLoadBVHModel<RSS>(memory_map);
+    testSaveLoadBVHModel<kIOS>(memory_map);
+    testSaveLoadBVHModel<OBBRSS>(memory_map);
+    testSaveLoadBVHModel<KDOP<16> >(memory_map);
+    testSaveLoadBVHModel<KDOP<18> >(memory_map);
+    testSaveLoadBVHModel<KDOP<24> >(memory_map);
+  }
+
+  boost::filesystem::path path(TEST_RESOURCES_DIR);
+  BOOST_CHECK_THROW (loadBVHModel ((path / "env.obj").string()),
+                     std::runtime_error);
+  BOOST_CHECK_THROW (loadBVHModel ((path / "env.obj").string(), false),
+                     std::runtime_error);
+
+  // So are the files whose indices are outside of the arrays.
+  std::vector<Vec3f> points;
+  std::vector<Triangle> triangles;
+  loadOBJFile((path / "env.obj").string().c_str(), points, triangles);
+  BVHModel<OBBRSS> model;
+  model.beginModel();
+  model.addSubModel(points, triangles);
+  model.endModel();
+  std::string filename = (boost::filesystem::temp_directory_path()
+      / boost::filesystem::unique_path("%%%%-%%%%-%%%%.bvh")).string();
+  saveBVHModel (model, filename);
+
+  // A vertex index of the last triangle.
+  const Triangle& triangle = model.tri_indices[model.num_tris - 1];
+  Triangle bad_triangle (triangle[0], triangle[1], (Triangle::index_type) model.num_vertices);
+  checkCorruptedBVHFile (filename, &triangle, &bad_triangle, sizeof (Triangle));
+
+  // The last node, which is a leaf, is given the root as children.
+  const BVNode<OBBRSS>& node = model.getBV(model.getNumBVs() - 1);
+  BOOST_REQUIRE (node.isLeaf());
+  BVNode<OBBRSS> bad_node (node);
+  bad_node.first_child = 0;
+  checkCorruptedBVHFile (filename, &node, &bad_node, sizeof (BVNode<OBBRSS>));
+
+  // A leaf refers to a triangle which does not exist.
+  bad_node.first_child = - model.num_tris - 1;
+  checkCorruptedBVHFile (filename, &node, &bad_node, sizeof (BVNode<OBBRSS>));
+  boost::filesystem::remove (filename);
+}
@@ -46,6 +46,7 @@
 #include <boost/assign/list_of.hpp>
 
 #include <hpp/fcl/collision.h>
+#include <hpp/fcl/distance.h>
 #include <hpp/fcl/BV/BV.h>
 #include <hpp/fcl/shape/geometric_shapes.h>
 #include <hpp/fcl/narrowphase/narrowphase.h>
@@ -610,6 +611,317 @@ BOOST_AUTO_TEST_CASE(mesh_mesh)
   boost::mpl::for_each<BVs_t, wrap<boost::mpl::placeholders::_1> > (runner);
 }
 
+template<typename BV>
+void checkParallelCollision(const std::vector<Vec3f>& p1, const std::vector<Triangle>& t1,
+                            const std::vector<Vec3f>& p2, const std::vector<Triangle>& t2,
+                            const std::vector<Transform3f>& transforms)
+{
+  BVHModel<BV> m1, m2;
+  m1.beginModel(); m1.addSubModel(p1, t1); m1.endModel();
+  m2.beginModel(); m2.addSubModel(p2, t2); m2.endModel();
+
+  size_t max_contacts[] = { 1, 10, num_max_contacts };
+  for(std::size_t i = 0; i < transforms.size(); ++i)
+  {
+    for(int k = 0; k < 3; ++k)
+    {
+      CollisionRequest request (CONTACT, max_contacts[k]);
+      CollisionResult reference, result;
+      collide(&m1, transforms[i], &m2, Transform3f(), request, reference);
+
+      request.num_threads = 4;
+      collide(&m1, transforms[i], &m2, Transform3f(), request, result);
+
+      // The contacts are merged in the order of the sequential traversal.
+      // Contact::o1 and o2 are not compared since for some bounding volumes,
+      // they point to temporary copies of the models.
+      BOOST_CHECK_EQUAL(result.numContacts(), reference.numContacts());
+      for(std::size_t j = 0; j < std::min(result.numContacts(), reference.numContacts()); ++j)
+      {
+        const Contact& c (result.getContact(j)), & r (reference.getContact(j));
+        BOOST_CHECK_EQUAL(c.b1, r.b1);
+        BOOST_CHECK_EQUAL(c.b2, r.b2);
+        BOOST_CHECK_EQUAL(c.pos, r.pos);
+        BOOST_CHECK_EQUAL(c.penetration_depth, r.penetration_depth);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(mesh_mesh_parallel)
+{
+  std::vector<Vec3f> p1, p2;
+  std::vector<Triangle> t1, t2;
+  loadOBJFile(TEST_RESOURCES_DIR "/env.obj", p1, t1);
+  loadOBJFile(TEST_RESOURCES_DIR "/rob.obj", p2, t2);
+
+  std::vector<Transform3f> transforms;
+  FCL_REAL extents[] = {-3000, -3000, 0, 3000, 3000, 3000};
+  generateRandomTransforms(extents, transforms, 10);
+
+  checkParallelCollision<AABB>(p1, t1, p2, t2, transforms);
+  checkParallelCollision<OBBRSS>(p1, t1, p2, t2, transforms);
+}
+
+BOOST_AUTO_TEST_CASE(mesh_mesh_collide_and_distance)
+{
+  BVHModel<OBBRSS> m1, m2;
+  std::vector<Vec3f> p1, p2;
+  std::vector<Triangle> t1, t2;
+  loadOBJFile(TEST_RESOURCES_DIR "/env.obj", p1, t1);
+  loadOBJFile(TEST_RESOURCES_DIR "/rob.obj", p2, t2);
+  m1.beginModel(); m1.addSubModel(p1, t1); m1.endModel();
+  m2.beginModel(); m2.addSubModel(p2, t2); m2.endModel();
+
+  std::vector<Transform3f> transforms;
+  FCL_REAL extents[] = {-3000, -3000, 0, 3000, 3000, 3000};
+  generateRandomTransforms(extents, transforms, 20);
+
+  FCL_REAL security_margins[] = { 0, 10, -1 };
+  std::size_t n_collisions = 0;
+  for(std::size_t i = 0; i < transforms.size(); ++i)
+  {
+    for(int k = 0; k < 3; ++k)
+    {
+      CollisionRequest request (NO_REQUEST, num_max_contacts);
+      request.security_margin = security_margins[k];
+      DistanceRequest distance_request (true);
+      CollisionResult col_reference, col_result;
+      DistanceResult dist_reference, dist_result;
+      collide(&m1, transforms[i], &m2, Transform3f(), request, col_reference);
+      distance(&m1, transforms[i], &m2, Transform3f(), distance_request,
+               dist_reference);
+
+      std::size_t n = collideAndDistance(&m1, transforms[i], &m2, Transform3f(),
+          request, col_result, distance_request, dist_result);
+      BOOST_CHECK_EQUAL(n, col_result.numContacts());
+
+      // The traversals differ: compare the sets of colliding triangles.
+      std::vector<std::pair<int, int> > pairs, pairs_ref;
+      for(std::size_t j = 0; j < col_result.numContacts(); ++j)
+        pairs.push_back(std::make_pair(col_result.getContact(j).b1,
+                                       col_result.getContact(j).b2));
+      for(std::size_t j = 0; j < col_reference.numContacts(); ++j)
+        pairs_ref.push_back(std::make_pair(col_reference.getContact(j).b1,
+                                           col_reference.getContact(j).b2));
+      std::sort(pairs.begin(), pairs.end());
+      std::sort(pairs_ref.begin(), pairs_ref.end());
+      BOOST_CHECK(pairs == pairs_ref);
+      if(col_result.isCollision()) ++n_collisions;
+
+      BOOST_CHECK_CLOSE(dist_result.min_distance + 1, dist_reference.min_distance + 1, 1e-6);
+      if(dist_result.min_distance > 0)
+      {
+        EIGEN_VECTOR_IS_APPROX(dist_result.nearest_points[0], dist_reference.nearest_points[0], 1e-6);
+        EIGEN_VECTOR_IS_APPROX(dist_result.nearest_points[1], dist_reference.nearest_points[1], 1e-6);
+      }
+      if(!col_result.isCollision())
+        BOOST_CHECK_CLOSE(col_result.distance_lower_bound, dist_result.min_distance, 1e-6);
+
+      // With a relative error, the distance is only an upper bound but the
+      // lower bound of the collision result stays a lower bound.
+      distance_request.rel_err = .5;
+      col_result.clear();
+      dist_result.clear();
+      collideAndDistance(&m1, transforms[i], &m2, Transform3f(),
+          request, col_result, distance_request, dist_result);
+      if(!col_result.isCollision())
+        BOOST_CHECK(col_result.distance_lower_bound
+                    <= dist_reference.min_distance + 1e-6);
+    }
+  }
+  BOOST_CHECK(n_collisions > 0);
+}
+
+BOOST_AUTO_TEST_CASE(triangle_triangle_intersection)
+{
+  // Compare the separating axis test with the triangle distance.
+  std::size_t n_collisions = 0;
+  for(int i = 0; i < 10000; ++i)
+  {
+    Vec3f P[3], Q[3];
+    for(int j = 0; j < 3; ++j)
+    {
+      P[j] = Vec3f(rand_interval(0, 1), rand_interval(0, 1), rand_interval(0, 1));
+      Q[j] = Vec3f(rand_interval(0, 1), rand_interval(0, 1), rand_interval(0, 1)) + Vec3f(.5, 0, 0);
+    }
+    // Coplanar triangles.
+    if(i % 10 == 0)
+      for(int j = 0; j < 3; ++j) { P[j][2] = 0; Q[j][2] = 0; }
+
+    Vec3f p, q;
+    FCL_REAL sqrDist = TriangleDistance::sqrTriDistance(P, Q, p, q);
+    FCL_REAL sqrDistLowerBound = -1;
+    bool collision = Intersect::intersectTriangles(P[0], P[1], P[2],
+        Q[0], Q[1], Q[2], &sqrDistLowerBound);
+    if(sqrDist > 1e-12 && sqrDist < 1e-8) continue; // touching triangles
+    BOOST_CHECK_EQUAL(collision, sqrDist <= 1e-12);
+    if(collision)
+      ++n_collisions;
+    else
+      BOOST_CHECK(sqrDistLowerBound > 0 && sqrDistLowerBound <= sqrDist * (1 + 1e-8));
+  }
+  BOOST_CHECK(n_collisions > 0);
+}
+
+BOOST_AUTO_TEST_CASE(triangle_box_intersection)
+{
+  // Compare the separating axis test with the distance to the faces of the
+  // box.
+  const Vec3f halfSide (.3, .2, .1);
+  Vec3f C[8];
+  for(int k = 0; k < 8; ++k)
+    C[k] = Vec3f((k & 1) ? halfSide[0] : -halfSide[0],
+                 (k & 2) ? halfSide[1] : -halfSide[1],
+                 (k & 4) ? halfSide[2] : -halfSide[2]);
+  // Two triangles per face of the box.
+  const int faces[12][3] = {
+    {0, 1, 3}, {0, 3, 2}, {4, 5, 7}, {4, 7, 6}, {0, 1, 5}, {0, 5, 4},
+    {2, 3, 7}, {2, 7, 6}, {0, 2, 6}, {0, 6, 4}, {1, 3, 7}, {1, 7, 5} };
+
+  std::size_t n_collisions = 0;
+  for(int i = 0; i < 10000; ++i)
+  {
+    Vec3f P[3];
+    for(int j = 0; j < 3; ++j)
+      P[j] = Vec3f(rand_interval(-1, 1), rand_interval(-1, 1), rand_interval(-1, 1));
+    FCL_REAL margin = (i % 2 == 0) ? 0 : rand_interval(0, .2);
+
+    FCL_REAL sqrDist = std::numeric_limits<FCL_REAL>::max();
+    for(int j = 0; j < 3; ++j)
+      if((P[j].cwiseAbs().array() <= halfSide.array()).all())
+        sqrDist = 0;
+    Vec3f p, q;
+    for(int f = 0; f < 12; ++f)
+      sqrDist = std::min(sqrDist, TriangleDistance::sqrTriDistance(
+            P[0], P[1], P[2], C[faces[f][0]], C[faces[f][1]], C[faces[f][2]],
+            p, q));
+
+    FCL_REAL sqrDistLowerBound = -1;
+    bool overlap = Intersect::intersectTriangleBox(P[0], P[1], P[2],
+        halfSide, margin, &sqrDistLowerBound);
+    FCL_REAL dist = sqrt(sqrDist);
+    if(std::abs(dist - margin) < 1e-6) continue; // touching
+    if(dist < margin)
+      BOOST_CHECK(overlap);
+    if(margin == 0)
+      BOOST_CHECK_EQUAL(overlap, dist <= margin);
+    if(overlap)
+      ++n_collisions;
+    else
+      BOOST_CHECK(sqrDistLowerBound > margin * margin
+          && sqrDistLowerBound <= sqrDist * (1 + 1e-8));
+  }
+  BOOST_CHECK(n_collisions > 0);
+}
+
+BOOST_AUTO_TEST_CASE(segment_box_distance)
+{
+  // Compare with the distance of points sampled along the segment.
+  const Vec3f halfSide (.3, .2, .1);
+  const int n = 1000;
+  std::size_t n_collisions = 0;
+  for(int i = 0; i < 1000; ++i)
+  {
+    Vec3f P1 (rand_interval(-1, 1), rand_interval(-1, 1), rand_interval(-1, 1)),
+          P2 (rand_interval(-1, 1), rand_interval(-1, 1), rand_interval(-1, 1));
+    if(i == 0) P2 = P1;
+
+    FCL_REAL sqrDist = std::numeric_limits<FCL_REAL>::max();
+    for(int k = 0; k <= n; ++k)
+    {
+      Vec3f p (P1 + (P2 - P1) * ((FCL_REAL)k / n));
+      sqrDist = std::min(sqrDist,
+          (p.cwiseAbs() - halfSide).cwiseMax(0).squaredNorm());
+    }
+
+    FCL_REAL d = std::sqrt(Intersect::sqrDistanceSegmentBox(P1, P2, halfSide));
+    FCL_REAL step = (P2 - P1).norm() / n;
+    BOOST_CHECK(d <= std::sqrt(sqrDist) + 1e-10);
+    BOOST_CHECK(d >= std::sqrt(sqrDist) - step);
+    if(d == 0) ++n_collisions;
+  }
+  BOOST_CHECK(n_collisions > 0);
+}
+
+BOOST_AUTO_TEST_CASE(mesh_mesh_without_contact_information)
+{
+  // The leaf tests do not use GJK when the contact information is not
+  // requested. The same pairs of triangles must be found in collision.
+  BVHModel<OBBRSS> m1, m2;
+  std::vector<Vec3f> p1, p2;
+  std::vector<Triangle> t1, t2;
+  loadOBJFile(TEST_RESOURCES_DIR "/env.obj", p1, t1);
+  loadOBJFile(TEST_RESOURCES_DIR "/rob.obj", p2, t2);
+  m1.beginModel(); m1.addSubModel(p1, t1); m1.endModel();
+  m2.beginModel(); m2.addSubModel(p2, t2); m2.endModel();
+
+  std::vector<Transform3f> transforms;
+  FCL_REAL extents[] = {-3000, -3000, 0, 3000, 3000, 3000};
+  generateRandomTransforms(extents, transforms, 10);
+
+  for(std::size_t i = 0; i < transforms.size(); ++i)
+  {
+    CollisionRequest request (CONTACT, num_max_contacts);
+    CollisionResult reference;
+    collide(&m1, transforms[i], &m2, Transform3f(), request, reference);
+
+    request.enable_contact = false;
+    CollisionResult result;
+    collide(&m1, transforms[i], &m2, Transform3f(), request, result);
+    BOOST_CHECK_EQUAL(result.numContacts(), reference.numContacts());
+
+    request.enable_distance_lower_bound = true;
+    CollisionResult result_lb;
+    collide(&m1, transforms[i], &m2, Transform3f(), request, result_lb);
+    BOOST_CHECK_EQUAL(result_lb.numContacts(), reference.numContacts());
+    if(!result_lb.isCollision())
+      BOOST_CHECK(result_lb.distance_lower_bound > 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(mesh_mesh_negative_security_margin)
+{
+  // The second triangle crosses the first one and goes 1 below it: the
+  // triangles are in collision for a security margin above -1, with or
+  // without the contact information.
+  BVHModel<OBBRSS> m1, m2;
+  std::vector<Vec3f> p1, p2;
+  std::vector<Triangle> t1 (1, Triangle (0, 1, 2)), t2 (t1);
+  p1.push_back(Vec3f(-10, -10, 0));
+  p1.push_back(Vec3f( 10, -10, 0));
+  p1.push_back(Vec3f(  0,  10, 0));
+  p2.push_back(Vec3f( 0, 0, -1));
+  p2.push_back(Vec3f( 1, 0,  5));
+  p2.push_back(Vec3f(-1, 0,  5));
+  m1.beginModel(); m1.addSubModel(p1, t1); m1.endModel();
+  m2.beginModel(); m2.addSubModel(p2, t2); m2.endModel();
+
+  FCL_REAL security_margins[] = { -.5, -2 };
+  for(int k = 0; k < 2; ++k)
+  {
+    for(int contact = 0; contact < 2; ++contact)
+    {
+      CollisionRequest request (contact ? CONTACT : NO_REQUEST, 1);
+      request.security_margin = security_margins[k];
+      CollisionResult result;
+      collide(&m1, Transform3f(), &m2, Transform3f(), request, result);
+      BOOST_CHECK_EQUAL(result.isCollision(), k == 0);
+      if(result.isCollision())
+        BOOST_CHECK_CLOSE(result.getContact(0).penetration_depth, 1, 1e-3);
+
+      // The combined query agrees with the collision query.
+      CollisionResult col_result;
+      DistanceResult dist_result;
+      collideAndDistance(&m1, Transform3f(), &m2, Transform3f(), request,
+          col_result, DistanceRequest(), dist_result);
+      BOOST_CHECK_EQUAL(col_result.isCollision(), result.isCollision());
+      if(col_result.isCollision() && contact)
+        BOOST_CHECK_CLOSE(col_result.getContact(0).penetration_depth, 1, 1e-3);
+    }
+  }
+}
+
 BOOST_AUTO_TEST_CASE(mesh_mesh_benchmark)
 {
   std::vector<Transform3f> transforms;
@@ -40,9 +40,12 @@
 #include <boost/timer.hpp>
 #include <boost/filesystem.hpp>
 
+#include <hpp/fcl/collision.h>
+#include <hpp/fcl/distance.h>
 #include <hpp/fcl/internal/traversal_node_bvhs.h>
 #include <hpp/fcl/internal/traversal_node_setup.h>
 #include "../src/collision_node.h"
+#include <hpp/fcl/internal/traversal_recurse.h>
 #include <hpp/fcl/internal/BV_splitter.h>
 
 #include "utility.h"
@@ -68,6 +71,227 @@ bool collide_Test_OBB(const Transform3f& tf,
                       const std::vector<Vec3f>& vertices2, const std::vector<Triangle>& triangles2, SplitMethodType split_method, bool verbose);
 
 
+template<typename BV>
+void checkParallelDistance(const std::vector<Vec3f>& p1, const std::vector<Triangle>& t1,
+                           const std::vector<Vec3f>& p2, const std::vector<Triangle>& t2,
+                           const std::vector<Transform3f>& transforms)
+{
+  BVHModel<BV> m1, m2;
+  m1.beginModel(); m1.addSubModel(p1, t1); m1.endModel();
+  m2.beginModel(); m2.addSubModel(p2, t2); m2.endModel();
+
+  for(std::size_t i = 0; i < transforms.size(); ++i)
+  {
+    DistanceRequest request (true);
+    DistanceResult reference, result;
+    distance(&m1, transforms[i], &m2, Transform3f(), request, reference);
+
+    request.num_threads = 4;
+    distance(&m1, transforms[i], &m2, Transform3f(), request, result);
+    BOOST_CHECK_EQUAL(result.min_distance, reference.min_distance);
+    // The nearest points are not computed when the meshes collide.
+    if(result.min_distance > 0)
+      BOOST_CHECK_SMALL((result.nearest_points[0] - result.nearest_points[1]).norm()
+                        - result.min_distance, 1e-6);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(mesh_distance_parallel)
+{
+  std::vector<Vec3f> p1, p2;
+  std::vector<Triangle> t1, t2;
+  boost::filesystem::path path(TEST_RESOURCES_DIR);
+  loadOBJFile((path / "env.obj").string().c_str(), p1, t1);
+  loadOBJFile((path / "rob.obj").string().c_str(), p2, t2);
+
+  std::vector<Transform3f> transforms;
+  FCL_REAL extents[] = {-3000, -3000, 0, 3000, 3000, 3000};
+  generateRandomTransforms(extents, transforms, 10);
+
+  checkParallelDistance<AABB>(p1, t1, p2, t2, transforms);
+  checkParallelDistance<RSS>(p1, t1, p2, t2, transforms);
+  checkParallelDistance<OBBRSS>(p1, t1, p2, t2, transforms);
+}
+
+template<typename BV>
+void checkClosestPairs(const std::vector<Vec3f>& p1, const std::vector<Triangle>& t1,
+                       const std::vector<Vec3f>& p2, const std::vector<Triangle>& t2,
+                       const std::vector<Transform3f>& transforms)
+{
+  BVHModel<BV> m1, m2;
+  m1.beginModel(); m1.addSubModel(p1, t1); m1.endModel();
+  m2.beginModel(); m2.addSubModel(p2, t2); m2.endModel();
+
+  for(std::size_t i = 0; i < transforms.size(); ++i)
+  {
+    // Distances of all the pairs of triangles.
+    std::vector<FCL_REAL> distances;
+    distances.reserve(t1.size() * t2.size());
+    for(std::size_t j = 0; j < t1.size(); ++j)
+    {
+      Vec3f P[3];
+      for(int k = 0; k < 3; ++k) P[k] = transforms[i].transform(p1[t1[j][k]]);
+      for(std::size_t l = 0; l < t2.size(); ++l)
+      {
+        Vec3f Q[3] = { p2[t2[l][0]], p2[t2[l][1]], p2[t2[l][2]] }, p, q;
+        distances.push_back(sqrt(TriangleDistance::sqrTriDistance(P, Q, p, q)));
+      }
+    }
+    std::sort(distances.begin(), distances.end());
+
+    DistanceRequest request (true);
+    request.num_closest_pairs = 10;
+    DistanceResult result;
+    distance(&m1, transforms[i], &m2, Transform3f(), request, result);
+    BOOST_REQUIRE_EQUAL(result.closest_pairs.size(), request.num_closest_pairs);
+    BOOST_CHECK_CLOSE(result.closest_pairs[0].distance + 1, result.min_distance + 1, 1e-8);
+    for(std::size_t j = 0; j < result.closest_pairs.size(); ++j)
+    {
+      const DistancePair& pair (result.closest_pairs[j]);
+      BOOST_CHECK_CLOSE(pair.distance + 1, distances[j] + 1, 1e-6);
+      // The nearest points are not computed for intersecting triangles.
+      if(pair.distance > 0)
+        BOOST_CHECK_SMALL((pair.nearest_points[0] - pair.nearest_points[1]).norm()
+                          - pair.distance, 1e-6);
+      for(std::size_t k = 0; k < j; ++k)
+        BOOST_CHECK(pair.b1 != result.closest_pairs[k].b1
+                    || pair.b2 != result.closest_pairs[k].b2);
+    }
+
+    // All the pairs closer than a threshold.
+    request.num_closest_pairs = std::numeric_limits<std::size_t>::max();
+    request.closest_pairs_max_distance = distances[0] + 100;
+    result.clear();
+    distance(&m1, transforms[i], &m2, Transform3f(), request, result);
+    std::size_t n = (std::size_t)(std::upper_bound(distances.begin(), distances.end(),
+          request.closest_pairs_max_distance) - distances.begin());
+    BOOST_CHECK_EQUAL(result.closest_pairs.size(), n);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(mesh_distance_closest_pairs)
+{
+  std::vector<Vec3f> p1, p2;
+  std::vector<Triangle> t1, t2;
+  boost::filesystem::path path(TEST_RESOURCES_DIR);
+  loadOBJFile((path / "env.obj").string().c_str(), p1, t1);
+  loadOBJFile((path / "rob.obj").string().c_str(), p2, t2);
+
+  std::vector<Transform3f> transforms;
+  FCL_REAL extents[] = {-3000, -3000, 0, 3000, 3000, 3000};
+  generateRandomTransforms(extents, transforms, 3);
+
+  checkClosestPairs<AABB>(p1, t1, p2, t2, transforms);
+  checkClosestPairs<OBBRSS>(p1, t1, p2, t2, transforms);
+}
+
+template<typename BV>
+void checkBudget(const std::vector<Vec3f>& p1, const std::vector<Triangle>& t1,
+                 const std::vector<Vec3f>& p2, const std::vector<Triangle>& t2,
+                 const std::vector<Transform3f>& transforms)
+{
+  BVHModel<BV> m1, m2;
+  m1.beginModel(); m1.addSubModel(p1, t1); m1.endModel();
+  m2.beginModel(); m2.addSubModel(p2, t2); m2.endModel();
+
+  for(std::size_t i = 0; i < transforms.size(); ++i)
+  {
+    DistanceRequest request (true);
+    DistanceResult reference;
+    distance(&m1, transforms[i], &m2, Transform3f(), request, reference);
+    BOOST_CHECK(reference.completed);
+    BOOST_CHECK_EQUAL(reference.distance_lower_bound, reference.min_distance);
+
+    // The traversal is interrupted and returns bounds of the distance.
+    request.max_traversal_iterations = 10;
+    DistanceResult result;
+    distance(&m1, transforms[i], &m2, Transform3f(), request, result);
+    BOOST_CHECK(!result.completed);
+    BOOST_CHECK(result.distance_lower_bound <= reference.min_distance + 1e-8);
+    BOOST_CHECK(reference.min_distance <= result.min_distance + 1e-8);
+
+    CollisionRequest col_request (CONTACT, 1);
+    col_request.max_traversal_iterations = 10;
+    CollisionResult col_result;
+    collide(&m1, transforms[i], &m2, Transform3f(), col_request, col_result);
+    // Disjoint root bounding volumes complete the traversal immediately.
+    if(!col_result.completed)
+      BOOST_CHECK_EQUAL(col_result.distance_lower_bound, 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(mesh_distance_budget)
+{
+  std::vector<Vec3f> p1, p2;
+  std::vector<Triangle> t1, t2;
+  boost::filesystem::path path(TEST_RESOURCES_DIR);
+  loadOBJFile((path / "env.obj").string().c_str(), p1, t1);
+  loadOBJFile((path / "rob.obj").string().c_str(), p2, t2);
+
+  std::vector<Transform3f> transforms;
+  FCL_REAL extents[] = {-3000, -3000, 0, 3000, 3000, 3000};
+  generateRandomTransforms(extents, transforms, 10);
+
+  checkBudget<RSS>(p1, t1, p2, t2, transforms);
+  checkBudget<OBBRSS>(p1, t1, p2, t2, transforms);
+}
+
+BOOST_AUTO_TEST_CASE(query_statistics)
+{
+  std::vector<Vec3f> p1, p2;
+  std::vector<Triangle> t1, t2;
+  boost::filesystem::path path(TEST_RESOURCES_DIR);
+  loadOBJFile((path / "env.obj").string().c_str(), p1, t1);
+  loadOBJFile((path / "rob.obj").string().c_str(), p2, t2);
+
+  BVHModel<OBBRSS> m1, m2;
+  m1.beginModel(); m1.addSubModel(p1, t1); m1.endModel();
+  m2.beginModel(); m2.addSubModel(p2, t2); m2.endModel();
+
+  std::vector<Transform3f> transforms;
+  FCL_REAL extents[] = {-3000, -3000, 0, 3000, 3000, 3000};
+  generateRandomTransforms(extents, transforms, 5);
+
+  for(std::size_t i = 0; i < transforms.size(); ++i)
+  {
+    DistanceRequest request (true);
+    DistanceResult result;
+    distance(&m1, transforms[i], &m2, Transform3f(), request, result);
+    BOOST_CHECK(result.statistics == QueryStatistics());
+
+    request.enable_statistics = true;
+    result.clear();
+    distance(&m1, transforms[i], &m2, Transform3f(), request, result);
+    BOOST_CHECK(result.statistics.num_bv_tests > 0);
+    BOOST_CHECK(result.statistics.num_leaf_tests > 0);
+    BOOST_CHECK(result.statistics.time >= 0);
+
+    // The tests of all the threads are counted.
+    request.num_threads = 2;
+    DistanceResult parallel_result;
+    distance(&m1, transforms[i], &m2, Transform3f(), request, parallel_result);
+    BOOST_CHECK(parallel_result.statistics.num_bv_tests > 0);
+    BOOST_CHECK(parallel_result.statistics.num_leaf_tests > 0);
+  }
+
+  // GJK and EPA between penetrating shapes.
+  Box box (1, 1, 1);
+  Cone cone (1, 2);
+  CollisionRequest request (CONTACT, 1);
+  request.enable_statistics = true;
+  CollisionResult result;
+  collide(&box, Transform3f(), &cone, Transform3f(Vec3f(0, 0, .5)),
+          request, result);
+  BOOST_CHECK(result.isCollision());
+  BOOST_CHECK_EQUAL(result.statistics.num_gjk_calls, 1);
+  BOOST_CHECK_EQUAL(result.statistics.num_epa_calls, 1);
+  BOOST_CHECK(result.statistics.num_epa_iterations > 0);
+  BOOST_CHECK(result.statistics.num_support_calls
+              > result.statistics.num_gjk_iterations);
+  result.clear();
+  BOOST_CHECK(result.statistics == QueryStatistics());
+}
+
 template<typename BV, typename TraversalNode>
 void distance_Test_Oriented(const Transform3f& tf,
                             const std::vector<Vec3f>& vertices1, const std::vector<Triangle>& triangles1,
@@ -331,6 +555,63 @@ BOOST_AUTO_TEST_CASE(mesh_distance)
   BOOST_TEST_MESSAGE("collision timing: " << col_time << " sec");
 }
 
+BOOST_AUTO_TEST_CASE(mesh_distance_workspace)
+{
+  std::vector<Vec3f> p1, p2;
+  std::vector<Triangle> t1, t2;
+  boost::filesystem::path path(TEST_RESOURCES_DIR);
+  loadOBJFile((path / "env.obj").string().c_str(), p1, t1);
+  loadOBJFile((path / "rob.obj").string().c_str(), p2, t2);
+
+  BVHModel<RSS> m1, m2;
+  m1.beginModel();
+  m1.addSubModel(p1, t1);
+  m1.endModel();
+  m2.beginModel();
+  m2.addSubModel(p2, t2);
+  m2.endModel();
+
+  std::vector<Transform3f> transforms;
+  FCL_REAL extents[] = {-3000, -3000, 0, 3000, 3000, 3000};
+  generateRandomTransforms(extents, transforms, 20);
+
+  // The same workspace is reused by all the queries.
+  DistanceTraversalWorkspace workspace;
+  // ComputeDistance reuses its own workspace, a copy has another one.
+  ComputeDistance calc_distance (&m1, &m2);
+  ComputeDistance calc_distance_copy (calc_distance);
+  for(std::size_t i = 0; i < transforms.size(); ++i)
+  {
+    DistanceResult reference;
+    MeshDistanceTraversalNodeRSS node;
+    initialize(node, m1, transforms[i], m2, Transform3f(), DistanceRequest(true), reference);
+    node.preprocess();
+    distanceRecurse(&node, 0, 0, NULL);
+    node.postprocess();
+
+    int qsizes[] = { 2, 20 };
+    for(int k = 0; k < 2; ++k)
+    {
+      DistanceResult result, static_result;
+      MeshDistanceTraversalNodeRSS node1, node2;
+      initialize(node1, m1, transforms[i], m2, Transform3f(), DistanceRequest(true), result);
+      distance(&node1, workspace, NULL, qsizes[k]);
+      BOOST_CHECK_CLOSE(result.min_distance, reference.min_distance, 1e-6);
+
+      initialize(node2, m1, transforms[i], m2, Transform3f(), DistanceRequest(true), static_result);
+      staticDistance(node2, workspace, NULL, qsizes[k]);
+      BOOST_CHECK_EQUAL(static_result.min_distance, result.min_distance);
+      BOOST_CHECK(workspace.stack.empty());
+    }
+
+    DistanceResult result, copy_result;
+    calc_distance (transforms[i], Transform3f(), DistanceRequest(true), result);
+    BOOST_CHECK_CLOSE(result.min_distance, reference.min_distance, 1e-6);
+    calc_distance_copy (transforms[i], Transform3f(), DistanceRequest(true), copy_result);
+    BOOST_CHECK_EQUAL(copy_result.min_distance, result.min_distance);
+  }
+}
+
 template<typename BV, typename TraversalNode>
 void distance_Test_Oriented(const Transform3f& tf,
                             const std::vector<Vec3f>& vertices1, const std::vector<Triangle>& triangles1,
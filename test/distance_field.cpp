@@ -0,0 +1,301 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define BOOST_TEST_MODULE FCL_DISTANCE_FIELD
+#include <boost/test/included/unit_test.hpp>
+
+#include <hpp/fcl/distance_field.h>
+#include <hpp/fcl/collision.h>
+#include <hpp/fcl/distance.h>
+
+#include "utility.h"
+
+using namespace hpp::fcl;
+
+typedef std::vector<boost::array<FCL_REAL, 6> > Boxes_t;
+
+/// Occupy randomly the cells of a 8x8x8 grid of cells of size resolution.
+std::vector<Vec3f> makeCells (FCL_REAL resolution)
+{
+  std::vector<Vec3f> points;
+  for (int i = 0; i < 8; ++i)
+    for (int j = 0; j < 8; ++j)
+      for (int k = 0; k < 8; ++k)
+        if (rand_interval (0, 1) < 0.1)
+          points.push_back (resolution * Vec3f (i - 4 + .5, j - 4 + .5, k - 4 + .5));
+  return points;
+}
+
+/// Distance between a point and the nearest box, 0 inside the boxes.
+FCL_REAL distanceBoxes (const Boxes_t& boxes, const Vec3f& p)
+{
+  FCL_REAL d = std::numeric_limits<FCL_REAL>::max();
+  for (std::size_t i = 0; i < boxes.size (); ++i) {
+    Vec3f v;
+    for (int a = 0; a < 3; ++a)
+      v[a] = std::max (std::abs (p[a] - boxes[i][a]) - boxes[i][3] / 2, 0.);
+    d = std::min (d, v.norm ());
+  }
+  return d;
+}
+
+Vec3f voxelCenter (const DistanceField& field, std::size_t i, std::size_t j,
+                   std::size_t k)
+{
+  return field.getBounds ().min_ + field.getResolution () *
+    Vec3f ((FCL_REAL) i + .5, (FCL_REAL) j + .5, (FCL_REAL) k + .5);
+}
+
+const FCL_REAL resolution (0.1);
+const AABB bounds (Vec3f (-.6, -.6, -.6), Vec3f (.6, .6, .6));
+
+BOOST_AUTO_TEST_CASE(voxels)
+{
+  LinearOcTree tree (resolution, makeCells (resolution));
+  Boxes_t boxes (tree.toBoxes ());
+  const FCL_REAL res (resolution / 2), max_distance (.3);
+  DistanceField field (tree, res, bounds, max_distance);
+
+  BOOST_CHECK_EQUAL (field.getNodeType (), GEOM_DISTANCE_FIELD);
+  for (int a = 0; a < 3; ++a)
+    BOOST_CHECK_EQUAL (field.getSize (a), 24u);
+
+  for (std::size_t i = 0; i < field.getSize (0); ++i)
+    for (std::size_t j = 0; j < field.getSize (1); ++j)
+      for (std::size_t k = 0; k < field.getSize (2); ++k) {
+        FCL_REAL d = distanceBoxes (boxes, voxelCenter (field, i, j, k));
+        FCL_REAL value = field.getVoxelDistance (i, j, k);
+        BOOST_CHECK_EQUAL (field.isVoxelOccupied (i, j, k), d == 0);
+        BOOST_CHECK_EQUAL (field.isVoxelOccupied (i, j, k), value < 0);
+        BOOST_CHECK (value <= (float) max_distance);
+        if (d > 0 && d < max_distance - res)
+          BOOST_CHECK_SMALL (value - d, res);
+      }
+}
+
+BOOST_AUTO_TEST_CASE(gradient)
+{
+  LinearOcTree tree (resolution, makeCells (resolution));
+  DistanceField field (tree, resolution / 2, bounds, .3);
+
+  const FCL_REAL h (1e-6);
+  for (int n = 0; n < 1000; ++n) {
+    Vec3f p (rand_interval (-.7, .7), rand_interval (-.7, .7),
+             rand_interval (-.7, .7));
+    Vec3f gradient;
+    FCL_REAL d = field.distance (p, &gradient);
+    BOOST_CHECK_EQUAL (d, field.distance (p));
+    for (int a = 0; a < 3; ++a) {
+      Vec3f dp (Vec3f::Zero ());
+      dp[a] = h;
+      FCL_REAL fd ((field.distance (p + dp) - field.distance (p - dp)) / (2 * h));
+      BOOST_CHECK_SMALL (fd - gradient[a], 1e-4);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(update)
+{
+  std::vector<Vec3f> points (makeCells (resolution));
+  LinearOcTree tree (resolution, points);
+  const FCL_REAL res (resolution / 2), max_distance (.2);
+  DistanceField field (tree, res, bounds, max_distance);
+
+  // Change the cells of a corner of the map.
+  AABB region (Vec3f (-.4, -.4, -.4), Vec3f (-.1, -.1, -.1));
+  std::vector<Vec3f> changed;
+  for (std::size_t i = 0; i < points.size (); ++i)
+    if (!region.contain (points[i])) changed.push_back (points[i]);
+  for (int n = 0; n < 5; ++n)
+    changed.push_back (Vec3f (rand_interval (-.4, -.1), rand_interval (-.4, -.1),
+                              rand_interval (-.4, -.1)));
+  LinearOcTree changed_tree (resolution, changed);
+
+  field.update (changed_tree, region);
+  DistanceField expected (changed_tree, res, bounds, max_distance);
+  for (std::size_t i = 0; i < field.getSize (0); ++i)
+    for (std::size_t j = 0; j < field.getSize (1); ++j)
+      for (std::size_t k = 0; k < field.getSize (2); ++k) {
+        BOOST_CHECK_EQUAL (field.isVoxelOccupied (i, j, k),
+                           expected.isVoxelOccupied (i, j, k));
+        BOOST_CHECK_EQUAL (field.getVoxelDistance (i, j, k),
+                           expected.getVoxelDistance (i, j, k));
+      }
+}
+
+BOOST_AUTO_TEST_CASE(spheres_and_capsules)
+{
+  LinearOcTree tree (resolution, makeCells (resolution));
+  const FCL_REAL res (resolution / 2), max_distance (.3);
+  DistanceField field (tree, res, bounds, max_distance);
+
+  Sphere sphere (.05);
+  Capsule capsule (.05, .2);
+  CollisionRequest collisionRequest;
+  DistanceRequest distanceRequest (true);
+
+  std::vector<Vec3f> centers, a, b;
+  std::vector<FCL_REAL> radii, distances;
+  std::vector<Vec3f> gradients;
+  FCL_REAL extents[] = {-0.5, -0.5, -0.5, 0.5, 0.5, 0.5};
+  std::vector<Transform3f> transforms;
+  generateRandomTransforms (extents, transforms, 100);
+  Transform3f tfField;
+  tfField.setQuatRotation (Quaternion3f (.5, .5, .5, .5));
+  tfField.setTranslation (Vec3f (.1, -.2, .3));
+
+  for (std::size_t n = 0; n < 100; ++n) {
+    const Transform3f& tf (transforms[n]);
+    Transform3f tfShape (tfField * tf);
+
+    const CollisionGeometry* shapes[2] = { &sphere, &capsule };
+    const Vec3f u (capsule.halfLength * tf.getRotation ().col (2));
+    FCL_REAL expected[2] = {
+      field.sphereDistance (tf.getTranslation (), sphere.radius),
+      field.capsuleDistance (tf.getTranslation () - u, tf.getTranslation () + u,
+                             capsule.radius) };
+    bool truncated[2];
+    Vec3f p1, p2, normal;
+    field.shapeDistance (sphere, tf, p1, p2, normal, &truncated[0]);
+    field.shapeDistance (capsule, tf, p1, p2, normal, &truncated[1]);
+    const FCL_REAL lower_bounds[2] = { max_distance - sphere.radius,
+                                       max_distance - capsule.radius };
+    centers.push_back (tf.getTranslation ());
+    a.push_back (tf.getTranslation () - u);
+    b.push_back (tf.getTranslation () + u);
+
+    for (int s = 0; s < 2; ++s) {
+      CollisionResult result;
+      bool res1 = collide (&field, tfField, shapes[s], tfShape,
+                           collisionRequest, result) > 0;
+      BOOST_CHECK_EQUAL (res1, expected[s] <= 0);
+      result.clear ();
+      bool res2 = collide (shapes[s], tfShape, &field, tfField,
+                           collisionRequest, result) > 0;
+      BOOST_CHECK_EQUAL (res2, expected[s] <= 0);
+
+      // Beyond the maximal distance, only a lower bound is known.
+      DistanceResult distanceResult;
+      if (truncated[s]) {
+        FCL_REAL d = distance (&field, tfField, shapes[s], tfShape,
+                               distanceRequest, distanceResult);
+        BOOST_CHECK_EQUAL (d, std::numeric_limits<FCL_REAL>::max ());
+        BOOST_CHECK_CLOSE (distanceResult.distance_lower_bound,
+                           lower_bounds[s], 1e-6);
+        continue;
+      }
+
+      // The nearest points are separated by the distance along the normal,
+      // which points from the first object to the second one.
+      FCL_REAL d1 = distance (&field, tfField, shapes[s], tfShape,
+                              distanceRequest, distanceResult);
+      BOOST_CHECK_CLOSE (d1, expected[s], 1e-6);
+      BOOST_CHECK (((distanceResult.nearest_points[1] - distanceResult.nearest_points[0])
+                    - d1 * distanceResult.normal).isZero (1e-8));
+      distanceResult.clear ();
+      FCL_REAL d2 = distance (shapes[s], tfShape, &field, tfField,
+                              distanceRequest, distanceResult);
+      BOOST_CHECK_CLOSE (d2, expected[s], 1e-6);
+      BOOST_CHECK (((distanceResult.nearest_points[1] - distanceResult.nearest_points[0])
+                    - d2 * distanceResult.normal).isZero (1e-8));
+
+      // The distance field approximates the distance to the octree.
+      if (expected[s] < max_distance - 2 * res) {
+        distanceResult.clear ();
+        FCL_REAL d = distance (&tree, tfField, shapes[s], tfShape,
+                               distanceRequest, distanceResult);
+        if (d > 0) BOOST_CHECK_SMALL (d - expected[s], 2 * res);
+      }
+    }
+  }
+
+  radii.assign (centers.size (), sphere.radius);
+  field.sphereDistances (centers, radii, distances, &gradients);
+  BOOST_REQUIRE_EQUAL (distances.size (), centers.size ());
+  for (std::size_t i = 0; i < centers.size (); ++i) {
+    Vec3f gradient;
+    BOOST_CHECK_EQUAL (distances[i],
+                       field.sphereDistance (centers[i], radii[i], &gradient));
+    BOOST_CHECK (gradients[i] == gradient);
+  }
+  radii.assign (a.size (), capsule.radius);
+  field.capsuleDistances (a, b, radii, distances);
+  BOOST_REQUIRE_EQUAL (distances.size (), a.size ());
+  for (std::size_t i = 0; i < a.size (); ++i)
+    BOOST_CHECK_EQUAL (distances[i], field.capsuleDistance (a[i], b[i], radii[i]));
+}
+
+BOOST_AUTO_TEST_CASE(truncated_distances)
+{
+  // A single cell at the center of the field.
+  LinearOcTree tree (resolution, std::vector<Vec3f> (1, Vec3f::Constant (.05)));
+  BOOST_CHECK_THROW (DistanceField invalid (tree, resolution, bounds, 0),
+                     std::invalid_argument);
+
+  const FCL_REAL max_distance (.2);
+  DistanceField field (tree, resolution / 2, bounds, max_distance);
+
+  // A sphere in free space, farther than the maximal distance from the cell.
+  Sphere sphere (.1);
+  Transform3f tf (Vec3f (.5, .5, .5));
+  CollisionRequest collisionRequest;
+  CollisionResult collisionResult;
+  BOOST_CHECK_EQUAL (collide (&field, Transform3f (), &sphere, tf,
+                              collisionRequest, collisionResult), 0u);
+  BOOST_CHECK (collisionResult.distance_lower_bound >= max_distance - sphere.radius - 1e-6);
+
+  DistanceRequest distanceRequest;
+  DistanceResult distanceResult;
+  distance (&field, Transform3f (), &sphere, tf, distanceRequest, distanceResult);
+  BOOST_CHECK_EQUAL (distanceResult.min_distance, std::numeric_limits<FCL_REAL>::max ());
+  BOOST_CHECK_CLOSE (distanceResult.distance_lower_bound,
+                     max_distance - sphere.radius, 1e-6);
+
+  // The field cannot tell whether a sphere larger than the maximal distance
+  // is in collision.
+  Sphere large (.3);
+  collisionResult.clear ();
+  BOOST_CHECK_THROW (collide (&field, Transform3f (), &large, tf,
+                              collisionRequest, collisionResult),
+                     std::invalid_argument);
+  collisionRequest.security_margin = .15;
+  BOOST_CHECK_THROW (collide (&sphere, tf, &field, Transform3f (),
+                              collisionRequest, collisionResult),
+                     std::invalid_argument);
+
+  distanceResult.clear ();
+  distance (&field, Transform3f (), &large, tf, distanceRequest, distanceResult);
+  BOOST_CHECK_EQUAL (distanceResult.min_distance, std::numeric_limits<FCL_REAL>::max ());
+  BOOST_CHECK (distanceResult.distance_lower_bound <= (.5 - .1) * std::sqrt (3.) - large.radius);
+}
@@ -43,6 +43,8 @@
 #include <hpp/fcl/internal/traversal_node_setup.h>
 #include <../src/collision_node.h>
 #include <hpp/fcl/internal/BV_splitter.h>
+#include <hpp/fcl/collision.h>
+#include <hpp/fcl/distance.h>
 #include "utility.h"
 
 #include "fcl_resources/config.h"
@@ -202,6 +204,67 @@ BOOST_AUTO_TEST_CASE(front_list)
 
 }
 
+template<typename BV>
+void testComputeWithFrontList(const std::vector<Vec3f>& p1, const std::vector<Triangle>& t1,
+                              const std::vector<Vec3f>& p2, const std::vector<Triangle>& t2,
+                              const std::vector<Transform3f>& transforms,
+                              const std::vector<Transform3f>& transforms2)
+{
+  boost::shared_ptr<BVHModel<BV> > m1 (new BVHModel<BV>), m2 (new BVHModel<BV>);
+  m1->beginModel(); m1->addSubModel(p1, t1); m1->endModel();
+  m2->beginModel(); m2->addSubModel(p2, t2); m2->endModel();
+
+  ComputeCollision calc_collision (m1.get(), m2.get());
+  ComputeDistance calc_distance (m1.get(), m2.get());
+  calc_collision.enableFrontList(true);
+  calc_distance.enableFrontList(true);
+  BOOST_CHECK(calc_collision.frontListEnabled());
+
+  CollisionRequest colRequest (CONTACT, 100000);
+  DistanceRequest distRequest;
+  // Move the robot from transforms[i] to transforms2[i] in small steps.
+  for(std::size_t i = 0; i < transforms.size(); ++i)
+  {
+    calc_collision.clearFrontList();
+    calc_distance.clearFrontList();
+    for(int k = 0; k <= 10; ++k)
+    {
+      Transform3f tf (transforms[i].getRotation(),
+          transforms[i].getTranslation() + (transforms2[i].getTranslation()
+            - transforms[i].getTranslation()) * (FCL_REAL)k / 10);
+
+      CollisionResult colRes, colRef;
+      calc_collision(Transform3f(), tf, colRequest, colRes);
+      collide(m1.get(), Transform3f(), m2.get(), tf, colRequest, colRef);
+      BOOST_CHECK_EQUAL(colRes.numContacts(), colRef.numContacts());
+      BOOST_CHECK(!calc_collision.frontList().empty());
+
+      DistanceResult distRes, distRef;
+      calc_distance(Transform3f(), tf, distRequest, distRes);
+      distance(m1.get(), Transform3f(), m2.get(), tf, distRequest, distRef);
+      BOOST_CHECK_CLOSE(distRes.min_distance, distRef.min_distance, 1e-6);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(compute_with_front_list)
+{
+  std::vector<Vec3f> p1, p2;
+  std::vector<Triangle> t1, t2;
+  boost::filesystem::path path(TEST_RESOURCES_DIR);
+  loadOBJFile((path / "env.obj").string().c_str(), p1, t1);
+  loadOBJFile((path / "rob.obj").string().c_str(), p2, t2);
+
+  std::vector<Transform3f> transforms, transforms2;
+  FCL_REAL extents[] = {-3000, -3000, 0, 3000, 3000, 3000};
+  FCL_REAL delta_trans[] = {100, 100, 100};
+  generateRandomTransforms(extents, delta_trans, 0.005 * 2 * 3.1415, transforms, transforms2, 10);
+
+  testComputeWithFrontList<AABB>(p1, t1, p2, t2, transforms, transforms2);
+  testComputeWithFrontList<RSS>(p1, t1, p2, t2, transforms, transforms2);
+  testComputeWithFrontList<OBBRSS>(p1, t1, p2, t2, transforms, transforms2);
+}
+
 template<typename BV>
 bool collide_front_list_Test(const Transform3f& tf1, const Transform3f& tf2,
                              const std::vector<Vec3f>& vertices1, const std::vector<Triangle>& triangles1,
@@ -0,0 +1,666 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, CNRS - LAAS
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of CNRS-LAAS. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define BOOST_TEST_MODULE FCL_LINEAR_OCTREE
+#include <boost/test/included/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <fstream>
+
+#include <hpp/fcl/linear_octree.h>
+#include <hpp/fcl/box_set.h>
+#include <hpp/fcl/linear_octree_serialization.h>
+#include <hpp/fcl/octree_change_tracker.h>
+#include <hpp/fcl/collision.h>
+#include <hpp/fcl/distance.h>
+#include <hpp/fcl/BVH/BVH_model.h>
+#include <hpp/fcl/shape/geometric_shapes.h>
+#include <hpp/fcl/shape/geometric_shape_to_BVH_model.h>
+#include <hpp/fcl/mesh_loader/loader.h>
+
+#include "utility.h"
+
+using namespace hpp::fcl;
+
+typedef std::vector<boost::array<FCL_REAL, 6> > Boxes_t;
+
+/// Occupy randomly the cells of a 8x8x8 grid of cells of size resolution.
+std::vector<Vec3f> makeCells (FCL_REAL resolution)
+{
+  std::vector<Vec3f> points;
+  for (int i = 0; i < 8; ++i)
+    for (int j = 0; j < 8; ++j)
+      for (int k = 0; k < 8; ++k)
+        if (rand_interval (0, 1) < 0.3)
+          points.push_back (resolution * Vec3f (i - 4 + .5, j - 4 + .5, k - 4 + .5));
+  return points;
+}
+
+bool collideBoxes (const Boxes_t& boxes, const CollisionGeometry* o,
+                   const Transform3f& tf)
+{
+  CollisionRequest request;
+  for (std::size_t i = 0; i < boxes.size(); ++i) {
+    Box box (boxes[i][3], boxes[i][3], boxes[i][3]);
+    Transform3f tfBox (Vec3f (boxes[i][0], boxes[i][1], boxes[i][2]));
+    CollisionResult result;
+    if (collide (&box, tfBox, o, tf, request, result)) return true;
+  }
+  return false;
+}
+
+FCL_REAL distanceBoxes (const Boxes_t& boxes, const CollisionGeometry* o,
+                        const Transform3f& tf)
+{
+  DistanceRequest request;
+  FCL_REAL d = std::numeric_limits<FCL_REAL>::max();
+  for (std::size_t i = 0; i < boxes.size(); ++i) {
+    Box box (boxes[i][3], boxes[i][3], boxes[i][3]);
+    Transform3f tfBox (Vec3f (boxes[i][0], boxes[i][1], boxes[i][2]));
+    DistanceResult result;
+    d = std::min (d, distance (&box, tfBox, o, tf, request, result));
+  }
+  return d;
+}
+
+BOOST_AUTO_TEST_CASE(structure)
+{
+  FCL_REAL resolution (0.1);
+  std::vector<Vec3f> points (makeCells (resolution));
+  // Duplicated points and points outside of the root cell are ignored.
+  points.push_back (points.front ());
+  points.push_back (Vec3f (1e6, 0, 0));
+  LinearOcTree tree (resolution, points);
+
+  BOOST_CHECK_EQUAL (tree.getNodeType (), GEOM_LINEAR_OCTREE);
+  BOOST_CHECK_EQUAL (tree.getTreeDepth (), 16u);
+  BOOST_REQUIRE (tree.getRoot () != NULL);
+
+  Boxes_t boxes (tree.toBoxes ());
+  BOOST_CHECK_EQUAL (boxes.size (), points.size () - 2);
+  for (std::size_t i = 0; i < boxes.size (); ++i) {
+    BOOST_CHECK_CLOSE (boxes[i][3], resolution, 1e-8);
+    Vec3f center (boxes[i][0], boxes[i][1], boxes[i][2]);
+    bool found = false;
+    for (std::size_t j = 0; j < points.size () && !found; ++j)
+      found = (center - points[j]).isZero (1e-8);
+    BOOST_CHECK (found);
+  }
+
+  // The children of a node are stored after it, contiguously, and every node
+  // but the root is the child of exactly one node.
+  const LinearOcTree::Node* nodes (tree.getNodes ());
+  std::vector<int> parents (tree.size (), 0);
+  for (std::size_t i = 0; i < tree.size (); ++i) {
+    for (unsigned int c = 0; c < 8; ++c) {
+      if (!tree.nodeChildExists (&nodes[i], c)) continue;
+      std::size_t child = (std::size_t) (tree.getNodeChild (&nodes[i], c) - &nodes[0]);
+      BOOST_CHECK (child > i);
+      BOOST_CHECK (child < tree.size ());
+      ++parents[child];
+    }
+    BOOST_CHECK (tree.isNodeOccupied (&nodes[i]));
+  }
+  BOOST_CHECK_EQUAL (parents[0], 0);
+  for (std::size_t i = 1; i < tree.size (); ++i)
+    BOOST_CHECK_EQUAL (parents[i], 1);
+
+  // Raising the occupancy threshold above the occupancy of the cells makes
+  // them uncertain.
+  tree.setOccupancyThres (1.5);
+  BOOST_CHECK (tree.isNodeUncertain (tree.getRoot ()));
+  BOOST_CHECK (tree.toBoxes ().empty ());
+
+  LinearOcTree empty (resolution);
+  BOOST_CHECK (empty.getRoot () == NULL);
+  BOOST_CHECK (empty.toBoxes ().empty ());
+}
+
+BOOST_AUTO_TEST_CASE(shapes_and_meshes)
+{
+  FCL_REAL resolution (0.1);
+  LinearOcTree tree (resolution, makeCells (resolution));
+  Boxes_t boxes (tree.toBoxes ());
+
+  Sphere sphere (0.07);
+  Box box (0.05, 0.2, 0.1);
+  Capsule capsule (0.03, 0.2);
+  TriangleP triangle (Vec3f (-0.1, 0, 0), Vec3f (0.1, 0.02, 0), Vec3f (0, 0.1, 0.05));
+  BVHModel<OBBRSS> mesh;
+  generateBVHModel (mesh, Box (0.1, 0.05, 0.2), Transform3f ());
+
+  FCL_REAL extents[] = {-0.5, -0.5, -0.5, 0.5, 0.5, 0.5};
+  std::vector<Transform3f> transforms;
+  generateRandomTransforms (extents, transforms, 200);
+
+  // The cells are tested against the shapes and the triangles with closed
+  // form tests when the contact information is not requested, and with GJK
+  // otherwise.
+  const CollisionGeometry* geoms[] = { &sphere, &box, &capsule, &triangle, &mesh };
+  for (std::size_t g = 0; g < 5; ++g) {
+    for (std::size_t i = 0; i < transforms.size (); ++i) {
+      bool expected = collideBoxes (boxes, geoms[g], transforms[i]);
+
+      for (int contact = 0; contact < 2; ++contact) {
+        CollisionRequest request (contact ? CONTACT : NO_REQUEST, 1);
+        CollisionResult result;
+        collide (&tree, Transform3f (), geoms[g], transforms[i], request, result);
+        BOOST_CHECK_EQUAL (result.isCollision (), expected);
+        result.clear ();
+        collide (geoms[g], transforms[i], &tree, Transform3f (), request, result);
+        BOOST_CHECK_EQUAL (result.isCollision (), expected);
+      }
+
+      if (g == 4 || expected) continue;
+      FCL_REAL d = distanceBoxes (boxes, geoms[g], transforms[i]);
+      DistanceRequest drequest;
+      DistanceResult dresult;
+      distance (&tree, Transform3f (), geoms[g], transforms[i], drequest, dresult);
+      BOOST_CHECK_CLOSE (dresult.min_distance, d, 1e-4);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(octree_octree)
+{
+  FCL_REAL resolution (0.1);
+  LinearOcTree tree1 (resolution, makeCells (resolution));
+  LinearOcTree tree2 (resolution, makeCells (resolution));
+  Boxes_t boxes1 (tree1.toBoxes ()), boxes2 (tree2.toBoxes ());
+
+  FCL_REAL extents[] = {-0.8, -0.8, -0.8, 0.8, 0.8, 0.8};
+  std::vector<Transform3f> transforms;
+  generateRandomTransforms (extents, transforms, 50);
+
+  for (std::size_t i = 0; i < transforms.size (); ++i) {
+    bool expected = false;
+    for (std::size_t j = 0; j < boxes2.size () && !expected; ++j) {
+      Box box (boxes2[j][3], boxes2[j][3], boxes2[j][3]);
+      Transform3f tfBox (transforms[i] *
+                         Transform3f (Vec3f (boxes2[j][0], boxes2[j][1], boxes2[j][2])));
+      expected = collideBoxes (boxes1, &box, tfBox);
+    }
+
+    CollisionRequest request;
+    CollisionResult result;
+    collide (&tree1, Transform3f (), &tree2, transforms[i], request, result);
+    BOOST_CHECK_EQUAL (result.isCollision (), expected);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(merged_boxes)
+{
+  FCL_REAL resolution (0.1);
+  LinearOcTree tree (resolution, makeCells (resolution));
+  Boxes_t boxes (tree.toBoxes ());
+  std::vector<AABB> merged (tree.toMergedBoxes ());
+
+  // The merged boxes cover exactly the occupied cells.
+  BOOST_CHECK (merged.size () < boxes.size ());
+  FCL_REAL volume (0);
+  for (std::size_t i = 0; i < merged.size (); ++i) {
+    volume += merged[i].volume ();
+    for (std::size_t j = 0; j < i; ++j) {
+      AABB overlap;
+      if (merged[i].overlap (merged[j], overlap))
+        BOOST_CHECK_SMALL (overlap.volume (), 1e-12);
+    }
+  }
+  BOOST_CHECK_CLOSE (volume, (FCL_REAL) boxes.size () * std::pow (resolution, 3), 1e-8);
+  for (std::size_t i = 0; i < boxes.size (); ++i) {
+    Vec3f center (boxes[i][0], boxes[i][1], boxes[i][2]);
+    bool found = false;
+    for (std::size_t j = 0; j < merged.size () && !found; ++j)
+      found = merged[j].contain (center);
+    BOOST_CHECK (found);
+  }
+
+  // A full block of cells is a single box.
+  std::vector<Vec3f> points;
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 6; ++j)
+      for (int k = 0; k < 3; ++k)
+        points.push_back (resolution * Vec3f (i + .5, j - 2.5, k + 1.5));
+  merged = LinearOcTree (resolution, points).toMergedBoxes ();
+  BOOST_REQUIRE_EQUAL (merged.size (), 1u);
+  BOOST_CHECK (merged[0].min_.isApprox (resolution * Vec3f (0, -3, 1)));
+  BOOST_CHECK (merged[0].max_.isApprox (resolution * Vec3f (4, 3, 4)));
+
+  // A shape inside the block collides with the set of its boxes.
+  BoxSet block (merged);
+  Sphere small (0.05);
+  Transform3f inside (Vec3f (resolution * Vec3f (2, 0, 2.5)));
+  CollisionRequest request;
+  CollisionResult result;
+  BOOST_CHECK (collide (&block, Transform3f (), &small, inside, request, result));
+  DistanceRequest drequest;
+  DistanceResult dresult;
+  BOOST_CHECK (distance (&small, inside, &block, Transform3f (), drequest, dresult) < 0);
+
+  // The set of the merged boxes answers the queries of the occupied cells.
+  merged = tree.toMergedBoxes ();
+  BoxSet set (merged);
+  BOOST_CHECK_EQUAL (set.getNodeType (), GEOM_BOX_SET);
+  BOOST_CHECK_EQUAL (set.getNodes ().size (), 2 * merged.size () - 1);
+
+  Sphere sphere (0.07);
+  FCL_REAL extents[] = {-0.5, -0.5, -0.5, 0.5, 0.5, 0.5};
+  std::vector<Transform3f> transforms;
+  generateRandomTransforms (extents, transforms, 200);
+  for (std::size_t i = 0; i < transforms.size (); ++i) {
+    result.clear ();
+    bool expected = collideBoxes (boxes, &sphere, transforms[i]);
+    BOOST_CHECK_EQUAL (collide (&set, Transform3f (), &sphere, transforms[i],
+                                request, result) > 0, expected);
+    if (result.isCollision ()) {
+      const AABB& box = merged[result.getContact (0).b1];
+      BOOST_CHECK (box.distance (AABB (transforms[i].getTranslation ())) <= sphere.radius + 1e-8);
+    }
+    if (expected) continue;
+
+    dresult.clear ();
+    distance (&sphere, transforms[i], &set, Transform3f (), drequest, dresult);
+    BOOST_CHECK_CLOSE (dresult.min_distance,
+                       distanceBoxes (boxes, &sphere, transforms[i]), 1e-4);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(several_shapes)
+{
+  FCL_REAL resolution (0.1);
+  LinearOcTree tree (resolution, makeCells (resolution));
+
+  Sphere sphere (0.07);
+  Capsule capsule (0.03, 0.2);
+  Box box (0.05, 0.2, 0.1);
+  Cylinder cylinder (0.05, 0.1);
+  const CollisionGeometry* geoms[] = { &sphere, &capsule, &box, &cylinder };
+
+  FCL_REAL extents[] = {-0.5, -0.5, -0.5, 0.5, 0.5, 0.5};
+  std::vector<Transform3f> transforms;
+  generateRandomTransforms (extents, transforms, 40);
+  std::vector<const CollisionGeometry*> shapes;
+  for (std::size_t i = 0; i < transforms.size (); ++i)
+    shapes.push_back (geoms[i % 4]);
+  Transform3f tfTree;
+  tfTree.setQuatRotation (Quaternion3f (.5, .5, .5, .5));
+  tfTree.setTranslation (Vec3f (.1, -.2, .3));
+  for (std::size_t i = 0; i < transforms.size (); ++i)
+    transforms[i] = tfTree * transforms[i];
+
+  // Each result is the result of a query with the shape alone.
+  for (int contact = 0; contact < 2; ++contact) {
+    CollisionRequest request (contact ? CONTACT : NO_REQUEST, 1);
+    std::vector<CollisionResult> results;
+    std::size_t n = collide (&tree, tfTree, shapes, transforms, request, results);
+    BOOST_REQUIRE_EQUAL (results.size (), shapes.size ());
+    std::size_t expected_n = 0;
+    for (std::size_t i = 0; i < shapes.size (); ++i) {
+      CollisionResult result;
+      collide (&tree, tfTree, shapes[i], transforms[i], request, result);
+      BOOST_CHECK_EQUAL (results[i].isCollision (), result.isCollision ());
+      if (!result.isCollision ()) continue;
+      ++expected_n;
+      BOOST_CHECK (results[i].getContact (0).o1 == &tree);
+      BOOST_CHECK (results[i].getContact (0).o2 == shapes[i]);
+    }
+    BOOST_CHECK_EQUAL (n, expected_n);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parallel)
+{
+  // The parallel traversals find the same contacts, in the same order, and
+  // the same distances as the sequential ones.
+  FCL_REAL resolution (0.1);
+  LinearOcTree tree1 (resolution, makeCells (resolution));
+  LinearOcTree tree2 (resolution, makeCells (resolution));
+  BVHModel<OBBRSS> mesh;
+  generateBVHModel (mesh, Sphere (0.3), Transform3f (), 10, 10);
+
+  FCL_REAL extents[] = {-0.8, -0.8, -0.8, 0.8, 0.8, 0.8};
+  std::vector<Transform3f> transforms;
+  generateRandomTransforms (extents, transforms, 50);
+
+  const CollisionGeometry* geoms[] = { &tree2, &mesh };
+  for (std::size_t g = 0; g < 2; ++g) {
+    for (std::size_t i = 0; i < transforms.size (); ++i) {
+      for (std::size_t max_contacts = 1; max_contacts < 1000; max_contacts *= 30) {
+        CollisionRequest request (NO_REQUEST, max_contacts);
+        CollisionResult result;
+        collide (&tree1, Transform3f (), geoms[g], transforms[i], request, result);
+
+        request.num_threads = 4;
+        CollisionResult presult;
+        collide (&tree1, Transform3f (), geoms[g], transforms[i], request, presult);
+        BOOST_REQUIRE_EQUAL (presult.numContacts (), result.numContacts ());
+        for (std::size_t k = 0; k < result.numContacts (); ++k) {
+          BOOST_CHECK_EQUAL (presult.getContact (k).b1, result.getContact (k).b1);
+          BOOST_CHECK_EQUAL (presult.getContact (k).b2, result.getContact (k).b2);
+        }
+
+        // The threads merge the statistics of the narrow phase. When the
+        // contacts are not all found, no task is cancelled and the threads
+        // run the same tests.
+        if (result.numContacts () == max_contacts) continue;
+        request = CollisionRequest (CONTACT, max_contacts);
+        request.enable_statistics = true;
+        result.clear ();
+        presult.clear ();
+        collide (&tree1, Transform3f (), geoms[g], transforms[i], request, result);
+        request.num_threads = 4;
+        collide (&tree1, Transform3f (), geoms[g], transforms[i], request, presult);
+        BOOST_CHECK_EQUAL (presult.statistics.num_gjk_calls,
+                           result.statistics.num_gjk_calls);
+      }
+
+      DistanceRequest drequest;
+      DistanceResult dresult;
+      distance (&tree1, Transform3f (), geoms[g], transforms[i], drequest, dresult);
+
+      drequest.num_threads = 4;
+      DistanceResult pdresult;
+      distance (&tree1, Transform3f (), geoms[g], transforms[i], drequest, pdresult);
+      // Both traversals stop at the first pair in collision.
+      if (dresult.min_distance <= 0)
+        BOOST_CHECK (pdresult.min_distance <= 0);
+      else
+        BOOST_CHECK_CLOSE (pdresult.min_distance, dresult.min_distance, 1e-8);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(max_depth)
+{
+  FCL_REAL resolution (0.1);
+  LinearOcTree tree (resolution, makeCells (resolution));
+  BVHModel<OBBRSS> mesh;
+  generateBVHModel (mesh, Sphere (0.2), Transform3f (), 10, 10);
+  Sphere sphere (0.1);
+
+  FCL_REAL extents[] = {-0.8, -0.8, -0.8, 0.8, 0.8, 0.8};
+  std::vector<Transform3f> transforms;
+  generateRandomTransforms (extents, transforms, 100);
+
+  const CollisionGeometry* geoms[] = { &sphere, &mesh };
+  for (std::size_t g = 0; g < 2; ++g) {
+    for (unsigned int depth = tree.getTreeDepth () - 4;
+         depth < tree.getTreeDepth (); ++depth) {
+      for (std::size_t i = 0; i < transforms.size (); ++i) {
+        // The coarse queries are conservative.
+        CollisionRequest request;
+        CollisionResult result;
+        bool full = collide (&tree, Transform3f (), geoms[g], transforms[i],
+                             request, result) > 0;
+        request.octree_max_depth = depth;
+        result.clear ();
+        bool coarse = collide (&tree, Transform3f (), geoms[g], transforms[i],
+                               request, result) > 0;
+        BOOST_CHECK (coarse || !full);
+
+        // The refined queries give the result at full depth.
+        request.octree_refine = true;
+        result.clear ();
+        bool refined = collide (&tree, Transform3f (), geoms[g], transforms[i],
+                                request, result) > 0;
+        BOOST_CHECK_EQUAL (refined, full);
+
+        DistanceRequest drequest;
+        DistanceResult dresult;
+        FCL_REAL dfull = distance (&tree, Transform3f (), geoms[g],
+                                   transforms[i], drequest, dresult);
+        drequest.octree_max_depth = depth;
+        dresult.clear ();
+        FCL_REAL dcoarse = distance (&tree, Transform3f (), geoms[g],
+                                     transforms[i], drequest, dresult);
+        BOOST_CHECK (dcoarse <= std::max (dfull, 0.) + 1e-8);
+
+        // Above the refine distance, the coarse distance is kept.
+        drequest.octree_refine = true;
+        drequest.octree_refine_distance = 0.1;
+        dresult.clear ();
+        FCL_REAL drefined = distance (&tree, Transform3f (), geoms[g],
+                                      transforms[i], drequest, dresult);
+        if (dcoarse > drequest.octree_refine_distance)
+          BOOST_CHECK_EQUAL (drefined, dcoarse);
+        else if (dfull > 0)
+          BOOST_CHECK_CLOSE (drefined, dfull, 1e-6);
+        else
+          BOOST_CHECK (drefined <= 0);
+      }
+    }
+  }
+
+  // Only the shapes in collision at the coarse depth are refined.
+  std::vector<const CollisionGeometry*> shapes (transforms.size (), &sphere);
+  CollisionRequest request;
+  std::vector<CollisionResult> full, refined;
+  collide (&tree, Transform3f (), shapes, transforms, request, full);
+  request.octree_max_depth = tree.getTreeDepth () - 3;
+  request.octree_refine = true;
+  collide (&tree, Transform3f (), shapes, transforms, request, refined);
+  for (std::size_t i = 0; i < shapes.size (); ++i)
+    BOOST_CHECK_EQUAL (refined[i].isCollision (), full[i].isCollision ());
+}
+
+BOOST_AUTO_TEST_CASE(changes)
+{
+  FCL_REAL resolution (0.1);
+  std::vector<Vec3f> points (makeCells (resolution));
+  LinearOcTree tree (resolution, points);
+  BOOST_CHECK (tree.changedRegions (tree).empty ());
+
+  // Change the cells of a corner of the map.
+  AABB corner (Vec3f (-.4, -.4, -.4), Vec3f (-.1, -.1, -.1));
+  std::vector<Vec3f> changed;
+  for (std::size_t i = 0; i < points.size (); ++i)
+    if (!corner.contain (points[i])) changed.push_back (points[i]);
+  for (int n = 0; n < 5; ++n)
+    changed.push_back (Vec3f (rand_interval (-.4, -.1), rand_interval (-.4, -.1),
+                              rand_interval (-.4, -.1)));
+  LinearOcTree changed_tree (resolution, changed);
+
+  // The regions cover the cells which changed, and only them.
+  std::vector<AABB> regions (changed_tree.changedRegions (tree));
+  std::vector<Vec3f> cells[2] = { points, changed };
+  for (int t = 0; t < 2; ++t) {
+    for (std::size_t i = 0; i < cells[t].size (); ++i) {
+      Vec3f c (cells[t][i]);
+      for (int a = 0; a < 3; ++a)
+        c[a] = resolution * (std::floor (c[a] / resolution) + .5);
+      bool changed_cell = true;
+      for (std::size_t j = 0; j < cells[1 - t].size (); ++j)
+        if (AABB (c).expand (Vec3f::Constant (resolution / 2))
+            .contain (cells[1 - t][j]))
+          changed_cell = false;
+      bool in_region = false;
+      for (std::size_t j = 0; j < regions.size (); ++j)
+        if (regions[j].contain (c)) in_region = true;
+      BOOST_CHECK_EQUAL (in_region, changed_cell);
+    }
+  }
+  for (std::size_t j = 0; j < regions.size (); ++j)
+    BOOST_CHECK (corner.contain (regions[j].center ()));
+
+  // The results which stay valid are the same as with the new octree.
+  OcTreeChangeTracker tracker;
+  OcTreeChangeTracker::Stamp stamp (tracker.getStamp ());
+  Sphere sphere (0.05);
+  sphere.computeLocalAABB ();
+  FCL_REAL extents[] = {-0.5, -0.5, -0.5, 0.5, 0.5, 0.5};
+  std::vector<Transform3f> transforms;
+  generateRandomTransforms (extents, transforms, 200);
+  std::vector<bool> cached;
+  CollisionRequest request;
+  for (std::size_t i = 0; i < transforms.size (); ++i) {
+    CollisionResult result;
+    cached.push_back (collide (&tree, Transform3f (), &sphere, transforms[i],
+                               request, result) > 0);
+  }
+
+  BOOST_CHECK_EQUAL (tracker.addUpdate (regions), stamp + 1);
+  BOOST_CHECK (corner.contain (tracker.getDirtyRegion (stamp)));
+  std::size_t valid = 0;
+  for (std::size_t i = 0; i < transforms.size (); ++i) {
+    if (!tracker.isValid (&sphere, transforms[i], Transform3f (), stamp))
+      continue;
+    ++valid;
+    CollisionResult result;
+    bool res = collide (&changed_tree, Transform3f (), &sphere, transforms[i],
+                        request, result) > 0;
+    BOOST_CHECK_EQUAL (res, cached[i]);
+  }
+  BOOST_CHECK (valid > 0);
+
+  // The results older than the history are not valid.
+  OcTreeChangeTracker short_tracker (1);
+  short_tracker.addUpdate (std::vector<AABB> ());
+  short_tracker.addUpdate (std::vector<AABB> ());
+  BOOST_CHECK (short_tracker.isValid (AABB (), 1));
+  BOOST_CHECK (!short_tracker.isValid (AABB (), 0));
+}
+
+void checkSaveLoad (bool memory_map)
+{
+  FCL_REAL resolution (0.1);
+  LinearOcTree tree (resolution, makeCells (resolution));
+  std::string filename = (boost::filesystem::temp_directory_path()
+      / boost::filesystem::unique_path("%%%%-%%%%-%%%%.lot")).string();
+  saveLinearOcTree (tree, filename);
+  BOOST_CHECK (isLinearOcTreeFile (filename));
+
+  boost::shared_ptr<LinearOcTree> loaded (loadLinearOcTree (filename, memory_map));
+  BOOST_REQUIRE (loaded);
+  BOOST_CHECK_EQUAL (loaded->isMemoryMapped (), memory_map);
+  BOOST_CHECK_EQUAL (loaded->getResolution (), tree.getResolution ());
+  BOOST_CHECK_EQUAL (loaded->getTreeDepth (), tree.getTreeDepth ());
+  BOOST_CHECK_EQUAL (loaded->getOccupancyThres (), tree.getOccupancyThres ());
+  BOOST_REQUIRE_EQUAL (loaded->size (), tree.size ());
+  for (std::size_t i = 0; i < tree.size (); ++i) {
+    const LinearOcTree::Node& n1 = tree.getNodes ()[i], n2 = loaded->getNodes ()[i];
+    BOOST_CHECK_EQUAL (n1.first_child, n2.first_child);
+    BOOST_CHECK_EQUAL (n1.child_mask, n2.child_mask);
+    BOOST_CHECK_EQUAL (n1.flags, n2.flags);
+    BOOST_CHECK_EQUAL (n1.occupancy, n2.occupancy);
+  }
+
+  // Both octrees must give the same collision results.
+  Sphere sphere (0.05);
+  FCL_REAL extents[] = {-0.5, -0.5, -0.5, 0.5, 0.5, 0.5};
+  std::vector<Transform3f> transforms;
+  generateRandomTransforms (extents, transforms, 100);
+  for (std::size_t i = 0; i < transforms.size (); ++i) {
+    CollisionRequest request (CONTACT, 10);
+    CollisionResult r1, r2;
+    collide (&tree, Transform3f (), &sphere, transforms[i], request, r1);
+    collide (loaded.get (), Transform3f (), &sphere, transforms[i], request, r2);
+    BOOST_CHECK_EQUAL (r1.numContacts (), r2.numContacts ());
+  }
+
+  // The copies share the mapping. Changing the thresholds of one copies the
+  // nodes first.
+  LinearOcTree copy (*loaded);
+  BOOST_CHECK_EQUAL (copy.isMemoryMapped (), memory_map);
+  BOOST_CHECK_EQUAL (copy.getNodes () == loaded->getNodes (), memory_map);
+  copy.setOccupancyThres (1.5);
+  BOOST_CHECK (!copy.isMemoryMapped ());
+  BOOST_CHECK (copy.getRoot ()->flags != loaded->getRoot ()->flags);
+  BOOST_CHECK_EQUAL (loaded->getRoot ()->flags, tree.getRoot ()->flags);
+
+  // The mesh loader maps the files of LinearOcTree.
+  MeshLoader loader;
+  CollisionGeometryPtr_t geom (loader.loadOctree (filename));
+  BOOST_REQUIRE (geom);
+  BOOST_CHECK_EQUAL (geom->getNodeType (), GEOM_LINEAR_OCTREE);
+  BOOST_CHECK (boost::static_pointer_cast<LinearOcTree> (geom)->isMemoryMapped ());
+
+  loaded.reset ();
+  geom.reset ();
+  boost::filesystem::remove (filename);
+}
+
+BOOST_AUTO_TEST_CASE(save_load)
+{
+  checkSaveLoad (true);
+  checkSaveLoad (false);
+
+  // The other files are rejected.
+  std::string filename = (boost::filesystem::temp_directory_path()
+      / boost::filesystem::unique_path("%%%%-%%%%-%%%%.lot")).string();
+  {
+    std::ofstream os (filename.c_str());
+    os << "not an octree";
+  }
+  BOOST_CHECK (!isLinearOcTreeFile (filename));
+  BOOST_CHECK_THROW (loadLinearOcTree (filename), std::runtime_error);
+  BOOST_CHECK_THROW (loadLinearOcTree (filename, false), std::runtime_error);
+
+  // So are the files whose nodes have children outside of the node array.
+  // The last node is a leaf, which is given children.
+  FCL_REAL resolution (0.1);
+  saveLinearOcTree (LinearOcTree (resolution, makeCells (resolution)), filename);
+  {
+    std::fstream fs (filename.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+    fs.seekp ((std::streamoff) boost::filesystem::file_size (filename)
+              - (std::streamoff) sizeof (LinearOcTree::Node)
+              + (std::streamoff) offsetof (LinearOcTree::Node, child_mask));
+    fs.put ((char) 1);
+  }
+  BOOST_CHECK (isLinearOcTreeFile (filename));
+  BOOST_CHECK_THROW (loadLinearOcTree (filename), std::runtime_error);
+  BOOST_CHECK_THROW (loadLinearOcTree (filename, false), std::runtime_error);
+
+  // And the files whose nodes are not aligned. In the header, the offset of
+  // the nodes follows their number.
+  LinearOcTree tree (resolution, makeCells (resolution));
+  saveLinearOcTree (tree, filename);
+  {
+    std::fstream fs (filename.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+    std::string content ((std::istreambuf_iterator<char> (fs)),
+                         std::istreambuf_iterator<char> ());
+    const boost::uint64_t num_nodes (tree.size ());
+    std::size_t position = content.find (std::string (
+          reinterpret_cast<const char*> (&num_nodes), sizeof (num_nodes)));
+    BOOST_REQUIRE (position != std::string::npos);
+    boost::uint64_t nodes_offset;
+    std::memcpy (&nodes_offset, &content[position + sizeof (num_nodes)],
+                 sizeof (nodes_offset));
+    nodes_offset -= 8;
+    fs.seekp ((std::streamoff) (position + sizeof (num_nodes)));
+    fs.write (reinterpret_cast<const char*> (&nodes_offset), sizeof (nodes_offset));
+  }
+  BOOST_CHECK_THROW (loadLinearOcTree (filename), std::runtime_error);
+  BOOST_CHECK_THROW (loadLinearOcTree (filename, false), std::runtime_error);
+  boost::filesystem::remove (filename);
+}
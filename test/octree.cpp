@@ -56,6 +56,7 @@ using hpp::fcl::OBBRSS;
 using hpp::fcl::BVHModel;
 using hpp::fcl::BVSplitter;
 using hpp::fcl::OcTree;
+using hpp::fcl::LinearOcTree;
 using hpp::fcl::FCL_REAL;
 using hpp::fcl::Transform3f;
 using hpp::fcl::CollisionRequest;
@@ -165,3 +166,36 @@ BOOST_AUTO_TEST_CASE (OCTREE)
     }
   }
 }
+
+BOOST_AUTO_TEST_CASE (LINEAR_OCTREE)
+{
+  FCL_REAL resolution (0.1);
+  octomap::OcTreePtr_t octree (new octomap::OcTree (resolution));
+  for (std::size_t i = 0; i < 200; ++i) {
+    octomap::point3d p ((float) hpp::fcl::rand_interval (-1, 1),
+                        (float) hpp::fcl::rand_interval (-1, 1),
+                        (float) hpp::fcl::rand_interval (-1, 1));
+    octree->updateNode (p, i % 4 != 0);
+  }
+  octree->updateInnerOccupancy();
+  OcTree tree (octree);
+  LinearOcTree linear (tree);
+
+  BOOST_CHECK_EQUAL (linear.size (), octree->size ());
+  BOOST_CHECK_EQUAL (linear.getTreeDepth (), octree->getTreeDepth ());
+  BOOST_CHECK_EQUAL (linear.toBoxes ().size (), tree.toBoxes ().size ());
+
+  hpp::fcl::Sphere sphere (0.15);
+  std::vector<Transform3f> transforms;
+  FCL_REAL extents[] = {-1.2, -1.2, -1.2, 1.2, 1.2, 1.2};
+  generateRandomTransforms(extents, transforms, 100);
+  for (std::size_t i = 0; i < transforms.size (); ++i) {
+    CollisionRequest request;
+    CollisionResult result, linearResult;
+    hpp::fcl::collide (&tree, Transform3f (), &sphere, transforms[i],
+                       request, result);
+    hpp::fcl::collide (&linear, Transform3f (), &sphere, transforms[i],
+                       request, linearResult);
+    BOOST_CHECK_EQUAL (result.isCollision (), linearResult.isCollision ());
+  }
+}
@@ -399,6 +399,12 @@ std::string getNodeTypeName(NODE_TYPE node_type)
     return std::string("GEOM_TRIANGLE");
   else if (node_type == GEOM_OCTREE)
     return std::string("GEOM_OCTREE");
+  else if (node_type == GEOM_LINEAR_OCTREE)
+    return std::string("GEOM_LINEAR_OCTREE");
+  else if (node_type == GEOM_DISTANCE_FIELD)
+    return std::string("GEOM_DISTANCE_FIELD");
+  else if (node_type == GEOM_BOX_SET)
+    return std::string("GEOM_BOX_SET");
   else
     return std::string("invalid");
 }
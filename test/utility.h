@@ -120,6 +120,9 @@ fcl::OcTree loadOctreeFile (const std::string& filename, const FCL_REAL& resolut
 /// The translation is (x, y, z), and extents[0] <= x <= extents[3], extents[1] <= y <= extents[4], extents[2] <= z <= extents[5]
 void generateRandomTransform(FCL_REAL extents[6], Transform3f& transform);
 
+/// @brief Generate a random number in [rmin, rmax[
+FCL_REAL rand_interval(FCL_REAL rmin, FCL_REAL rmax);
+
 /// @brief Generate n random transforms whose translations are constrained by extents.
 void generateRandomTransforms(FCL_REAL extents[6], std::vector<Transform3f>& transforms, std::size_t n);
 